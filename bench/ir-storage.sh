@@ -0,0 +1,34 @@
+#!/usr/bin/env bash
+## Compare the memory use and walking speed of the IR stored as objects
+## and in packed form on a large generated program.
+##
+## Usage: bench/ir-storage.sh <path to intc> [number of statements] [intc flags...]
+set -eu
+
+if [ $# -lt 1 ]; then
+  echo "Usage: $0 <path to intc> [number of statements] [intc flags...]" >&2
+  exit 1
+fi
+
+intc="$1"
+count="${2:-20000}"
+shift $(( $# < 2 ? $# : 2 ))
+
+dir="$(mktemp -d)"
+trap 'rm -rf "$dir"' EXIT
+
+{
+  echo "big : integer(n : integer) {"
+  echo "  x0 : integer = n"
+  for (( i = 1; i <= count; i++ )); do
+    echo "  x$i : integer = x$(( i - 1 )) * 3 + $i"
+    if (( i % 8 == 0 )); then echo "  if x$i > n { x$i := x$i - n }"; fi
+  done
+  echo "  x$count"
+  echo "}"
+  echo
+  echo "big(42)"
+} > "$dir/big.int"
+
+## Exits with 42 after printing the results.
+"$intc" "$@" --bench-ir -o "$dir/big.s" "$dir/big.int" || [ $? -eq 42 ]
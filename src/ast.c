@@ -79,13 +79,11 @@ static Scope *scope_create(Scope *parent) {
 }
 
 static void scope_delete(Scope *scope) {
-  foreach_val (symbol, scope->symbols) {
-    free(symbol->name.data);
-    free(symbol);
-  }
+  foreach_val (symbol, scope->symbols) free(symbol);
 
   vector_delete(scope->symbols);
   vector_delete(scope->children);
+  map_delete(scope->symbol_index);
   free(scope);
 }
 
@@ -101,30 +99,34 @@ void scope_pop(Module *ast) {
   (void) vector_pop(ast->scope_stack);
 }
 
-Symbol *scope_add_symbol_unconditional(Scope *scope, enum SymbolKind kind, span name, void *value) {
+Symbol *scope_add_symbol_unconditional(Scope *scope, enum SymbolKind kind, string name, void *value) {
   Symbol *symbol = calloc(1, sizeof(Symbol));
   symbol->kind = kind;
-  symbol->name = string_dup(name);
+  symbol->name = name;
   symbol->scope = scope;
   if (kind == SYM_TYPE) symbol->val.type = value;
   else symbol->val.node = value;
   vector_push(scope->symbols, symbol);
+
+  /// Append the symbol to the chain of symbols with the same name.
+  Symbol **next = map_get_default(scope->symbol_index, (const char *) symbol->name.data);
+  while (*next) next = &(*next)->next_with_name;
+  *next = symbol;
   return symbol;
 }
 
 
-Symbol *scope_add_symbol(Scope *scope, enum SymbolKind kind, span name, void *value) {
+Symbol *scope_add_symbol(Scope *scope, enum SymbolKind kind, string name, void *value) {
   // Check if the symbol already exists.
   if (scope_find_symbol(scope, name, true)) return NULL;
   return scope_add_symbol_unconditional(scope, kind, name, value);
 }
 
-Symbol *scope_find_symbol(Scope *scope, span name, bool this_scope_only) {
+Symbol *scope_find_symbol(Scope *scope, string name, bool this_scope_only) {
   while (scope) {
     /// Return the symbol if it exists.
-    foreach_val (symbol, scope->symbols)
-      if (string_eq(symbol->name, name))
-        return symbol;
+    Symbol **first = map_get(scope->symbol_index, (const char *) name.data);
+    if (first) return *first;
 
     /// If we're only looking in the current scope, return NULL.
     if (this_scope_only) return NULL;
@@ -137,7 +139,7 @@ Symbol *scope_find_symbol(Scope *scope, span name, bool this_scope_only) {
   return NULL;
 }
 
-Symbol *scope_find_or_add_symbol(Scope *scope, enum SymbolKind kind, span name, bool this_scope_only) {
+Symbol *scope_find_or_add_symbol(Scope *scope, enum SymbolKind kind, string name, bool this_scope_only) {
   Symbol *symbol = scope_find_symbol(scope, name, this_scope_only);
   if (symbol) return symbol;
   return scope_add_symbol(scope, kind, name, NULL);
@@ -148,7 +150,7 @@ Symbol *scope_find_or_add_symbol(Scope *scope, enum SymbolKind kind, span name,
 /// ===========================================================================
 /// Internal helper to create a node.
 NODISCARD static Node *mknode(Module *ast, enum NodeKind kind, loc source_location) {
-  Node *node = calloc(1, sizeof(Node));
+  Node *node = arena_new(&ast->arena, Node);
   node->kind = kind;
   node->source_location = source_location;
   vector_push(ast->_nodes_, node);
@@ -157,13 +159,33 @@ NODISCARD static Node *mknode(Module *ast, enum NodeKind kind, loc source_locati
 
 /// Internal helper to create a type.
 NODISCARD static Type *mktype(Module *ast, enum TypeKind kind, loc source_location) {
-  Type *type = calloc(1, sizeof(Type));
+  Type *type = arena_new(&ast->arena, Type);
   type->kind = kind;
   type->source_location = source_location;
   vector_push(ast->_types_, type);
   return type;
 }
 
+/// Internal helper to look up a structural type or create it if it
+/// doesn’t exist yet. An interned type is shared by every occurrence
+/// of it, so it has no source location and must never be modified
+/// after creation.
+NODISCARD static Type *mktype_interned(
+  Module *ast,
+  enum TypeKind kind,
+  const void *element,
+  usz size,
+  bool is_signed
+) {
+  TypeInternKey key = {element, size, (u32) kind, is_signed};
+  Type **existing = map_get(ast->type_index, key);
+  if (existing) return *existing;
+  Type *type = mktype(ast, kind, (loc){0});
+  type->interned_in = ast;
+  map_set(ast->type_index, key, type);
+  return type;
+}
+
 /// Create a new function node.
 Node *ast_make_function(
   Module *ast,
@@ -172,10 +194,10 @@ Node *ast_make_function(
     SymbolLinkage linkage,
     Nodes param_decls,
     Node *body,
-    span name
+    string name ///< Interned.
 ) {
   Node *node = mknode(ast, NODE_FUNCTION, source_location);
-  node->function.name = string_dup(name);
+  node->function.name = name;
   node->type = type;
   node->function.linkage = linkage;
   node->function.body = body;
@@ -193,11 +215,11 @@ Node *ast_make_declaration(
     loc source_location,
     Type *type,
     SymbolLinkage linkage,
-    span name,
+    string name,
     Node *init
 ) {
   Node *node = mknode(ast, NODE_DECLARATION, source_location);
-  node->declaration.name = string_dup(name);
+  node->declaration.name = name;
   node->declaration.linkage = linkage;
   node->type = type;
   if (init) {
@@ -422,11 +444,11 @@ Node *ast_make_structure_declaration(
 Node *ast_make_member_access(
   Module *ast,
     loc source_location,
-    span ident,
+    string ident,
     Node *struct_
 ) {
   Node *node = mknode(ast, NODE_MEMBER_ACCESS, source_location);
-  node->member_access.ident = string_dup(ident);
+  node->member_access.ident = ident;
   node->member_access.struct_ = struct_;
   return node;
 }
@@ -435,10 +457,10 @@ Node *ast_make_member_access(
 Node *ast_make_function_reference(
   Module *ast,
     loc source_location,
-    span symbol
+    string symbol
 ) {
   Node *node = mknode(ast, NODE_FUNCTION_REFERENCE, source_location);
-  node->funcref.name = string_dup(symbol);
+  node->funcref.name = symbol;
   node->funcref.resolved = NULL;
   node->funcref.scope = vector_back(ast->scope_stack);
   return node;
@@ -450,7 +472,7 @@ Type *ast_make_type_named(
     loc source_location,
     Symbol *symbol
 ) {
-  Type *type = mktype(ast, TYPE_NAMED, source_location);
+  Type *type = mktype_interned(ast, TYPE_NAMED, symbol, 0, false);
   type->named = symbol;
   return type;
 }
@@ -461,7 +483,7 @@ Type *ast_make_type_pointer(
     loc source_location,
     Type *to
 ) {
-  Type *type = mktype(ast, TYPE_POINTER, source_location);
+  Type *type = mktype_interned(ast, TYPE_POINTER, to, 0, false);
   type->pointer.to = to;
   return type;
 }
@@ -472,7 +494,7 @@ Type *ast_make_type_reference(
     loc source_location,
     Type *to
 ) {
-  Type *type = mktype(ast, TYPE_REFERENCE, source_location);
+  Type *type = mktype_interned(ast, TYPE_REFERENCE, to, 0, false);
   type->reference.to = to;
   return type;
 }
@@ -484,7 +506,7 @@ Type *ast_make_type_array(
     Type *of,
     size_t size
 ) {
-  Type *type = mktype(ast, TYPE_ARRAY, source_location);
+  Type *type = mktype_interned(ast, TYPE_ARRAY, of, size, false);
   type->array.of = of;
   type->array.size = size;
   return type;
@@ -522,7 +544,7 @@ Type *ast_make_type_integer(
     bool is_signed,
     usz bit_width
 ) {
-  Type *type = mktype(ast, TYPE_INTEGER, source_location);
+  Type *type = mktype_interned(ast, TYPE_INTEGER, NULL, bit_width, is_signed);
   type->integer.is_signed = is_signed;
   type->integer.bit_width = bit_width;
   return type;
@@ -616,9 +638,48 @@ string typename(Type *type, bool colour) {
 }
 
 Type *type_canonical(Type *type) {
-  while (type && type->kind == TYPE_NAMED)
-    type = type->named->val.type;
-  return type;
+  if (!type || type->kind != TYPE_NAMED) return type;
+  if (type->canonical) return type->canonical;
+
+  /// Only cache the result once the type is complete; the
+  /// symbol may still be resolved later on.
+  Type *canon = type;
+  while (canon && canon->kind == TYPE_NAMED)
+    canon = canon->named->val.type;
+  if (!type_is_incomplete_canon(canon)) type->canonical = canon;
+  return canon;
+}
+
+Type *type_structural(Type *type) {
+  Type *canon = type_canonical(type);
+  if (!canon) return NULL;
+  switch (canon->kind) {
+    default: return NULL;
+
+    /// Integer literals are equal to integers.
+    case TYPE_PRIMITIVE: return canon == t_integer_literal ? t_integer : canon;
+    case TYPE_INTEGER: return canon->interned_in ? canon : NULL;
+
+    case TYPE_POINTER:
+    case TYPE_REFERENCE:
+    case TYPE_ARRAY: {
+      if (canon->structural) return canon->structural;
+      if (!canon->interned_in) return NULL;
+
+      /// Only cache the result once we have one; the element type
+      /// may still be completed later on.
+      Type *element = type_get_element(canon);
+      Type *s = type_structural(element);
+      if (!s) return NULL;
+
+      Module *ast = canon->interned_in;
+      if (s == element) s = canon;
+      else if (canon->kind == TYPE_POINTER) s = ast_make_type_pointer(ast, (loc){0}, s);
+      else if (canon->kind == TYPE_REFERENCE) s = ast_make_type_reference(ast, (loc){0}, s);
+      else s = ast_make_type_array(ast, (loc){0}, s, canon->array.size);
+      return canon->structural = s;
+    }
+  }
 }
 
 Type *type_last_alias(Type *type) {
@@ -647,8 +708,8 @@ bool type_is_incomplete_canon(Type *type) {
   return !type || type == t_void;
 }
 
-// TODO: Consider this returning bits instead of bytes.
-usz type_sizeof(Type *type) {
+/// Compute the size of a type, in bytes.
+static usz compute_sizeof(Type *type) {
   STATIC_ASSERT(TYPE_COUNT == 8, "Exhaustive handling of types!");
   switch (type->kind) {
     default: ICE("Invalid type kind: %d", type->kind);
@@ -663,8 +724,8 @@ usz type_sizeof(Type *type) {
   }
 }
 
-// TODO: Consider this returning bits instead of bytes.
-usz type_alignof(Type *type) {
+/// Compute the alignment of a type, in bytes.
+static usz compute_alignof(Type *type) {
   STATIC_ASSERT(TYPE_COUNT == 8, "Exhaustive handling of types!");
   switch (type->kind) {
     default: ICE("Invalid type kind: %d", type->kind);
@@ -679,6 +740,32 @@ usz type_alignof(Type *type) {
   }
 }
 
+/// Cache the layout of a type if it can no longer change. Only
+/// named and array types are worth caching since everything else
+/// stores its layout directly or has a fixed size.
+static bool cache_layout(Type *type) {
+  if (type->layout_cached) return true;
+  if (!type->type_checked) return false;
+  if (type->kind != TYPE_NAMED && type->kind != TYPE_ARRAY) return false;
+  if (!type_canonical(type)) return false;
+  type->cached_size = compute_sizeof(type);
+  type->cached_alignment = compute_alignof(type);
+  type->layout_cached = true;
+  return true;
+}
+
+// TODO: Consider this returning bits instead of bytes.
+usz type_sizeof(Type *type) {
+  if (cache_layout(type)) return type->cached_size;
+  return compute_sizeof(type);
+}
+
+// TODO: Consider this returning bits instead of bytes.
+usz type_alignof(Type *type) {
+  if (cache_layout(type)) return type->cached_alignment;
+  return compute_alignof(type);
+}
+
 bool type_is_void(Type *type) {
   return type_canonical(type) == t_void;
 }
@@ -727,9 +814,9 @@ Module *ast_create() {
   vector_push(ast->_scopes_, vector_back(ast->scope_stack));
 
   /// Add the builtin types to the global scope.
-  scope_add_symbol(ast->_scopes_.data[0], SYM_TYPE, literal_span("integer"), t_integer);
-  scope_add_symbol(ast->_scopes_.data[0], SYM_TYPE, literal_span("byte"), t_byte);
-  scope_add_symbol(ast->_scopes_.data[0], SYM_TYPE, literal_span("void"), t_void);
+  scope_add_symbol(ast->_scopes_.data[0], SYM_TYPE, identifier_intern(literal_span("integer")), t_integer);
+  scope_add_symbol(ast->_scopes_.data[0], SYM_TYPE, identifier_intern(literal_span("byte")), t_byte);
+  scope_add_symbol(ast->_scopes_.data[0], SYM_TYPE, identifier_intern(literal_span("void")), t_void);
 
   /// Done.
   return ast;
@@ -742,15 +829,10 @@ void ast_free(Module *ast) {
   foreach_val(node, ast->_nodes_) {
     STATIC_ASSERT(NODE_COUNT == 19, "Exhaustive handling of node types when freeing AST.");
     switch (node->kind) {
-      case NODE_FUNCTION:
-        free(node->function.name.data);
-        vector_delete(node->function.param_decls);
-        continue;
+      case NODE_FUNCTION: vector_delete(node->function.param_decls); continue;
 
       case NODE_ROOT: vector_delete(node->root.children); continue;
       case NODE_BLOCK: vector_delete(node->block.children); continue;
-      case NODE_DECLARATION: free(node->declaration.name.data); continue;
-      case NODE_MEMBER_ACCESS: free(node->member_access.ident.data); continue;
 
       case NODE_INTRINSIC_CALL:
       case NODE_CALL:
@@ -767,9 +849,9 @@ void ast_free(Module *ast) {
       case NODE_VARIABLE_REFERENCE:
       case NODE_MODULE_REFERENCE:
       case NODE_STRUCTURE_DECLARATION:
-        continue;
+      case NODE_DECLARATION:
+      case NODE_MEMBER_ACCESS:
       case NODE_FUNCTION_REFERENCE:
-        free(node->funcref.name.data);
         continue;
 
       default: UNREACHABLE();
@@ -777,23 +859,19 @@ void ast_free(Module *ast) {
     UNREACHABLE();
   }
 
-  /// Now that that’s done, free all nodes.
-  foreach_val(node, ast->_nodes_) free(node);
   vector_delete(ast->_nodes_);
   vector_delete(ast->functions);
 
   /// Free all types.
   foreach_val(type, ast->_types_) {
-    if (type->kind == TYPE_FUNCTION) {
-      foreach (param, type->function.parameters) free(param->name.data);
-      vector_delete(type->function.parameters);
-    } else if (type->kind == TYPE_STRUCT) {
-      foreach (member, type->structure.members) free(member->name.data);
-      vector_delete(type->structure.members);
-    }
-    free(type);
+    if (type->kind == TYPE_FUNCTION) vector_delete(type->function.parameters);
+    else if (type->kind == TYPE_STRUCT) vector_delete(type->structure.members);
   }
   vector_delete(ast->_types_);
+  map_delete(ast->type_index);
+
+  /// Now that that’s done, free all nodes and types.
+  arena_free(&ast->arena);
 
   /// Free all scopes. This also deletes all symbols.
   foreach_val(scope, ast->_scopes_) scope_delete(scope);
@@ -801,8 +879,7 @@ void ast_free(Module *ast) {
   vector_delete(ast->scope_stack);
 
   /// Free all interned strings.
-  foreach (s, ast->strings) free(s->data);
-  vector_delete(ast->strings);
+  interner_free(&ast->strings);
 
   /// Free the filename and source code.
   free(ast->filename.data);
@@ -1217,15 +1294,57 @@ static void ast_print_children(
 
 /// Intern a string.
 size_t ast_intern_string(Module *ast, span str) {
+  return interner_intern(&ast->strings, str);
+}
+
+/// ===========================================================================
+///  String interning.
+/// ===========================================================================
+/// Global identifier table. This is never freed.
+static Interner identifiers;
+
+u32 interner_find(Interner *interner, span str) {
+  u32 *first = map_get(interner->index, string_hash(str));
+  for (u32 id = first ? *first : INTERNER_NOT_FOUND; id != INTERNER_NOT_FOUND; id = interner->next.data[id])
+    if (string_eq(interner->entries.data[id], str))
+      return id;
+  return INTERNER_NOT_FOUND;
+}
+
+u32 interner_intern(Interner *interner, span str) {
+  u64 hash = string_hash(str);
+
   /// Check if the string is already interned.
-  foreach_index(i, ast->strings)
-    if (string_eq(ast->strings.data[i], str)) return i;
+  u32 *first = map_get(interner->index, hash);
+  for (u32 id = first ? *first : INTERNER_NOT_FOUND; id != INTERNER_NOT_FOUND; id = interner->next.data[id])
+    if (string_eq(interner->entries.data[id], str))
+      return id;
+
+  /// Copy the string into the interner’s storage.
+  char *data = arena_alloc(&interner->storage, str.size + 1, 1);
+  memcpy(data, str.data, str.size);
 
-  /// Intern the string.
-  vector_push(ast->strings, string_dup(str));
-  return ast->strings.size - 1;
+  /// Prepend it to the chain of strings with the same hash.
+  u32 id = (u32) interner->entries.size;
+  vector_push(interner->entries, ((string){data, str.size}));
+  vector_push(interner->next, first ? *first : INTERNER_NOT_FOUND);
+  map_set(interner->index, hash, id);
+  return id;
 }
 
+void interner_free(Interner *interner) {
+  vector_delete(interner->entries);
+  vector_delete(interner->next);
+  map_delete(interner->index);
+  arena_free(&interner->storage);
+}
+
+string identifier_intern(span name) {
+  u32 id = interner_intern(&identifiers, name);
+  return identifiers.entries.data[id];
+}
+
+
 /// Replace a node with another node.
 void ast_replace_node(Module *ast, Node *old, Node *new) {
 #define REPLACE_IN_CHILDREN(children)                            \
@@ -1345,6 +1464,11 @@ bool type_equals_canon(Type *a, Type *b) {
 
   if (a == b) return true;
 
+  /// Interned types with the same structure are the same type.
+  Type *sa = type_structural(a);
+  Type *sb = type_structural(b);
+  if (sa && sb) return sa == sb;
+
   /// If the type kinds are not the same, the the types are obviously not equal.
   if (a->kind != b->kind) return false;
 
@@ -1393,7 +1517,7 @@ IncompleteResult compare_incomplete(Type *a, Type *b) {
     if (type_is_void(a) && type_is_void(b)) return (IncompleteResult){.incomplete = true, .equal = true};
 
     /// If both are named and have the same name, then they’re equal.
-    if (a->kind == TYPE_NAMED && b->kind == TYPE_NAMED && string_eq(a->named->name, b->named->name))
+    if (a->kind == TYPE_NAMED && b->kind == TYPE_NAMED && a->named->name.data == b->named->name.data)
       return (IncompleteResult){.incomplete = true, .equal = true};
 
     /// Otherwise, they’re not equal.
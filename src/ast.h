@@ -149,7 +149,8 @@ enum SymbolKind {
 #define ALL_BACKEND_INTRINSICS(F) \
   F(BUILTIN_SYSCALL)              \
   F(BUILTIN_DEBUGTRAP)            \
-  F(BUILTIN_MEMCPY)
+  F(BUILTIN_MEMCPY)               \
+  F(BUILTIN_MEMSET)
 
 /// Intrinsics that need to be gone after IR generation.
 #define ALL_FRONTEND_INTRINSICS(F) \
@@ -176,6 +177,51 @@ enum IntrinsicKind {
 #undef F
 };
 
+/// ===========================================================================
+///  String interning.
+/// ===========================================================================
+/// Returned by `interner_find()` if a string has not been interned.
+#define INTERNER_NOT_FOUND ((u32) -1)
+
+/// A set of unique strings, each of which is identified by an ID. IDs
+/// are assigned in order starting from 0. Interned strings are
+/// zero-terminated, and their data never moves, so two interned
+/// strings from the same interner are equal iff their data pointers
+/// are equal.
+typedef struct Interner {
+  /// The interned strings, indexed by ID.
+  Vector(string) entries;
+
+  /// For each ID, the next ID whose string has the same hash.
+  Vector(u32) next;
+
+  /// Maps string hashes to the first ID with that hash.
+  Map(u64, u32) index;
+
+  /// Storage for the string data.
+  Arena storage;
+} Interner;
+
+/// Intern a string.
+/// \return The ID of the string.
+u32 interner_intern(Interner *interner, span str);
+
+/// Look up a string without interning it.
+/// \return The ID of the string, or INTERNER_NOT_FOUND.
+u32 interner_find(Interner *interner, span str);
+
+/// Free an interner and all strings in it.
+void interner_free(Interner *interner);
+
+/// Intern an identifier in the global identifier table. The string
+/// returned is owned by the table and must not be freed.
+///
+/// The lexer interns every identifier, and the names of symbols,
+/// AST nodes, IR functions and variables, and object file symbols
+/// are all interned identifiers, so two such names are equal iff
+/// their data pointers are equal.
+string identifier_intern(span name);
+
 /// ===========================================================================
 ///  Symbol table.
 /// ===========================================================================
@@ -189,13 +235,13 @@ typedef Vector(Type *) Types;
 /// A function parameter.
 typedef struct Parameter {
   Type *type;
-  string name;
+  string name; ///< Interned.
   loc source_location;
 } Parameter;
 
 typedef struct Member {
   Type *type;
-  string name;
+  string name; ///< Interned.
   loc source_location;
   size_t byte_offset;
 } Member;
@@ -208,12 +254,16 @@ typedef struct Symbol {
   /// The type of the symbol.
   enum SymbolKind kind;
 
-  /// The name of the symbol.
+  /// The name of the symbol. This is an interned identifier.
   string name;
 
   /// The scope in which the symbol is defined.
   Scope *scope;
 
+  /// The next symbol in the same scope with the same name, in
+  /// declaration order. This chains together overloads.
+  struct Symbol *next_with_name;
+
   /// The actual value of the symbol.
   union {
     Node *node;
@@ -226,9 +276,12 @@ struct Scope {
   /// The parent scope.
   struct Scope *parent;
 
-  /// The symbols in this scope.
+  /// The symbols in this scope, in declaration order.
   Vector(Symbol *) symbols;
 
+  /// Maps an interned name to the first symbol with that name.
+  Map(const char *, Symbol *) symbol_index;
+
   /// All child scopes.
   Vector(Scope *) children;
 };
@@ -256,7 +309,7 @@ typedef struct NodeRoot {
 typedef struct NodeFunction {
   Nodes param_decls;
   Node *body;
-  string name;
+  string name; ///< Interned.
   IRFunction *ir;
   SymbolLinkage linkage;
 } NodeFunction;
@@ -264,7 +317,7 @@ typedef struct NodeFunction {
 /// Variable declaration.
 typedef struct NodeDeclaration {
   Node *init;
-  string name;
+  string name; ///< Interned.
   SymbolLinkage linkage;
 } NodeDeclaration;
 
@@ -324,7 +377,7 @@ typedef struct NodeLiteral {
 
 /// Function refernece.
 typedef struct NodeFunctionReference {
-  string name;
+  string name; ///< Interned.
   Symbol *resolved;
   Scope *scope;
 } NodeFunctionReference;
@@ -333,7 +386,7 @@ typedef struct NodeFunctionReference {
 typedef Symbol *NodeStructDecl;
 
 typedef struct NodeMemberAccess {
-  string ident;
+  string ident; ///< Interned.
   Member *member;
   Node *struct_;
 } NodeMemberAccess;
@@ -409,7 +462,9 @@ struct Type {
   /// The kind of the type.
   enum TypeKind kind;
 
-  /// Location of the type in the source code.
+  /// Location of the type in the source code. Empty for interned
+  /// types (named, pointer, reference, array, and integer types),
+  /// since those are shared by all of their occurrences.
   loc source_location;
 
   /// The actual type data.
@@ -424,9 +479,38 @@ struct Type {
     TypeInteger integer;
   };
 
+  /// Cached canonical type of a named type. NULL if not yet
+  /// computed or if the type is incomplete.
+  Type *canonical;
+
+  /// Module whose intern table this type is in, or NULL if the
+  /// type is not interned.
+  struct Module *interned_in;
+
+  /// Cached result of `type_structural()`.
+  Type *structural;
+
+  /// Cached mangled name of an interned type. This is interned too.
+  string mangled;
+
+  /// Cached size and alignment. Only valid if `layout_cached` is set;
+  /// layouts are only cached once a type has been type checked.
+  usz cached_size;
+  usz cached_alignment;
+  bool layout_cached;
+
   bool type_checked;
 };
 
+/// Key used to look up hash-consed types. `element` is the pointee,
+/// element type, or symbol, `size` the array size or bit width.
+typedef struct TypeInternKey {
+  const void *element;
+  usz size;
+  u32 kind;
+  u32 is_signed;
+} TypeInternKey;
+
 /// A node in the AST.
 struct Node {
   /// Type of the node.
@@ -491,19 +575,29 @@ typedef struct Module {
   string filename;
   string source;
 
+  /// Backing storage for all nodes and types in the AST. Nodes and
+  /// types are allocated in creation order and live until the AST is
+  /// freed; use `arena.bytes_used` to track frontend memory usage.
+  Arena arena;
+
   /// All nodes/types/scopes in the AST. NEVER iterate over this, ever.
   Nodes _nodes_;
   Types _types_;
   Vector(Scope *) _scopes_;
 
+  /// Named, pointer, reference, array, and integer types are
+  /// hash-consed so that each distinct type exists only once per
+  /// module and can be compared by pointer.
+  Map(TypeInternKey, Type *) type_index;
+
   /// Counter used for generating unique names.
   usz counter;
 
   /// Scopes that are currently being parsed.
   Vector(Scope *) scope_stack;
 
-  /// String table.
-  Vector(string) strings;
+  /// String literal table.
+  Interner strings;
 
   /// Functions.
   Vector(Node *) functions;
@@ -520,19 +614,23 @@ void scope_pop(Module *ast);
 
 /// Add an empty symbol to a scope, no matter what.
 /// \return The symbol that was added.
-Symbol *scope_add_symbol_unconditional(Scope *scope, enum SymbolKind kind, span name, void *value);
+Symbol *scope_add_symbol_unconditional(Scope *scope, enum SymbolKind kind, string name, void *value);
 
 /// Add an empty symbol to a scope.
 /// \return The symbol that was added, or NULL if the symbol already exists.
-Symbol *scope_add_symbol(Scope *scope, enum SymbolKind kind, span name, void *value);
+Symbol *scope_add_symbol(Scope *scope, enum SymbolKind kind, string name, void *value);
 
-/// Find a symbol in a scope.
+/// Find a symbol in a scope. If there are several symbols with the
+/// same name in a scope, the first one that was declared is returned;
+/// use `next_with_name` to iterate over the rest.
+///
+/// Symbol names passed to these functions must be interned.
 /// \return The symbol, or NULL if it was not found.
-Symbol *scope_find_symbol(Scope *scope, span name, bool this_scope_only);
+Symbol *scope_find_symbol(Scope *scope, string name, bool this_scope_only);
 
 /// Find a symbol in a scope or add it if it does not exist.
 /// \return The symbol.
-Symbol *scope_find_or_add_symbol(Scope *scope, enum SymbolKind kind, span name, bool this_scope_only);
+Symbol *scope_find_or_add_symbol(Scope *scope, enum SymbolKind kind, string name, bool this_scope_only);
 
 /// ===========================================================================
 ///  Functions to create ast nodes.
@@ -545,7 +643,7 @@ Node *ast_make_function(
     SymbolLinkage linkage,
     Nodes param_decls,
     Node *body,
-    span name
+    string name ///< Interned.
 );
 
 /// Create a new declaration node.
@@ -554,7 +652,7 @@ Node *ast_make_declaration(
     loc source_location,
     Type *type,
     SymbolLinkage linkage, ///< Pass whatever for locals.
-    span name,
+    string name, ///< Interned.
     Node *init
 );
 
@@ -676,7 +774,7 @@ Node *ast_make_module_reference(
 Node *ast_make_function_reference(
   Module *ast,
     loc source_location,
-    span symbol
+    string symbol ///< Interned.
 );
 
 Node *ast_make_structure_declaration(
@@ -688,7 +786,7 @@ Node *ast_make_structure_declaration(
 Node *ast_make_member_access(
   Module *ast,
     loc source_location,
-    span ident,
+    string ident, ///< Interned.
     Node *struct_
 );
 
@@ -773,6 +871,15 @@ NODISCARD Type *type_canonical(Type *type);
 /// This function strips nested named types until there is only one left.
 NODISCARD Type *type_last_alias(Type *type);
 
+/// Get the structural form of a type, i.e. the canonical type with all
+/// aliases in its element types stripped as well. Structural forms are
+/// interned, so two types that have one are equal iff their structural
+/// forms are the same pointer.
+///
+/// \return NULL if the type is or contains a function type, a struct
+///         type, or a named type that has not been resolved.
+NODISCARD Type *type_structural(Type *type);
+
 /** Check if a type is incomplete.
  *
  * A type T is incomplete, iff
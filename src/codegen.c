@@ -71,7 +71,7 @@ static void codegen_lvalue(CodegenContext *ctx, Node *lval) {
         ctx,
         lval,
         lval->type,
-        string_dup(lval->declaration.name)
+        lval->declaration.name
       );
 
       lval->address = ir_insert_static_ref(ctx, var);
@@ -375,7 +375,7 @@ static void codegen_expr(CodegenContext *ctx, Node *expr) {
   /// Intrinsic.
   case NODE_INTRINSIC_CALL: {
     ASSERT(expr->call.callee->kind = NODE_FUNCTION_REFERENCE);
-    STATIC_ASSERT(INTRIN_COUNT == 7, "Handle all intrinsics in codegen");
+    STATIC_ASSERT(INTRIN_COUNT == 8, "Handle all intrinsics in codegen");
     switch (expr->call.intrinsic) {
       case INTRIN_COUNT:
       case INTRIN_BACKEND_COUNT:
@@ -385,6 +385,10 @@ static void codegen_expr(CodegenContext *ctx, Node *expr) {
       case INTRIN_BUILTIN_FILENAME:
         UNREACHABLE();
 
+      /// Only created by the optimiser.
+      case INTRIN_BUILTIN_MEMSET:
+        UNREACHABLE();
+
       /// System call.
       case INTRIN_BUILTIN_SYSCALL:
         /// Syscalls are not a thing on Windows.
@@ -494,6 +498,8 @@ static void codegen_expr(CodegenContext *ctx, Node *expr) {
         IRInstruction *var_decl = lhs->var->val.node->address;
         IRType kind = ir_kind(var_decl);
         Type *ty = ir_typeof(var_decl);
+        /// Static references may belong to a different function.
+        if (kind == IR_STATIC_REF) var_decl = ir_insert_static_ref(ctx, ir_static_ref_var(var_decl));
         if (kind == IR_PARAMETER || kind == IR_STATIC_REF || kind == IR_ALLOCA)
           if (type_is_pointer(ty) && type_is_pointer(ty->pointer.to))
             subs_lhs = ir_insert_load(ctx, type_get_element(ty), var_decl);
@@ -508,7 +514,7 @@ static void codegen_expr(CodegenContext *ctx, Node *expr) {
       } else if (lhs->kind == NODE_LITERAL && lhs->literal.type == TK_STRING) {
         codegen_expr(ctx, lhs);
         if (rhs->kind == NODE_LITERAL && rhs->literal.type == TK_NUMBER) {
-          string str = ctx->ast->strings.data[lhs->literal.string_index];
+          string str = ctx->ast->strings.entries.data[lhs->literal.string_index];
           if (rhs->literal.integer >= str.size) {
             ERR("Out of bounds: subscript %U too large for string literal.", rhs->literal.integer);
           }
@@ -646,7 +652,9 @@ static void codegen_expr(CodegenContext *ctx, Node *expr) {
       // handle empty string for static names, and it will
       // automatically generate one (i.e. exactly what we do here).
       static size_t string_literal_count = 0;
-      IRStaticVariable *var = ir_create_static(ctx, expr, expr->type, format("__str_lit%zu", string_literal_count++));
+      string name = format("__str_lit%zu", string_literal_count++);
+      IRStaticVariable *var = ir_create_static(ctx, expr, expr->type, identifier_intern(as_span(name)));
+      free(name.data);
       expr->ir = ir_insert_static_ref(ctx, var);
       // Set static initialiser so backend will properly fill in data from string literal.
       ir_static_var_init(var, ir_create_interned_str_lit(ctx, expr->literal.string_index));
@@ -849,17 +857,17 @@ bool codegen
         /// Create the main function.
         Type* c_int = ast_make_type_integer(ast, (loc){0}, true, context->ffi.cint_size);
         Parameter argc =  {
-          .name = string_create("__argc__"),
+          .name = identifier_intern(literal_span("__argc__")),
           .type = c_int,
           .source_location = {0},
         };
         Parameter argv =  {
-          .name = string_create("__argv__"),
+          .name = identifier_intern(literal_span("__argv__")),
           .type = ast_make_type_pointer(ast, (loc){0}, ast_make_type_pointer(ast, (loc){0}, t_byte)),
           .source_location = {0},
         };
         Parameter envp =  {
-          .name = string_create("__envp__"),
+          .name = identifier_intern(literal_span("__envp__")),
           .type = ast_make_type_pointer(ast, (loc){0}, ast_make_type_pointer(ast, (loc){0}, t_byte)),
           .source_location = {0},
         };
@@ -871,18 +879,20 @@ bool codegen
 
         /// FIXME: return type should be int as well, but that currently breaks the x86_64 backend.
         Type *main_type = ast_make_type_function(context->ast, (loc){0}, t_integer, main_params);
-        context->entry = ir_create_function(context, string_create("main"), main_type, LINKAGE_EXPORTED);
+        context->entry = ir_create_function(context, identifier_intern(literal_span("main")), main_type, LINKAGE_EXPORTED);
       } else {
         Parameters entry_params = {0};
         Type *entry_type = ast_make_type_function(context->ast, (loc){0}, t_void, entry_params);
-        context->entry = ir_create_function(context, format("__module%S_entry", context->ast->module_name), entry_type, LINKAGE_EXPORTED);
+        string name = format("__module%S_entry", context->ast->module_name);
+        context->entry = ir_create_function(context, identifier_intern(as_span(name)), entry_type, LINKAGE_EXPORTED);
+        free(name.data);
       }
 
       ir_attribute(context->entry, FUNC_ATTR_NOMANGLE, true);
 
       /// Create the remaining functions and set the address of each function.
       foreach_val (func, ast->functions) {
-        func->function.ir = ir_create_function(context, string_dup(func->function.name), func->type, func->function.linkage);
+        func->function.ir = ir_create_function(context, func->function.name, func->type, func->function.linkage);
         ir_location(func->function.ir, func->source_location);
 
         /// Handle attributes.
@@ -946,6 +956,11 @@ bool codegen
     exit(42);
   }
 
+  if (bench_ir_storage) {
+    ir_print_storage_benchmark(context);
+    exit(42);
+  }
+
   if (print_ir2) exit(42);
 
   /// No need to lower anything if we’re emitting LLVM IR.
@@ -969,6 +984,14 @@ bool codegen
 
 static void mangle_type_to(string_buffer *buf, Type *t) {
   ASSERT(t);
+
+  /// Interned types are shared, so we only need to mangle each once.
+  if (t->mangled.data) {
+    format_to(buf, "%S", t->mangled);
+    return;
+  }
+
+  usz start = buf->size;
   switch (t->kind) {
     default: TODO("Handle type kind %d in type mangling!", (int)t->kind);
 
@@ -1018,6 +1041,11 @@ static void mangle_type_to(string_buffer *buf, Type *t) {
       format_to(buf, "E");
       break;
   }
+
+  if (t->interned_in) {
+    span mangled = {buf->data + start, buf->size - start};
+    t->mangled = identifier_intern(mangled);
+  }
 }
 
 void mangle_function_name(IRFunction *function) {
@@ -1029,5 +1057,6 @@ void mangle_function_name(IRFunction *function) {
   mangle_type_to(&buf, ir_typeof(function));
 
   /// FIXME: Mangled name should not override original name.
-  ir_name(function, ((string){buf.data, buf.size}));
+  ir_name(function, identifier_intern(as_span(buf)));
+  vector_delete(buf);
 }
@@ -16,6 +16,8 @@ extern bool codegen_only;
 extern bool annotate_code;
 extern bool print_dot_cfg;
 extern bool print_dot_dj;
+extern bool bench_ir_storage;
+extern int verbosity;
 
 typedef Vector(IRInstruction *) InstructionVector;
 
@@ -29,7 +31,7 @@ CodegenContext *codegen_context_create
 void codegen_context_free(CodegenContext *context);
 
 typedef struct IRStaticVariable {
-  string name;
+  string name; ///< Interned.
   Type *type;
   Node *decl;
   InstructionVector references;
@@ -49,8 +51,11 @@ struct CodegenContext {
   /// The IR
   Vector(IRFunction *) functions;
   Vector(IRStaticVariable *) static_vars;
-  IRInstructionVector free_instructions;
-  IRBlockVector free_blocks;
+
+  /// Backing storage for all IR instructions and blocks. These
+  /// are released in bulk when the context is freed.
+  Pool instruction_pool;
+  Pool block_pool;
 
   /// Code emission (targets)
   FILE *code;
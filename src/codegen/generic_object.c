@@ -293,34 +293,21 @@ void generic_object_as_elf_x86_64(GenericObjectFile *object, FILE *f) {
   // Build elf64_rela relocations
   Vector(elf64_rela) relocations = {0};
   foreach (reloc, object->relocs) {
-    // Find symbol with matching name.
-    elf64_sym *sym = NULL;
+    // Find symbol with matching name. Its ELF symbol comes after the
+    // NULL entry and the symbols of all sections.
     size_t sym_index = 0;
-    foreach_index (i, syms) {
-      elf64_sym *sym_candidate = syms.data + i;
-      char *sym_name = (char*)string_table.data + sym_candidate->st_name;
-      if (strcmp(sym_name, reloc->sym.name) == 0) {
-        sym = sym_candidate;
-        sym_index = i;
+    foreach_index (i, object->symbols) {
+      if (object->symbols.data[i].name == reloc->sym.name) {
+        sym_index = 1 + object->sections.size + i;
         break;
       }
     }
-    if (!sym) ICE("Could not find symbol referenced by relocation: \"%s\"", reloc->sym.name);
+    if (!sym_index) ICE("Could not find symbol referenced by relocation: \"%s\"", reloc->sym.name);
 
     elf64_rela elf_reloc = {0};
     elf_reloc.r_offset = reloc->sym.byte_offset;
     switch (reloc->type) {
     case RELOC_DISP32_PCREL: {
-      GObjSymbol *sym_reloc = NULL;
-      foreach (sym_function, object->symbols) {
-        if (strcmp(sym_function->name, reloc->sym.name) == 0) {
-          sym_reloc = sym_function;
-          break;
-        }
-      }
-      ASSERT(sym_reloc, "Could not find symbol referenced by relocation: \"%s\"", reloc->sym.name);
-      //print("sym_reloc->name: %s sym_reloc->type: %d\n", sym_reloc->name, (int)sym_reloc->type);
-
       if (reloc->sym.type == GOBJ_SYMTYPE_FUNCTION)
         elf_reloc.r_info = ELF64_R_INFO(sym_index, R_X86_64_PLT32);
       else elf_reloc.r_info = ELF64_R_INFO(sym_index, R_X86_64_PC32);
@@ -624,7 +611,7 @@ void generic_object_as_coff_x86_64(GenericObjectFile *object, FILE *f) {
       i = (uint32_t)idx;
       GObjSymbol *sym = object->symbols.data + i;
       // FIXME: Use proper symbol comparison or something, like `gobj_symbol_equals(a, b)`.
-      if (strcmp(sym->name, reloc->sym.name) == 0) break;
+      if (sym->name == reloc->sym.name) break;
     }
     if (i == object->symbols.size) ICE("[GObj]: Couldn't find symbol mentioned by relocation: \"%s\" (%Z symbols)", reloc->sym.name, object->symbols.size);
     entry.r_vaddr = (uint32_t)(reloc->sym.byte_offset);
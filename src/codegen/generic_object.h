@@ -19,8 +19,9 @@ typedef enum GObjSymbolType {
 
 typedef struct GObjSymbol {
   GObjSymbolType type;
-  // Name of symbol.
-  char *name;
+  // Name of symbol. This is an interned identifier, so symbols with
+  // the same name have the same name pointer.
+  const char *name;
   // Name of section this symbol is associated with.
   char *section_name;
   // Offset within section where symbol is defined.
@@ -723,7 +723,7 @@ static MIROpcodeCommon isel_parse_opcode(ISelParser *p) {
 
 /// <inst-spec> ::= <opcode> IDENTIFIER "(" { <operand> } ")" [ "," ]
 static MIRInstruction *isel_parse_inst_spec(ISelParser *p) {
-  MIRInstruction *out = mir_makenew(MIR_IMMEDIATE);
+  MIRInstruction *out = mir_makenew(NULL, MIR_IMMEDIATE);
 
   // Parse opcode
   out->opcode = (uint32_t)isel_parse_opcode(p);
@@ -782,7 +782,7 @@ static MIRInstruction *isel_parse_inst_spec(ISelParser *p) {
       MIROperandRegister r = {0};
       r.value = entry->value.vreg.value;
       r.size = (u32) entry->value.vreg.size;
-      vector_push(out->clobbers, r);
+      mir_add_clobber(out, r);
 
       // Yeet bound identifier
       isel_next_tok(p);
@@ -1051,6 +1051,11 @@ typedef Vector(usz) ISelRegisterValues;
 
 static void mark_defining_uses(ISelRegisterValues *regs_seen, MIRBlock *block) {
   foreach_val (inst, block->instructions) {
+    /// Instructions that are lowered after RA, such as calls, define
+    /// their result without an operand.
+    if (inst->opcode < MIR_COUNT && inst->reg >= MIR_ARCH_START)
+      vector_push_unique(*regs_seen, inst->reg);
+
     FOREACH_MIR_OPERAND(inst, op) {
       if (op->kind == MIR_OP_REGISTER && op->value.reg.value >= MIR_ARCH_START) {
         if (!vector_contains(*regs_seen, op->value.reg.value)) {
@@ -1194,7 +1199,7 @@ void isel_do_selection(MIRFunctionVector mir, ISelPatterns patterns) {
           MIRInstruction *last_input_inst = vector_back(pattern_input);
           foreach_index (i, pattern->output) {
             MIRInstruction *pattern_inst = pattern->output.data[i];
-            MIRInstruction *out = mir_makecopy(pattern_inst);
+            MIRInstruction *out = mir_makecopy(f, pattern_inst);
             if (i == pattern->output.size - 1)
               out->reg = last_input_inst->reg;
             else out->reg = MIR_ARCH_START + f->inst_count++;
@@ -1281,7 +1286,8 @@ void isel_do_selection(MIRFunctionVector mir, ISelPatterns patterns) {
     } // foreach_ptr (MIRBlock*, bb, ...)
   } // foreach_ptr (MIRFunction*, f, ...)
 
-  // Mark defining uses of virtual register operands for RA.
+  // Mark defining uses of virtual register operands for RA. Virtual
+  // registers are numbered per function, so start afresh each time.
   ISelRegisterValues vregs_seen = {0};
   MIRBlockVector visited = {0};
   MIRBlockVector doubly_visited = {0};
@@ -1291,12 +1297,18 @@ void isel_do_selection(MIRFunctionVector mir, ISelPatterns patterns) {
     MIRBlock *entry = vector_front(f->blocks);
     ASSERT(entry->is_entry, "First block within MIRFunction is not entry point; we should do more work to find the entry, sorry");
 
+    vector_clear(vregs_seen);
+    vector_clear(visited);
+    vector_clear(doubly_visited);
+
     // NOTE: This function is an absolute doozy; check it out, iff you must.
     calculate_defining_uses_for_block(&vregs_seen, entry, &visited, &doubly_visited);
 
   }
 
   vector_delete(vregs_seen);
+  vector_delete(visited);
+  vector_delete(doubly_visited);
 
   vector_delete(instructions);
   isel_env_delete(&env);
@@ -1305,6 +1317,10 @@ void isel_do_selection(MIRFunctionVector mir, ISelPatterns patterns) {
 // Delete ISelPatterns.
 void isel_patterns_delete(ISelPatterns *patterns) {
   foreach (pattern, *patterns) {
+    foreach_val (inst, pattern->input) mir_instruction_free(inst);
+    foreach_val (inst, pattern->output) mir_instruction_free(inst);
+    vector_delete(pattern->input);
+    vector_delete(pattern->output);
     isel_env_delete(&pattern->local);
   }
   vector_delete(*patterns);
@@ -13,6 +13,7 @@ typedef struct LLVMContext {
   /// Used intrinsics.
   bool llvm_debugtrap_used : 1;
   bool llvm_memcpy_used    : 1;
+  bool llvm_memset_used    : 1;
 } LLVMContext;
 
 /// Forward decl because mutual recursion.
@@ -189,12 +190,13 @@ static bool llvm_is_numbered_value(IRInstruction *inst) {
       return !type_equals(ir_call_callee_type(inst)->function.return_type, t_void);
 
     case IR_INTRINSIC: {
-      STATIC_ASSERT(INTRIN_BACKEND_COUNT == 3, "Handle all intrinsics");
+      STATIC_ASSERT(INTRIN_BACKEND_COUNT == 4, "Handle all intrinsics");
       switch (ir_intrinsic_kind(inst)) {
         IGNORE_FRONTEND_INTRINSICS()
         case INTRIN_BUILTIN_SYSCALL: return true;
         case INTRIN_BUILTIN_DEBUGTRAP: return false;
         case INTRIN_BUILTIN_MEMCPY: return false;
+        case INTRIN_BUILTIN_MEMSET: return false;
       }
 
       UNREACHABLE();
@@ -308,7 +310,7 @@ static void emit_value(LLVMContext *ctx, IRInstruction *value, bool print_type)
       return;
 
     case IR_INTRINSIC: {
-      STATIC_ASSERT(INTRIN_BACKEND_COUNT == 3, "Handle all intrinsics");
+      STATIC_ASSERT(INTRIN_BACKEND_COUNT == 4, "Handle all intrinsics");
       switch (ir_intrinsic_kind(value)) {
         IGNORE_FRONTEND_INTRINSICS()
         case INTRIN_BUILTIN_SYSCALL:
@@ -318,6 +320,7 @@ static void emit_value(LLVMContext *ctx, IRInstruction *value, bool print_type)
         /// Not a value.
         case INTRIN_BUILTIN_DEBUGTRAP:
         case INTRIN_BUILTIN_MEMCPY:
+        case INTRIN_BUILTIN_MEMSET:
           ICE("Refusing to emit non-value as value");
       }
 
@@ -418,14 +421,16 @@ static void emit_pointer_add(
 
   /// If the displacement is known at compile time and a multiple of
   /// the pointee size, convert it to a GEP and emit that instead.
+  /// The displacement may be negative.
   Type *ptr_type = ir_typeof(pointer);
-  if (ir_kind(integer) == IR_IMMEDIATE && ir_imm(integer) % type_sizeof(ptr_type->pointer.to) == 0) {
+  i64 elem_size = (i64) type_sizeof(ptr_type->pointer.to);
+  if (ir_kind(integer) == IR_IMMEDIATE && (i64) ir_imm(integer) % elem_size == 0) {
     emit_instruction_index(ctx, inst);
     format_to(out, "getelementptr ");
     emit_type(ctx, ptr_type->pointer.to);
     format_to(out, ", ");
     emit_value(ctx, pointer, true);
-    format_to(out, ", i64 %Z\n", ir_imm(integer) / type_sizeof(ptr_type->pointer.to));
+    format_to(out, ", i64 %D\n", (i64) ir_imm(integer) / elem_size);
     return;
   }
 
@@ -472,7 +477,7 @@ static void emit_instruction(LLVMContext *ctx, IRInstruction *inst) {
       ICE("LLVM backend cannot emit IR_REGISTER instructions");
 
     case IR_INTRINSIC: {
-      STATIC_ASSERT(INTRIN_BACKEND_COUNT == 3, "Handle all intrinsics");
+      STATIC_ASSERT(INTRIN_BACKEND_COUNT == 4, "Handle all intrinsics");
       switch (ir_intrinsic_kind(inst)) {
         IGNORE_FRONTEND_INTRINSICS()
 
@@ -516,7 +521,7 @@ static void emit_instruction(LLVMContext *ctx, IRInstruction *inst) {
         /// Same thing.
         case INTRIN_BUILTIN_MEMCPY:
           emit_instruction_index(ctx, inst);
-          format_to(out, "call void @llvm.memcpy.p0.p0.i%Z(\n", type_sizeof(t_integer));
+          format_to(out, "call void @llvm.memcpy.p0.p0.i%Z(\n", type_sizeof(t_integer) * 8);
           emit_value(ctx, ir_call_arg(inst, 0), true);
           format_to(out, ", ");
           emit_value(ctx, ir_call_arg(inst, 1), true);
@@ -525,6 +530,19 @@ static void emit_instruction(LLVMContext *ctx, IRInstruction *inst) {
           format_to(out, ", i1 0)\n"); /// Note: 0 = not volatile.
           ctx->llvm_memcpy_used = true;
           return;
+
+        /// The value is always a byte.
+        case INTRIN_BUILTIN_MEMSET:
+          emit_instruction_index(ctx, inst);
+          format_to(out, "call void @llvm.memset.p0.i%Z(\n", type_sizeof(t_integer) * 8);
+          emit_value(ctx, ir_call_arg(inst, 0), true);
+          format_to(out, ", ");
+          emit_value(ctx, ir_call_arg(inst, 1), true);
+          format_to(out, ", ");
+          emit_value(ctx, ir_call_arg(inst, 2), true);
+          format_to(out, ", i1 0)\n");
+          ctx->llvm_memset_used = true;
+          return;
       }
 
       UNREACHABLE();
@@ -850,7 +868,8 @@ void codegen_emit_llvm(CodegenContext *cg) {
 
   /// Emit intrinsic declarations.
   if (ctx.llvm_debugtrap_used) format_to(&ctx.out, "declare void @llvm.debugtrap()\n");
-  if (ctx.llvm_memcpy_used) format_to(&ctx.out, "declare void @llvm.memcpy.p0.p0.i%Z(ptr, ptr, i64, i1)\n", type_sizeof(t_integer));
+  if (ctx.llvm_memcpy_used) format_to(&ctx.out, "declare void @llvm.memcpy.p0.p0.i%Z(ptr, ptr, i64, i1)\n", type_sizeof(t_integer) * 8);
+  if (ctx.llvm_memset_used) format_to(&ctx.out, "declare void @llvm.memset.p0.i%Z(ptr, i8, i64, i1)\n", type_sizeof(t_integer) * 8);
 
   /// Write to file.
   fprint(cg->code, "%S", as_span(ctx.out));
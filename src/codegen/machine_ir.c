@@ -164,27 +164,76 @@ MIROperand mir_op_register(RegisterDescriptor reg, uint16_t size, bool defining_
 static bool mir_make_arch = false;
 static size_t mir_alloc_id = 0;
 static size_t mir_arch_alloc_id = MIR_ARCH_START;
-MIRInstruction *mir_makenew(uint32_t opcode) {
-  MIRInstruction *mir = calloc(1, sizeof(*mir));
-  ASSERT(mir, "Memory allocation failure");
+
+/// Push an element onto a vector that is owned by an instruction. If
+/// the instruction lives in an arena, so does the vector’s storage.
+#define mir_vector_push(inst, vector, element)                                    \
+  do {                                                                            \
+    if (!(inst)->arena) {                                                         \
+      vector_push(vector, element);                                               \
+      break;                                                                      \
+    }                                                                             \
+    if ((vector).size == (vector).capacity) {                                     \
+      usz _capacity = (vector).capacity ? (vector).capacity * 2 : 4;              \
+      void *_data = arena_alloc(                                                  \
+        (inst)->arena,                                                            \
+        _capacity * sizeof *(vector).data,                                        \
+        _Alignof(__typeof__(*(vector).data))                                      \
+      );                                                                          \
+      if ((vector).size) memcpy(_data, (vector).data, (vector).size * sizeof *(vector).data); \
+      (vector).data = _data;                                                      \
+      (vector).capacity = _capacity;                                              \
+    }                                                                             \
+    (vector).data[(vector).size++] = (element);                                   \
+  } while (0)
+
+MIRInstruction *mir_makenew(MIRFunction *function, uint32_t opcode) {
+  MIRInstruction *mir = NULL;
+  if (function) {
+    mir = arena_new(&function->arena, MIRInstruction);
+    mir->arena = &function->arena;
+  } else {
+    mir = calloc(1, sizeof(*mir));
+    ASSERT(mir, "Memory allocation failure");
+  }
   if (mir_make_arch)
     mir->id = ++mir_arch_alloc_id;
   else mir->id = ++mir_alloc_id;
   mir->opcode = opcode;
   return mir;
 }
-MIRInstruction *mir_makecopy(MIRInstruction *original) {
-  MIRInstruction *mir = mir_makenew(MIR_UNREACHABLE);
-  mir->opcode = original->opcode;
-  mir->operand_count = original->operand_count;
-  if (mir->operand_count <= MIR_OPERAND_SSO_THRESHOLD)
+MIRInstruction *mir_makecopy(MIRFunction *function, MIRInstruction *original) {
+  MIRInstruction *mir = mir_makenew(function, original->opcode);
+  if (original->operand_count <= MIR_OPERAND_SSO_THRESHOLD) {
     memcpy(mir->operands.arr, original->operands.arr, sizeof(mir->operands.arr));
-  else vector_append(mir->operands.vec, original->operands.vec);
+    mir->operand_count = original->operand_count;
+  } else {
+    FOREACH_MIR_OPERAND(original, op) mir_add_op(mir, *op);
+  }
   mir->origin = original->origin;
-  vector_append(mir->clobbers, original->clobbers);
+  foreach (clobber, original->clobbers) mir_add_clobber(mir, *clobber);
   return mir;
 }
 
+void mir_instruction_free(MIRInstruction *inst) {
+  if (inst->arena) return;
+  if (inst->operand_count > MIR_OPERAND_SSO_THRESHOLD) vector_delete(inst->operands.vec);
+  vector_delete(inst->clobbers);
+  free(inst);
+}
+
+void mir_function_free(MIRFunction *function) {
+  foreach_val (block, function->blocks) {
+    vector_delete(block->instructions);
+    vector_delete(block->predecessors);
+    vector_delete(block->successors);
+  }
+  vector_delete(function->blocks);
+  vector_delete(function->frame_objects);
+  arena_free(&function->arena);
+  free(function);
+}
+
 /// Function is only needed to update instruction count. May pass NULL.
 void mir_push_with_reg_into_block(MIRFunction *f, MIRBlock *block, MIRInstruction *mi, MIRRegister reg) {
   DBGASSERT(f, "Invalid argument");
@@ -244,15 +293,15 @@ static void mir_push(MIRFunction *f, MIRInstruction *mi) {
 MIRFunction *mir_function(IRFunction *ir_f) {
   MIRFunction* f = calloc(1, sizeof(*f));
   f->origin = ir_f;
-  f->name = string_dup(ir_name(ir_f));
+  f->name = ir_name(ir_f);
   ir_mir(ir_f, f);
   return f;
 }
 
 MIRBlock *mir_block_makenew(MIRFunction *function, span name) {
-  MIRBlock* bb = calloc(1, sizeof(*bb));
+  MIRBlock* bb = arena_new(&function->arena, MIRBlock);
   bb->function = function;
-  bb->name = string_dup(name);
+  bb->name = name;
   vector_push(function->blocks, bb);
   return bb;
 }
@@ -267,7 +316,7 @@ MIRBlock *mir_block(MIRFunction *function, IRBlock *ir_bb) {
 MIRBlock *mir_block_copy(MIRFunction *function, MIRBlock *original) {
   ASSERT(function, "Invalid argument");
   ASSERT(original, "Invalid argument");
-  MIRBlock *bb = mir_block_makenew(function, as_span(original->name));
+  MIRBlock *bb = mir_block_makenew(function, original->name);
   bb->origin = original->origin;
   bb->is_entry = original->is_entry;
   bb->is_exit = original->is_exit;
@@ -275,14 +324,14 @@ MIRBlock *mir_block_copy(MIRFunction *function, MIRBlock *original) {
   return bb;
 }
 
-MIRInstruction *mir_imm(int64_t imm) {
-  MIRInstruction* mir = mir_makenew(MIR_IMMEDIATE);
+MIRInstruction *mir_imm(MIRFunction *function, int64_t imm) {
+  MIRInstruction* mir = mir_makenew(function, MIR_IMMEDIATE);
   mir_add_op(mir, mir_op_immediate(imm));
   return mir;
 }
 
 MIRInstruction *mir_from_ir_copy(MIRFunction *function, IRInstruction *copy) {
-  MIRInstruction *mir = mir_makenew(MIR_COPY);
+  MIRInstruction *mir = mir_makenew(function, MIR_COPY);
   mir->origin = copy;
   mir_add_op(mir, mir_op_reference_ir(function, ir_operand(copy)));
   ir_mir(copy, mir);
@@ -348,115 +397,169 @@ static void remove_inlined(MIRFunction *function) {
   vector_delete(instructions_to_remove);
 }
 
+/// Insert copies of the arguments of `phis` that flow in from `pred`
+/// into the PHIs' virtual registers at position `index` in `bb`.
+///
+/// All PHIs of a block are evaluated at the same time, so if an
+/// argument is a PHI of the same block, it must be read before any
+/// of the copies are performed; we copy such arguments into a fresh
+/// temporary first.
+static void phi2copy_edge(MIRFunction *function, MIRInstructionVector *phis, IRBlock *pred, MIRBlock *bb, usz index) {
+  MIRInstructionVector temporaries = {0};
+  foreach_val (instruction, *phis) {
+    IRInstruction *phi = instruction->origin;
+    MIRInstruction *temporary = NULL;
+    for (usz i = 0; i < ir_phi_args_count(phi); i++) {
+      const IRPhiArgument *arg = ir_phi_arg(phi, i);
+      if (arg->block != pred) continue;
+      if (ir_kind(arg->value) == IR_PHI && arg->value != phi && ir_parent(arg->value) == ir_parent(phi)) {
+        temporary = mir_makenew(function, MIR_COPY);
+        temporary->origin = arg->value;
+        mir_add_op(temporary, mir_op_reference_ir(function, arg->value));
+        mir_insert_instruction(bb, temporary, index++);
+      }
+      break;
+    }
+    vector_push(temporaries, temporary);
+  }
+
+  foreach_index (i, *phis) {
+    MIRInstruction *instruction = phis->data[i];
+    IRInstruction *phi = instruction->origin;
+    for (usz a = 0; a < ir_phi_args_count(phi); a++) {
+      const IRPhiArgument *arg = ir_phi_arg(phi, a);
+      if (arg->block != pred) continue;
+
+      /// Copy the argument (or the temporary that holds it) into
+      /// the PHI's virtual register. When we eventually remove the
+      /// MIR PHI, what will be left is a bunch of copies into the same
+      /// virtual register, which RA can then assign a single register.
+      MIRInstruction *copy = mir_makenew(function, MIR_COPY);
+      copy->origin = phi;
+      if (temporaries.data[i]) mir_add_op(copy, mir_op_reference(temporaries.data[i]));
+      else mir_add_op(copy, mir_op_reference_ir(function, arg->value));
+      mir_insert_instruction_with_reg(bb, copy, index++, instruction->reg);
+      break;
+    }
+  }
+
+  vector_delete(temporaries);
+}
+
+/// Replace the edge from `pred` to `block` in a conditional branch with
+/// an edge to a new block that branches to `block`, and return that block.
+static MIRBlock *split_critical_edge(MIRFunction *function, IRInstruction *branch, MIRBlock *block) {
+  // Possible FIXME: This relies on backend filling empty block
+  // names with something.
+  MIRBlock *critical_edge_trampoline = mir_block_makenew(function, (span){0});
+  MIRInstruction *critical_edge_branch = mir_makenew(function, MIR_BRANCH);
+  mir_add_op(critical_edge_branch, mir_op_block(block));
+  mir_push_into_block(function, critical_edge_trampoline, critical_edge_branch);
+
+  // Condition is first operand, then the "then" branch, then "else".
+  MIRInstruction *branch_mir = ir_mir(branch);
+  MIROperand *branch_then = mir_get_op(branch_mir, 1);
+  MIROperand *branch_else = mir_get_op(branch_mir, 2);
+  ASSERT(
+    branch_then->value.block == block || branch_else->value.block == block,
+    "Branch to phi block is neither true nor false branch of conditional branch!"
+  );
+  if (branch_then->value.block == block) *branch_then = mir_op_block(critical_edge_trampoline);
+  if (branch_else->value.block == block) *branch_else = mir_op_block(critical_edge_trampoline);
+
+  // Update the CFG.
+  MIRBlock *pred = branch_mir->block;
+  foreach (succ, pred->successors)
+    if (*succ == block) *succ = critical_edge_trampoline;
+  foreach (p, block->predecessors)
+    if (*p == pred) *p = critical_edge_trampoline;
+  vector_push(critical_edge_trampoline->predecessors, pred);
+  vector_push(critical_edge_trampoline->successors, block);
+  return critical_edge_trampoline;
+}
+
 /// For each argument of each phi instruction, add in a copy to the phi's virtual register.
 static void phi2copy(MIRFunction *function) {
-  IRBlock *last_block = NULL;
-  MIRInstructionVector instructions_to_remove = {0};
-  foreach_val (block, function->blocks) {
-    vector_clear(instructions_to_remove);
+  MIRInstructionVector phis = {0};
+  IRBlockVector preds = {0};
+
+  /// Don’t iterate over the critical edge trampolines we create.
+  usz block_count = function->blocks.size;
+  for (usz b = 0; b < block_count; b++) {
+    MIRBlock *block = function->blocks.data[b];
+    vector_clear(phis);
+    vector_clear(preds);
     foreach_val (instruction, block->instructions) {
       if (instruction->opcode != MIR_PHI) continue;
       IRInstruction *phi = instruction->origin;
-      ASSERT(ir_parent(phi) != last_block, "Multiple PHI instructions in a single block are not allowed!");
-      last_block = ir_parent(phi);
 
       /// Single PHI argument means that we can replace it with a simple copy.
-      usz args_count = ir_phi_args_count(phi);
-      if (args_count == 1) {
+      if (ir_phi_args_count(phi) == 1) {
         instruction->opcode = MIR_COPY;
         mir_op_clear(instruction);
         mir_add_op(instruction, mir_op_reference_ir(function, ir_phi_arg(phi, 0)->value));
         continue;
       }
 
-      /// For each of the PHI arguments, we basically insert a copy.
-      /// Where we insert it depends on some complicated factors
-      /// that have to do with control flow.
-      for (usz i = 0; i < args_count; i++) {
-        STATIC_ASSERT(IR_COUNT == 40, "Handle all branch types");
-        const IRPhiArgument *arg = ir_phi_arg(phi, i);
-        IRInstruction *branch = ir_terminator(arg->block);
-        switch (ir_kind(branch)) {
-        /// If the predecessor returns or is unreachable, then the PHI
-        /// is never going to be reached, so we can just ignore
-        /// this argument.
-        case IR_UNREACHABLE:
-        case IR_RETURN: continue;
-
-        /// For direct branches, we just insert the copy before the branch.
-        case IR_BRANCH: {
-          if (needs_register(arg->value)) {
-            MIRInstruction *copy = mir_makenew(MIR_COPY);
-            MIRInstruction *value_mir = ir_mir(arg->value);
-            ASSERT(value_mir);
-            ASSERT(value_mir->block);
-            copy->block = value_mir->block;
-            copy->reg = instruction->reg;
-            mir_add_op(copy, mir_op_reference_ir(function, arg->value));
-            // Insert copy before branch machine instruction.
-            // mir_push_before(branch->machine_inst, copy);
-            MIRInstructionVector *instructions = &value_mir->block->instructions;
-            vector_insert(*instructions, instructions->data + (instructions->size - 1), copy);
-          } else {
-            print("\n\n%31Offending block%m:\n");
-            ir_print_block(stdout, ir_parent(arg->value));
-            ICE("Block ends with instruction that does not return value.");
-          }
-        } break;
-
-        /// Indirect branches are a bit more complicated. We need to insert an
-        /// additional block for the copy instruction and replace the branch
-        /// to the phi block with a branch to that block.
-        case IR_BRANCH_CONDITIONAL: {
-
-          // Create a COPY of the argument into the MIR PHI's vreg.
-          // When we eventually remove the MIR PHI, what will be left is a bunch
-          // of copies into the same virtual register. RA can then fill this virtual
-          // register in with a single register and boom our PHI is codegenned
-          // properly.
-          MIRInstruction *copy = mir_makenew(MIR_COPY);
-          mir_add_op(copy, mir_op_reference_ir(function, arg->value));
-          copy->reg = instruction->reg;
-
-          // Possible FIXME: This relies on backend filling empty block
-          // names with something.
-          MIRBlock *critical_edge_trampoline = mir_block_makenew(function, literal_span(""));
-          mir_push_into_block(function, critical_edge_trampoline, copy);
-          // Branch to phi block from critical edge
-          MIRInstruction *critical_edge_branch = mir_makenew(MIR_BRANCH);
-          critical_edge_branch->block = instruction->block;
-          mir_push_into_block(function, critical_edge_trampoline, critical_edge_branch);
-
-          // The critical edge trampoline block is now complete. This
-          // means we can replace the branch of the argument block to that
-          // of this critical edge trampoline.
-
-          // Condition is first operand, then the "then" branch, then "else".
-          IRBlock *phi_parent = ir_parent(phi);
-          MIRInstruction *branch_mir = ir_mir(branch);
-          MIROperand *branch_then = mir_get_op(branch_mir, 1);
-          MIROperand *branch_else = mir_get_op(branch_mir, 2);
-          if (branch_then->value.block->origin == phi_parent)
-            *branch_then = mir_op_block(critical_edge_trampoline);
-          else {
-            ASSERT(branch_else->value.block->origin == phi_parent,
-                   "Branch to phi block is neither true nor false branch of conditional branch!");
-            *branch_else = mir_op_block(critical_edge_trampoline);
-          }
-        } break;
-        default: UNREACHABLE();
-        }
+      vector_push(phis, instruction);
+      for (usz i = 0; i < ir_phi_args_count(phi); i++)
+        vector_push_unique(preds, ir_phi_arg(phi, i)->block);
+    }
 
-        // Add index of phi instruction to list of instructions to remove.
-        vector_push(instructions_to_remove, instruction);
+    if (!phis.size) continue;
+
+    /// For each incoming edge, we insert copies of the arguments
+    /// coming from that edge. Where we insert them depends on
+    /// the branch at the end of the predecessor.
+    foreach_val (pred, preds) {
+      STATIC_ASSERT(IR_COUNT == 40, "Handle all branch types");
+      IRInstruction *branch = ir_terminator(pred);
+      switch (ir_kind(branch)) {
+      /// If the predecessor returns or is unreachable, then the PHI
+      /// is never going to be reached, so we can just ignore
+      /// this argument.
+      case IR_UNREACHABLE:
+      case IR_RETURN: break;
+
+      /// For direct branches, we just insert the copies before the branch.
+      case IR_BRANCH: {
+        MIRBlock *pred_mir = ir_mir(pred);
+        ASSERT(pred_mir);
+        phi2copy_edge(function, &phis, pred, pred_mir, pred_mir->instructions.size - 1);
+      } break;
+
+      /// Conditional branches are a bit more complicated. We need to insert
+      /// an additional block for the copies and replace the branch to the
+      /// phi block with a branch to that block.
+      case IR_BRANCH_CONDITIONAL: {
+        MIRBlock *trampoline = split_critical_edge(function, branch, block);
+        phi2copy_edge(function, &phis, pred, trampoline, 0);
+      } break;
+
+      default: UNREACHABLE();
       }
+    }
 
-      foreach_val (to_remove, instructions_to_remove) {
-        vector_remove_element(block->instructions, to_remove);
-      }
+    foreach_val (to_remove, phis) vector_remove_element(block->instructions, to_remove);
+  }
+
+  /// Move each trampoline after its predecessor. The backend expects
+  /// the last block to be the one that returns from the function.
+  MIRBlockVector trampolines = {0};
+  while (function->blocks.size > block_count) vector_push(trampolines, vector_pop(function->blocks));
+  foreach_val (trampoline, trampolines) {
+    MIRBlock *pred = trampoline->predecessors.data[0];
+    foreach_index (b, function->blocks) {
+      if (function->blocks.data[b] != pred) continue;
+      vector_insert_index(function->blocks, b + 1, trampoline);
+      break;
     }
   }
-  vector_delete(instructions_to_remove);
+
+  vector_delete(trampolines);
+
+  vector_delete(phis);
+  vector_delete(preds);
 }
 
 MIRFunctionVector mir_from_ir(CodegenContext *context) {
@@ -490,14 +593,14 @@ MIRFunctionVector mir_from_ir(CodegenContext *context) {
         case IR_POISON: ICE("Refusing to codegen poison value");
 
         case IR_IMMEDIATE: {
-          MIRInstruction *mir = mir_makenew(MIR_IMMEDIATE);
+          MIRInstruction *mir = mir_makenew(function, MIR_IMMEDIATE);
           mir->origin = inst;
           ir_mir(inst, mir);
           mir_push_into_block(function, mir_bb, mir);
         } break;
 
         case IR_FUNC_REF: {
-          MIRInstruction *mir = mir_makenew(MIR_FUNC_REF);
+          MIRInstruction *mir = mir_makenew(function, MIR_FUNC_REF);
           ir_mir(inst, mir);
           mir->origin = inst;
           mir_add_op(mir, mir_op_reference_ir(function, inst));
@@ -508,14 +611,14 @@ MIRFunctionVector mir_from_ir(CodegenContext *context) {
           break;
 
         case IR_PHI: {
-          MIRInstruction *mir = mir_makenew(MIR_PHI);
+          MIRInstruction *mir = mir_makenew(function, MIR_PHI);
           mir->origin = inst;
           ir_mir(inst, mir);
           mir_push_into_block(function, mir_bb, mir);
         } break;
 
         case IR_INTRINSIC: {
-          MIRInstruction *mir = mir_makenew(MIR_INTRINSIC);
+          MIRInstruction *mir = mir_makenew(function, MIR_INTRINSIC);
           mir->origin = inst;
           ir_mir(inst, mir);
 
@@ -530,7 +633,7 @@ MIRFunctionVector mir_from_ir(CodegenContext *context) {
         } break;
 
         case IR_CALL: {
-          MIRInstruction *mir = mir_makenew(MIR_CALL);
+          MIRInstruction *mir = mir_makenew(function, MIR_CALL);
           mir->origin = inst;
           ir_mir(inst, mir);
 
@@ -547,7 +650,7 @@ MIRFunctionVector mir_from_ir(CodegenContext *context) {
         } break;
 
         case IR_LOAD: {
-          MIRInstruction *mir = mir_makenew(MIR_LOAD);
+          MIRInstruction *mir = mir_makenew(function, MIR_LOAD);
           mir->origin = inst;
 
           // Address of load
@@ -564,7 +667,7 @@ MIRFunctionVector mir_from_ir(CodegenContext *context) {
 
         case IR_NOT: FALLTHROUGH;
         case IR_BITCAST: {
-          MIRInstruction *mir = mir_makenew((uint32_t)ir_kind(inst));
+          MIRInstruction *mir = mir_makenew(function, (uint32_t)ir_kind(inst));
           mir->origin = inst;
           mir_add_op(mir, mir_op_reference_ir(function, ir_operand(inst)));
           ir_mir(inst, mir);
@@ -574,7 +677,7 @@ MIRFunctionVector mir_from_ir(CodegenContext *context) {
         case IR_ZERO_EXTEND: FALLTHROUGH;
         case IR_SIGN_EXTEND: FALLTHROUGH;
         case IR_TRUNCATE: {
-          MIRInstruction *mir = mir_makenew((uint32_t)ir_kind(inst));
+          MIRInstruction *mir = mir_makenew(function, (uint32_t)ir_kind(inst));
           mir->origin = inst;
           // Thing to truncate
           mir_add_op(mir, mir_op_reference_ir(function, ir_operand(inst)));
@@ -592,7 +695,7 @@ MIRFunctionVector mir_from_ir(CodegenContext *context) {
         } break;
 
         case IR_RETURN: {
-          MIRInstruction *mir = mir_makenew(MIR_RETURN);
+          MIRInstruction *mir = mir_makenew(function, MIR_RETURN);
           mir->origin = inst;
           if (ir_operand(inst)) mir_add_op(mir, mir_op_reference_ir(function, ir_operand(inst)));
           ir_mir(inst, mir);
@@ -600,7 +703,7 @@ MIRFunctionVector mir_from_ir(CodegenContext *context) {
           mir_bb->is_exit = true;
         } break;
         case IR_BRANCH: {
-          MIRInstruction *mir = mir_makenew(MIR_BRANCH);
+          MIRInstruction *mir = mir_makenew(function, MIR_BRANCH);
           MIRBlock *dest = ir_mir(ir_dest(inst));
           mir->origin = inst;
           mir_add_op(mir, mir_op_block(dest));
@@ -611,7 +714,7 @@ MIRFunctionVector mir_from_ir(CodegenContext *context) {
           vector_push(dest->predecessors, mir_bb);
         } break;
         case IR_BRANCH_CONDITIONAL: {
-          MIRInstruction *mir = mir_makenew(MIR_BRANCH_CONDITIONAL);
+          MIRInstruction *mir = mir_makenew(function, MIR_BRANCH_CONDITIONAL);
           MIRBlock *mir_then = ir_mir(ir_then(inst));
           MIRBlock *mir_else = ir_mir(ir_else(inst));
           mir->origin = inst;
@@ -642,7 +745,7 @@ MIRFunctionVector mir_from_ir(CodegenContext *context) {
         case IR_GE:
         case IR_EQ:
         case IR_NE: {
-          MIRInstruction *mir = mir_makenew((uint32_t)ir_kind(inst));
+          MIRInstruction *mir = mir_makenew(function, (uint32_t)ir_kind(inst));
           mir->origin = inst;
           mir_add_op(mir, mir_op_reference_ir(function, ir_lhs(inst)));
           mir_add_op(mir, mir_op_reference_ir(function, ir_rhs(inst)));
@@ -650,14 +753,14 @@ MIRFunctionVector mir_from_ir(CodegenContext *context) {
           mir_push_into_block(function, mir_bb, mir);
         } break;
         case IR_STATIC_REF: {
-          MIRInstruction *mir = mir_makenew((uint32_t)ir_kind(inst));
+          MIRInstruction *mir = mir_makenew(function, (uint32_t)ir_kind(inst));
           ir_mir(inst, mir);
           mir->origin = inst;
           mir_add_op(mir, mir_op_reference_ir(function, inst));
           mir_push_into_block(function, mir_bb, mir);
         } break;
         case IR_STORE: {
-          MIRInstruction *mir = mir_makenew(MIR_STORE);
+          MIRInstruction *mir = mir_makenew(function, MIR_STORE);
           mir->origin = inst;
           MIROperand value = mir_op_reference_ir(function, ir_store_value(inst));
           MIROperand addr = mir_op_reference_ir(function, ir_store_addr(inst));
@@ -670,7 +773,7 @@ MIRFunctionVector mir_from_ir(CodegenContext *context) {
           mir_push_into_block(function, mir_bb, mir);
         } break;
         case IR_ALLOCA: {
-          MIRInstruction *mir = mir_makenew(MIR_ALLOCA);
+          MIRInstruction *mir = mir_makenew(function, MIR_ALLOCA);
           mir->origin = inst;
           ir_alloca_offset(inst, (usz)-1); // Implementation detail for referencing frame objects
           mir_add_op(mir, mir_op_local_ref_ir(function, inst));
@@ -679,7 +782,7 @@ MIRFunctionVector mir_from_ir(CodegenContext *context) {
         } break;
 
         case IR_UNREACHABLE: {
-          MIRInstruction *mir = mir_makenew(MIR_UNREACHABLE);
+          MIRInstruction *mir = mir_makenew(function, MIR_UNREACHABLE);
           mir->origin = inst;
           ir_mir(inst, mir);
           mir_push_into_block(function, mir_bb, mir);
@@ -925,16 +1028,21 @@ void mir_add_op(MIRInstruction *inst, MIROperand op) {
     memcpy(tmp, inst->operands.arr, sizeof(inst->operands.arr[0]) * MIR_OPERAND_SSO_THRESHOLD);
     memset(&inst->operands.vec, 0, sizeof(inst->operands.vec));
     for (size_t i = 0; i < MIR_OPERAND_SSO_THRESHOLD; ++i)
-      vector_push(inst->operands.vec, tmp[i]);
+      mir_vector_push(inst, inst->operands.vec, tmp[i]);
 
-    vector_push(inst->operands.vec, op);
+    mir_vector_push(inst, inst->operands.vec, op);
   } else {
     // inst->operand_count > MIR_OPERAND_SSO_THRESHOLD
-    vector_push(inst->operands.vec, op);
+    mir_vector_push(inst, inst->operands.vec, op);
   }
   ++inst->operand_count;
 }
 
+void mir_add_clobber(MIRInstruction *inst, MIROperandRegister reg) {
+  ASSERT(inst, "Invalid argument");
+  mir_vector_push(inst, inst->clobbers, reg);
+}
+
 MIROperand *mir_get_op(MIRInstruction *inst, size_t index) {
   ASSERT(inst, "Invalid argument");
   ASSERT(index < inst->operand_count, "Index out of bounds (greater than operand count)");
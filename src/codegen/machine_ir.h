@@ -120,6 +120,11 @@ typedef struct MIRInstruction {
 
   MIROperandRegisters clobbers;
 
+  /// Arena of the function this instruction was created for. Its
+  /// operand array and clobbers are allocated from the same arena.
+  /// NULL if the instruction is heap-allocated (e.g. ISel patterns).
+  Arena *arena;
+
   MIRBlock *block;
 
   // Keep track of originating IR instruction.
@@ -140,7 +145,7 @@ typedef struct MIRInstruction {
        ++(name))
 
 typedef struct MIRBlock {
-  string name;
+  span name; ///< Interned.
   MIRInstructionVector instructions;
 
   MIRFunction *function;
@@ -166,7 +171,7 @@ typedef struct MIRFrameObject {
 } MIRFrameObject;
 
 typedef struct MIRFunction {
-  string name;
+  span name; ///< Interned.
 
   uint32_t inst_count;
 
@@ -181,12 +186,25 @@ typedef struct MIRFunction {
   MIRBlockVector blocks;
 
   IRFunction *origin;
+
+  /// Backing storage for all instructions, operand arrays, and
+  /// clobber lists of this function. Freed by mir_function_free().
+  Arena arena;
 } MIRFunction;
 
 /// dwisott
-MIRInstruction *mir_makenew(uint32_t opcode);
-/// Copy the entire instruction
-MIRInstruction *mir_makecopy(MIRInstruction *original);
+/// If `function` is NULL, the instruction is heap-allocated and must
+/// be freed with mir_instruction_free().
+MIRInstruction *mir_makenew(MIRFunction *function, uint32_t opcode);
+/// Copy the entire instruction into the arena of `function`.
+MIRInstruction *mir_makecopy(MIRFunction *function, MIRInstruction *original);
+
+/// Free a heap-allocated instruction. Does nothing for instructions
+/// that were allocated from a function's arena.
+void mir_instruction_free(MIRInstruction *inst);
+
+/// Free a function along with all of its blocks and instructions.
+void mir_function_free(MIRFunction *function);
 
 /// Clear the given instructions operands.
 void mir_op_clear(MIRInstruction *);
@@ -235,6 +253,7 @@ MIROperand mir_op_register(RegisterDescriptor reg, uint16_t size, bool defining_
 bool mir_operand_kinds_match(MIRInstruction *inst, usz operand_count, ...);
 
 void mir_add_op(MIRInstruction *inst, MIROperand op);
+void mir_add_clobber(MIRInstruction *inst, MIROperandRegister reg);
 /// Return a pointer to operand at index within instruction.
 MIROperand *mir_get_op(MIRInstruction *inst, size_t index);
 
@@ -6,6 +6,7 @@
 
 #include <codegen.h>
 #include <codegen/opt/opt.h>
+#include <ir/analysis.h>
 #include <ir/dom.h>
 #include <ir/ir.h>
 #include <stdbool.h>
@@ -2,21 +2,27 @@
 
 typedef Vector(IRBlock *) BlockVector;
 
+/// Statistics about what the optimiser did. Printed with `-v`.
+static struct {
+  usz split_aggregates;
+  usz promoted_variables;
+  usz redundant_instructions;
+  usz hoisted_instructions;
+  usz reduced_pointers;
+  usz unrolled_loops;
+  usz rotated_loops;
+  usz unswitched_loops;
+  usz recognised_idioms;
+  usz constants_propagated;
+  usz eliminated_loads;
+  usz eliminated_stores;
+} opt_stats;
+
 /// ===========================================================================
 ///  Helpers
 /// ===========================================================================
 #define ctzll __builtin_ctzll
 
-#define IR_REDUCE_BINARY(op)                                                           \
-  IRInstruction *lhs = ir_lhs(i);                                                      \
-  IRInstruction *rhs = ir_rhs(i);                                                      \
-  IRType lhs_kind = ir_kind(lhs);                                                      \
-  IRType rhs_kind = ir_kind(rhs);                                                      \
-  if (lhs_kind == IR_IMMEDIATE && rhs_kind == IR_IMMEDIATE) {                          \
-    ir_replace(i, ir_create_immediate(ctx, ir_typeof(i), ir_imm(lhs) op ir_imm(rhs))); \
-    changed = true;                                                                    \
-  }
-
 static bool power_of_two(u64 value) {
   return value > 0 && (value & (value - 1)) == 0;
 }
@@ -79,500 +85,3470 @@ static bool perform_truncation(u64 *out_value, u64 value, usz dest_size) {
   }
 }
 
-/// Sign-extend a value.
-static bool perform_sign_extension(u64 *out_value, u64 value, usz dest_size, usz src_size) {
-  /// Sign-extend from source size to destination size.
-  switch (src_size) {
-    case 1: value = (u64) (i64) (i8) value; break;
-    case 2: value = (u64) (i64) (i16) value; break;
-    case 4: value = (u64) (i64) (i32) value; break;
-    case 8: value = (u64) (i64) (i64) value; break;
-    default: return false;
+/// Sign-extend a value.
+static bool perform_sign_extension(u64 *out_value, u64 value, usz dest_size, usz src_size) {
+  /// Sign-extend from source size to destination size.
+  switch (src_size) {
+    case 1: value = (u64) (i64) (i8) value; break;
+    case 2: value = (u64) (i64) (i16) value; break;
+    case 4: value = (u64) (i64) (i32) value; break;
+    case 8: value = (u64) (i64) (i64) value; break;
+    default: return false;
+  }
+
+  /// Truncate to destination size.
+  return perform_truncation(out_value, value, dest_size);
+}
+
+/// Sign-extend a value from the size of its type to 64 bits.
+static i64 sign_extended(u64 value, Type *t) {
+  u64 extended = value;
+  perform_sign_extension(&extended, value, 8, type_sizeof(t));
+  return (i64) extended;
+}
+
+/// Compute the result of a binary operation on constants. Returns
+/// false if the operation can’t be folded, e.g. because it would trap.
+static bool fold_binary(IRType kind, Type *operand_type, u64 l, u64 r, u64 *out) {
+  i64 sl = sign_extended(l, operand_type);
+  i64 sr = sign_extended(r, operand_type);
+  usz bits = type_sizeof(operand_type) * 8;
+  switch (kind) {
+    default: UNREACHABLE();
+    case IR_ADD: *out = l + r; return true;
+    case IR_SUB: *out = l - r; return true;
+    case IR_MUL: *out = l * r; return true;
+    case IR_AND: *out = l & r; return true;
+    case IR_OR: *out = l | r; return true;
+
+    /// Leave division by zero to the backend, and don’t bother
+    /// with INT_MIN / -1 either.
+    case IR_DIV:
+    case IR_MOD:
+      if (sr == 0 || sr == -1) return false;
+      *out = (u64) (kind == IR_DIV ? sl / sr : sl % sr);
+      return true;
+
+    case IR_SHL:
+    case IR_SHR:
+    case IR_SAR:
+      if (r >= bits) return false;
+      if (kind == IR_SHL) *out = l << r;
+      else if (kind == IR_SAR) *out = (u64) (sl >> r);
+      else *out = (bits == 64 ? l : l & (((u64) 1 << bits) - 1)) >> r;
+      return true;
+
+    /// Comparisons are signed.
+    case IR_LT: *out = sl < sr; return true;
+    case IR_LE: *out = sl <= sr; return true;
+    case IR_GT: *out = sl > sr; return true;
+    case IR_GE: *out = sl >= sr; return true;
+    case IR_EQ: *out = sl == sr; return true;
+    case IR_NE: *out = sl != sr; return true;
+  }
+}
+
+/// ===========================================================================
+///  Instruction combination
+/// ===========================================================================
+/// Everything that merges instructions or performs strength reduction,
+/// folding, etc. etc. goes here. If you’re unsure where to put something,
+/// put it here.
+///
+/// Rather than scanning the entire function until nothing changes, we
+/// keep a worklist of instructions: whenever an instruction is changed,
+/// only its users and operands are queued, since those are the only
+/// instructions that the change can open up new opportunities for. This
+/// also takes care of dead code elimination: an instruction that has no
+/// users and no side effects is deleted when it comes up, and its operands
+/// are queued as they may have become dead as well.
+///
+/// The worklist is seeded with every instruction only once per function
+/// and stays attached to the function while the other passes run, so the
+/// instructions that those passes change are queued as well; after that,
+/// instcombine only ever looks at what has changed since it last ran.
+///
+/// Note: Take care to remove uses etc. *before* overwriting the `imm` field
+/// as it is in a union together with whatever it is whose uses you want to
+/// remove.
+typedef struct {
+  IRWorklist worklist;
+
+  /// Scratch space for operands.
+  IRInstructionVector ops;
+
+  /// Whether we’ve changed the CFG since this was last reset.
+  bool cfg_changed;
+} instcombine_state;
+
+static void instcombine_push(instcombine_state *s, IRInstruction *i) {
+  ir_worklist_push(&s->worklist, i);
+}
+
+static void instcombine_push_users(instcombine_state *s, IRInstruction *i) {
+  FOREACH_USER (user, i) instcombine_push(s, user);
+}
+
+static void instcombine_push_operands(instcombine_state *s, IRInstruction *i) {
+  ir_operands(i, &s->ops);
+  foreach_val (op, s->ops) instcombine_push(s, op);
+}
+
+/// Replace an instruction with another instruction, which is inserted
+/// in its place if need be, and delete it.
+static void instcombine_replace(instcombine_state *s, IRInstruction *old, IRInstruction *new) {
+  instcombine_push_operands(s, old);
+  instcombine_push_users(s, old);
+  ir_replace(old, new);
+  instcombine_push(s, new);
+}
+
+/// Fold a binary instruction whose operands are both immediates.
+static bool instcombine_fold_binary(CodegenContext *ctx, instcombine_state *s, IRInstruction *i) {
+  IRInstruction *lhs = ir_lhs(i);
+  IRInstruction *rhs = ir_rhs(i);
+  if (ir_kind(lhs) != IR_IMMEDIATE || ir_kind(rhs) != IR_IMMEDIATE) return false;
+
+  /// Make sure we know how to sign-extend the operands.
+  u64 value;
+  if (!perform_truncation(&value, 0, type_sizeof(ir_typeof(lhs)))) return false;
+  if (!fold_binary(ir_kind(i), ir_typeof(lhs), ir_imm(lhs), ir_imm(rhs), &value)) return false;
+  if (!perform_truncation(&value, value, type_sizeof(ir_typeof(i)))) return false;
+  instcombine_replace(s, i, ir_create_immediate(ctx, ir_typeof(i), value));
+  return true;
+}
+
+/// Create a comparison that is equivalent to `i` but has its operands
+/// swapped, e.g. `b > a` for `a < b`.
+static IRInstruction *instcombine_swap_comparison(CodegenContext *ctx, IRInstruction *i) {
+  IRInstruction *lhs = ir_lhs(i);
+  IRInstruction *rhs = ir_rhs(i);
+  switch (ir_kind(i)) {
+    default: UNREACHABLE();
+    case IR_LT: return ir_create_gt(ctx, rhs, lhs);
+    case IR_LE: return ir_create_ge(ctx, rhs, lhs);
+    case IR_GT: return ir_create_lt(ctx, rhs, lhs);
+    case IR_GE: return ir_create_le(ctx, rhs, lhs);
+    case IR_EQ: return ir_create_eq(ctx, rhs, lhs);
+    case IR_NE: return ir_create_ne(ctx, rhs, lhs);
+  }
+}
+
+/// Try to simplify an instruction.
+static bool instcombine_instruction(CodegenContext *ctx, instcombine_state *s, IRInstruction *i) {
+  STATIC_ASSERT(IR_COUNT == 40, "Handle all instructions");
+
+  /// Delete instructions whose result is never used.
+  if (ir_use_count(i) == 0 && !has_side_effects(i)) {
+    instcombine_push_operands(s, i);
+    ir_remove(i);
+    return true;
+  }
+
+  switch (ir_kind(i)) {
+    default: return false;
+    ALL_BINARY_INSTRUCTION_CASES()
+      if (instcombine_fold_binary(ctx, s, i)) return true;
+      break;
+
+    case IR_NOT: {
+      IRInstruction *op = ir_operand(i);
+      if (ir_kind(op) != IR_IMMEDIATE) return false;
+      u64 value;
+      if (!perform_truncation(&value, ~ir_imm(op), type_sizeof(ir_typeof(i)))) return false;
+      instcombine_replace(s, i, ir_create_immediate(ctx, ir_typeof(i), value));
+      return true;
+    }
+
+    case IR_ZERO_EXTEND: {
+      IRInstruction *op = ir_operand(i);
+      if (ir_kind(op) != IR_IMMEDIATE) return false;
+      instcombine_replace(s, i, ir_create_immediate(ctx, ir_typeof(i), ir_imm(op)));
+      return true;
+    }
+
+    case IR_SIGN_EXTEND: {
+      IRInstruction *op = ir_operand(i);
+      if (ir_kind(op) != IR_IMMEDIATE) return false;
+      u64 value = 0;
+      if (
+        !perform_sign_extension(
+          &value,
+          ir_imm(op),
+          type_sizeof(ir_typeof(i)),
+          type_sizeof(ir_typeof(op))
+        )
+      ) return false;
+      instcombine_replace(s, i, ir_create_immediate(ctx, ir_typeof(i), value));
+      return true;
+    }
+
+    case IR_TRUNCATE: {
+      IRInstruction *op = ir_operand(i);
+      if (ir_kind(op) != IR_IMMEDIATE) return false;
+      u64 value = 0;
+      if (!perform_truncation(&value, ir_imm(op), type_sizeof(ir_typeof(i)))) return false;
+      instcombine_replace(s, i, ir_create_immediate(ctx, ir_typeof(i), value));
+      return true;
+    }
+
+    /// Simplify conditional branches with constant conditions.
+    case IR_BRANCH_CONDITIONAL: {
+      IRInstruction *cond = ir_cond(i);
+      if (ir_kind(cond) != IR_IMMEDIATE) return false;
+      instcombine_replace(s, i, ir_create_br(ctx, ir_imm(cond) ? ir_then(i) : ir_else(i)));
+      s->cfg_changed = true;
+      return true;
+    }
+
+    /// Simplify PHIs that only ever receive a single value, not
+    /// counting the PHI itself.
+    case IR_PHI: {
+      IRInstruction *value = NULL;
+      for (usz n = 0; n < ir_phi_args_count(i); n++) {
+        IRInstruction *arg = ir_phi_arg(i, n)->value;
+        if (arg == i) continue;
+        if (value && arg != value) return false;
+        value = arg;
+      }
+
+      if (!value) return false;
+      instcombine_replace(s, i, value);
+      return true;
+    }
+
+    /// Simplify indirect calls to direct calls.
+    case IR_CALL: {
+      if (ir_call_is_direct(i)) return false;
+      IRInstruction *callee = ir_callee(i).inst;
+      if (ir_kind(callee) == IR_BITCAST) callee = ir_operand(callee);
+      if (ir_kind(callee) != IR_FUNC_REF) return false;
+      instcombine_push_operands(s, i);
+      ir_callee(i, ir_val(ir_func_ref_func(callee)), true);
+      return true;
+    }
+
+    /// Collapse pointer copies.
+    case IR_COPY: {
+      /// FIXME: Enabling this optimisation breaks a bunch of stuff. Presumably,
+      /// this is due to the clobbering problem that we have in ISel atm.
+      /*if (type_is_pointer(ir_typeof(i)) && type_is_pointer(ir_typeof(i->operand))) {
+        ir_replace(i, ir_operand(i));
+        changed = true;
+      }*/
+      return false;
+    }
+  }
+
+  /// Algebraic simplifications of binary instructions.
+  IRInstruction *lhs = ir_lhs(i);
+  IRInstruction *rhs = ir_rhs(i);
+  bool lhs_imm = ir_kind(lhs) == IR_IMMEDIATE;
+  bool rhs_imm = ir_kind(rhs) == IR_IMMEDIATE;
+  switch (ir_kind(i)) {
+    default: return false;
+
+    /// TODO: Canonicalisation.
+    case IR_ADD:
+      // Adding zero to something == no-op
+      if (lhs_imm && ir_imm(lhs) == 0) instcombine_replace(s, i, rhs);
+      else if (rhs_imm && ir_imm(rhs) == 0) instcombine_replace(s, i, lhs);
+      else return false;
+      return true;
+
+    case IR_SUB:
+      // Subtracting zero from something == no-op
+      if (rhs_imm && ir_imm(rhs) == 0) instcombine_replace(s, i, lhs);
+      else return false;
+      return true;
+
+    case IR_MUL:
+      // Multiplying by zero == zero
+      if (lhs_imm && ir_imm(lhs) == 0) instcombine_replace(s, i, lhs);
+      else if (rhs_imm && ir_imm(rhs) == 0) instcombine_replace(s, i, rhs);
+      // Multiplying by one == no-op
+      else if (lhs_imm && ir_imm(lhs) == 1) instcombine_replace(s, i, rhs);
+      else if (rhs_imm && ir_imm(rhs) == 1) instcombine_replace(s, i, lhs);
+      else return false;
+      return true;
+
+    case IR_DIV: {
+      if (!rhs_imm) return false;
+      usz imm = ir_imm(rhs);
+
+      /// Division by 1 does nothing.
+      if (imm == 1) {
+        instcombine_replace(s, i, lhs);
+        return true;
+      }
+
+      /// Replace division by a power of two with a shift.
+      if (power_of_two(imm)) {
+        IRInstruction *shift_amount = ir_create_immediate(ctx, ir_typeof(i), (u64) ctzll(imm));
+        ir_insert_before(i, shift_amount);
+        instcombine_replace(s, i, ir_create_sar(ctx, lhs, shift_amount));
+        return true;
+      }
+
+      return false;
+    }
+
+    case IR_NE:
+    case IR_EQ:
+      if (lhs == rhs) {
+        instcombine_replace(s, i, ir_create_immediate(ctx, ir_typeof(i), ir_kind(i) == IR_EQ));
+        return true;
+      }
+      FALLTHROUGH;
+
+    /// Move immediates to the right-hand side of comparisons since
+    /// the backend can’t compare an immediate against a register.
+    case IR_LT:
+    case IR_LE:
+    case IR_GT:
+    case IR_GE:
+      if (!lhs_imm || rhs_imm) return false;
+      instcombine_replace(s, i, instcombine_swap_comparison(ctx, i));
+      return true;
+  }
+}
+
+/// Queue every instruction in a function and attach the worklist to it.
+static void instcombine_init(instcombine_state *s, IRFunction *f) {
+  /// The worklist is a stack, so push instructions in reverse
+  /// order to visit them in order.
+  for (usz b = ir_count(f); b; b--) {
+    IRBlock *block = ir_block_get(f, b - 1);
+    for (IRInstruction *i = ir_terminator(block); i; i = ir_prev(i))
+      instcombine_push(s, i);
+  }
+
+  ir_attach_worklist(f, &s->worklist);
+}
+
+static void instcombine_free(instcombine_state *s, IRFunction *f) {
+  ir_attach_worklist(f, NULL);
+  ir_worklist_delete(&s->worklist);
+  vector_delete(s->ops);
+}
+
+/// Simplify all instructions that have been queued since the last call.
+static bool opt_instcombine(CodegenContext *ctx, instcombine_state *s) {
+  bool changed = false;
+  for (IRInstruction *i; (i = ir_worklist_pop(&s->worklist));)
+    if (ir_parent(i)) changed |= instcombine_instruction(ctx, s, i);
+  return changed;
+}
+
+/// ===========================================================================
+///  TCE
+/// ===========================================================================
+typedef struct {
+  IRInstruction *call;
+  Vector(IRInstruction *) phis;
+} tail_call_info;
+
+/// See opt_tail_call_elim() for more info.
+static bool tail_call_possible_iter(tail_call_info *tc, IRBlock *b) {
+  /// Start at the call if this is the block containing the call,
+  /// or at the first instruction of the block otherwise.
+  IRInstruction *i = b == ir_parent(tc->call) ? ir_next(tc->call) : ir_front(b);
+  for (; i; i = ir_next(i)) {
+    IRType kind = ir_kind(i);
+    switch (kind) {
+      /// If this is a phi node, then the call or a previous phi
+      /// must be an argument of the phi.
+      case IR_PHI: {
+        for (usz j = 0; j < ir_phi_args_count(i); j++) {
+          const IRPhiArgument *arg = ir_phi_arg(i, j);
+          if (arg->value == tc->call) { goto phi; }
+          foreach_val (a, tc->phis) {
+            if (a == arg->value) { goto phi; }
+          }
+        }
+        return false;
+
+      phi:
+        vector_push(tc->phis, i);
+        continue;
+      }
+
+      /// If we encounter a return instruction, then a tail call
+      /// is only possible if the return value is the call, or
+      /// any of the PHIs.
+      case IR_RETURN: {
+        IRInstruction *retval = ir_operand(i);
+        foreach_val (a, tc->phis)
+          if (a == retval)
+            return true;
+        return retval == tc->call;
+      }
+
+      /// If this is a branch, follow the branches.
+      case IR_BRANCH : return tail_call_possible_iter(tc, ir_dest(i));
+      case IR_BRANCH_CONDITIONAL:
+        return tail_call_possible_iter(tc, ir_then(i)) &&
+               tail_call_possible_iter(tc, ir_else(i));
+
+      /// Any other instruction means that the call is not the last
+      /// relevant instruction before a return.
+      default: return false;
+    }
+  }
+
+  return false;
+}
+
+static bool tail_call_possible(IRInstruction *i) {
+  tail_call_info tc_info = {0};
+  tc_info.call = i;
+  bool possible = tail_call_possible_iter(&tc_info, ir_parent(i));
+  vector_delete(tc_info.phis);
+  return possible;
+}
+
+bool opt_try_convert_to_tail_call(IRInstruction *i) {
+  /// An instruction is a tail call iff there are no other instruction
+  /// between it and the next return instruction other than branches
+  /// and phis.
+  if (tail_call_possible(i)) {
+    /// The actual tail call optimisation takes place in the code generator.
+    ir_call_tail(i, true);
+    ir_make_unreachable(ir_parent(i));
+    return true;
+  }
+
+  return false;
+}
+
+static bool opt_tail_call_elim(IRFunction *f) {
+  bool changed = false;
+  FOREACH_BLOCK (b, f) {
+    FOREACH_INSTRUCTION (i, b) {
+      if (ir_kind(i) != IR_CALL || ir_call_tail(i)) { continue; }
+
+      /// We can’t have more than two tail calls in a single block.
+      if (opt_try_convert_to_tail_call(i)) {
+        changed = true;
+        goto next_block;
+      }
+    }
+  next_block:;
+  }
+  return changed;
+}
+
+/// ===========================================================================
+///  Scalar replacement of aggregates
+/// ===========================================================================
+/// Don’t split aggregates that have more fields than this.
+#define SROA_MAX_FIELDS 16
+
+/// A scalar field of an aggregate that is being split.
+typedef struct {
+  usz offset;
+  Type *type;
+
+  /// The variable that replaces the field. Created on demand.
+  IRInstruction *alloca;
+} sroa_field;
+
+/// An instruction that accesses the aggregate through `addr`, which
+/// points `offset` bytes into it.
+typedef struct {
+  IRInstruction *inst;
+  IRInstruction *addr;
+  usz offset;
+} sroa_access;
+
+typedef struct {
+  CodegenContext *ctx;
+  IRInstruction *alloca;
+
+  /// Fields of the aggregate, sorted by offset.
+  Vector(sroa_field) fields;
+  Vector(sroa_access) accesses;
+
+  /// Instructions that compute addresses into the aggregate. Each
+  /// one comes after the address it is computed from.
+  IRInstructionVector addresses;
+
+  /// Scratch space.
+  IRInstructionVector values;
+} sroa_state;
+
+static bool sroa_is_aggregate(Type *t) {
+  return type_is_struct(t) || type_is_array(t);
+}
+
+/// Split a type into its scalar fields.
+static bool sroa_flatten(sroa_state *s, Type *t, usz offset) {
+  t = type_canonical(t);
+  if (!t || type_is_incomplete_canon(t)) return false;
+  switch (t->kind) {
+    default:
+      if (s->fields.size == SROA_MAX_FIELDS) return false;
+      vector_push(s->fields, ((sroa_field){offset, t, NULL}));
+      return true;
+
+    case TYPE_STRUCT:
+      foreach (m, t->structure.members)
+        if (!sroa_flatten(s, m->type, offset + m->byte_offset))
+          return false;
+      return true;
+
+    case TYPE_ARRAY:
+      for (usz n = 0; n < t->array.size; n++)
+        if (!sroa_flatten(s, t->array.of, offset + n * type_sizeof(t->array.of)))
+          return false;
+      return true;
+  }
+}
+
+/// Collect the accesses to the aggregate through `addr`, which points
+/// `offset` bytes into it. Returns false if the address escapes or is
+/// offset by a value that isn’t constant.
+static bool sroa_collect(sroa_state *s, IRInstruction *addr, usz offset) {
+  FOREACH_USER (user, addr) {
+    switch (ir_kind(user)) {
+      default: return false;
+      case IR_COPY:
+      case IR_BITCAST:
+        vector_push(s->addresses, user);
+        if (!sroa_collect(s, user, offset)) return false;
+        break;
+
+      case IR_ADD: {
+        IRInstruction *other = ir_lhs(user) == addr ? ir_rhs(user) : ir_lhs(user);
+        if (ir_kind(other) != IR_IMMEDIATE) return false;
+        vector_push(s->addresses, user);
+        if (!sroa_collect(s, user, offset + ir_imm(other))) return false;
+      } break;
+
+      case IR_STORE:
+        if (ir_store_value(user) == addr) return false;
+        FALLTHROUGH;
+
+      case IR_LOAD:
+        vector_push(s->accesses, ((sroa_access){user, addr, offset}));
+        break;
+
+      case IR_INTRINSIC:
+        if (
+          ir_intrinsic_kind(user) != INTRIN_BUILTIN_MEMCPY ||
+          ir_call_arg(user, 0) == ir_call_arg(user, 1) ||
+          ir_kind(ir_call_arg(user, 2)) != IR_IMMEDIATE
+        ) return false;
+        vector_push(s->accesses, ((sroa_access){user, addr, offset}));
+        break;
+    }
+  }
+
+  return true;
+}
+
+/// Find the fields that make up `size` bytes at `offset`. Fails if
+/// any field is only partially covered.
+static bool sroa_range(sroa_state *s, usz offset, usz size, usz *begin, usz *end) {
+  bool found = false;
+  foreach_index (n, s->fields) {
+    sroa_field *f = s->fields.data + n;
+    usz field_size = type_sizeof(f->type);
+    if (f->offset + field_size <= offset || f->offset >= offset + size) continue;
+    if (f->offset < offset || f->offset + field_size > offset + size) return false;
+    if (!found) *begin = n;
+    *end = n + 1;
+    found = true;
+  }
+
+  return found;
+}
+
+/// Find the fields accessed by a load or store of type `t`. A scalar
+/// access must cover exactly one field.
+static bool sroa_fields(sroa_state *s, usz offset, Type *t, usz *begin, usz *end) {
+  if (!sroa_range(s, offset, type_sizeof(t), begin, end)) return false;
+  if (sroa_is_aggregate(t)) return true;
+  sroa_field *f = s->fields.data + *begin;
+  return *end - *begin == 1 && f->offset == offset && type_sizeof(f->type) == type_sizeof(t);
+}
+
+/// Check if an instruction accesses the aggregate.
+static bool sroa_accesses(sroa_state *s, IRInstruction *i) {
+  foreach (a, s->accesses)
+    if (a->inst == i)
+      return true;
+  return false;
+}
+
+/// Check if we know how to split an access.
+static bool sroa_splittable(sroa_state *s, sroa_access *a) {
+  IRInstruction *i = a->inst;
+  usz begin, end;
+  switch (ir_kind(i)) {
+    default: UNREACHABLE();
+    case IR_LOAD: {
+      if (!sroa_fields(s, a->offset, ir_typeof(i), &begin, &end)) return false;
+      if (!sroa_is_aggregate(ir_typeof(i))) return true;
+
+      /// A loaded aggregate can only be stored somewhere else.
+      FOREACH_USER (user, i) {
+        if (
+          ir_kind(user) != IR_STORE ||
+          ir_store_addr(user) == i ||
+          sroa_accesses(s, user)
+        ) return false;
+      }
+      return true;
+    }
+
+    case IR_STORE: {
+      IRInstruction *value = ir_store_value(i);
+      if (!sroa_fields(s, a->offset, ir_typeof(value), &begin, &end)) return false;
+      if (!sroa_is_aggregate(ir_typeof(value))) return true;
+
+      /// We can only split a stored aggregate if it is loaded from
+      /// somewhere else.
+      return ir_kind(value) == IR_LOAD && !sroa_accesses(s, value);
+    }
+
+    /// Both the source and destination of a memcpy may point into the
+    /// aggregate, in which case it shows up twice.
+    case IR_INTRINSIC: {
+      usz count = 0;
+      foreach (other, s->accesses) count += other->inst == i;
+      return count == 1 && sroa_range(s, a->offset, ir_imm(ir_call_arg(i, 2)), &begin, &end);
+    }
+  }
+}
+
+static IRInstruction *sroa_field_alloca(sroa_state *s, sroa_field *f) {
+  if (!f->alloca) f->alloca = ir_insert_after(s->alloca, ir_create_alloca(s->ctx, f->type));
+  return f->alloca;
+}
+
+/// Compute the address of a field of type `type` at `offset` bytes
+/// past `base` before an instruction.
+static IRInstruction *sroa_address(sroa_state *s, IRInstruction *before, IRInstruction *base, usz offset, Type *type) {
+  IRInstruction *addr;
+  if (offset) {
+    IRInstruction *imm = ir_insert_before(before, ir_create_immediate(s->ctx, t_integer, offset));
+    addr = ir_create_add(s->ctx, base, imm);
+  } else {
+    addr = ir_create_copy(s->ctx, base);
+  }
+
+  ir_set_type(addr, ast_make_type_pointer(s->ctx->ast, type->source_location, type));
+  return ir_insert_before(before, addr);
+}
+
+/// Rewrite an access to use the scalars that replace the aggregate.
+static void sroa_split(sroa_state *s, sroa_access *a) {
+  IRInstruction *i = a->inst;
+  usz begin = 0, end = 0;
+  switch (ir_kind(i)) {
+    default: UNREACHABLE();
+    case IR_LOAD: {
+      ASSERT(sroa_fields(s, a->offset, ir_typeof(i), &begin, &end));
+      if (!sroa_is_aggregate(ir_typeof(i))) {
+        ir_operand(i, sroa_field_alloca(s, s->fields.data + begin));
+        return;
+      }
+
+      /// Load all fields here and store them wherever the aggregate
+      /// was stored to.
+      vector_clear(s->values);
+      for (usz n = begin; n < end; n++) {
+        sroa_field *f = s->fields.data + n;
+        vector_push(s->values, ir_insert_before(i, ir_create_load(s->ctx, f->type, sroa_field_alloca(s, f))));
+      }
+
+      while (ir_use_count(i)) {
+        IRInstruction *store = NULL;
+        FOREACH_USER (user, i) {
+          store = user;
+          break;
+        }
+
+        for (usz n = begin; n < end; n++) {
+          sroa_field *f = s->fields.data + n;
+          IRInstruction *addr = sroa_address(s, store, ir_store_addr(store), f->offset - a->offset, f->type);
+          ir_insert_before(store, ir_create_store(s->ctx, s->values.data[n - begin], addr));
+        }
+
+        ir_remove(store);
+      }
+
+      ir_remove(i);
+    } break;
+
+    case IR_STORE: {
+      IRInstruction *value = ir_store_value(i);
+      ASSERT(sroa_fields(s, a->offset, ir_typeof(value), &begin, &end));
+      if (!sroa_is_aggregate(ir_typeof(value))) {
+        ir_store_addr(i, sroa_field_alloca(s, s->fields.data + begin));
+        return;
+      }
+
+      /// Load each field from where the aggregate was loaded from.
+      IRInstruction *src = ir_operand(value);
+      for (usz n = begin; n < end; n++) {
+        sroa_field *f = s->fields.data + n;
+        IRInstruction *addr = sroa_address(s, value, src, f->offset - a->offset, f->type);
+        IRInstruction *field = ir_insert_before(value, ir_create_load(s->ctx, f->type, addr));
+        ir_insert_before(i, ir_create_store(s->ctx, field, sroa_field_alloca(s, f)));
+      }
+
+      ir_remove(i);
+      if (!ir_use_count(value)) ir_remove(value);
+    } break;
+
+    /// Copy the fields one by one.
+    case IR_INTRINSIC: {
+      ASSERT(sroa_range(s, a->offset, ir_imm(ir_call_arg(i, 2)), &begin, &end));
+      IRInstruction *dest = ir_call_arg(i, 0);
+      IRInstruction *src = ir_call_arg(i, 1);
+      bool into_aggregate = dest == a->addr;
+      for (usz n = begin; n < end; n++) {
+        sroa_field *f = s->fields.data + n;
+        usz offset = f->offset - a->offset;
+        IRInstruction *from = into_aggregate ? sroa_address(s, i, src, offset, f->type) : sroa_field_alloca(s, f);
+        IRInstruction *to = into_aggregate ? sroa_field_alloca(s, f) : sroa_address(s, i, dest, offset, f->type);
+        IRInstruction *field = ir_insert_before(i, ir_create_load(s->ctx, f->type, from));
+        ir_insert_before(i, ir_create_store(s->ctx, field, to));
+      }
+
+      ir_remove(i);
+    } break;
+  }
+}
+
+/// Split local variables of struct or array type into a separate
+/// variable for each field so that mem2reg can promote them.
+///
+/// This is only possible if the address of the variable never escapes
+/// and every access is at a constant offset. Copies of the entire
+/// variable, or of a nested aggregate inside it, are split into copies
+/// of the individual fields.
+static bool opt_sroa(CodegenContext *ctx, IRFunction *f) {
+  sroa_state s = {.ctx = ctx};
+  IRInstructionVector allocas = {0};
+  FOREACH_INSTRUCTION_IN_FUNCTION (i, b, f)
+    if (ir_kind(i) == IR_ALLOCA)
+      vector_push(allocas, i);
+
+  bool changed = false;
+  foreach_val (alloca, allocas) {
+    Type *t = type_get_element(ir_typeof(alloca));
+    if (!sroa_is_aggregate(t) || ir_alloca_size(alloca) != type_sizeof(t)) continue;
+
+    s.alloca = alloca;
+    vector_clear(s.fields);
+    vector_clear(s.accesses);
+    vector_clear(s.addresses);
+    if (!sroa_flatten(&s, t, 0) || !sroa_collect(&s, alloca, 0)) continue;
+
+    bool splittable = true;
+    foreach (a, s.accesses) {
+      if (!sroa_splittable(&s, a)) {
+        splittable = false;
+        break;
+      }
+    }
+
+    if (!splittable) continue;
+    foreach (a, s.accesses) sroa_split(&s, a);
+    for (usz n = s.addresses.size; n; n--) ir_remove(s.addresses.data[n - 1]);
+    ir_remove(alloca);
+    opt_stats.split_aggregates++;
+    changed = true;
+  }
+
+  vector_delete(allocas);
+  vector_delete(s.fields);
+  vector_delete(s.accesses);
+  vector_delete(s.addresses);
+  vector_delete(s.values);
+  return changed;
+}
+
+/// ===========================================================================
+///  Mem2Reg
+/// ===========================================================================
+/// A stack variable that is being promoted to SSA form.
+typedef struct {
+  IRInstruction *alloca;
+  Type *type;
+
+  /// Stack of values of the variable during renaming.
+  IRInstructionVector values;
+
+  /// Zero value that is used wherever the variable is read before
+  /// it is written to. Created on demand.
+  IRInstruction *undef;
+} promoted_var;
+
+/// Indices of the variables that were assigned a new value
+/// during renaming, in order.
+typedef Vector(usz) mem2reg_log;
+
+/// A PHI that was inserted for a variable.
+typedef struct {
+  IRInstruction *phi;
+  usz var;
+  bool live;
+} mem2reg_phi;
+
+typedef struct {
+  IRFunction *f;
+  DominatorTree *dom;
+  Vector(promoted_var) vars;
+  Vector(mem2reg_phi) phis;
+
+  /// Indices into `phis` by block index.
+  Vector(Vector(usz)) block_phis;
+
+  /// Index + 1 of the variable for each instruction that
+  /// is a promotable alloca, and 0 otherwise.
+  IRInstructionTable(usz) var_index;
+} mem2reg_state;
+
+/// Check if an alloca can be promoted. This is the case if its
+/// address never escapes, i.e. it is only ever loaded from and
+/// stored to, and all accesses use the same scalar type.
+static bool mem2reg_promotable(IRInstruction *alloca, Type **type) {
+  Type *t = NULL;
+  FOREACH_USER (user, alloca) {
+    Type *access_type;
+    switch (ir_kind(user)) {
+      default: return false;
+      case IR_LOAD:
+        access_type = ir_typeof(user);
+        break;
+
+      case IR_STORE:
+        if (ir_store_value(user) == alloca) return false;
+        access_type = ir_typeof(ir_store_value(user));
+        break;
+    }
+
+    if (!t) t = access_type;
+    else if (!type_equals(t, access_type)) return false;
+  }
+
+  if (!t || type_is_struct(t) || type_is_array(t)) return false;
+  *type = t;
+  return true;
+}
+
+/// Get the promoted variable an instruction accesses, if any.
+static promoted_var *mem2reg_var(mem2reg_state *s, IRInstruction *addr) {
+  if (ir_kind(addr) != IR_ALLOCA) return NULL;
+  usz index = ir_instruction_table_get(s->var_index, addr);
+  return index ? s->vars.data + index - 1 : NULL;
+}
+
+/// Get the value of a variable that has not been written to.
+static IRInstruction *mem2reg_undef(mem2reg_state *s, promoted_var *v) {
+  if (v->undef) return v->undef;
+
+  /// Insert it at the start of the function so it dominates everything.
+  IRInstruction *first = ir_front(*ir_begin(s->f));
+  while (ir_kind(first) == IR_PARAMETER) first = ir_next(first);
+  v->undef = ir_create_immediate(ir_context(s->f), v->type, 0);
+  ir_insert_before(first, v->undef);
+  return v->undef;
+}
+
+/// Get the current value of a variable.
+static IRInstruction *mem2reg_current(mem2reg_state *s, promoted_var *v) {
+  return v->values.size ? vector_back(v->values) : mem2reg_undef(s, v);
+}
+
+/// Rename the accesses to promoted variables in a block.
+static void mem2reg_rename_block(mem2reg_state *s, IRBlock *b, mem2reg_log *pushed) {
+  foreach (idx, s->block_phis.data[ir_block_index(b)]) {
+    mem2reg_phi *p = s->phis.data + *idx;
+    vector_push(s->vars.data[p->var].values, p->phi);
+    vector_push(*pushed, p->var);
+  }
+
+  FOREACH_INSTRUCTION (i, b) {
+    switch (ir_kind(i)) {
+      default: break;
+
+      /// Replace loads with the current value.
+      case IR_LOAD: {
+        promoted_var *v = mem2reg_var(s, ir_operand(i));
+        if (!v) break;
+        if (!v->values.size) {
+          CodegenContext *ctx = ir_context(s->f);
+          issue_diagnostic(
+            DIAG_WARN,
+            ctx->ast->filename.data,
+            as_span(ctx->ast->source),
+            ir_location(s->f), /// FIXME: Should be location of the load.
+            "Load of uninitialised variable in function %S",
+            ir_name(s->f)
+          );
+        }
+
+        ir_replace(i, mem2reg_current(s, v));
+      } break;
+
+      /// Stores define a new value.
+      case IR_STORE: {
+        promoted_var *v = mem2reg_var(s, ir_store_addr(i));
+        if (!v) break;
+        vector_push(v->values, ir_store_value(i));
+        vector_push(*pushed, (usz) (v - s->vars.data));
+        ir_remove(i);
+      } break;
+    }
+  }
+
+  /// Fill in the PHIs in our successors.
+  STATIC_ASSERT(IR_COUNT == 40, "Handle all branch instructions");
+  IRInstruction *br = ir_terminator(b);
+  IRBlock *succs[2];
+  usz count = 0;
+  if (ir_kind(br) == IR_BRANCH) succs[count++] = ir_dest(br);
+  else if (ir_kind(br) == IR_BRANCH_CONDITIONAL) {
+    succs[count++] = ir_then(br);
+    succs[count++] = ir_else(br);
+  }
+
+  for (usz n = 0; n < count; n++) {
+    foreach (idx, s->block_phis.data[ir_block_index(succs[n])]) {
+      mem2reg_phi *p = s->phis.data + *idx;
+      ir_phi_add_arg(p->phi, b, mem2reg_current(s, s->vars.data + p->var));
+    }
+  }
+}
+
+/// Promote stack variables to SSA values.
+///
+/// This is the classic SSA construction algorithm from (Cytron, R. et al.
+/// (1991). ‘Efficiently Computing Static Single Assignment Form and the
+/// Control Dependence Graph’): PHIs for a variable are placed at the
+/// iterated dominance frontier of the blocks that store to it, after
+/// which loads and stores are replaced by walking the dominator tree
+/// while keeping track of the current value of each variable.
+static bool opt_mem2reg(AnalysisManager *am, IRFunction *f) {
+  mem2reg_state s = {.f = f};
+
+  /// Collect all variables whose address is never taken.
+  ir_instruction_table_init(s.var_index, f);
+  FOREACH_INSTRUCTION_IN_FUNCTION (i, b, f) {
+    Type *type;
+    if (ir_kind(i) != IR_ALLOCA || !mem2reg_promotable(i, &type)) continue;
+    promoted_var v = {.alloca = i, .type = type};
+    vector_push(s.vars, v);
+    ir_instruction_table_get(s.var_index, i) = s.vars.size;
+  }
+
+  if (!s.vars.size) {
+    vector_delete(s.var_index);
+    return false;
+  }
+
+  s.dom = analysis_dom_tree(am, f);
+  vector_resize(s.block_phis, ir_count(f));
+  memset(s.block_phis.data, 0, s.block_phis.size * sizeof *s.block_phis.data);
+
+  /// Place PHIs. We mark each block with the index + 1 of the last variable
+  /// for which it was added to the worklist or given a PHI, respectively.
+  Vector(usz) queued = {0}, has_phi = {0};
+  vector_resize(queued, ir_count(f));
+  vector_resize(has_phi, ir_count(f));
+  memset(queued.data, 0, queued.size * sizeof *queued.data);
+  memset(has_phi.data, 0, has_phi.size * sizeof *has_phi.data);
+  IRBlockVector worklist = {0};
+  foreach_index (var, s.vars) {
+    promoted_var *v = s.vars.data + var;
+    FOREACH_USER (user, v->alloca) {
+      if (ir_kind(user) != IR_STORE) continue;
+      IRBlock *b = ir_parent(user);
+      if (queued.data[ir_block_index(b)] == var + 1) continue;
+      queued.data[ir_block_index(b)] = var + 1;
+      vector_push(worklist, b);
+    }
+
+    while (worklist.size) {
+      IRBlock *b = vector_pop(worklist);
+      if (!dom_tree_reachable(s.dom, b)) continue;
+      foreach_val (df, *dom_tree_frontier(s.dom, b)) {
+        usz df_index = ir_block_index(df);
+        if (has_phi.data[df_index] != var + 1) {
+          has_phi.data[df_index] = var + 1;
+          IRInstruction *phi = ir_create_phi(ir_context(f), v->type);
+          ir_insert_before(ir_front(df), phi);
+          mem2reg_phi p = {.phi = phi, .var = var};
+          vector_push(s.phis, p);
+          vector_push(s.block_phis.data[df_index], s.phis.size - 1);
+        }
+
+        if (queued.data[df_index] != var + 1) {
+          queued.data[df_index] = var + 1;
+          vector_push(worklist, df);
+        }
+      }
+    }
+  }
+  vector_delete(queued);
+  vector_delete(has_phi);
+  vector_delete(worklist);
+
+  /// Rename variables by walking the dominator tree. Each frame records
+  /// how many values were pushed before we entered the block so that we
+  /// can pop them again once we leave it.
+  typedef struct { IRBlock *block; usz next_child; usz pushed; } frame;
+  Vector(frame) stack = {0};
+  mem2reg_log pushed = {0};
+  IRBlock *entry = *ir_begin(f);
+  vector_push(stack, ((frame){entry, 0, 0}));
+  mem2reg_rename_block(&s, entry, &pushed);
+  while (stack.size) {
+    frame *fr = &vector_back(stack);
+    IRBlockVector *children = dom_tree_children(s.dom, fr->block);
+    if (fr->next_child == children->size) {
+      while (pushed.size > fr->pushed) {
+        usz var = vector_pop(pushed);
+        (void) vector_pop(s.vars.data[var].values);
+      }
+      (void) vector_pop(stack);
+      continue;
+    }
+
+    IRBlock *child = children->data[fr->next_child++];
+    vector_push(stack, ((frame){child, 0, pushed.size}));
+    mem2reg_rename_block(&s, child, &pushed);
+  }
+  vector_delete(stack);
+  vector_delete(pushed);
+
+  /// Accesses in unreachable blocks were not visited above, and PHIs
+  /// have no value for unreachable predecessors yet.
+  FOREACH_BLOCK (b, f) {
+    if (dom_tree_reachable(s.dom, b)) {
+      Predecessors *preds = analysis_preds(am, f);
+      MapValue(*preds) *p = map_get(*preds, b);
+      if (!p) continue;
+      foreach_val (pred, *p) {
+        if (dom_tree_reachable(s.dom, pred)) continue;
+        foreach (idx, s.block_phis.data[ir_block_index(b)]) {
+          mem2reg_phi *phi = s.phis.data + *idx;
+          ir_phi_add_arg(phi->phi, pred, mem2reg_undef(&s, s.vars.data + phi->var));
+        }
+      }
+      continue;
+    }
+
+    FOREACH_INSTRUCTION (i, b) {
+      promoted_var *v;
+      if (ir_kind(i) == IR_LOAD && (v = mem2reg_var(&s, ir_operand(i)))) ir_replace(i, mem2reg_undef(&s, v));
+      else if (ir_kind(i) == IR_STORE && mem2reg_var(&s, ir_store_addr(i))) ir_remove(i);
+    }
+  }
+
+  /// Remove PHIs that are never used, including cycles of PHIs that
+  /// are only used by one another.
+  Map(IRInstruction *, usz) phi_index = {0};
+  foreach_index (i, s.phis) map_set(phi_index, s.phis.data[i].phi, i);
+  Vector(usz) live = {0};
+  foreach_index (i, s.phis) {
+    FOREACH_USER (user, s.phis.data[i].phi) {
+      if (ir_kind(user) == IR_PHI && map_contains(phi_index, user)) continue;
+      s.phis.data[i].live = true;
+      vector_push(live, i);
+      break;
+    }
+  }
+
+  while (live.size) {
+    mem2reg_phi *p = s.phis.data + vector_pop(live);
+    for (usz i = 0; i < ir_phi_args_count(p->phi); i++) {
+      usz *arg = map_get(phi_index, ir_phi_arg(p->phi, i)->value);
+      if (!arg || s.phis.data[*arg].live) continue;
+      s.phis.data[*arg].live = true;
+      vector_push(live, *arg);
+    }
+  }
+
+  foreach (p, s.phis) {
+    if (p->live) continue;
+    ir_replace(p->phi, mem2reg_undef(&s, s.vars.data + p->var));
+  }
+
+  /// Finally, delete the variables.
+  foreach (v, s.vars) {
+    ir_remove(v->alloca);
+    vector_delete(v->values);
+  }
+
+  opt_stats.promoted_variables += s.vars.size;
+  map_delete(phi_index);
+  vector_delete(live);
+  foreach (b, s.block_phis) vector_delete(*b);
+  vector_delete(s.block_phis);
+  vector_delete(s.phis);
+  vector_delete(s.vars);
+  vector_delete(s.var_index);
+  return true;
+}
+
+/// ===========================================================================
+///  Global value numbering
+/// ===========================================================================
+/// A value that is available in the current scope.
+typedef struct {
+  IRInstruction *inst;
+
+  /// The state of memory that the value was computed in, or
+  /// 0 if the value does not depend on memory.
+  usz epoch;
+} gvn_leader;
+
+typedef struct {
+  Predecessors *preds;
+  DominatorTree *dom;
+
+  /// Available values, by hash.
+  MultiMap(u64, gvn_leader) table;
+
+  /// Hashes of the values added to the table, in order.
+  Vector(u64) log;
+
+  /// State of memory at the end of each block, by block index.
+  Vector(usz) block_epoch;
+  usz epoch;
+  usz epochs;
+} gvn_state;
+
+/// Check if a call is to a function without side effects. If it is,
+/// `reads_memory` is set to whether the result depends on memory.
+static bool gvn_pure_call(IRInstruction *call, bool *reads_memory) {
+  if (!ir_call_is_direct(call) || ir_call_tail(call)) return false;
+  IRFunction *callee = ir_callee(call).func;
+  if (ir_attribute(callee, FUNC_ATTR_CONST)) {
+    *reads_memory = false;
+    return true;
+  }
+
+  if (ir_attribute(callee, FUNC_ATTR_PURE)) {
+    *reads_memory = true;
+    return true;
+  }
+
+  return false;
+}
+
+/// Check if a comparison is used by a conditional branch. Instruction
+/// selection fuses such comparisons into the branch, so their value is
+/// never materialised and must not be reused elsewhere.
+static bool gvn_feeds_branch(IRInstruction *i) {
+  switch (ir_kind(i)) {
+    default: return false;
+    case IR_EQ:
+    case IR_NE:
+    case IR_LT:
+    case IR_LE:
+    case IR_GT:
+    case IR_GE:
+      FOREACH_USER (user, i)
+        if (ir_kind(user) == IR_BRANCH_CONDITIONAL)
+          return true;
+      return false;
+  }
+}
+
+/// Check if we can number an instruction.
+static bool gvn_candidate(IRInstruction *i, bool *reads_memory) {
+  STATIC_ASSERT(IR_COUNT == 40, "Handle all instructions");
+  *reads_memory = false;
+  switch (ir_kind(i)) {
+    ALL_BINARY_INSTRUCTION_CASES()
+      return !gvn_feeds_branch(i);
+
+    case IR_NOT:
+    case IR_ZERO_EXTEND:
+    case IR_SIGN_EXTEND:
+    case IR_TRUNCATE:
+    case IR_BITCAST:
+    case IR_STATIC_REF:
+    case IR_FUNC_REF:
+      return true;
+
+    case IR_CALL:
+      return !type_is_void(ir_typeof(i)) && gvn_pure_call(i, reads_memory);
+
+    default: return false;
+  }
+}
+
+static bool gvn_is_binary(IRInstruction *i) {
+  switch (ir_kind(i)) {
+    ALL_BINARY_INSTRUCTION_CASES()
+      return true;
+    default: return false;
+  }
+}
+
+static bool gvn_commutative(IRType kind) {
+  switch (kind) {
+    case IR_ADD:
+    case IR_MUL:
+    case IR_AND:
+    case IR_OR:
+    case IR_EQ:
+    case IR_NE:
+      return true;
+    default: return false;
+  }
+}
+
+/// Get the operands of a binary instruction such that `a > b` and
+/// `b < a` as well as `a >= b` and `b <= a` are numbered the same.
+static IRType gvn_binary(IRInstruction *i, IRInstruction **lhs, IRInstruction **rhs) {
+  IRType kind = ir_kind(i);
+  *lhs = ir_lhs(i);
+  *rhs = ir_rhs(i);
+  if (kind != IR_GT && kind != IR_GE) return kind;
+  IRInstruction *tmp = *lhs;
+  *lhs = *rhs;
+  *rhs = tmp;
+  return kind == IR_GT ? IR_LT : IR_LE;
+}
+
+/// Two operands have the same value if they are the same instruction
+/// or immediates of the same type with the same value.
+static bool gvn_same_operand(IRInstruction *a, IRInstruction *b) {
+  if (a == b) return true;
+  return ir_kind(a) == IR_IMMEDIATE &&
+         ir_kind(b) == IR_IMMEDIATE &&
+         ir_imm(a) == ir_imm(b) &&
+         type_equals(ir_typeof(a), ir_typeof(b));
+}
+
+static u64 gvn_hash_operand(IRInstruction *op) {
+  u64 h = ir_kind(op) == IR_IMMEDIATE ? ir_imm(op) : (u64) (uintptr_t) op;
+  return map_impl_hash(&h, sizeof h);
+}
+
+static u64 gvn_combine(u64 h, u64 v) {
+  return (h ^ v) * 0x100000001b3ull;
+}
+
+static u64 gvn_hash(IRInstruction *i) {
+  STATIC_ASSERT(IR_COUNT == 40, "Handle all instructions");
+  switch (ir_kind(i)) {
+    ALL_BINARY_INSTRUCTION_CASES() {
+      IRInstruction *lhs, *rhs;
+      IRType kind = gvn_binary(i, &lhs, &rhs);
+      u64 l = gvn_hash_operand(lhs), r = gvn_hash_operand(rhs);
+
+      /// Operands of commutative instructions are hashed in
+      /// a fixed order so that `a + b` and `b + a` collide.
+      if (gvn_commutative(kind) && l > r) {
+        u64 tmp = l;
+        l = r;
+        r = tmp;
+      }
+
+      return gvn_combine(gvn_combine(kind, l), r);
+    }
+
+    case IR_STATIC_REF: return gvn_combine(IR_STATIC_REF, (u64) (uintptr_t) ir_static_ref_var(i));
+    case IR_FUNC_REF: return gvn_combine(IR_FUNC_REF, (u64) (uintptr_t) ir_func_ref_func(i));
+    case IR_CALL: {
+      u64 h = gvn_combine(IR_CALL, (u64) (uintptr_t) ir_callee(i).func);
+      for (usz a = 0; a < ir_call_args_count(i); a++) h = gvn_combine(h, gvn_hash_operand(ir_call_arg(i, a)));
+      return h;
+    }
+
+    default: return gvn_combine(ir_kind(i), gvn_hash_operand(ir_operand(i)));
+  }
+}
+
+/// Check if two candidate instructions compute the same value.
+static bool gvn_equal(IRInstruction *a, IRInstruction *b) {
+  STATIC_ASSERT(IR_COUNT == 40, "Handle all instructions");
+  if (!type_equals(ir_typeof(a), ir_typeof(b))) return false;
+  switch (ir_kind(a)) {
+    ALL_BINARY_INSTRUCTION_CASES() {
+      IRInstruction *al, *ar, *bl, *br;
+      IRType kind = gvn_binary(a, &al, &ar);
+      if (!gvn_is_binary(b) || gvn_binary(b, &bl, &br) != kind) return false;
+      if (gvn_same_operand(al, bl) && gvn_same_operand(ar, br)) return true;
+      return gvn_commutative(kind) && gvn_same_operand(al, br) && gvn_same_operand(ar, bl);
+    }
+
+    case IR_STATIC_REF:
+      return ir_kind(b) == IR_STATIC_REF && ir_static_ref_var(a) == ir_static_ref_var(b);
+
+    case IR_FUNC_REF:
+      return ir_kind(b) == IR_FUNC_REF && ir_func_ref_func(a) == ir_func_ref_func(b);
+
+    case IR_CALL: {
+      if (ir_kind(b) != IR_CALL || !ir_call_is_direct(b)) return false;
+      if (ir_callee(a).func != ir_callee(b).func) return false;
+      if (ir_call_args_count(a) != ir_call_args_count(b)) return false;
+      for (usz n = 0; n < ir_call_args_count(a); n++)
+        if (!gvn_same_operand(ir_call_arg(a, n), ir_call_arg(b, n)))
+          return false;
+      return true;
+    }
+
+    default:
+      return ir_kind(a) == ir_kind(b) && gvn_same_operand(ir_operand(a), ir_operand(b));
+  }
+}
+
+/// Replace redundant instructions in a block with equivalent values that
+/// are available from its dominators, and make the block’s own values
+/// available to the blocks it dominates.
+static bool gvn_block(gvn_state *s, IRBlock *b) {
+  bool changed = false;
+
+  /// Memory is in the same state at the start of a block as at the end
+  /// of its immediate dominator iff that is its only predecessor.
+  IRBlock *idom = dom_tree_idom(s->dom, b);
+  MapValue(*s->preds) *preds = map_get(*s->preds, b);
+  if (idom && preds && preds->size == 1 && preds->data[0] == idom) s->epoch = s->block_epoch.data[ir_block_index(idom)];
+  else s->epoch = ++s->epochs;
+
+  FOREACH_INSTRUCTION (i, b) {
+    bool reads_memory;
+    if (!gvn_candidate(i, &reads_memory)) {
+      if (clobbers_memory(i) && !(ir_kind(i) == IR_CALL && gvn_pure_call(i, &reads_memory)))
+        s->epoch = ++s->epochs;
+      continue;
+    }
+
+    usz epoch = reads_memory ? s->epoch : 0;
+    u64 hash = gvn_hash(i);
+    MapValue(s->table) *leaders = map_get_default(s->table, hash);
+    gvn_leader *leader = NULL;
+    foreach (l, *leaders) {
+      if (l->epoch == epoch && gvn_equal(l->inst, i)) {
+        leader = l;
+        break;
+      }
+    }
+
+    if (leader) {
+      ir_replace(i, leader->inst);
+      opt_stats.redundant_instructions++;
+      changed = true;
+      continue;
+    }
+
+    vector_push(*leaders, ((gvn_leader){i, epoch}));
+    vector_push(s->log, hash);
+  }
+
+  s->block_epoch.data[ir_block_index(b)] = s->epoch;
+  return changed;
+}
+
+/// Eliminate instructions that recompute a value that has already been
+/// computed by an instruction that dominates them.
+///
+/// Values are numbered by hashing their kind and operands; operands
+/// are numbered by identity, since we replace each redundant value
+/// with its leader before we visit any of its users. Instructions are
+/// only available in the subtree of the dominator tree rooted at the
+/// block they are defined in, so we remove them from the table again
+/// once we leave that subtree.
+static bool opt_gvn(AnalysisManager *am, IRFunction *f) {
+  gvn_state s = {
+    .preds = analysis_preds(am, f),
+    .dom = analysis_dom_tree(am, f),
+  };
+
+  vector_resize(s.block_epoch, ir_count(f));
+  bool changed = false;
+
+  typedef struct { IRBlock *block; usz next_child; usz logged; } frame;
+  Vector(frame) stack = {0};
+  IRBlock *entry = *ir_begin(f);
+  vector_push(stack, ((frame){entry, 0, 0}));
+  changed |= gvn_block(&s, entry);
+  while (stack.size) {
+    frame *fr = &vector_back(stack);
+    IRBlockVector *children = dom_tree_children(s.dom, fr->block);
+    if (fr->next_child == children->size) {
+      while (s.log.size > fr->logged) {
+        u64 hash = vector_pop(s.log);
+        (void) vector_pop(*map_get(s.table, hash));
+      }
+      (void) vector_pop(stack);
+      continue;
+    }
+
+    IRBlock *child = children->data[fr->next_child++];
+    vector_push(stack, ((frame){child, 0, s.log.size}));
+    changed |= gvn_block(&s, child);
+  }
+
+  vector_delete(stack);
+  vector_delete(s.log);
+  vector_delete(s.block_epoch);
+  mmap_delete(s.table);
+  return changed;
+}
+
+/// ===========================================================================
+///  Loop-invariant code motion
+/// ===========================================================================
+/// Maximum number of hoisted values per loop that remain live across
+/// the loop. The register allocator can’t spill yet, so we need to be
+/// careful not to increase register pressure too much.
+#define LICM_MAX_LIVE_VALUES 4
+
+/// Maximum number of values live across a loop, including the ones
+/// that were live across it before we hoisted anything and the PHIs
+/// in its header.
+#define LICM_MAX_PRESSURE 8
+
+typedef struct {
+  LoopInfo *loops;
+  DominatorTree *dom;
+  Loop *loop;
+
+  /// Blocks in the loop that have a successor outside of it or
+  /// that return from the function.
+  IRBlockVector exiting;
+
+  /// Instructions in the loop that may write to memory.
+  IRInstructionVector writers;
+
+  /// Whether the loop contains a call that may not return.
+  bool may_not_return;
+
+  /// Instructions to hoist, in the order in which they are to be
+  /// inserted into the preheader, mapped to the number of their
+  /// users that are not hoisted along with them.
+  IRInstructionVector hoist;
+  Map(IRInstruction *, usz) remaining_users;
+
+  /// Number of hoisted instructions with users in the loop.
+  usz live_values;
+
+  /// Number of values that are live on entry to the header or
+  /// defined by its PHIs.
+  usz live_across;
+} licm_state;
+
+/// Check if a block is part of the loop or of a loop nested in it.
+static bool licm_in_loop(licm_state *s, IRBlock *b) {
+  for (Loop *l = loop_of(s->loops, b); l; l = l->parent)
+    if (l == s->loop)
+      return true;
+  return false;
+}
+
+/// Check if a value is computed outside the loop or is hoisted.
+static bool licm_invariant(licm_state *s, IRInstruction *i) {
+  IRBlock *b = ir_parent(i);
+  return !b || !licm_in_loop(s, b) || map_contains(s->remaining_users, i);
+}
+
+/// Get the operands of an instruction that we might hoist.
+static void licm_operands(IRInstruction *i, IRInstructionVector *ops) {
+  vector_clear(*ops);
+  switch (ir_kind(i)) {
+    default: break;
+    ALL_BINARY_INSTRUCTION_CASES() {
+      IRInstruction *rhs = ir_rhs(i);
+      vector_push(*ops, ir_lhs(i));
+      vector_push_unique(*ops, rhs);
+    } break;
+
+    case IR_NOT:
+    case IR_ZERO_EXTEND:
+    case IR_SIGN_EXTEND:
+    case IR_TRUNCATE:
+    case IR_BITCAST:
+    case IR_LOAD:
+      vector_push(*ops, ir_operand(i));
+      break;
+
+    case IR_CALL:
+      for (usz n = 0; n < ir_call_args_count(i); n++) {
+        IRInstruction *arg = ir_call_arg(i, n);
+        vector_push_unique(*ops, arg);
+      }
+      break;
+  }
+}
+
+/// Check if an address refers to an object that we know the identity
+/// of, i.e. a local or global variable. Loading from such an address
+/// never traps.
+static bool licm_known_object(IRInstruction *addr) {
+  return ir_kind(addr) == IR_ALLOCA || ir_kind(addr) == IR_STATIC_REF;
+}
+
+/// Check if an instruction may write to the memory that `load` reads.
+static bool licm_may_write(IRInstruction *writer, IRInstruction *load) {
+  if (ir_kind(writer) != IR_STORE) return true;
+  IRInstruction *addr = ir_operand(load);
+  IRInstruction *dest = ir_store_addr(writer);
+  if (!licm_known_object(addr) || !licm_known_object(dest))
+    return !optimise_tbaa || tbaa_may_alias(ir_typeof(ir_store_value(writer)), ir_typeof(load));
+  if (ir_kind(addr) != ir_kind(dest)) return false;
+  if (ir_kind(addr) == IR_ALLOCA) return addr == dest;
+  return ir_static_ref_var(addr) == ir_static_ref_var(dest);
+}
+
+/// Check if an instruction can be hoisted, provided its operands are
+/// loop-invariant. `speculative` is set if executing the instruction
+/// when the loop would not have done so may trap or not terminate.
+static bool licm_candidate(licm_state *s, IRInstruction *i, bool *speculative) {
+  STATIC_ASSERT(IR_COUNT == 40, "Handle all instructions");
+  *speculative = false;
+  switch (ir_kind(i)) {
+    ALL_BINARY_INSTRUCTION_CASES() {
+      if (ir_kind(i) != IR_DIV && ir_kind(i) != IR_MOD) return true;
+
+      /// Division by a small positive constant can’t trap.
+      IRInstruction *rhs = ir_rhs(i);
+      *speculative = ir_kind(rhs) != IR_IMMEDIATE || ir_imm(rhs) == 0 || ir_imm(rhs) >= (u64) INT32_MAX;
+      return true;
+    }
+
+    case IR_NOT:
+    case IR_ZERO_EXTEND:
+    case IR_SIGN_EXTEND:
+    case IR_TRUNCATE:
+    case IR_BITCAST:
+    case IR_STATIC_REF:
+      return true;
+
+    case IR_LOAD: {
+      IRInstruction *addr = ir_operand(i);
+      foreach_val (w, s->writers)
+        if (licm_may_write(w, i))
+          return false;
+
+      *speculative = !licm_known_object(addr);
+      return true;
+    }
+
+    case IR_CALL: {
+      bool reads_memory;
+      if (type_is_void(ir_typeof(i)) || !gvn_pure_call(i, &reads_memory)) return false;
+      if (reads_memory && s->writers.size) return false;
+
+      /// A pure function may still loop forever.
+      *speculative = true;
+      return true;
+    }
+
+    default: return false;
+  }
+}
+
+/// Check if an instruction is executed whenever the loop is left.
+static bool licm_always_executed(licm_state *s, IRInstruction *i) {
+  if (s->may_not_return) return false;
+  foreach_val (b, s->exiting)
+    if (!dom_tree_dominates(s->dom, ir_parent(i), b))
+      return false;
+  return true;
+}
+
+/// Collect information about the blocks of the loop.
+static void licm_scan_loop(licm_state *s) {
+  foreach_val (b, s->loop->blocks) {
+    IRInstruction *term = ir_terminator(b);
+    switch (ir_kind(term)) {
+      case IR_BRANCH:
+        if (!licm_in_loop(s, ir_dest(term))) vector_push(s->exiting, b);
+        break;
+
+      case IR_BRANCH_CONDITIONAL:
+        if (!licm_in_loop(s, ir_then(term)) || !licm_in_loop(s, ir_else(term)))
+          vector_push(s->exiting, b);
+        break;
+
+      default:
+        vector_push(s->exiting, b);
+        break;
+    }
+
+    FOREACH_INSTRUCTION (i, b) {
+      bool reads_memory;
+      bool pure = ir_kind(i) == IR_CALL && gvn_pure_call(i, &reads_memory);
+      if (!clobbers_memory(i) || pure) continue;
+      vector_push(s->writers, i);
+      if (ir_kind(i) != IR_STORE) s->may_not_return = true;
+    }
+  }
+}
+
+/// Mark an instruction for hoisting. Returns false if that would
+/// keep too many values alive across the loop.
+static bool licm_mark(licm_state *s, IRInstruction *i, IRInstructionVector *ops) {
+  usz users = ir_use_count(i);
+
+  /// The operands of the instruction that are hoisted as well may
+  /// no longer be live in the loop once we hoist this.
+  usz freed = 0;
+  foreach_val (op, *ops) {
+    usz *remaining = map_get(s->remaining_users, op);
+    if (remaining && *remaining == 1) freed++;
+  }
+
+  usz live = s->live_values + (users != 0) - freed;
+  if (live > LICM_MAX_LIVE_VALUES || s->live_across + live > LICM_MAX_PRESSURE) return false;
+
+  foreach_val (op, *ops) {
+    usz *remaining = map_get(s->remaining_users, op);
+    if (remaining && *remaining) --*remaining;
+  }
+
+  s->live_values = live;
+  map_set(s->remaining_users, i, users);
+  vector_push(s->hoist, i);
+  return true;
+}
+
+/// Find the instructions in a loop that we can hoist.
+///
+/// Blocks are visited in dominator tree order so the operands of
+/// an instruction are always visited before the instruction.
+static void licm_collect(licm_state *s) {
+  IRInstructionVector ops = {0};
+  IRBlockVector stack = {0};
+  vector_push(stack, s->loop->header);
+  while (stack.size) {
+    IRBlock *b = vector_pop(stack);
+    foreach_val (child, *dom_tree_children(s->dom, b))
+      if (licm_in_loop(s, child))
+        vector_push(stack, child);
+
+    FOREACH_INSTRUCTION (i, b) {
+      bool speculative;
+      if (!licm_candidate(s, i, &speculative)) continue;
+      if (speculative && !licm_always_executed(s, i)) continue;
+
+      licm_operands(i, &ops);
+      bool invariant = true;
+      foreach_val (op, ops) {
+        if (!licm_invariant(s, op)) {
+          invariant = false;
+          break;
+        }
+      }
+
+      if (invariant && !licm_mark(s, i, &ops)) goto done;
+    }
+  }
+
+done:
+  vector_delete(stack);
+  vector_delete(ops);
+}
+
+/// Create a preheader for a loop. All branches from outside the loop
+/// to the header are redirected to the preheader, which also receives
+/// the incoming values of the header’s PHIs from those branches.
+static void licm_create_preheader(CodegenContext *ctx, licm_state *s, Predecessors *preds) {
+  IRBlock *header = s->loop->header;
+  IRBlockVector outside = {0};
+  foreach_val (p, *map_get(*preds, header))
+    if (!licm_in_loop(s, p))
+      vector_push_unique(outside, p);
+
+  IRBlock *preheader = ir_block_insert_before(header, ir_block(ctx));
+  IRInstruction *br = ir_insert_at_end(preheader, ir_create_br(ctx, header));
+
+  /// Move incoming values to the preheader.
+  FOREACH_INSTRUCTION (phi, header) {
+    if (ir_kind(phi) != IR_PHI) continue;
+    IRInstruction *value = NULL;
+    if (outside.size > 1) value = ir_insert_before(br, ir_create_phi(ctx, ir_typeof(phi)));
+    foreach_val (p, outside) {
+      for (usz n = 0; n < ir_phi_args_count(phi); n++) {
+        const IRPhiArgument *arg = ir_phi_arg(phi, n);
+        if (arg->block != p) continue;
+        if (value) ir_phi_add_arg(value, p, arg->value);
+        else value = arg->value;
+        break;
+      }
+
+      ir_phi_remove_arg(phi, p);
+    }
+
+    ASSERT(value, "PHI is missing an incoming value from outside the loop");
+    ir_phi_add_arg(phi, preheader, value);
+  }
+
+  /// Redirect branches to the header.
+  foreach_val (p, outside) {
+    IRInstruction *term = ir_terminator(p);
+    if (ir_kind(term) == IR_BRANCH) {
+      ir_dest(term, preheader);
+    } else {
+      ASSERT(ir_kind(term) == IR_BRANCH_CONDITIONAL, "Unsupported branch to loop header");
+      if (ir_then(term) == header) ir_then(term, preheader);
+      if (ir_else(term) == header) ir_else(term, preheader);
+    }
+  }
+
+  vector_delete(outside);
+}
+
+/// Hoist loop-invariant instructions out of a loop. Returns whether we
+/// changed anything. `cfg_changed` is set if we had to create a
+/// preheader, in which case nothing is hoisted yet.
+static bool licm_loop(CodegenContext *ctx, AnalysisManager *am, IRFunction *f, Loop *loop, bool *cfg_changed) {
+  licm_state s = {
+    .loops = analysis_loops(am, f),
+    .dom = analysis_dom_tree(am, f),
+    .loop = loop,
+    .live_across = liveness_live_in_count(analysis_liveness(am, f), loop->header),
+  };
+
+  FOREACH_INSTRUCTION (i, loop->header)
+    if (ir_kind(i) == IR_PHI)
+      s.live_across++;
+
+  licm_scan_loop(&s);
+  licm_collect(&s);
+
+  bool changed = false;
+  if (s.hoist.size) {
+    Predecessors *preds = analysis_preds(am, f);
+    IRBlock *preheader = loop_preheader(loop, preds);
+    if (!preheader) {
+      licm_create_preheader(ctx, &s, preds);
+      *cfg_changed = true;
+    } else {
+      IRInstruction *br = ir_terminator(preheader);
+      foreach_val (i, s.hoist) ir_move_before(br, i);
+      opt_stats.hoisted_instructions += s.hoist.size;
+    }
+
+    changed = true;
+  }
+
+  vector_delete(s.exiting);
+  vector_delete(s.writers);
+  vector_delete(s.hoist);
+  map_delete(s.remaining_users);
+  return changed;
+}
+
+/// Move instructions whose operands don’t change in a loop out of
+/// that loop and into its preheader.
+///
+/// Loops are processed from innermost to outermost so that values
+/// hoisted out of an inner loop can be hoisted further if they are
+/// invariant in the outer loop as well. Instructions that might trap
+/// or not terminate are only hoisted if they are executed in every
+/// iteration that leaves the loop, since they might otherwise be
+/// executed when the original program would not have. We also stop
+/// hoisting once too many values would be live across the loop.
+static bool opt_licm(CodegenContext *ctx, AnalysisManager *am, IRFunction *f) {
+  bool changed = false;
+  bool again;
+  do {
+    again = false;
+    LoopInfo *loops = analysis_loops(am, f);
+    for (usz n = loops->loops.size; n; n--) {
+      Loop *loop = loops->loops.data[n - 1];
+      if (loop->header == ir_entry_block(f)) continue;
+
+      bool cfg_changed = false;
+      bool loop_changed = licm_loop(ctx, am, f, loop, &cfg_changed);
+      changed |= loop_changed;
+
+      /// Creating a preheader invalidates all analyses, so start over.
+      if (cfg_changed) {
+        analysis_invalidate(am, f, ANALYSIS_NONE);
+        again = true;
+        break;
+      }
+
+      /// Hoisting changes what is live across the enclosing loops.
+      if (loop_changed) analysis_invalidate(am, f, ANALYSIS_ALL ^ ANALYSIS_LIVENESS);
+    }
+  } while (again);
+  return changed;
+}
+
+/// ===========================================================================
+///  Loop helpers
+/// ===========================================================================
+/// A basic induction variable, i.e. a PHI in the loop header that is
+/// incremented by a constant on every iteration.
+typedef struct {
+  IRInstruction *phi;
+
+  /// The value on entry to the loop.
+  IRInstruction *init;
+
+  /// The instruction that computes the value for the next iteration.
+  IRInstruction *next;
+  i64 step;
+} induction_var;
+
+/// Maps the instructions and blocks of a loop to their copies.
+typedef struct {
+  Map(IRInstruction *, IRInstruction *) values;
+  Map(IRBlock *, IRBlock *) blocks;
+} clone_map;
+
+/// Get the value that a PHI receives from a block.
+static IRInstruction *phi_incoming(IRInstruction *phi, IRBlock *b) {
+  for (usz n = 0; n < ir_phi_args_count(phi); n++) {
+    const IRPhiArgument *arg = ir_phi_arg(phi, n);
+    if (arg->block == b) return arg->value;
+  }
+  return NULL;
+}
+
+/// Check if a PHI in the header of a loop with the given preheader
+/// and latch is a basic induction variable.
+static bool loop_basic_iv(IRBlock *preheader, IRBlock *latch, IRInstruction *phi, induction_var *iv) {
+  if (ir_phi_args_count(phi) != 2 || !type_is_integer(ir_typeof(phi))) return false;
+  IRInstruction *init = phi_incoming(phi, preheader);
+  IRInstruction *next = phi_incoming(phi, latch);
+  if (!init || !next) return false;
+  if (ir_kind(next) != IR_ADD && ir_kind(next) != IR_SUB) return false;
+
+  IRInstruction *step = ir_lhs(next) == phi ? ir_rhs(next) : ir_lhs(next);
+  if (ir_lhs(next) != phi && (ir_rhs(next) != phi || ir_kind(next) == IR_SUB)) return false;
+  if (ir_kind(step) != IR_IMMEDIATE) return false;
+
+  iv->phi = phi;
+  iv->init = init;
+  iv->next = next;
+  iv->step = ir_kind(next) == IR_ADD ? (i64) ir_imm(step) : -(i64) ir_imm(step);
+  return true;
+}
+
+/// Get the copy of an instruction or block, if it was copied.
+static IRInstruction *clone_value(clone_map *m, IRInstruction *i) {
+  IRInstruction **copy = map_get(m->values, i);
+  return copy ? *copy : i;
+}
+
+static IRInstruction *clone_operand(IRInstruction *i, void *m) {
+  return clone_value(m, i);
+}
+
+static IRBlock *clone_block(clone_map *m, IRBlock *b) {
+  IRBlock **copy = map_get(m->blocks, b);
+  return copy ? *copy : b;
+}
+
+/// Redirect the branches from `b` to `from` to `to` instead.
+static void retarget_branch(IRBlock *b, IRBlock *from, IRBlock *to) {
+  IRInstruction *term = ir_terminator(b);
+  if (ir_kind(term) == IR_BRANCH) {
+    if (ir_dest(term) == from) ir_dest(term, to);
+  } else {
+    ASSERT(ir_kind(term) == IR_BRANCH_CONDITIONAL, "Unsupported branch");
+    if (ir_then(term) == from) ir_then(term, to);
+    if (ir_else(term) == from) ir_else(term, to);
+  }
+}
+
+/// Copy blocks and insert the copies before `before`.
+///
+/// Operands, branch targets, and incoming blocks of PHIs that refer
+/// to the copied blocks are redirected to the copies. Instructions
+/// that are already in the value map are not copied; the copies use
+/// the value they are mapped to instead, which is how callers can
+/// substitute the values of header PHIs.
+static void clone_blocks(CodegenContext *ctx, IRBlockVector *blocks, IRBlock *before, clone_map *m) {
+  foreach_val (b, *blocks) map_set(m->blocks, b, ir_block_insert_before(before, ir_block(ctx)));
+  foreach_val (b, *blocks) {
+    IRBlock *copy = clone_block(m, b);
+    FOREACH_INSTRUCTION (i, b)
+      if (!map_contains(m->values, i))
+        map_set(m->values, i, ir_insert_at_end(copy, ir_clone(ctx, i)));
+  }
+
+  Vector(IRPhiArgument) args = {0};
+  foreach_val (b, *blocks) {
+    FOREACH_INSTRUCTION (i, clone_block(m, b)) {
+      ir_map_operands(i, clone_operand, m);
+      switch (ir_kind(i)) {
+        default: break;
+        case IR_BRANCH: ir_dest(i, clone_block(m, ir_dest(i))); break;
+        case IR_BRANCH_CONDITIONAL:
+          ir_then(i, clone_block(m, ir_then(i)));
+          ir_else(i, clone_block(m, ir_else(i)));
+          break;
+
+        case IR_PHI:
+          vector_clear(args);
+          for (usz n = 0; n < ir_phi_args_count(i); n++) vector_push(args, *ir_phi_arg(i, n));
+          foreach (arg, args) {
+            IRBlock *from = clone_block(m, arg->block);
+            if (from == arg->block) continue;
+            ir_phi_remove_arg(i, arg->block);
+            ir_phi_add_arg(i, from, arg->value);
+          }
+          break;
+      }
+    }
+  }
+
+  vector_delete(args);
+}
+
+/// Delete blocks that are no longer reachable. Values defined in
+/// them may only be used in the blocks that are being deleted.
+static void delete_blocks(CodegenContext *ctx, IRBlockVector *blocks) {
+  foreach_val (b, *blocks)
+    FOREACH_INSTRUCTION (i, b)
+      ir_replace_uses(i, ctx->poison);
+
+  /// A block may branch to one that we’ve already deleted otherwise.
+  foreach_val (b, *blocks) ir_block_detach(b);
+  foreach_val (b, *blocks) ir_delete_block(b);
+}
+
+/// ===========================================================================
+///  Induction variable strength reduction
+/// ===========================================================================
+/// Maximum number of pointers that we introduce per loop. These stay
+/// live across the entire loop, and the register allocator can’t
+/// spill yet.
+#define IVSR_MAX_POINTERS 2
+
+/// A pointer `base + iv * scale` that is recomputed on every iteration
+/// and that we replace with a pointer that is incremented instead.
+typedef struct {
+  induction_var *iv;
+  IRInstruction *base;
+  i64 scale;
+
+  /// The PHI that replaces the pointer and its value in the next
+  /// iteration.
+  IRInstruction *phi;
+  IRInstruction *next;
+} reduced_pointer;
+
+typedef struct {
+  CodegenContext *ctx;
+  DominatorTree *dom;
+  Loop *loop;
+  IRBlock *preheader;
+  IRBlock *latch;
+  Vector(induction_var) ivs;
+  Vector(reduced_pointer) pointers;
+} ivsr_state;
+
+/// Check if a value does not change in the loop.
+static bool ivsr_invariant(ivsr_state *s, IRInstruction *i) {
+  IRBlock *b = ir_parent(i);
+  return !b || !loop_contains(s->loop, b);
+}
+
+/// Check if a PHI is a basic induction variable that we can use
+/// to compute addresses.
+static bool ivsr_basic_iv(ivsr_state *s, IRInstruction *phi, induction_var *iv) {
+  if (!loop_basic_iv(s->preheader, s->latch, phi, iv)) return false;
+  return type_sizeof(ir_typeof(phi)) == type_sizeof(t_integer);
+}
+
+/// Check if an instruction computes `base + iv * scale`, where `base`
+/// is a loop-invariant pointer.
+static bool ivsr_pointer(ivsr_state *s, IRInstruction *i, reduced_pointer *p) {
+  if (ir_kind(i) != IR_ADD || !type_is_pointer(ir_typeof(i))) return false;
+  if (!loop_contains(s->loop, ir_parent(i))) return false;
+  for (usz n = 0; n < 2; n++) {
+    IRInstruction *base = n ? ir_rhs(i) : ir_lhs(i);
+    IRInstruction *offset = n ? ir_lhs(i) : ir_rhs(i);
+    if (!type_is_pointer(ir_typeof(base)) || !ivsr_invariant(s, base)) continue;
+
+    /// The offset is either the induction variable itself or the
+    /// induction variable multiplied by a constant.
+    i64 scale = 1;
+    if (ir_kind(offset) == IR_MUL) {
+      IRInstruction *lhs = ir_lhs(offset);
+      IRInstruction *rhs = ir_rhs(offset);
+      if (ir_kind(rhs) == IR_IMMEDIATE) {
+        scale = (i64) ir_imm(rhs);
+        offset = lhs;
+      } else if (ir_kind(lhs) == IR_IMMEDIATE) {
+        scale = (i64) ir_imm(lhs);
+        offset = rhs;
+      } else {
+        continue;
+      }
+    }
+
+    foreach (iv, s->ivs) {
+      if (iv->phi != offset) continue;
+      p->iv = iv;
+      p->base = base;
+      p->scale = scale;
+      p->phi = NULL;
+      return true;
+    }
+  }
+
+  return false;
+}
+
+/// Compute `base + value * scale` before an instruction.
+static IRInstruction *ivsr_offset(ivsr_state *s, IRInstruction *before, IRInstruction *base, IRInstruction *value, i64 scale, Type *type) {
+  IRInstruction *offset;
+  if (ir_kind(value) == IR_IMMEDIATE) {
+    offset = ir_insert_before(before, ir_create_immediate(s->ctx, t_integer, ir_imm(value) * (u64) scale));
+  } else {
+    IRInstruction *imm = ir_insert_before(before, ir_create_immediate(s->ctx, t_integer, (u64) scale));
+    offset = ir_insert_before(before, ir_create_mul(s->ctx, value, imm));
+  }
+
+  IRInstruction *addr = ir_create_add(s->ctx, base, offset);
+  ir_set_type(addr, type);
+  return ir_insert_before(before, addr);
+}
+
+/// Create the PHI that replaces a pointer.
+static IRInstruction *ivsr_create_phi(ivsr_state *s, reduced_pointer *p, Type *type) {
+  IRInstruction *br = ir_terminator(s->preheader);
+  IRInstruction *start = ivsr_offset(s, br, p->base, p->iv->init, p->scale, type);
+
+  IRInstruction *step = ir_create_immediate(s->ctx, t_integer, (u64) (p->iv->step * p->scale));
+  ir_insert_after(p->iv->next, step);
+  IRInstruction *next = p->next = ir_create_add(s->ctx, p->phi = ir_create_phi(s->ctx, type), step);
+  ir_set_type(next, type);
+  ir_insert_after(step, next);
+
+  ir_insert_before(ir_front(s->loop->header), p->phi);
+  ir_phi_add_arg(p->phi, s->preheader, start);
+  ir_phi_add_arg(p->phi, s->latch, next);
+  return p->phi;
+}
+
+/// If the only other use of an induction variable is a comparison in
+/// the loop with a loop-invariant value, compare the pointer instead,
+/// and delete the induction variable. In a rotated loop, the comparison uses the value
+/// for the next iteration instead.
+static void ivsr_replace_exit_test(ivsr_state *s, reduced_pointer *p) {
+  induction_var *iv = p->iv;
+  if (p->scale <= 0) return;
+
+  IRInstruction *value, *pointer;
+  if (ir_use_count(iv->next) == 1) {
+    value = iv->phi;
+    pointer = p->phi;
+  } else if (ir_use_count(iv->next) == 2 && ir_use_count(iv->phi) == 1) {
+    value = iv->next;
+    pointer = p->next;
+  } else {
+    return;
+  }
+
+  IRInstruction *cmp = NULL;
+  FOREACH_USER (user, value) {
+    if (user == iv->next || user == iv->phi || user == cmp) continue;
+    if (cmp) return;
+    cmp = user;
+  }
+
+  if (!cmp || !loop_contains(s->loop, ir_parent(cmp))) return;
+  switch (ir_kind(cmp)) {
+    default: return;
+    case IR_LT:
+    case IR_LE:
+    case IR_GT:
+    case IR_GE:
+    case IR_EQ:
+    case IR_NE: break;
+  }
+
+  bool lhs = ir_lhs(cmp) == value;
+  IRInstruction *limit = lhs ? ir_rhs(cmp) : ir_lhs(cmp);
+  if (limit == value || !ivsr_invariant(s, limit)) return;
+
+  /// We compute the end of the range in the preheader, so the limit
+  /// must be available there.
+  IRBlock *limit_block = ir_parent(limit);
+  if (
+    ir_kind(limit) != IR_IMMEDIATE &&
+    limit_block &&
+    !dom_tree_dominates(s->dom, limit_block, s->preheader)
+  ) return;
+
+  IRInstruction *end = ivsr_offset(s, ir_terminator(s->preheader), p->base, limit, p->scale, ir_typeof(p->phi));
+  if (lhs) {
+    ir_lhs(cmp, pointer);
+    ir_rhs(cmp, end);
+  } else {
+    ir_lhs(cmp, end);
+    ir_rhs(cmp, pointer);
+  }
+
+  ir_phi_remove_arg(iv->phi, s->latch);
+  ir_remove(iv->next);
+  ir_remove(iv->phi);
+}
+
+static bool ivsr_loop(CodegenContext *ctx, AnalysisManager *am, IRFunction *f, Loop *loop) {
+  if (loop->latches.size != 1) return false;
+  ivsr_state s = {
+    .ctx = ctx,
+    .dom = analysis_dom_tree(am, f),
+    .loop = loop,
+    .preheader = loop_preheader(loop, analysis_preds(am, f)),
+    .latch = loop->latches.data[0],
+  };
+
+  if (!s.preheader) return false;
+  FOREACH_INSTRUCTION (i, loop->header) {
+    induction_var iv;
+    if (ir_kind(i) == IR_PHI && ivsr_basic_iv(&s, i, &iv)) vector_push(s.ivs, iv);
+  }
+
+  if (!s.ivs.size) {
+    vector_delete(s.ivs);
+    return false;
+  }
+
+  /// Replace each pointer with a PHI, sharing PHIs between pointers
+  /// that are computed from the same base and induction variable.
+  bool changed = false;
+  foreach_val (b, loop->blocks) {
+    FOREACH_INSTRUCTION (i, b) {
+      reduced_pointer p;
+      if (!ivsr_pointer(&s, i, &p)) continue;
+
+      IRInstruction *phi = NULL;
+      foreach (other, s.pointers) {
+        if (other->iv == p.iv && other->base == p.base && other->scale == p.scale) {
+          phi = other->phi;
+          break;
+        }
+      }
+
+      if (!phi) {
+        if (s.pointers.size == IVSR_MAX_POINTERS) continue;
+        phi = ivsr_create_phi(&s, &p, ir_typeof(i));
+        vector_push(s.pointers, p);
+      }
+
+      /// Delete the multiplication too so it doesn’t count as a use
+      /// of the induction variable.
+      IRInstruction *lhs = ir_lhs(i);
+      IRInstruction *rhs = ir_rhs(i);
+      ir_replace_uses(i, phi);
+      ir_remove(i);
+      if (ir_kind(lhs) == IR_MUL && !ir_use_count(lhs)) ir_remove(lhs);
+      if (ir_kind(rhs) == IR_MUL && !ir_use_count(rhs)) ir_remove(rhs);
+      opt_stats.reduced_pointers++;
+      changed = true;
+    }
+  }
+
+  foreach (p, s.pointers) {
+    bool first = true;
+    foreach (other, s.pointers) {
+      if (other == p) break;
+      if (other->iv == p->iv) first = false;
+    }
+
+    if (first) ivsr_replace_exit_test(&s, p);
+  }
+
+  vector_delete(s.ivs);
+  vector_delete(s.pointers);
+  return changed;
+}
+
+/// Replace pointers into arrays that are recomputed from an induction
+/// variable on every iteration of a loop, e.g. `base + i * 8`, with a
+/// pointer that is incremented by `step * 8` instead. If the induction
+/// variable is then only used to decide when to leave the loop, we
+/// compare the pointer against the end of the range instead, which
+/// allows us to delete the induction variable.
+///
+/// This assumes that address computations don’t overflow.
+static bool opt_ivsr(CodegenContext *ctx, AnalysisManager *am, IRFunction *f) {
+  bool changed = false;
+  LoopInfo *loops = analysis_loops(am, f);
+  foreach_val (loop, loops->loops) changed |= ivsr_loop(ctx, am, f, loop);
+  return changed;
+}
+
+/// ===========================================================================
+///  Loop unrolling
+/// ===========================================================================
+/// Don’t bother computing trip counts larger than this.
+#define UNROLL_MAX_TRIP_COUNT (1 << 16)
+
+typedef struct {
+  CodegenContext *ctx;
+  Loop *loop;
+  IRBlock *preheader;
+  IRBlock *latch;
+
+  /// The successors of the header in and outside the loop.
+  IRBlock *body;
+  IRBlock *exit;
+
+  /// Number of instructions in the loop, not counting PHIs.
+  usz size;
+} unroll_state;
+
+/// Check if a loop has a shape that we can unroll: the header must be
+/// the only block that leaves the loop, and values computed in other
+/// blocks must not be used outside the loop.
+static bool unroll_candidate(unroll_state *s, LoopInfo *loops) {
+  IRBlock *header = s->loop->header;
+  IRInstruction *br = ir_terminator(header);
+  if (ir_kind(br) != IR_BRANCH_CONDITIONAL) return false;
+  bool then_in_loop = loop_contains(s->loop, ir_then(br));
+  if (then_in_loop == loop_contains(s->loop, ir_else(br))) return false;
+  s->body = then_in_loop ? ir_then(br) : ir_else(br);
+  s->exit = then_in_loop ? ir_else(br) : ir_then(br);
+
+  foreach_val (b, s->loop->blocks) {
+    /// Only unroll innermost loops.
+    if (loop_of(loops, b) != s->loop) return false;
+    IRInstruction *term = ir_terminator(b);
+    if (b != header) {
+      switch (ir_kind(term)) {
+        default: return false;
+        case IR_BRANCH:
+          if (!loop_contains(s->loop, ir_dest(term))) return false;
+          break;
+
+        case IR_BRANCH_CONDITIONAL:
+          if (!loop_contains(s->loop, ir_then(term)) || !loop_contains(s->loop, ir_else(term))) return false;
+          break;
+      }
+    }
+
+    FOREACH_INSTRUCTION (i, b) {
+      if (ir_kind(i) == IR_ALLOCA) return false;
+      if (ir_kind(i) != IR_PHI) s->size++;
+      if (b == header) continue;
+      FOREACH_USER (user, i)
+        if (!loop_contains(s->loop, ir_parent(user)))
+          return false;
+    }
+  }
+
+  return true;
+}
+
+/// Compute how often the body of a loop is executed, if the exit test
+/// compares a basic induction variable against a constant and the
+/// induction variable starts out as a constant.
+static bool unroll_trip_count(unroll_state *s, usz *trip_count) {
+  IRInstruction *br = ir_terminator(s->loop->header);
+  IRInstruction *cond = ir_cond(br);
+  switch (ir_kind(cond)) {
+    default: return false;
+    case IR_LT:
+    case IR_LE:
+    case IR_GT:
+    case IR_GE:
+    case IR_EQ:
+    case IR_NE: break;
+  }
+
+  induction_var iv;
+  bool iv_is_lhs = ir_parent(ir_lhs(cond)) == s->loop->header && ir_kind(ir_lhs(cond)) == IR_PHI;
+  IRInstruction *phi = iv_is_lhs ? ir_lhs(cond) : ir_rhs(cond);
+  IRInstruction *limit = iv_is_lhs ? ir_rhs(cond) : ir_lhs(cond);
+  if (ir_kind(phi) != IR_PHI || ir_parent(phi) != s->loop->header) return false;
+  if (!loop_basic_iv(s->preheader, s->latch, phi, &iv)) return false;
+  if (ir_kind(iv.init) != IR_IMMEDIATE || ir_kind(limit) != IR_IMMEDIATE) return false;
+
+  /// Simulate the loop rather than solving for the trip count so we
+  /// get the same results as the generated code for any comparison,
+  /// including when the induction variable wraps around.
+  Type *t = ir_typeof(phi);
+  bool stay = ir_then(br) == s->body;
+  u64 value = ir_imm(iv.init);
+  for (usz trip = 0; trip <= UNROLL_MAX_TRIP_COUNT; trip++) {
+    u64 taken;
+    fold_binary(ir_kind(cond), t, iv_is_lhs ? value : ir_imm(limit), iv_is_lhs ? ir_imm(limit) : value, &taken);
+    if ((taken != 0) != stay) {
+      *trip_count = trip;
+      return true;
+    }
+
+    if (!perform_truncation(&value, value + (u64) iv.step, type_sizeof(t))) return false;
+  }
+
+  return false;
+}
+
+/// Insert `n` copies of an iteration of the loop on the edge from
+/// `pred` to the header. The values of the header PHIs in the first
+/// copy are the ones they receive from `pred`.
+///
+/// The copies of the header branch to the body unconditionally, so
+/// the caller must make sure that the loop isn’t left during any of
+/// the copied iterations.
+static void unroll_copies(unroll_state *s, IRBlock *pred, usz n) {
+  IRBlock *header = s->loop->header;
+  IRInstructionVector phis = {0}, values = {0};
+  FOREACH_INSTRUCTION (i, header) {
+    if (ir_kind(i) != IR_PHI) continue;
+    vector_push(phis, i);
+    vector_push(values, phi_incoming(i, pred));
+  }
+
+  /// Copy everything before we change any branches, since those
+  /// would be copied as well otherwise.
+  IRBlockVector headers = {0}, latches = {0};
+  for (usz k = 0; k < n; k++) {
+    clone_map m = {0};
+    foreach_index (j, phis) map_set(m.values, phis.data[j], values.data[j]);
+    clone_blocks(s->ctx, &s->loop->blocks, header, &m);
+
+    IRBlock *h = clone_block(&m, header);
+    ir_replace(ir_terminator(h), ir_create_br(s->ctx, clone_block(&m, s->body)));
+    vector_push(headers, h);
+    vector_push(latches, clone_block(&m, s->latch));
+    foreach_index (j, phis) values.data[j] = clone_value(&m, phi_incoming(phis.data[j], s->latch));
+
+    map_delete(m.values);
+    map_delete(m.blocks);
+  }
+
+  /// Chain the copies together. The latch of each copy currently
+  /// branches to the header of the same copy.
+  if (n) {
+    retarget_branch(pred, header, headers.data[0]);
+    for (usz k = 0; k < n; k++) {
+      IRBlock *next = k + 1 < n ? headers.data[k + 1] : header;
+      retarget_branch(latches.data[k], headers.data[k], next);
+    }
+
+    foreach_index (j, phis) {
+      ir_phi_remove_arg(phis.data[j], pred);
+      ir_phi_add_arg(phis.data[j], vector_back(latches), values.data[j]);
+    }
+  }
+
+  vector_delete(phis);
+  vector_delete(values);
+  vector_delete(headers);
+  vector_delete(latches);
+}
+
+/// Unroll a loop. Returns whether we changed anything.
+static bool unroll_loop(CodegenContext *ctx, AnalysisManager *am, IRFunction *f, Loop *loop) {
+  if (loop->latches.size != 1 || loop->header == ir_entry_block(f)) return false;
+  if (loop->latches.data[0] == loop->header) return false;
+  unroll_state s = {
+    .ctx = ctx,
+    .loop = loop,
+    .preheader = loop_preheader(loop, analysis_preds(am, f)),
+    .latch = loop->latches.data[0],
+  };
+
+  usz trip_count;
+  if (!s.preheader || !unroll_candidate(&s, analysis_loops(am, f))) return false;
+  if (!unroll_trip_count(&s, &trip_count)) return false;
+
+  /// If the unrolled loop fits in the budget, replace it with one copy
+  /// of the body per iteration. All that is left of the loop is the
+  /// last evaluation of the exit test, which now always leaves it.
+  IRBlock *header = loop->header;
+  if (trip_count * s.size <= optimise_unroll_threshold) {
+    unroll_copies(&s, s.preheader, trip_count);
+    ir_replace(ir_terminator(header), ir_create_br(ctx, s.exit));
+    FOREACH_INSTRUCTION (i, header)
+      if (ir_kind(i) == IR_PHI)
+        ir_phi_remove_arg(i, s.latch);
+
+    IRBlockVector dead = {0};
+    foreach_val (b, loop->blocks)
+      if (b != header)
+        vector_push(dead, b);
+
+    delete_blocks(ctx, &dead);
+    vector_delete(dead);
+    opt_stats.unrolled_loops++;
+    return true;
+  }
+
+  /// Otherwise, copy the body as often as the budget allows. The exit
+  /// test is only evaluated once per `factor` iterations, so the first
+  /// `trip_count % factor` iterations are peeled off in front of the
+  /// loop to make the rest a multiple of the factor. Don’t bother if
+  /// the unrolled loop would only run once.
+  usz factor = optimise_unroll_threshold / s.size;
+  if (factor < 2 || trip_count / factor < 2) return false;
+  unroll_copies(&s, s.preheader, trip_count % factor);
+  unroll_copies(&s, s.latch, factor - 1);
+  opt_stats.unrolled_loops++;
+  return true;
+}
+
+/// Unroll innermost loops whose exit test compares an induction
+/// variable against a constant, so that we know how often they run.
+///
+/// Loops are unrolled fully if the result has no more instructions
+/// than the unroll threshold, which can be set on the command line.
+/// Otherwise, the body is copied as many times as the threshold allows
+/// and the exit test is only evaluated once for all of those copies.
+static bool opt_unroll(CodegenContext *ctx, AnalysisManager *am, IRFunction *f) {
+  if (!optimise_unroll_threshold) return false;
+  bool changed = false;
+  bool again;
+  do {
+    again = false;
+    LoopInfo *loops = analysis_loops(am, f);
+    for (usz n = loops->loops.size; n; n--) {
+      if (!unroll_loop(ctx, am, f, loops->loops.data[n - 1])) continue;
+
+      /// Unrolling changes the CFG, so start over.
+      analysis_invalidate(am, f, ANALYSIS_NONE);
+      changed = again = true;
+      break;
+    }
+  } while (again);
+  return changed;
+}
+
+/// ===========================================================================
+///  Loop rotation
+/// ===========================================================================
+/// Maximum number of instructions in a loop header that we duplicate,
+/// not counting PHIs.
+#define ROTATE_MAX_HEADER_SIZE 8
+
+typedef struct {
+  CodegenContext *ctx;
+  Loop *loop;
+  IRBlock *preheader;
+  IRBlock *latch;
+
+  /// The successors of the header in and outside the loop.
+  IRBlock *body;
+  IRBlock *exit;
+
+  /// The copy of the header in front of the loop, the new preheader,
+  /// and the copy of the header at the end of the loop.
+  IRBlock *guard;
+  IRBlock *entry;
+  IRBlock *bottom;
+  clone_map guard_values;
+  clone_map bottom_values;
+
+  /// PHIs that merge the values computed by both copies of the header
+  /// at the start of the body and after the loop, respectively.
+  Map(IRInstruction *, IRInstruction *) body_phis;
+  Map(IRInstruction *, IRInstruction *) exit_phis;
+} rotate_state;
+
+/// Check if a loop has a shape that we can rotate: the header must be
+/// the only block that leaves the loop, and it must be small enough
+/// to be duplicated.
+static bool rotate_candidate(rotate_state *s) {
+  IRBlock *header = s->loop->header;
+  IRInstruction *br = ir_terminator(header);
+  if (ir_kind(br) != IR_BRANCH_CONDITIONAL) return false;
+  bool then_in_loop = loop_contains(s->loop, ir_then(br));
+  if (then_in_loop == loop_contains(s->loop, ir_else(br))) return false;
+  s->body = then_in_loop ? ir_then(br) : ir_else(br);
+  s->exit = then_in_loop ? ir_else(br) : ir_then(br);
+
+  usz size = 0;
+  FOREACH_INSTRUCTION (i, header) {
+    if (ir_kind(i) == IR_ALLOCA) return false;
+    if (ir_kind(i) != IR_PHI) size++;
+  }
+
+  if (size > ROTATE_MAX_HEADER_SIZE) return false;
+  foreach_val (b, s->loop->blocks) {
+    if (b == header) continue;
+    IRInstruction *term = ir_terminator(b);
+    switch (ir_kind(term)) {
+      default: break;
+      case IR_BRANCH:
+        if (!loop_contains(s->loop, ir_dest(term))) return false;
+        break;
+
+      case IR_BRANCH_CONDITIONAL:
+        if (!loop_contains(s->loop, ir_then(term)) || !loop_contains(s->loop, ir_else(term))) return false;
+        break;
+    }
+  }
+
+  return true;
+}
+
+/// Check if a value computed in the header is used after the loop other
+/// than by a PHI on the edge that leaves the header.
+static bool rotate_used_after_loop(rotate_state *s) {
+  FOREACH_INSTRUCTION (i, s->loop->header) {
+    FOREACH_USER (user, i) {
+      if (loop_contains(s->loop, ir_parent(user))) continue;
+      if (ir_kind(user) != IR_PHI) return true;
+      for (usz n = 0; n < ir_phi_args_count(user); n++) {
+        const IRPhiArgument *arg = ir_phi_arg(user, n);
+        if (arg->value == i && arg->block != s->loop->header) return true;
+      }
+    }
+  }
+  return false;
+}
+
+/// Insert an empty block on the edge from the header to `b`.
+static IRBlock *rotate_split_edge(rotate_state *s, IRBlock *b) {
+  IRBlock *split = ir_block_insert_before(b, ir_block(s->ctx));
+  ir_insert_at_end(split, ir_create_br(s->ctx, b));
+  retarget_branch(s->loop->header, b, split);
+  FOREACH_INSTRUCTION (phi, b) {
+    if (ir_kind(phi) != IR_PHI) continue;
+    IRInstruction *value = phi_incoming(phi, s->loop->header);
+    if (!value) continue;
+    ir_phi_remove_arg(phi, s->loop->header);
+    ir_phi_add_arg(phi, split, value);
+  }
+  return split;
+}
+
+/// Get the value that replaces a value computed in the header, either
+/// in the loop or after it. This is a PHI that merges the values of
+/// both copies of the header; its arguments are added once both copies
+/// exist.
+static IRInstruction *rotate_value(rotate_state *s, IRInstruction *i, bool in_loop) {
+  if (ir_parent(i) != s->loop->header) return i;
+  IRInstruction **phi = in_loop ? map_get(s->body_phis, i) : map_get(s->exit_phis, i);
+  if (phi) return *phi;
+
+  IRBlock *b = in_loop ? s->body : s->exit;
+  IRInstruction *merged = ir_insert_before(ir_front(b), ir_create_phi(s->ctx, ir_typeof(i)));
+  if (in_loop) map_set(s->body_phis, i, merged);
+  else map_set(s->exit_phis, i, merged);
+  return merged;
+}
+
+/// Add the incoming values from both copies of the header to a PHI.
+static void rotate_add_args(rotate_state *s, IRInstruction *phi, IRBlock *from, IRInstruction *value) {
+  ir_phi_add_arg(phi, from, clone_value(&s->guard_values, value));
+  ir_phi_add_arg(phi, s->bottom, clone_value(&s->bottom_values, value));
+}
+
+/// Make the users of a value computed in the header use the value
+/// that replaces it.
+static void rotate_replace_uses(rotate_state *s, IRInstruction *i) {
+  IRInstructionVector users = {0};
+  FOREACH_USER (user, i)
+    if (ir_parent(user) != s->loop->header)
+      vector_push_unique(users, user);
+
+  Vector(IRPhiArgument) args = {0};
+  foreach_val (user, users) {
+    if (ir_kind(user) == IR_PHI) {
+      vector_clear(args);
+      for (usz n = 0; n < ir_phi_args_count(user); n++) vector_push(args, *ir_phi_arg(user, n));
+      foreach (arg, args) {
+        if (arg->value != i) continue;
+        bool in_loop = arg->block == s->body || loop_contains(s->loop, arg->block);
+        ir_phi_remove_arg(user, arg->block);
+        ir_phi_add_arg(user, arg->block, rotate_value(s, i, in_loop));
+      }
+      continue;
+    }
+
+    clone_map m = {0};
+    map_set(m.values, i, rotate_value(s, i, loop_contains(s->loop, ir_parent(user))));
+    ir_map_operands(user, clone_operand, &m);
+    map_delete(m.values);
+  }
+
+  vector_delete(users);
+  vector_delete(args);
+}
+
+/// Rotate a loop. Returns whether we changed anything.
+static bool rotate_loop(CodegenContext *ctx, AnalysisManager *am, IRFunction *f, Loop *loop) {
+  IRBlock *header = loop->header;
+  if (loop->latches.size != 1 || header == ir_entry_block(f)) return false;
+  Predecessors *preds = analysis_preds(am, f);
+  rotate_state s = {
+    .ctx = ctx,
+    .loop = loop,
+    .preheader = loop_preheader(loop, preds),
+    .latch = loop->latches.data[0],
+  };
+
+  /// If the latch is the header, the loop is already rotated.
+  if (!s.preheader || s.latch == header || !rotate_candidate(&s)) return false;
+
+  /// Values from the header are replaced with PHIs at the start of
+  /// the body and after the loop. If those blocks have any other
+  /// predecessors, we need blocks on these edges to put them in.
+  if (map_get(*preds, s.body)->size != 1) s.body = rotate_split_edge(&s, s.body);
+  if (map_get(*preds, s.exit)->size != 1 && rotate_used_after_loop(&s)) s.exit = rotate_split_edge(&s, s.exit);
+
+  /// Copy the header in front of the loop and to the end of the loop;
+  /// the PHIs are replaced with the values from the respective edge.
+  IRBlockVector blocks = {0};
+  vector_push(blocks, header);
+  FOREACH_INSTRUCTION (phi, header) {
+    if (ir_kind(phi) != IR_PHI) continue;
+    map_set(s.guard_values.values, phi, phi_incoming(phi, s.preheader));
+    map_set(s.bottom_values.values, phi, rotate_value(&s, phi_incoming(phi, s.latch), true));
+  }
+
+  clone_blocks(ctx, &blocks, header, &s.guard_values);
+  s.guard = clone_block(&s.guard_values, header);
+  s.entry = ir_block_insert_before(header, ir_block(ctx));
+  ir_insert_at_end(s.entry, ir_create_br(ctx, s.body));
+  retarget_branch(s.guard, s.body, s.entry);
+  clone_blocks(ctx, &blocks, header, &s.bottom_values);
+  s.bottom = clone_block(&s.bottom_values, header);
+
+  /// Fix PHIs that had an incoming value from the header.
+  FOREACH_INSTRUCTION (phi, s.body) {
+    if (ir_kind(phi) != IR_PHI) continue;
+    IRInstruction *value = phi_incoming(phi, header);
+    if (!value) continue;
+    ir_phi_remove_arg(phi, header);
+    rotate_add_args(&s, phi, s.entry, value);
+  }
+
+  FOREACH_INSTRUCTION (phi, s.exit) {
+    if (ir_kind(phi) != IR_PHI) continue;
+    IRInstruction *value = phi_incoming(phi, header);
+    if (!value) continue;
+    ir_phi_remove_arg(phi, header);
+    rotate_add_args(&s, phi, s.guard, value);
+  }
+
+  /// Replace all other uses of values computed in the header and fill
+  /// in the PHIs that we created for them.
+  FOREACH_INSTRUCTION (i, header) rotate_replace_uses(&s, i);
+  map_foreach (e, s.body_phis) rotate_add_args(&s, e->value, s.entry, e->key);
+  map_foreach (e, s.exit_phis) rotate_add_args(&s, e->value, s.guard, e->key);
+
+  /// Enter the loop through the guard and branch back from the bottom.
+  retarget_branch(s.preheader, header, s.guard);
+  retarget_branch(s.latch, header, s.bottom);
+  delete_blocks(ctx, &blocks);
+  opt_stats.rotated_loops++;
+
+  vector_delete(blocks);
+  map_delete(s.guard_values.values);
+  map_delete(s.guard_values.blocks);
+  map_delete(s.bottom_values.values);
+  map_delete(s.bottom_values.blocks);
+  map_delete(s.body_phis);
+  map_delete(s.exit_phis);
+  return true;
+}
+
+/// Rotate loops whose exit test is at the top so that it is at the
+/// bottom instead. A loop such as
+///
+///   header:
+///     if cond goto body else goto exit
+///   body:
+///     ...
+///     goto header
+///
+/// is turned into
+///
+///   guard:
+///     if cond goto preheader else goto exit
+///   preheader:
+///     goto body
+///   body:
+///     ...
+///     if cond goto body else goto exit
+///
+/// This saves a branch per iteration. Moreover, the body now always
+/// runs before the loop is left, which lets LICM hoist instructions
+/// that it otherwise couldn’t.
+static bool opt_rotate(CodegenContext *ctx, AnalysisManager *am, IRFunction *f) {
+  bool changed = false;
+  bool again;
+  do {
+    again = false;
+    LoopInfo *loops = analysis_loops(am, f);
+    for (usz n = loops->loops.size; n; n--) {
+      if (!rotate_loop(ctx, am, f, loops->loops.data[n - 1])) continue;
+
+      /// Rotating changes the CFG, so start over.
+      analysis_invalidate(am, f, ANALYSIS_NONE);
+      changed = again = true;
+      break;
+    }
+  } while (again);
+  return changed;
+}
+
+/// ===========================================================================
+///  Loop unswitching
+/// ===========================================================================
+/// Maximum number of instructions that the copies of a loop may have
+/// after unswitching all of its branches on invariant conditions.
+#define UNSWITCH_MAX_SIZE 128
+
+/// Find a conditional branch in a loop on a condition that doesn’t
+/// change in the loop. Returns NULL if there is none or if the loop
+/// can’t be copied.
+static IRInstruction *unswitch_candidate(Loop *loop) {
+  IRInstruction *branch = NULL;
+  usz size = 0, branches = 0;
+  foreach_val (b, loop->blocks) {
+    FOREACH_INSTRUCTION (i, b) {
+      if (ir_kind(i) == IR_ALLOCA) return NULL;
+      if (ir_kind(i) != IR_PHI) size++;
+
+      /// Values computed in the loop may only be used after it by PHIs
+      /// on the edges that leave the loop; other uses would have to be
+      /// merged with the values from the copy.
+      FOREACH_USER (user, i) {
+        if (loop_contains(loop, ir_parent(user))) continue;
+        if (ir_kind(user) != IR_PHI) return NULL;
+        for (usz n = 0; n < ir_phi_args_count(user); n++) {
+          const IRPhiArgument *arg = ir_phi_arg(user, n);
+          if (arg->value == i && !loop_contains(loop, arg->block)) return NULL;
+        }
+      }
+    }
+
+    IRInstruction *term = ir_terminator(b);
+    if (ir_kind(term) != IR_BRANCH_CONDITIONAL || ir_then(term) == ir_else(term)) continue;
+    IRInstruction *cond = ir_cond(term);
+    IRBlock *parent = ir_parent(cond);
+    if (ir_kind(cond) == IR_IMMEDIATE || (parent && loop_contains(loop, parent))) continue;
+    if (!branch) branch = term;
+    branches++;
+  }
+
+  /// Every branch that we unswitch doubles the number of copies of the
+  /// loop, so take all of them into account.
+  if (!branch || branches >= sizeof(usz) * 8 || size << branches > UNSWITCH_MAX_SIZE) return NULL;
+  return branch;
+}
+
+/// Replace a conditional branch with a branch to one of its targets.
+static void unswitch_fold_branch(CodegenContext *ctx, IRInstruction *br, bool taken) {
+  IRBlock *b = ir_parent(br);
+  IRBlock *dest = taken ? ir_then(br) : ir_else(br);
+  IRBlock *other = taken ? ir_else(br) : ir_then(br);
+  FOREACH_INSTRUCTION (phi, other)
+    if (ir_kind(phi) == IR_PHI)
+      ir_phi_remove_arg(phi, b);
+  ir_replace(br, ir_create_br(ctx, dest));
+}
+
+/// Add the incoming values from a copied block to the PHIs in a
+/// successor outside the loop.
+static void unswitch_exit_phis(clone_map *m, IRBlock *b, IRBlock *exit) {
+  FOREACH_INSTRUCTION (phi, exit) {
+    if (ir_kind(phi) != IR_PHI) continue;
+    IRInstruction *value = phi_incoming(phi, b);
+    if (value) ir_phi_add_arg(phi, clone_block(m, b), clone_value(m, value));
+  }
+}
+
+/// Unswitch a loop. Returns whether we changed anything.
+static bool unswitch_loop(CodegenContext *ctx, AnalysisManager *am, IRFunction *f, Loop *loop) {
+  IRBlock *header = loop->header;
+  if (header == ir_entry_block(f)) return false;
+  IRBlock *preheader = loop_preheader(loop, analysis_preds(am, f));
+  IRInstruction *branch = unswitch_candidate(loop);
+  if (!preheader || !branch) return false;
+
+  /// Copy the loop, keeping the blocks in the same order. The original
+  /// is run if the condition is true, the copy otherwise.
+  IRBlockVector blocks = {0};
+  FOREACH_BLOCK (b, f)
+    if (loop_contains(loop, b))
+      vector_push(blocks, b);
+
+  clone_map m = {0};
+  IRInstruction *cond = ir_cond(branch);
+  IRBlock *else_entry = ir_block_insert_before(header, ir_block(ctx));
+  clone_blocks(ctx, &blocks, header, &m);
+  IRBlock *then_entry = ir_block_insert_before(header, ir_block(ctx));
+  IRBlock *copy = clone_block(&m, header);
+  ir_insert_at_end(then_entry, ir_create_br(ctx, header));
+  ir_insert_at_end(else_entry, ir_create_br(ctx, copy));
+
+  /// Each loop gets its own preheader.
+  FOREACH_INSTRUCTION (phi, header) {
+    if (ir_kind(phi) != IR_PHI) continue;
+    IRInstruction *value = phi_incoming(phi, preheader);
+    ir_phi_remove_arg(phi, preheader);
+    ir_phi_add_arg(phi, then_entry, value);
+    ir_phi_remove_arg(clone_value(&m, phi), preheader);
+    ir_phi_add_arg(clone_value(&m, phi), else_entry, value);
+  }
+
+  /// The copy leaves the loop to the same blocks.
+  foreach_val (b, blocks) {
+    IRInstruction *term = ir_terminator(b);
+    switch (ir_kind(term)) {
+      default: break;
+      case IR_BRANCH:
+        if (!loop_contains(loop, ir_dest(term))) unswitch_exit_phis(&m, b, ir_dest(term));
+        break;
+
+      case IR_BRANCH_CONDITIONAL:
+        if (!loop_contains(loop, ir_then(term))) unswitch_exit_phis(&m, b, ir_then(term));
+        if (!loop_contains(loop, ir_else(term)) && ir_else(term) != ir_then(term)) unswitch_exit_phis(&m, b, ir_else(term));
+        break;
+    }
+  }
+
+  /// Decide which loop to run before entering either of them. Parts
+  /// of the loops that are no longer reachable are deleted by the CFG
+  /// simplification.
+  unswitch_fold_branch(ctx, clone_value(&m, branch), false);
+  unswitch_fold_branch(ctx, branch, true);
+  ir_replace(ir_terminator(preheader), ir_create_cond_br(ctx, cond, then_entry, else_entry));
+  opt_stats.unswitched_loops++;
+
+  vector_delete(blocks);
+  map_delete(m.values);
+  map_delete(m.blocks);
+  return true;
+}
+
+/// Move conditional branches on conditions that don’t change in a
+/// loop out of the loop by making a copy of the loop for either
+/// outcome of the condition and deciding which one to run before
+/// entering it.
+///
+/// Loops are processed from outermost to innermost so that a branch
+/// is moved as far out as possible.
+static bool opt_unswitch(CodegenContext *ctx, AnalysisManager *am, IRFunction *f) {
+  bool changed = false;
+  bool again;
+  do {
+    again = false;
+    LoopInfo *loops = analysis_loops(am, f);
+    foreach_val (loop, loops->loops) {
+      if (!unswitch_loop(ctx, am, f, loop)) continue;
+
+      /// Unswitching changes the CFG, so start over.
+      analysis_invalidate(am, f, ANALYSIS_NONE);
+      changed = again = true;
+      break;
+    }
+  } while (again);
+  return changed;
+}
+
+/// ===========================================================================
+///  Loop idiom recognition
+/// ===========================================================================
+typedef struct {
+  CodegenContext *ctx;
+  unroll_state loop;
+
+  /// Copies of loop-invariant instructions in the preheader.
+  clone_map hoisted;
+} idiom_state;
+
+/// An address `base + iv * scale`, where `base` is loop-invariant.
+typedef struct {
+  induction_var iv;
+  IRInstruction *base;
+  i64 scale;
+} idiom_address;
+
+/// An exit test `iv < limit` or `iv <= limit`, where `iv` moves
+/// forward by one and `limit` is loop-invariant.
+typedef struct {
+  induction_var iv;
+  IRInstruction *limit;
+  bool inclusive;
+} idiom_exit_test;
+
+/// Check if a value does not change in the loop. This runs before
+/// LICM, so we also accept computations of addresses that can be
+/// hoisted trivially.
+static bool idiom_invariant(idiom_state *s, IRInstruction *i) {
+  IRBlock *b = ir_parent(i);
+  if (!b || !loop_contains(s->loop.loop, b)) return true;
+  switch (ir_kind(i)) {
+    default: return false;
+    case IR_IMMEDIATE:
+    case IR_STATIC_REF:
+      return true;
+
+    case IR_COPY:
+    case IR_BITCAST:
+      return idiom_invariant(s, ir_operand(i));
+  }
+}
+
+/// Get a copy of a loop-invariant value in the preheader.
+static IRInstruction *idiom_hoist(idiom_state *s, IRInstruction *i);
+static IRInstruction *idiom_hoist_operand(IRInstruction *i, void *s) {
+  return idiom_hoist(s, i);
+}
+
+static IRInstruction *idiom_hoist(idiom_state *s, IRInstruction *i) {
+  IRBlock *b = ir_parent(i);
+  if (!b || !loop_contains(s->loop.loop, b)) return i;
+  IRInstruction **hoisted = map_get(s->hoisted.values, i);
+  if (hoisted) return *hoisted;
+
+  IRInstruction *copy = ir_clone(s->ctx, i);
+  ir_map_operands(copy, idiom_hoist_operand, s);
+  ir_insert_before(ir_terminator(s->loop.preheader), copy);
+  map_set(s->hoisted.values, i, copy);
+  return copy;
+}
+
+/// Check if an address is `base + iv * scale` for a basic induction
+/// variable that moves forward by one element of type `type` per
+/// iteration.
+static bool idiom_address_of(idiom_state *s, IRInstruction *addr, Type *type, idiom_address *a) {
+  if (ir_kind(addr) != IR_ADD || !type_is_pointer(ir_typeof(addr))) return false;
+  for (usz n = 0; n < 2; n++) {
+    IRInstruction *base = n ? ir_rhs(addr) : ir_lhs(addr);
+    IRInstruction *offset = n ? ir_lhs(addr) : ir_rhs(addr);
+    if (!type_is_pointer(ir_typeof(base)) || !idiom_invariant(s, base)) continue;
+
+    i64 scale = 1;
+    if (ir_kind(offset) == IR_MUL) {
+      IRInstruction *lhs = ir_lhs(offset);
+      IRInstruction *rhs = ir_rhs(offset);
+      if (ir_kind(rhs) == IR_IMMEDIATE) {
+        scale = (i64) ir_imm(rhs);
+        offset = lhs;
+      } else if (ir_kind(lhs) == IR_IMMEDIATE) {
+        scale = (i64) ir_imm(lhs);
+        offset = rhs;
+      } else {
+        continue;
+      }
+    }
+
+    if (ir_kind(offset) != IR_PHI || ir_parent(offset) != s->loop.loop->header) continue;
+    if (!loop_basic_iv(s->loop.preheader, s->loop.latch, offset, &a->iv)) continue;
+    if (type_sizeof(ir_typeof(offset)) != type_sizeof(t_integer)) continue;
+    if (a->iv.step * scale != (i64) type_sizeof(type)) continue;
+    a->base = base;
+    a->scale = scale;
+    return true;
+  }
+
+  return false;
+}
+
+/// Check if the loop runs while a basic induction variable that moves
+/// forward by one is less than, or less than or equal to, a value that
+/// doesn’t change in the loop.
+static bool idiom_exit_test_of(idiom_state *s, idiom_exit_test *t) {
+  IRBlock *header = s->loop.loop->header;
+  IRInstruction *br = ir_terminator(header);
+  IRInstruction *cond = ir_cond(br);
+  IRType kind = ir_kind(cond);
+  switch (kind) {
+    default: return false;
+    case IR_LT:
+    case IR_LE:
+    case IR_GT:
+    case IR_GE: break;
+  }
+
+  /// Rewrite the test as `iv op limit` that is true if we stay in
+  /// the loop.
+  bool iv_is_lhs = ir_parent(ir_lhs(cond)) == header && ir_kind(ir_lhs(cond)) == IR_PHI;
+  IRInstruction *phi = iv_is_lhs ? ir_lhs(cond) : ir_rhs(cond);
+  t->limit = iv_is_lhs ? ir_rhs(cond) : ir_lhs(cond);
+  if (!iv_is_lhs) {
+    switch (kind) {
+      default: UNREACHABLE();
+      case IR_LT: kind = IR_GT; break;
+      case IR_LE: kind = IR_GE; break;
+      case IR_GT: kind = IR_LT; break;
+      case IR_GE: kind = IR_LE; break;
+    }
+  }
+
+  if (ir_then(br) != s->loop.body) {
+    switch (kind) {
+      default: UNREACHABLE();
+      case IR_LT: kind = IR_GE; break;
+      case IR_LE: kind = IR_GT; break;
+      case IR_GT: kind = IR_LE; break;
+      case IR_GE: kind = IR_LT; break;
+    }
+  }
+
+  if (kind != IR_LT && kind != IR_LE) return false;
+  if (ir_kind(phi) != IR_PHI || ir_parent(phi) != header) return false;
+  if (!loop_basic_iv(s->loop.preheader, s->loop.latch, phi, &t->iv) || t->iv.step != 1) return false;
+  if (type_sizeof(ir_typeof(phi)) != type_sizeof(t_integer) || !idiom_invariant(s, t->limit)) return false;
+  t->inclusive = kind == IR_LE;
+  return true;
+}
+
+/// Compute the number of bytes that a loop with exit test `t` copies
+/// or fills in the preheader, assuming that it runs at least once.
+static IRInstruction *idiom_byte_count(idiom_state *s, idiom_exit_test *t, Type *type) {
+  IRInstruction *br = ir_terminator(s->loop.preheader);
+  IRInstruction *count = ir_insert_before(br, ir_create_sub(s->ctx, idiom_hoist(s, t->limit), t->iv.init));
+  if (t->inclusive) {
+    IRInstruction *one = ir_insert_before(br, ir_create_immediate(s->ctx, t_integer, 1));
+    count = ir_insert_before(br, ir_create_add(s->ctx, count, one));
+  }
+
+  IRInstruction *size = ir_insert_before(br, ir_create_immediate(s->ctx, t_integer, type_sizeof(type)));
+  return ir_insert_before(br, ir_create_mul(s->ctx, count, size));
+}
+
+/// Compute the address accessed in the first iteration in the preheader.
+static IRInstruction *idiom_start(idiom_state *s, idiom_address *a) {
+  IRInstruction *br = ir_terminator(s->loop.preheader);
+  IRInstruction *base = idiom_hoist(s, a->base);
+  IRInstruction *offset;
+  if (ir_kind(a->iv.init) == IR_IMMEDIATE) {
+    u64 bytes = ir_imm(a->iv.init) * (u64) a->scale;
+    if (!bytes) return base;
+    offset = ir_insert_before(br, ir_create_immediate(s->ctx, t_integer, bytes));
+  } else {
+    IRInstruction *scale = ir_insert_before(br, ir_create_immediate(s->ctx, t_integer, (u64) a->scale));
+    offset = ir_insert_before(br, ir_create_mul(s->ctx, a->iv.init, scale));
   }
-
-  /// Truncate to destination size.
-  return perform_truncation(out_value, value, dest_size);
+  return ir_insert_before(br, ir_create_add(s->ctx, base, offset));
 }
 
-/// ===========================================================================
-///  Instruction combination
-/// ===========================================================================
-/// Everything that merges instructions or performs strength reduction,
-/// folding, etc. etc. goes here. If you’re unsure where to put something,
-/// put it here.
-///
-/// Note: Take care to remove uses etc. *before* overwriting the `imm` field
-/// as it is in a union together with whatever it is whose uses you want to
-/// remove.
-static bool opt_instcombine(CodegenContext *ctx, IRFunction *f) {
-  bool changed = false;
+/// Get the byte that every byte of a value stored by a fill loop is
+/// set to, or NULL if there isn’t one.
+static IRInstruction *idiom_fill_byte(idiom_state *s, IRInstruction *value) {
+  usz size = type_sizeof(ir_typeof(value));
+  if (ir_kind(value) != IR_IMMEDIATE) {
+    IRBlock *b = ir_parent(value);
+    if (size != 1 || (b && loop_contains(s->loop.loop, b))) return NULL;
+    return value;
+  }
 
-  /// Div instructions to be replaced by shifts.
-  Vector(struct shift { IRInstruction *div; IRInstruction *shift_amount; }) shift_divs = {0};
+  u64 imm = ir_imm(value);
+  for (usz n = 1; n < size; n++)
+    if (((imm >> (8 * n)) & 0xff) != (imm & 0xff))
+      return NULL;
 
-  FOREACH_BLOCK (b, f) {
+  IRInstruction *br = ir_terminator(s->loop.preheader);
+  return ir_insert_before(br, ir_create_immediate(s->ctx, t_byte, imm & 0xff));
+}
+
+/// Replace a loop with a memcpy or memset. Returns whether we
+/// changed anything.
+static bool idiom_loop(CodegenContext *ctx, AnalysisManager *am, IRFunction *f, Loop *loop) {
+  if (loop->latches.size != 1 || loop->blocks.size != 2 || loop->header == ir_entry_block(f)) return false;
+  idiom_state s = {
+    .ctx = ctx,
+    .loop = {
+      .ctx = ctx,
+      .loop = loop,
+      .preheader = loop_preheader(loop, analysis_preds(am, f)),
+      .latch = loop->latches.data[0],
+    },
+  };
+
+  usz trip_count;
+  idiom_exit_test test;
+  if (!s.loop.preheader || s.loop.latch == loop->header) return false;
+  if (!unroll_candidate(&s.loop, analysis_loops(am, f)) || s.loop.body != s.loop.latch) return false;
+  bool known = unroll_trip_count(&s.loop, &trip_count);
+  if (!known && !idiom_exit_test_of(&s, &test)) return false;
+
+  /// The body may only store to one address and load the value that
+  /// it stores. Everything else must be free of side effects, since we
+  /// delete the loop, and must not be used after it.
+  IRInstruction *store = NULL, *load = NULL;
+  foreach_val (b, loop->blocks) {
     FOREACH_INSTRUCTION (i, b) {
+      FOREACH_USER (user, i)
+        if (!loop_contains(loop, ir_parent(user)))
+          return false;
+
       switch (ir_kind(i)) {
         default: break;
-        case IR_ADD: {
-          IR_REDUCE_BINARY(+)
-          else {
-            // Adding zero to something == no-op
-            /// TODO: Canonicalisation.
-            if (lhs_kind == IR_IMMEDIATE && ir_imm(lhs) == 0) {
-              ir_replace_uses(i, rhs);
-              changed = true;
-            } else if (rhs_kind == IR_IMMEDIATE && ir_imm(rhs) == 0) {
-              ir_replace_uses(i, lhs);
-              changed = true;
-            }
-          }
-        } break;
-
-        case IR_SUB: {
-          IR_REDUCE_BINARY(-)
-          else {
-            // Subtracting zero from something == no-op
-            if (rhs_kind == IR_IMMEDIATE && ir_imm(rhs) == 0) {
-              ir_replace_uses(i, lhs);
-              changed = true;
-            }
-          }
-        } break;
-
-        case IR_MUL: {
-          IR_REDUCE_BINARY(*)
-          else {
-            /// TODO: Canonicalisation.
-            // Multiplying by zero == zero
-            if ((lhs_kind == IR_IMMEDIATE && ir_imm(lhs) == 0)) {
-              ir_replace_uses(i, lhs);
-              changed = true;
-            }
-            // Multiplying by zero == zero
-            else if ((rhs_kind == IR_IMMEDIATE && ir_imm(rhs) == 0)) {
-              ir_replace_uses(i, rhs);
-              changed = true;
-            }
-            // Multiplying 1 * rhs == rhs
-            else if (lhs_kind == IR_IMMEDIATE && ir_imm(lhs) == 1) {
-              ir_replace_uses(i, rhs);
-              changed = true;
-            }
-            // Multiplying lhs * 1 == lhs
-            else if (rhs_kind == IR_IMMEDIATE && ir_imm(rhs) == 1) {
-              ir_replace_uses(i, lhs);
-              changed = true;
-            }
-          }
-        } break;
-
-        case IR_DIV: {
-          IR_REDUCE_BINARY(/)
-          else {
-            if (rhs_kind == IR_IMMEDIATE) {
-              usz imm = ir_imm(rhs);
-              /// Division by 1 does nothing.
-              if (imm == 1) {
-                ir_replace_uses(i, lhs);
-                changed = true;
-              }
-
-              /// Replace division by a power of two with a shift.
-              else if (power_of_two(imm)) {
-                vector_push(shift_divs, (struct shift){
-                  i,
-                  ir_create_immediate(ctx, ir_typeof(i), (u64) ctzll(imm)),
-                });
-                changed = true;
-              }
-            }
-          }
-        } break;
-
-        case IR_MOD: {
-          IR_REDUCE_BINARY(%)
-        } break;
-
-        case IR_SHL: {
-          IR_REDUCE_BINARY(<<)
-        } break;
-
-        case IR_SHR: {
-          IR_REDUCE_BINARY(>>)
-        } break;
-
-        case IR_SAR: {
-          IRInstruction *lhs = ir_lhs(i);
-          IRInstruction *rhs = ir_rhs(i);
-          IRType lhs_kind = ir_kind(lhs);
-          IRType rhs_kind = ir_kind(rhs);
-          if (lhs_kind == IR_IMMEDIATE && rhs_kind == IR_IMMEDIATE) {
-            ir_replace(i, ir_create_immediate(ctx, ir_typeof(i), (u64) ((i64) ir_imm(lhs) >> (i64) ir_imm(rhs))));
-            changed = true;
-          }
-        } break;
+        case IR_CALL:
+        case IR_INTRINSIC:
+          return false;
 
-        case IR_AND: {
-          IR_REDUCE_BINARY(&)
-        } break;
+        case IR_STORE:
+          if (store || b != s.loop.body) return false;
+          store = i;
+          break;
 
-        case IR_OR: {
-          IR_REDUCE_BINARY(|)
-        } break;
+        case IR_LOAD:
+          if (load || b != s.loop.body) return false;
+          load = i;
+          break;
+      }
+    }
+  }
 
-        case IR_NOT: {
-          IRInstruction *op = ir_operand(i);
-          if (ir_kind(op) == IR_IMMEDIATE) {
-            ir_replace(i, ir_create_immediate(ctx, ir_typeof(i), ~ir_imm(op)));
-            changed = true;
-          }
-        } break;
-
-        case IR_LT: {
-          IR_REDUCE_BINARY(<);
-        } break;
-        case IR_LE: {
-          IR_REDUCE_BINARY(<=);
-        } break;
-        case IR_GT: {
-          IR_REDUCE_BINARY(>);
-        } break;
-        case IR_GE: {
-          IR_REDUCE_BINARY(>=);
-        } break;
-        case IR_NE: {
-          IR_REDUCE_BINARY(!=)
-          else if (lhs == rhs) {
-            ir_replace(i, ir_create_immediate(ctx, ir_typeof(i), 0));
-            changed = true;
-          }
-        } break;
+  if (!store) return false;
+  IRInstruction *value = ir_store_value(store);
+  Type *type = ir_typeof(value);
+  if (load && (value != load || ir_use_count(load) != 1)) return false;
 
-        case IR_EQ: {
-          IR_REDUCE_BINARY(==)
-          else if (lhs == rhs) {
-            ir_replace(i, ir_create_immediate(ctx, ir_typeof(i), 1));
-            changed = true;
-          }
-        } break;
+  idiom_address dest, src;
+  if (!idiom_address_of(&s, ir_store_addr(store), type, &dest)) return false;
 
-        case IR_ZERO_EXTEND: {
-          IRInstruction *op = ir_operand(i);
-          if (ir_kind(op) == IR_IMMEDIATE) {
-            ir_replace(i, ir_create_immediate(ctx, ir_typeof(i), ir_imm(op)));
-            changed = true;
-          }
-        } break;
-
-        case IR_SIGN_EXTEND: {
-          IRInstruction *op = ir_operand(i);
-          if (ir_kind(op) == IR_IMMEDIATE) {
-            u64 value = 0;
-            if (
-              perform_sign_extension(
-                &value,
-                ir_imm(op),
-                type_sizeof(ir_typeof(i)),
-                type_sizeof(ir_typeof(op))
-              )
-            ) {
-              ir_replace(i, ir_create_immediate(ctx, ir_typeof(i), value));
-              changed = true;
-            }
-          }
-        } break;
-
-        case IR_TRUNCATE: {
-          IRInstruction *op = ir_operand(i);
-          if (ir_kind(op) == IR_IMMEDIATE) {
-            u64 value = 0;
-            if (
-              perform_truncation(
-                &value,
-                ir_imm(op),
-                type_sizeof(ir_typeof(i))
-              )
-            ) {
-              ir_replace(i, ir_create_immediate(ctx, ir_typeof(i), value));
-              changed = true;
-            }
-          }
-        }  break;
-
-        /// Simplify conditional branches with constant conditions.
-        case IR_BRANCH_CONDITIONAL: {
-          IRInstruction *cond = ir_cond(i);
-          if (ir_kind(cond) == IR_IMMEDIATE) {
-            ir_replace(i, ir_create_br(ctx, ir_imm(cond) ? ir_then(i) : ir_else(i)));
-            changed = true;
-          }
-        } break;
-
-        /// Simplify PHIs that contain only a single argument.
-        case IR_PHI: {
-          if (ir_phi_args_count(i) > 1) break;
-          ir_replace_uses(i, ir_phi_arg(i, 0)->value);
-          changed = true;
-        } break;
-
-        /// Simplify indirect calls to direct calls.
-        case IR_CALL: {
-          if (ir_call_is_direct(i)) break;
-          IRInstruction *callee = ir_callee(i).inst;
-          switch (ir_kind(callee)) {
-            default: break;
-
-            case IR_FUNC_REF:
-              ir_callee(i, ir_val(ir_func_ref_func(callee)), true);
-              changed = true;
-              break;
-
-            case IR_BITCAST: {
-              IRInstruction *op = ir_operand(callee);
-              if (ir_kind(op) == IR_FUNC_REF) {
-                ir_callee(i, ir_val(ir_func_ref_func(op)), true);
-                changed = true;
-              }
-            } break;
-          }
-        } break;
-
-        /// Collapse pointer copies.
-        case IR_COPY: {
-          /// FIXME: Enabling this optimisation breaks a bunch of stuff. Presumably,
-          /// this is due to the clobbering problem that we have in ISel atm.
-          /*if (type_is_pointer(ir_typeof(i)) && type_is_pointer(ir_typeof(i->operand))) {
-            ir_replace(i, ir_operand(i));
-            changed = true;
-          }*/
-        } break;
-      }
-    }
+  /// The source and destination of a copy must not overlap.
+  if (load) {
+    if (!idiom_address_of(&s, ir_operand(load), type, &src)) return false;
+    if (!memssa_disjoint(analysis_memory_ssa(am, f), dest.base, src.base)) return false;
   }
 
-  /// Perform replacements that require insertions.
-  foreach (s, shift_divs) {
-    ir_insert_before(s->div, s->shift_amount);
-    ir_replace(s->div, ir_create_sar(ctx, ir_lhs(s->div), s->shift_amount));
+  IRInstruction *fill = NULL;
+  if (!load && !(fill = idiom_fill_byte(&s, value))) return false;
+
+  /// If we don’t know how often the loop runs, we also don’t know if
+  /// it runs at all, so keep the exit test in the header and replace
+  /// the body, which then only runs once, with the copy or fill.
+  IRBlock *header = loop->header;
+  IRBlock *from = s.loop.preheader;
+  IRInstruction *bytes = NULL, *before = ir_terminator(s.loop.preheader);
+  if (!known) {
+    from = ir_block_insert_before(s.loop.body, ir_block(ctx));
+    before = ir_insert_at_end(from, ir_create_br(ctx, s.loop.exit));
+    bytes = idiom_byte_count(&s, &test, type);
+  } else if (trip_count) {
+    bytes = ir_insert_before(before, ir_create_immediate(ctx, t_integer, trip_count * type_sizeof(type)));
   }
 
-  return changed;
+  if (bytes) {
+    IRInstruction *to = idiom_start(&s, &dest);
+    if (load) ir_insert_before(before, ir_create_memcpy(ctx, to, idiom_start(&s, &src), bytes));
+    else ir_insert_before(before, ir_create_memset(ctx, to, fill, bytes));
+  }
+
+  /// Nothing computed in the loop is used afterwards, so the exit PHIs
+  /// receive the same values from the block that replaces the loop.
+  FOREACH_INSTRUCTION (i, s.loop.exit) {
+    if (ir_kind(i) != IR_PHI) continue;
+    IRInstruction *incoming = phi_incoming(i, header);
+    if (!incoming) continue;
+    if (known) ir_phi_remove_arg(i, header);
+    ir_phi_add_arg(i, from, incoming);
+  }
+
+  /// Either skip the loop entirely or just its body. In the latter
+  /// case, the header is no longer part of a loop, and its PHIs only
+  /// receive values from the preheader.
+  IRBlockVector dead = {0};
+  if (known) {
+    retarget_branch(s.loop.preheader, header, s.loop.exit);
+    vector_append(dead, loop->blocks);
+  } else {
+    retarget_branch(header, s.loop.body, from);
+    FOREACH_INSTRUCTION (i, header)
+      if (ir_kind(i) == IR_PHI)
+        ir_phi_remove_arg(i, s.loop.latch);
+    vector_push(dead, s.loop.body);
+  }
+
+  delete_blocks(ctx, &dead);
+  vector_delete(dead);
+  map_delete(s.hoisted.values);
+  opt_stats.recognised_idioms++;
+  return true;
 }
 
-/// ===========================================================================
-///  DCE
-/// ===========================================================================
-static bool opt_dce(IRFunction *f) {
+/// Replace innermost loops that copy one array into another or fill
+/// an array with the same byte with a call to the memcpy or memset
+/// intrinsic. The loop must either run a known number of times, or
+/// run while an induction variable that moves forward by one is less
+/// than a loop-invariant limit. The source and destination of a copy
+/// must point into different objects.
+static bool opt_loop_idiom(CodegenContext *ctx, AnalysisManager *am, IRFunction *f) {
   bool changed = false;
-  IRInstructionVector to_remove = {0};
-  FOREACH_BLOCK (b, f) {
-    FOREACH_INSTRUCTION (i, b) {
-      if (ir_use_count(i) == 0 && !has_side_effects(i)) {
-        vector_push(to_remove, i);
-        changed = true;
-      }
+  bool again;
+  do {
+    again = false;
+    LoopInfo *loops = analysis_loops(am, f);
+    foreach_val (loop, loops->loops) {
+      if (!idiom_loop(ctx, am, f, loop)) continue;
+
+      /// Deleting the loop changes the CFG, so start over.
+      analysis_invalidate(am, f, ANALYSIS_NONE);
+      changed = again = true;
+      break;
     }
-  }
-
-  /// Remove all instructions.
-  foreach_val (i, to_remove) ir_remove(i);
-  vector_delete(to_remove);
+  } while (again);
   return changed;
 }
 
 /// ===========================================================================
-///  TCE
+///  Sparse conditional constant propagation
 /// ===========================================================================
+/// Lattice value of an instruction. Values only ever move down
+/// the lattice, i.e. from TOP to CONST to BOTTOM.
 typedef struct {
-  IRInstruction *call;
-  Vector(IRInstruction *) phis;
-} tail_call_info;
+  enum {
+    SCCP_TOP,    /// No value seen yet.
+    SCCP_CONST,  /// Always the same constant.
+    SCCP_BOTTOM, /// Not a constant.
+  } kind;
+  u64 value;
+} sccp_value;
+
+/// A CFG edge.
+typedef struct {
+  IRBlock *from;
+  IRBlock *to;
+} sccp_edge;
 
-/// See opt_tail_call_elim() for more info.
-static bool tail_call_possible_iter(tail_call_info *tc, IRBlock *b) {
-  /// Start at the call if this is the block containing the call,
-  /// or at the first instruction of the block otherwise.
-  IRInstruction **it = b == ir_parent(tc->call) ? ir_it(tc->call) + 1 : ir_begin(b);
-  IRInstruction **end = ir_end(b);
-  for (; it < end; it++) {
-    IRInstruction *i = *it;
-    IRType kind = ir_kind(i);
-    switch (kind) {
-      /// If this is a phi node, then the call or a previous phi
-      /// must be an argument of the phi.
-      case IR_PHI: {
-        for (usz j = 0; j < ir_phi_args_count(i); j++) {
-          const IRPhiArgument *arg = ir_phi_arg(i, j);
-          if (arg->value == tc->call) { goto phi; }
-          foreach_val (a, tc->phis) {
-            if (a == arg->value) { goto phi; }
-          }
-        }
-        return false;
+typedef struct {
+  Vector(sccp_value) values;
+  Vector(bool) executable_blocks;
+  Map(sccp_edge, bool) executable_edges;
+  Vector(sccp_edge) cfg_worklist;
+  IRInstructionVector ssa_worklist;
+} sccp_state;
+
+/// Check if we can propagate constants of this type.
+static bool sccp_integer_type(Type *t) {
+  if (!type_is_integer(t) || type_is_reference(t)) return false;
+  usz size = type_sizeof(t);
+  return size == 1 || size == 2 || size == 4 || size == 8;
+}
 
-      phi:
-        vector_push(tc->phis, i);
-        continue;
-      }
+/// Get the lattice value of an instruction.
+static sccp_value sccp_get(sccp_state *s, IRInstruction *i) {
+  if (ir_kind(i) == IR_IMMEDIATE) return (sccp_value){SCCP_CONST, ir_imm(i)};
+  if (!ir_parent(i)) return (sccp_value){SCCP_BOTTOM, 0};
+  return s->values.data[ir_index(i)];
+}
 
-      /// If we encounter a return instruction, then a tail call
-      /// is only possible if the return value is the call, or
-      /// any of the PHIs.
-      case IR_RETURN: {
-        IRInstruction *retval = ir_operand(i);
-        foreach_val (a, tc->phis)
-          if (a == retval)
-            return true;
-        return retval == tc->call;
+/// Compute the lattice value of an instruction from its operands.
+static sccp_value sccp_evaluate(sccp_state *s, IRInstruction *i) {
+  STATIC_ASSERT(IR_COUNT == 40, "Handle all instructions");
+  static const sccp_value bottom = {SCCP_BOTTOM, 0};
+  if (!sccp_integer_type(ir_typeof(i))) return bottom;
+
+  switch (ir_kind(i)) {
+    default: return bottom;
+    case IR_IMMEDIATE: return sccp_get(s, i);
+    case IR_COPY: return sccp_get(s, ir_operand(i));
+
+    /// Meet of the values flowing in along executable edges.
+    case IR_PHI: {
+      sccp_value result = {SCCP_TOP, 0};
+      for (usz n = 0; n < ir_phi_args_count(i); n++) {
+        const IRPhiArgument *arg = ir_phi_arg(i, n);
+        sccp_edge e = {arg->block, ir_parent(i)};
+        if (!map_contains(s->executable_edges, e)) continue;
+        sccp_value v = sccp_get(s, arg->value);
+        if (v.kind == SCCP_TOP) continue;
+        if (v.kind == SCCP_BOTTOM) return bottom;
+        if (result.kind == SCCP_CONST && result.value != v.value) return bottom;
+        result = v;
       }
+      return result;
+    }
 
-      /// If this is a branch, follow the branches.
-      case IR_BRANCH : return tail_call_possible_iter(tc, ir_dest(i));
-      case IR_BRANCH_CONDITIONAL:
-        return tail_call_possible_iter(tc, ir_then(i)) &&
-               tail_call_possible_iter(tc, ir_else(i));
+    ALL_BINARY_INSTRUCTION_CASES() {
+      IRInstruction *lhs = ir_lhs(i);
+      sccp_value l = sccp_get(s, lhs);
+      sccp_value r = sccp_get(s, ir_rhs(i));
+      if (l.kind == SCCP_BOTTOM || r.kind == SCCP_BOTTOM) return bottom;
+      if (l.kind == SCCP_TOP || r.kind == SCCP_TOP) return (sccp_value){SCCP_TOP, 0};
+      if (!sccp_integer_type(ir_typeof(lhs))) return bottom;
+
+      u64 value;
+      if (!fold_binary(ir_kind(i), ir_typeof(lhs), l.value, r.value, &value)) return bottom;
+      if (!perform_truncation(&value, value, type_sizeof(ir_typeof(i)))) return bottom;
+      return (sccp_value){SCCP_CONST, value};
+    }
 
-      /// Any other instruction means that the call is not the last
-      /// relevant instruction before a return.
-      default: return false;
+    case IR_NOT:
+    case IR_ZERO_EXTEND:
+    case IR_SIGN_EXTEND:
+    case IR_TRUNCATE: {
+      IRInstruction *op = ir_operand(i);
+      sccp_value v = sccp_get(s, op);
+      if (v.kind != SCCP_CONST) return v;
+      if (!sccp_integer_type(ir_typeof(op))) return bottom;
+
+      u64 value = v.value;
+      usz size = type_sizeof(ir_typeof(i));
+      switch (ir_kind(i)) {
+        default: UNREACHABLE();
+        case IR_NOT: value = ~value; break;
+        case IR_ZERO_EXTEND: perform_truncation(&value, value, type_sizeof(ir_typeof(op))); break;
+        case IR_SIGN_EXTEND:
+          if (!perform_sign_extension(&value, value, size, type_sizeof(ir_typeof(op)))) return bottom;
+          break;
+        case IR_TRUNCATE: break;
+      }
+
+      if (!perform_truncation(&value, value, size)) return bottom;
+      return (sccp_value){SCCP_CONST, value};
     }
   }
-
-  return false;
 }
 
-static bool tail_call_possible(IRInstruction *i) {
-  tail_call_info tc_info = {0};
-  tc_info.call = i;
-  bool possible = tail_call_possible_iter(&tc_info, ir_parent(i));
-  vector_delete(tc_info.phis);
-  return possible;
+/// Mark an edge as executable.
+static void sccp_add_edge(sccp_state *s, IRBlock *from, IRBlock *to) {
+  sccp_edge e = {from, to};
+  if (map_contains(s->executable_edges, e)) return;
+  map_set(s->executable_edges, e, true);
+  vector_push(s->cfg_worklist, e);
 }
 
-bool opt_try_convert_to_tail_call(IRInstruction *i) {
-  /// An instruction is a tail call iff there are no other instruction
-  /// between it and the next return instruction other than branches
-  /// and phis.
-  if (tail_call_possible(i)) {
-    /// The actual tail call optimisation takes place in the code generator.
-    ir_call_tail(i, true);
-    ir_make_unreachable(ir_parent(i));
-    return true;
+/// Update the lattice value of an instruction, or the executable
+/// edges if it is a branch.
+static void sccp_visit(sccp_state *s, IRInstruction *i) {
+  IRBlock *b = ir_parent(i);
+  switch (ir_kind(i)) {
+    case IR_BRANCH:
+      sccp_add_edge(s, b, ir_dest(i));
+      return;
+
+    case IR_BRANCH_CONDITIONAL: {
+      sccp_value cond = sccp_get(s, ir_cond(i));
+      if (cond.kind == SCCP_TOP) return;
+      if (cond.kind == SCCP_BOTTOM || cond.value) sccp_add_edge(s, b, ir_then(i));
+      if (cond.kind == SCCP_BOTTOM || !cond.value) sccp_add_edge(s, b, ir_else(i));
+    } return;
+
+    default: {
+      sccp_value *old = s->values.data + ir_index(i);
+      if (old->kind == SCCP_BOTTOM) return;
+      sccp_value new = sccp_evaluate(s, i);
+      if (new.kind == old->kind && new.value == old->value) return;
+      *old = new;
+      FOREACH_USER (user, i) vector_push(s->ssa_worklist, user);
+    }
   }
-
-  return false;
 }
 
-static bool opt_tail_call_elim(IRFunction *f) {
-  bool changed = false;
-  FOREACH_BLOCK (b, f) {
-    FOREACH_INSTRUCTION (i, b) {
-      if (ir_kind(i) != IR_CALL) { continue; }
+/// Propagate constants through the function while only considering
+/// edges that can actually be taken.
+///
+/// This is the algorithm described in (Wegman, M. N. and Zadeck, F. K.
+/// (1991). ‘Constant Propagation with Conditional Branches’): Every
+/// instruction starts out as TOP, and every edge as not executable.
+/// Instructions are only evaluated once their block is known to be
+/// executable, and PHIs only take into account the values flowing in
+/// along executable edges. Conditional branches whose condition is
+/// constant only make one of their edges executable.
+///
+/// Afterwards, instructions with a constant value are replaced with
+/// immediates, branches on constants are folded, and blocks that are
+/// never executed are made unreachable, so the CFG simplification
+/// can delete them.
+static bool opt_sccp(CodegenContext *ctx, IRFunction *f) {
+  sccp_state s = {0};
+  usz instructions = ir_number_instructions(f);
+  usz blocks = ir_number_blocks(f);
+  vector_resize(s.values, instructions);
+  vector_resize(s.executable_blocks, blocks);
+  memset(s.values.data, 0, instructions * sizeof *s.values.data);
+  memset(s.executable_blocks.data, 0, blocks * sizeof *s.executable_blocks.data);
+
+  /// The entry block is always executable.
+  IRBlock *entry = ir_entry_block(f);
+  s.executable_blocks.data[ir_block_index(entry)] = true;
+  FOREACH_INSTRUCTION (i, entry) sccp_visit(&s, i);
+
+  while (s.cfg_worklist.size || s.ssa_worklist.size) {
+    while (s.cfg_worklist.size) {
+      sccp_edge e = vector_pop(s.cfg_worklist);
+      bool *executable = s.executable_blocks.data + ir_block_index(e.to);
+
+      /// The PHIs of the block may have an additional value now; if
+      /// the block has only just become executable, everything in it
+      /// needs to be evaluated.
+      FOREACH_INSTRUCTION (i, e.to) {
+        if (*executable && ir_kind(i) != IR_PHI) break;
+        sccp_visit(&s, i);
+      }
 
-      /// We can’t have more than two tail calls in a single block.
-      if (opt_try_convert_to_tail_call(i)) goto next_block;
+      *executable = true;
+    }
+
+    while (s.ssa_worklist.size) {
+      IRInstruction *i = vector_pop(s.ssa_worklist);
+      if (s.executable_blocks.data[ir_block_index(ir_parent(i))]) sccp_visit(&s, i);
     }
-  next_block:;
   }
-  return changed;
-}
 
-/// ===========================================================================
-///  Mem2Reg
-/// ===========================================================================
-static bool opt_mem2reg(IRFunction *f) {
+  /// Replace constants with immediates and fold branches.
   bool changed = false;
-
-  /// A stack variable.
-  typedef struct {
-    IRInstruction *alloca;
-    IRInstruction *store;
-    Vector(IRInstruction *) loads;
-    bool unoptimisable;
-  } stack_var;
-  Vector(stack_var) vars = {0};
-
-  /// Collect all stack variables that are stored into once, and
-  /// whose address is never taken.
+  IRInstructionVector constants = {0};
   FOREACH_BLOCK (b, f) {
+    if (!s.executable_blocks.data[ir_block_index(b)]) continue;
     FOREACH_INSTRUCTION (i, b) {
-      switch (ir_kind(i)) {
-        default: break;
-
-        /// New variable.
-        case IR_ALLOCA: {
-          stack_var v = {0};
-          v.alloca = i;
-          vector_push(vars, v);
-        } break;
-
-        /// Record the first store into a variable.
-        case IR_STORE: {
-          foreach (a, vars) {
-            if (!a->unoptimisable && a->alloca == ir_store_addr(i)) {
-              /// If there are multiple stores, mark the variable as unoptimisable.
-              if (a->store) a->unoptimisable = true;
-              else a->store = i;
-              break;
-            }
-          }
-        } break;
-
-        /// Record all loads; also check for loads before the first store.
-        case IR_LOAD: {
-          foreach (a, vars) {
-            if (!a->unoptimisable && a->alloca ==ir_operand(i)) {
-              /// Load before store.
-              if (!a->store) {
-                a->unoptimisable = true;
-                CodegenContext *ctx = ir_context(f);
-                issue_diagnostic(
-                  DIAG_WARN,
-                  ctx->ast->filename.data,
-                  as_span(ctx->ast->source),
-                  ir_location(f), /// FIXME: Should be location of the load.
-                  "Load of uninitialised variable in function %S",
-                  ir_name(f)
-                );
-              } else {
-                vector_push(a->loads, i);
-              }
-              break;
-            }
-          }
-        } break;
+      IRType kind = ir_kind(i);
+      if (kind == IR_IMMEDIATE) continue;
+      if (kind == IR_BRANCH_CONDITIONAL) {
+        sccp_value cond = sccp_get(&s, ir_cond(i));
+        if (cond.kind == SCCP_CONST) vector_push(constants, i);
+        continue;
       }
+
+      if (s.values.data[ir_index(i)].kind == SCCP_CONST) vector_push(constants, i);
     }
   }
 
-  /// Optimise all optimisable variables.
-  foreach (a, vars) {
-    /// If the variable is unoptimisable, do nothing.
-    ///
-    /// Since we don’t have `addressof` instructions or anything like
-    /// that, check if the address is taken anywhere by checking if
-    /// there are any uses of the alloca excepting the store and loads.
-    if (a->unoptimisable || !a->store || ir_use_count(a->alloca) != a->loads.size + 1) {
-      vector_delete(a->loads);
+  foreach_val (i, constants) {
+    IRBlock *b = ir_parent(i);
+    if (ir_kind(i) == IR_BRANCH_CONDITIONAL) {
+      bool taken = sccp_get(&s, ir_cond(i)).value != 0;
+      IRBlock *dest = taken ? ir_then(i) : ir_else(i);
+      IRBlock *other = taken ? ir_else(i) : ir_then(i);
+      if (other != dest) {
+        FOREACH_INSTRUCTION (phi, other)
+          if (ir_kind(phi) == IR_PHI)
+            ir_phi_remove_arg(phi, b);
+      }
+
+      ir_replace(i, ir_create_br(ctx, dest));
+      changed = true;
       continue;
     }
 
-    /// If we get here, we can yeet the variable.
-    changed = true;
-
-    /// Replace all loads with the stored value.
-    foreach_val (i, a->loads) ir_replace(i, ir_store_value(a->store));
-    vector_delete(a->loads);
+    /// Keep PHIs at the start of the block.
+    IRInstruction *imm = ir_create_immediate(ctx, ir_typeof(i), s.values.data[ir_index(i)].value);
+    if (ir_kind(i) == IR_PHI) {
+      IRInstruction *first = ir_front(b);
+      while (ir_kind(first) == IR_PHI) first = ir_next(first);
+      ir_insert_before(first, imm);
+    }
 
-    /// Remove the store.
-    ir_remove(a->store);
+    ir_replace(i, imm);
+    opt_stats.constants_propagated++;
+    changed = true;
+  }
 
-    /// Remove the alloca.
-    ir_remove(a->alloca);
+  /// Cut off blocks that are never executed. If they have no other
+  /// predecessors, they are deleted by the CFG simplification. Values
+  /// computed in them can only be used in other such blocks, which may
+  /// be deleted in any order, so replace them with poison.
+  FOREACH_BLOCK (b, f) {
+    if (s.executable_blocks.data[ir_block_index(b)]) continue;
+    FOREACH_INSTRUCTION (i, b) ir_replace_uses(i, ctx->poison);
+    IRInstruction *term = ir_terminator(b);
+    if (ir_kind(term) == IR_UNREACHABLE) continue;
+    ir_make_unreachable(b);
+    changed = true;
   }
 
-  vector_delete(vars);
+  vector_delete(constants);
+  vector_delete(s.values);
+  vector_delete(s.executable_blocks);
+  vector_delete(s.cfg_worklist);
+  vector_delete(s.ssa_worklist);
+  map_delete(s.executable_edges);
   return changed;
 }
 
@@ -733,7 +3709,7 @@ bool opt_analyse_functions(CodegenContext *ctx) {
         check_function_references(var->init, &referenced_functions);
 
     /// Delete functions that are never referenced.
-    foreach (entry, referenced_functions) {
+    map_foreach (entry, referenced_functions) {
       if (!entry->value) {
         ir_delete_function(entry->key);
         changed = true;
@@ -790,46 +3766,23 @@ static bool opt_remove_globals(CodegenContext *ctx) {
 /// ===========================================================================
 ///  Block reordering etc.
 /// ===========================================================================
-/// Map containing the predecessors of each block.
-typedef MultiMap(IRBlock*, IRBlock*) Predecessors;
-
-/// Collect the predecessors of each block and
-/// remove unreachable blocks.
-static bool collect_preds_and_prune(IRFunction *f, Predecessors *preds) {
-  bool changed = false;
-
-  mmap_clear(*preds);
-  FOREACH_BLOCK (block, f) {
-    STATIC_ASSERT(IR_COUNT == 40, "Handle all branch instructions");
-    IRInstruction *br = ir_terminator(block);
-    switch (ir_kind(br)) {
-      default: break;
-      case IR_BRANCH:
-        mmap_insert(*preds, ir_dest(br), block);
-        break;
-
-      case IR_BRANCH_CONDITIONAL:
-        mmap_insert(*preds, ir_then(br), block);
-        mmap_insert(*preds, ir_else(br), block);
-        break;
-    }
-  }
-
+/// Remove blocks that are unreachable from the entry block.
+static bool prune_unreachable_blocks(IRFunction *f, DominatorTree *dom) {
   /// Collect unreachable blocks.
   Vector(IRBlock *) to_remove = {0};
-  FOREACH_BLOCK (block, f) {
-    /// Entry block is always reachable.
-    if (block_ptr == block_begin_ptr) continue;
-
-    /// If the block has no predecessors, it’s unreachable.
-    if (!map_get(*preds, block)) {
+  FOREACH_BLOCK (block, f)
+    if (!dom_tree_reachable(dom, block))
       vector_push(to_remove, block);
-      changed = true;
-    }
-  }
 
-  /// Remove them.
+  /// Unreachable blocks may form cycles and use each other’s
+  /// values, so detach all of them and replace those values
+  /// with poison before deleting anything.
+  CodegenContext *ctx = ir_context(f);
+  foreach_val (block, to_remove) ir_block_detach(block);
+  foreach_val (block, to_remove) FOREACH_INSTRUCTION (i, block) ir_replace_uses(i, ctx->poison);
   foreach_val (block, to_remove) ir_delete_block(block);
+
+  bool changed = to_remove.size != 0;
   vector_delete(to_remove);
   return changed;
 }
@@ -861,13 +3814,20 @@ static bool opt_jump_threading(CodegenContext *ctx, IRFunction *f, Predecessors
       /// the condition also dominates this block in such cases, and we are free
       /// to copy the branch. The same is true for return instructions that return
       /// a value.
+      ///
+      /// The blocks that we now branch to gain a predecessor; record that
+      /// so we don’t merge them into one of their other predecessors.
       IRBlock *successor = ir_dest(last);
       if (map_get(*preds, successor)->size != 1) {
-        IRInstruction *first = *ir_begin(successor);
+        IRInstruction *first = ir_front(successor);
         STATIC_ASSERT(IR_COUNT == 40, "Handle all branch instructions");
         switch (ir_kind(first)) {
           default: continue;
-          case IR_BRANCH: ir_dest(last, ir_dest(first)); break;
+          case IR_BRANCH:
+            ir_dest(last, ir_dest(first));
+            mmap_insert(*preds, ir_dest(first), b);
+            break;
+
           case IR_UNREACHABLE:
             ir_replace(last, ir_create_unreachable(ctx));
             break;
@@ -878,6 +3838,8 @@ static bool opt_jump_threading(CodegenContext *ctx, IRFunction *f, Predecessors
 
           case IR_BRANCH_CONDITIONAL:
             ir_replace(last, ir_create_cond_br(ctx, ir_cond(first), ir_then(first), ir_else(first)));
+            mmap_insert(*preds, ir_then(first), b);
+            mmap_insert(*preds, ir_else(first), b);
             break;
         }
 
@@ -909,165 +3871,207 @@ static bool opt_jump_threading(CodegenContext *ctx, IRFunction *f, Predecessors
 }
 
 /// Simplify Control Flow Graph.
-static bool opt_simplify_cfg(CodegenContext *ctx, IRFunction *f) {
-  /// Compute predecessors and delete unreachable blocks.
-  Predecessors preds = {0};
+static bool opt_simplify_cfg(CodegenContext *ctx, AnalysisManager *am, IRFunction *f) {
   bool ever_changed = false;
   for (;;) {
-    collect_preds_and_prune(f, &preds);
-    bool changed = opt_jump_threading(ctx, f, &preds);
+    /// Delete unreachable blocks.
+    if (prune_unreachable_blocks(f, analysis_dom_tree(am, f))) {
+      analysis_invalidate(am, f, ANALYSIS_NONE);
+      ever_changed = true;
+    }
+
+    bool changed = opt_jump_threading(ctx, f, analysis_preds(am, f));
     if (!changed) break;
-    else ever_changed = true;
+    analysis_invalidate(am, f, ANALYSIS_NONE);
+    ever_changed = true;
   }
-  mmap_delete(preds);
   return ever_changed;
 }
 
-/// Check if two instructions refer to the same in-memory object.
-static bool same_memory_object(IRInstruction *a, IRInstruction *b) {
-  if (a == b) return true;
+/// ===========================================================================
+///  Load and store elimination
+/// ===========================================================================
+typedef struct {
+  MemorySSA *mssa;
+  DominatorTree *dom;
+
+  /// Loads that we have visited and kept, by the access that
+  /// defines the memory they read from.
+  MultiMap(MemoryAccess *, IRInstruction *) loads;
+} load_elim_state;
+
+/// Check if the value of an instruction is available at another
+/// instruction.
+static bool load_elim_available(load_elim_state *s, IRInstruction *value, IRInstruction *at) {
+  IRBlock *b = ir_parent(value);
+  if (!b) return true;
+  if (b == ir_parent(at)) return ir_comes_before(value, at);
+  return dom_tree_dominates(s->dom, b, ir_parent(at));
+}
 
-  /// Two static refs that refer to the same variable
-  /// are the same object, unless they have different
-  /// types; this can happen because of how references
-  /// work.
-  if (ir_kind(a) == ir_kind(b) && ir_kind(a) == IR_STATIC_REF) {
-    return ir_static_ref_var(a) == ir_static_ref_var(b) && type_equals(ir_typeof(a), ir_typeof(b));
+/// Get the value that a def stores to `addr`, if it is a store that
+/// writes exactly the memory that we’re loading.
+static IRInstruction *load_elim_stored_value(load_elim_state *s, MemoryAccess *def, IRInstruction *addr, Type *type) {
+  if (def->kind != MEMORY_DEF || ir_kind(def->inst) != IR_STORE) return NULL;
+  IRInstruction *value = ir_store_value(def->inst);
+  if (!type_equals(ir_typeof(value), type)) return NULL;
+  if (memssa_alias(s->mssa, ir_store_addr(def->inst), type, addr, type) != ALIAS_MUST) return NULL;
+  return value;
+}
+
+/// Instruction selection fuses comparisons into the conditional
+/// branches that use them, so we must neither add uses to such a
+/// comparison nor make a branch use a comparison that has other uses.
+static bool load_elim_can_replace(IRInstruction *load, IRInstruction *value) {
+  switch (ir_kind(value)) {
+    default: return true;
+    case IR_EQ:
+    case IR_NE:
+    case IR_LT:
+    case IR_LE:
+    case IR_GT:
+    case IR_GE:
+      if (gvn_feeds_branch(value)) return false;
+      FOREACH_USER (user, load)
+        if (ir_kind(user) == IR_BRANCH_CONDITIONAL)
+          return false;
+      return true;
+  }
+}
+
+/// Find the value that a load reads, if we know it.
+static IRInstruction *load_elim_value(load_elim_state *s, IRInstruction *load, MemoryAccess *clobber) {
+  IRInstruction *addr = ir_operand(load);
+  Type *type = ir_typeof(load);
+
+  /// Forward the value of a store.
+  IRInstruction *value = load_elim_stored_value(s, clobber, addr, type);
+  if (value) return value;
+
+  /// Reuse the value of an earlier load of the same memory.
+  MapValue(s->loads) *loads = map_get(s->loads, clobber);
+  if (loads) {
+    foreach_val (l, *loads) {
+      if (
+        type_equals(ir_typeof(l), type) &&
+        memssa_alias(s->mssa, ir_operand(l), type, addr, type) == ALIAS_MUST &&
+        load_elim_available(s, l, load)
+      ) return l;
+    }
   }
 
-  return false;
+  /// If the memory is defined by a phi, check whether the same value
+  /// is stored to it on every incoming path. Paths that go around a
+  /// loop back to the phi without writing to it don’t matter.
+  if (clobber->kind != MEMORY_PHI) return NULL;
+  foreach (arg, clobber->args) {
+    MemoryAccess *def = memssa_clobber(s->mssa, arg->value, addr, type);
+    if (def == clobber) continue;
+    IRInstruction *stored = load_elim_stored_value(s, def, addr, type);
+    if (!stored || (value && stored != value)) return NULL;
+    value = stored;
+  }
+
+  if (value && load_elim_available(s, value, load)) return value;
+  return NULL;
 }
 
-/// Foreach block, replace loads from a variable with the last value
-/// stored to that variable in that block, if any.
+/// Replace loads with the value that was last stored to or loaded
+/// from the same memory, even if that happened in another block.
 ///
-/// Keep in mind that call instructions may modify locals, so if the
-/// address of a variable is ever taken, we can’t forward stores to
-/// that variable across calls.
-static bool opt_store_forwarding(IRFunction *f) {
-  Vector(struct var {
-    IRInstruction *addr;
-    IRInstruction *store;
-    IRInstruction *last_value;
-    bool escaped; /// Variable may be modified by a call etc.
-    bool reload_required; /// Variable may have been modified since the previous store.
-  }) vars = {0};
-  bool changed = false;
-  IRInstructionVector to_remove = {0};
+/// We visit blocks in dominator tree order so that, if two loads read
+/// from the same memory, we see the one that dominates the other first.
+static bool opt_load_elim(AnalysisManager *am, IRFunction *f) {
+  load_elim_state s = {
+    .mssa = analysis_memory_ssa(am, f),
+    .dom = analysis_dom_tree(am, f),
+  };
 
-  FOREACH_BLOCK (b, f) {
-    vector_clear(vars);
+  bool changed = false;
+  BlockVector stack = {0};
+  vector_push(stack, ir_entry_block(f));
+  while (stack.size) {
+    IRBlock *b = vector_pop(stack);
+    foreach_val (child, *dom_tree_children(s.dom, b)) vector_push(stack, child);
     FOREACH_INSTRUCTION (i, b) {
-      switch (ir_kind(i)) {
-        case IR_STORE: {
-          IRInstruction *addr = ir_store_addr(i);
-          IRInstruction *value = ir_store_value(i);
-          struct var *v = vector_find_if(el, vars, same_memory_object(el->addr, addr));
-          if (v) {
-            /// Update the stored value.
-            v->last_value = value;
-
-            /// Eliminate the previous store if the address is never used.
-            if (v->store && (!v->escaped || !v->reload_required)) {
-              vector_push(to_remove, v->store);
-              changed = true;
-            }
-
-            /// Update the store.
-            v->reload_required = false;
-            v->store = i;
-
-            /// Also clobber all other escaped values because of aliasing.
-            foreach (var, vars)
-              if (var != v && var->escaped)
-                var->reload_required = true;
-          } else {
-            vector_push(
-              vars,
-              (struct var){
-                .addr = addr,
-                .store = i,
-                .last_value = value,
-                .escaped = false,
-                .reload_required = false,
-              }
-            );
-
-            /// Check if the address is ever used by any instruction other
-            /// than a load or store; if it is, we can’t forward stores
-            /// across calls, intrinsics, or other instructions that may
-            /// modify memory.
-            if (ir_kind(addr) == IR_ALLOCA) {
-              FOREACH_USER(user, addr) {
-                if (ir_kind(user) != IR_LOAD && ir_kind(user) != IR_STORE) {
-                  vector_back(vars).escaped = true;
-                  break;
-                }
-              }
-            }
-
-            /// Anything that isn’t an alloca always escapes.
-            else {
-              vector_back(vars).escaped = true;
-            }
-          }
-        } break;
-
-        case IR_LOAD: {
-          IRInstruction *op = ir_operand(i);
-          struct var *v = vector_find_if(el, vars, same_memory_object(el->addr, op));
-
-          /// If the variable is not escaped or does not need
-          /// to be reloaded, replace the load with the last
-          /// known value.
-          if (v && (!v->escaped || !v->reload_required)) {
-            /// Replace only the uses so we don’t invalidate
-            /// any iterators. DCE will yeet the load later.
-            ir_replace_uses(i, v->last_value);
-            changed = true;
-          }
+      if (ir_kind(i) != IR_LOAD) continue;
+      MemoryAccess *access = memssa_access(s.mssa, i);
+      MemoryAccess *clobber = memssa_clobber(s.mssa, access->defining, ir_operand(i), ir_typeof(i));
+      IRInstruction *value = load_elim_value(&s, i, clobber);
+      if (!value) {
+        mmap_insert(s.loads, clobber, i);
+        continue;
+      }
 
-          /// If the load is not replaced, then we at least no
-          /// longer need to reload it.
-          else if (v) {
-            v->reload_required = false;
-            v->last_value = i;
-          }
+      if (!load_elim_can_replace(i, value)) continue;
+      ir_replace(i, value);
+      opt_stats.eliminated_loads++;
+      changed = true;
+    }
+  }
 
-          /// If the variable hasn’t been encountered yet, add it.
-          else {
-            vector_push(
-              vars,
-              (struct var){
-                .addr = op,
-                .store = NULL,
-                .last_value = i,
-                .escaped = true, /// Certainly escaped since we don’t know where it came from.
-                .reload_required = false,
-              }
-            );
-          }
-        } break;
+  vector_delete(stack);
+  mmap_delete(s.loads);
+  return changed;
+}
 
-        /// Instructions that may clobber memory.
-        case IR_CALL:
-        case IR_INTRINSIC: {
-          foreach (var, vars)
-            if (var->escaped)
-              var->reload_required = true;
-        } break;
-
-        default:
-          ASSERT(!clobbers_memory(i), "Handle instruction that clobbers memory correctly");
-          break;
-      }
+typedef struct {
+  MemorySSA *mssa;
+  MemoryAccessVector worklist;
+  Map(MemoryAccess *, bool) visited;
+} dse_state;
+
+/// Check if the value written by a store is never read.
+///
+/// Starting at the store, we follow the accesses that see the memory
+/// it wrote. The store is dead if every path ends in a store that
+/// overwrites all of it, or leaves the function if the store is to
+/// a local variable, before anything reads from it.
+static bool dse_dead(dse_state *s, MemoryAccess *store) {
+  IRInstruction *addr = ir_store_addr(store->inst);
+  Type *type = ir_typeof(ir_store_value(store->inst));
+  vector_clear(s->worklist);
+  map_clear(s->visited);
+  vector_push(s->worklist, store);
+  while (s->worklist.size) {
+    MemoryAccess *a = vector_pop(s->worklist);
+    foreach_val (user, a->users) {
+      if (memssa_may_read(s->mssa, user, addr, type)) return false;
+      if (user->kind == MEMORY_USE) continue;
+
+      /// Stop at stores that overwrite the entire value.
+      if (
+        user->kind == MEMORY_DEF &&
+        ir_kind(user->inst) == IR_STORE &&
+        memssa_alias(s->mssa, ir_store_addr(user->inst), ir_typeof(ir_store_value(user->inst)), addr, type) == ALIAS_MUST
+      ) continue;
+
+      if (map_contains(s->visited, user)) continue;
+      map_set(s->visited, user, true);
+      vector_push(s->worklist, user);
     }
   }
 
-  /// Remove all stores that we have marked for removal.
-  foreach_val (i, to_remove) ir_remove(i);
-  vector_delete(to_remove);
-  vector_delete(vars);
+  return true;
+}
+
+/// Delete stores whose value is never read.
+static bool opt_dse(AnalysisManager *am, IRFunction *f) {
+  dse_state s = {.mssa = analysis_memory_ssa(am, f)};
+  IRInstructionVector dead = {0};
+  foreach_val (a, s.mssa->all)
+    if (a->kind == MEMORY_DEF && ir_kind(a->inst) == IR_STORE && dse_dead(&s, a))
+      vector_push(dead, a->inst);
+
+  /// If a store is dead because it is overwritten by another dead
+  /// store, it is still dead after we delete the latter, so we can
+  /// delete them all at once.
+  foreach_val (i, dead) ir_remove(i);
+  opt_stats.eliminated_stores += dead.size;
+  bool changed = dead.size != 0;
+  vector_delete(s.worklist);
+  map_delete(s.visited);
+  vector_delete(dead);
   return changed;
 }
 
@@ -1078,7 +4082,104 @@ static bool opt_store_forwarding(IRFunction *f) {
 PUSH_IGNORE_WARNING("-Wbitwise-instead-of-logical")
 #endif
 
+/// Passes that are run over an entire function.
+enum {
+  PASS_SIMPLIFY_CFG,
+  PASS_SROA,
+  PASS_MEM2REG,
+  PASS_SCCP,
+  PASS_GVN,
+  PASS_LOOP_IDIOM,
+  PASS_UNROLL,
+  PASS_ROTATE,
+  PASS_LICM,
+  PASS_UNSWITCH,
+  PASS_IVSR,
+  PASS_LOAD_ELIM,
+  PASS_DSE,
+  PASS_TAIL_CALL_ELIM,
+  PASS_COUNT,
+};
+
+STATIC_ASSERT(PASS_COUNT <= 32, "Too many passes for the `clean` bit set");
+
+typedef struct {
+  CodegenContext *ctx;
+  AnalysisManager *am;
+  IRFunction *f;
+  instcombine_state ic;
+
+  /// Passes that have found nothing to do since the function was
+  /// last changed by a pass.
+  u32 clean;
+} optimise_state;
+
+/// Simplify whatever the last pass has changed.
+///
+/// This doesn’t count as a change to the function for the purpose of
+/// rerunning other passes since instcombine handles the consequences
+/// of its own changes, unless it has changed the CFG.
+static void optimise_instcombine(optimise_state *s) {
+  s->ic.cfg_changed = false;
+  if (!opt_instcombine(s->ctx, &s->ic)) return;
+  if (!s->ic.cfg_changed) {
+    analysis_invalidate(s->am, s->f, ANALYSIS_CFG);
+    return;
+  }
+
+  analysis_invalidate(s->am, s->f, ANALYSIS_NONE);
+  s->clean = 0;
+}
+
+/// Run a pass over a function unless it has already found nothing to
+/// do since the last time the function was changed. If it changes
+/// anything, invalidate all analyses except for `preserved` and clean
+/// up after it; all passes need to look at the function again then.
+#define RUN_PASS(s, pass, preserved, ...)                       \
+  do {                                                          \
+    if ((s)->clean & (1u << (pass))) break;                     \
+    if (!(__VA_ARGS__)) {                                       \
+      (s)->clean |= 1u << (pass);                               \
+      break;                                                    \
+    }                                                           \
+    analysis_invalidate((s)->am, (s)->f, (preserved));          \
+    (s)->clean = 0;                                             \
+    optimise_instcombine(s);                                    \
+  } while (0)
+
+/// Optimise a single function until none of the passes find anything
+/// else to do.
+static void optimise_function(CodegenContext *ctx, AnalysisManager *am, IRFunction *f) {
+  optimise_state s = {.ctx = ctx, .am = am, .f = f};
+  instcombine_init(&s.ic, f);
+  optimise_instcombine(&s);
+  do {
+    /// Uncomment this to debug optimisation passes.
+    /// print("====== OPTIMISATION PASS over %S ======\n", ir_name(f));
+    /// ir_set_func_ids(f);
+    /// ir_print_function(stdout, f);
+
+    /// This one takes care of invalidating analyses itself.
+    RUN_PASS(&s, PASS_SIMPLIFY_CFG, ANALYSIS_ALL, opt_simplify_cfg(ctx, am, f));
+    RUN_PASS(&s, PASS_SROA, ANALYSIS_CFG, opt_sroa(ctx, f));
+    RUN_PASS(&s, PASS_MEM2REG, ANALYSIS_CFG, opt_mem2reg(am, f));
+    RUN_PASS(&s, PASS_SCCP, ANALYSIS_NONE, opt_sccp(ctx, f));
+    RUN_PASS(&s, PASS_GVN, ANALYSIS_CFG, opt_gvn(am, f));
+    RUN_PASS(&s, PASS_LOOP_IDIOM, ANALYSIS_NONE, opt_loop_idiom(ctx, am, f));
+    RUN_PASS(&s, PASS_UNROLL, ANALYSIS_NONE, opt_unroll(ctx, am, f));
+    RUN_PASS(&s, PASS_ROTATE, ANALYSIS_NONE, opt_rotate(ctx, am, f));
+    RUN_PASS(&s, PASS_LICM, ANALYSIS_CFG, opt_licm(ctx, am, f));
+    RUN_PASS(&s, PASS_UNSWITCH, ANALYSIS_NONE, opt_unswitch(ctx, am, f));
+    RUN_PASS(&s, PASS_IVSR, ANALYSIS_CFG, opt_ivsr(ctx, am, f));
+    RUN_PASS(&s, PASS_LOAD_ELIM, ANALYSIS_CFG, opt_load_elim(am, f));
+    RUN_PASS(&s, PASS_DSE, ANALYSIS_CFG, opt_dse(am, f));
+    RUN_PASS(&s, PASS_TAIL_CALL_ELIM, ANALYSIS_NONE, opt_tail_call_elim(f));
+  } while (s.clean != (1u << PASS_COUNT) - 1);
+  instcombine_free(&s.ic, f);
+}
+
 void codegen_optimise(CodegenContext *ctx) {
+  AnalysisManager am = {0};
   opt_analyse_functions(ctx);
 
   /// Uncomment this to debug the function analysis pass.
@@ -1088,21 +4189,12 @@ void codegen_optimise(CodegenContext *ctx) {
 
   /// Optimise each function individually.
   do {
+    /// The cross-function optimisations below may modify or delete
+    /// any function, so discard everything we’ve computed so far.
+    analysis_invalidate_all(&am);
     foreach_val (f, ctx->functions) {
       if (!ir_func_is_definition(f) || ir_attribute(f, FUNC_ATTR_NOOPT)) continue;
-      do {
-        /// Uncomment this to debug optimisation passes.
-        /// print("====== OPTIMISATION PASS over %S ======\n", ir_name(f));
-        /// ir_set_func_ids(f);
-        /// ir_print_function(stdout, f);
-      } while (
-        opt_simplify_cfg(ctx, f) |
-        opt_instcombine(ctx, f) |
-        opt_dce(f) |
-        opt_mem2reg(f) |
-        opt_store_forwarding(f) |
-        opt_tail_call_elim(f)
-      );
+      optimise_function(ctx, &am, f);
     }
   }
 
@@ -1114,12 +4206,31 @@ void codegen_optimise(CodegenContext *ctx) {
   /// At some point, we should comment out this pass here and fix all
   /// the backend errors that that will inevitably cause.
   while (opt_inline(ctx, 20) | opt_analyse_functions(ctx) | opt_remove_globals(ctx));
+  analysis_manager_free(&am);
+
+  if (verbosity) {
+    print("Optimiser statistics:\n");
+    print("  Aggregates split into scalars: %Z\n", opt_stats.split_aggregates);
+    print("  Variables promoted to SSA values: %Z\n", opt_stats.promoted_variables);
+    print("  Redundant instructions eliminated: %Z\n", opt_stats.redundant_instructions);
+    print("  Loop-invariant instructions hoisted: %Z\n", opt_stats.hoisted_instructions);
+    print("  Induction variables strength-reduced: %Z\n", opt_stats.reduced_pointers);
+    print("  Loops unrolled: %Z\n", opt_stats.unrolled_loops);
+    print("  Loops rotated: %Z\n", opt_stats.rotated_loops);
+    print("  Loops unswitched: %Z\n", opt_stats.unswitched_loops);
+    print("  Loops replaced by memcpy or memset: %Z\n", opt_stats.recognised_idioms);
+    print("  Constants propagated: %Z\n", opt_stats.constants_propagated);
+    print("  Loads eliminated: %Z\n", opt_stats.eliminated_loads);
+    print("  Dead stores eliminated: %Z\n", opt_stats.eliminated_stores);
+  }
 }
 
 /// Called after RA.
 void codegen_optimise_blocks(CodegenContext *ctx) {
+  AnalysisManager am = {0};
   foreach_val (f, ctx->functions) {
     if (!ir_func_is_definition(f)) continue;
-    opt_simplify_cfg(ctx, f);
+    opt_simplify_cfg(ctx, &am, f);
   }
+  analysis_manager_free(&am);
 }
\ No newline at end of file
@@ -5,6 +5,14 @@
 
 extern int optimise;
 
+/// Whether alias analysis may assume that accesses of incompatible
+/// types through pointers don’t overlap.
+extern bool optimise_tbaa;
+
+/// Maximum number of instructions that a loop may have after
+/// unrolling it. Zero disables loop unrolling.
+extern usz optimise_unroll_threshold;
+
 /// Currently, we don’t have optimisation levels, so this
 /// will simply perform all available optimisations.
 void codegen_optimise(CodegenContext *ctx);
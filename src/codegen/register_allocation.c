@@ -141,34 +141,31 @@ void allocate_adjacency_graph(AdjacencyGraph *G, usz size) {
   G->regmasks = calloc(1, size * sizeof(usz));
 }
 
-/// Walk over all possible paths in the control flow graph upwards from
-/// given block, computing instruction interferences based on the values
-/// that are currently live.
+/// Get the index of a virtual register in the list of registers, or
+/// -1 if it is not in the list.
+static usz vreg_index(VRegVector *vregs, usz vreg_value) {
+  foreach_index (i, *vregs)
+    if (vregs->data[i].value == vreg_value)
+      return i;
+  return (usz) -1;
+}
+
+/// Compute interferences between the virtual registers in a block,
+/// given the values that are live on exit from the block.
+///
+/// Basically, walk over the instructions of the block backwards, keeping
+/// track of all virtual registers that have been encountered but not
+/// their defining use, as these are our "live values".
 static void collect_interferences_from_block
 (const MachineDescription *desc,
  MIRBlock *b,
  VRegVector *live_vals,
  VRegVector *vregs,
- MIRBlockVector *visited,
- MIRBlockVector *doubly_visited,
  AdjacencyGraph *G
  )
 {
-  /// Don't visit the same block thrice.
-  if (vector_contains(*visited, b)) {
-    if (vector_contains(*doubly_visited, b))
-      return;
-    else vector_push(*doubly_visited, b);
-  } else vector_push(*visited, b);
-
-
   DEBUG("  from block...\n");
 
-  // Collect interferences for virtual registers in this block.
-  // Basically, walk over the instructions of the block backwards, keeping
-  // track of all virtual registers that have been encountered but not
-  // their defining use, as these are our "live values".
-
   /// Collect interferences for instructions in this block.
   foreach_ptr_rev (inst, b->instructions) {
 
@@ -195,6 +192,31 @@ static void collect_interferences_from_block
       }
     }
 
+    /// Instructions that are only lowered after register allocation, such
+    /// as calls, define their result register implicitly rather than via
+    /// an operand. Anything that is live across such an instruction must
+    /// not share a register with its result.
+    if (inst->opcode < MIR_COUNT && inst->reg >= MIR_ARCH_START) {
+      usz def_idx = (usz)-1;
+      foreach_index (i, *vregs) {
+        if (vregs->data[i].value == inst->reg) {
+          def_idx = i;
+          break;
+        }
+      }
+      if (def_idx != (usz)-1) {
+        vreg_vector_remove_element(live_vals, inst->reg);
+        foreach (live_val, *live_vals) {
+          foreach_index (i, *vregs) {
+            if (vregs->data[i].value != live_val->value) continue;
+            adjm_set(G->matrix, def_idx, i);
+            adjm_set(G->matrix, i, def_idx);
+            break;
+          }
+        }
+      }
+    }
+
     /// Collect all register operands from this instruction that are
     /// used as operands somewhere in the function (i.e. within the list of
     /// registers).
@@ -302,35 +324,123 @@ static void collect_interferences_from_block
       }
     }
   }
+}
 
-  // The entry block has no predecessors.
-  if (b->is_entry) return;
+/// Live-in and live-out sets of each block of a function. The sets are
+/// bit sets indexed by the position of a virtual register in the list
+/// of registers and contain `words` words each.
+typedef struct BlockLiveness {
+  Map(MIRBlock *, usz) block_index;
+  usz words;
+  Vector(u64) gen;  /// Registers used in a block before they are defined in it.
+  Vector(u64) kill; /// Registers defined in a block.
+  Vector(u64) in;
+  Vector(u64) out;
+} BlockLiveness;
+
+#define LIVE_SET(vec, block) ((live)->vec.data + (block) * (live)->words)
+#define LIVE_BIT(set, idx) ((set)[(idx) / 64] & ((u64) 1 << ((idx) % 64)))
+#define LIVE_SET_BIT(set, idx) ((set)[(idx) / 64] |= ((u64) 1 << ((idx) % 64)))
+#define LIVE_CLEAR_BIT(set, idx) ((set)[(idx) / 64] &= ~((u64) 1 << ((idx) % 64)))
+
+/// Compute the registers used and defined in a block by walking over
+/// it backwards, the same way collect_interferences_from_block() does.
+static void compute_block_gen_kill(BlockLiveness *live, usz block, MIRBlock *b, VRegVector *vregs) {
+  u64 *gen = LIVE_SET(gen, block);
+  u64 *kill = LIVE_SET(kill, block);
+  foreach_ptr_rev (inst, b->instructions) {
+    FOREACH_MIR_OPERAND(inst, op) {
+      if (op->kind != MIR_OP_REGISTER || op->value.reg.value < MIR_ARCH_START || !op->value.reg.defining_use) continue;
+      usz idx = vreg_index(vregs, op->value.reg.value);
+      if (idx == (usz) -1) continue;
+      LIVE_CLEAR_BIT(gen, idx);
+      LIVE_SET_BIT(kill, idx);
+    }
 
-#ifdef DEBUG_RA
-  foreach_ptr (MIRBlock*, parent, b->predecessors) {
-    print("  Parent block:\n");
-    print_mir_block(parent);
+    if (inst->opcode < MIR_COUNT && inst->reg >= MIR_ARCH_START) {
+      usz idx = vreg_index(vregs, inst->reg);
+      if (idx != (usz) -1) {
+        LIVE_CLEAR_BIT(gen, idx);
+        LIVE_SET_BIT(kill, idx);
+      }
+    }
+
+    FOREACH_MIR_OPERAND(inst, operand) {
+      if (operand->kind != MIR_OP_REGISTER || operand->value.reg.value < MIR_ARCH_START || operand->value.reg.defining_use) continue;
+      usz idx = vreg_index(vregs, operand->value.reg.value);
+      if (idx != (usz) -1) LIVE_SET_BIT(gen, idx);
+    }
   }
-#endif
+}
 
-  foreach_val (parent, b->predecessors) {
-    // Copy live vals
-    VRegVector live_vals_copy = {0};
-    foreach (lv, *live_vals)
-      vector_push(live_vals_copy, *lv);
+/// Compute which virtual registers are live on exit from each block
+/// by iterating the usual backward dataflow equations to a fixpoint:
+///
+///   out(b) = ∪ in(s) for each successor s of b
+///   in(b)  = gen(b) ∪ (out(b) − kill(b))
+///
+/// Unlike walking paths from the exit blocks, this also accounts for
+/// values that are live around loops, e.g. values that are defined
+/// before a loop and only used inside of it.
+static void compute_block_liveness(BlockLiveness *live, MIRFunction *f, VRegVector *vregs) {
+  usz blocks = f->blocks.size;
+  live->words = (vregs->size + 63) / 64;
+  foreach_index (i, f->blocks) map_set(live->block_index, f->blocks.data[i], i);
+
+#define ALLOC(vec)                                                    \
+  do {                                                                \
+    vector_resize(live->vec, blocks * live->words);                   \
+    if (live->vec.size) memset(live->vec.data, 0, live->vec.size * sizeof *live->vec.data); \
+  } while (0)
+
+  ALLOC(gen);
+  ALLOC(kill);
+  ALLOC(in);
+  ALLOC(out);
+
+#undef ALLOC
+
+  foreach_index (i, f->blocks) compute_block_gen_kill(live, i, f->blocks.data[i], vregs);
+
+  /// Visiting blocks in reverse order converges faster since most
+  /// of the function’s control flow goes forwards.
+  bool changed;
+  do {
+    changed = false;
+    for (usz i = blocks; i--;) {
+      MIRBlock *b = f->blocks.data[i];
+      u64 *in = LIVE_SET(in, i);
+      u64 *out = LIVE_SET(out, i);
+      u64 *gen = LIVE_SET(gen, i);
+      u64 *kill = LIVE_SET(kill, i);
+
+      foreach_val (succ, b->successors) {
+        u64 *succ_in = LIVE_SET(in, *map_get(live->block_index, succ));
+        for (usz w = 0; w < live->words; w++) out[w] |= succ_in[w];
+      }
 
-    collect_interferences_from_block(desc, parent, &live_vals_copy, vregs, visited, doubly_visited, G);
+      for (usz w = 0; w < live->words; w++) {
+        u64 new_in = gen[w] | (out[w] & ~kill[w]);
+        if (new_in != in[w]) {
+          in[w] = new_in;
+          changed = true;
+        }
+      }
+    }
+  } while (changed);
+}
 
-    vector_delete(live_vals_copy);
-  }
+static void free_block_liveness(BlockLiveness *live) {
+  map_delete(live->block_index);
+  vector_delete(live->gen);
+  vector_delete(live->kill);
+  vector_delete(live->in);
+  vector_delete(live->out);
 }
 
-/// For each exit block `b` in given function, collect interferences
-/// from exit to entrance. While doing so, the AdjacencyGraph G (the
-/// matrix and regmasks, specifically) is updated to reflect interferences.
-///
-/// "exit block": a block that ends with an instruction that exits the
-/// function (i.e. return or unreachable).
+/// Collect interferences for all blocks in a function. The AdjacencyGraph
+/// G (the matrix and regmasks, specifically) is updated to reflect
+/// interferences.
 static void collect_interferences_for_function
 (const MachineDescription *desc,
  MIRFunction *function,
@@ -338,40 +448,32 @@ static void collect_interferences_for_function
  AdjacencyGraph *G
  )
 {
-  // Collect all blocks that exit from the function.
-  MIRBlockVector exits = {0};
-  foreach_val (b, function->blocks) {
-    if (b->is_exit) vector_push(exits, b);
-  }
-
-  DBGASSERT(exits.size, "Function \"%S\" has no exit blocks...", function->name);
-
-#ifdef DEBUG_RA
-  foreach_ptr (MIRBlock*, b, exits) {
-    print("Exit block:\n");
-    print_mir_block(b);
-  }
-#endif
+  BlockLiveness live = {0};
+  compute_block_liveness(&live, function, vregs);
 
   VRegVector live_vals = {0};
-  MIRBlockVector visited = {0};
-  MIRBlockVector doubly_visited = {0};
+  foreach_index (i, function->blocks) {
+    MIRBlock *b = function->blocks.data[i];
 
-  // From each exit block (collected above), follow control flow to the
-  // root of the function (entry block), or to a block already visited.
-  foreach_val (b, exits) {
+    /// Start out with the values that are live on exit from the block.
     vector_clear(live_vals);
-    vector_clear(visited);
-    vector_clear(doubly_visited);
-    collect_interferences_from_block(desc, b, &live_vals, vregs, &visited, &doubly_visited, G);
+    u64 *out = live.out.data + i * live.words;
+    foreach_index (idx, *vregs)
+      if (LIVE_BIT(out, idx))
+        vector_push(live_vals, vregs->data[idx]);
+
+    collect_interferences_from_block(desc, b, &live_vals, vregs, G);
   }
 
-  vector_delete(doubly_visited);
-  vector_delete(visited);
   vector_delete(live_vals);
-  vector_delete(exits);
+  free_block_liveness(&live);
 }
 
+#undef LIVE_SET
+#undef LIVE_BIT
+#undef LIVE_SET_BIT
+#undef LIVE_CLEAR_BIT
+
 /// Build the adjacency graph for the given function.
 static void build_adjacency_graph(MIRFunction *f, const MachineDescription *desc, VRegVector *registers, AdjacencyGraph *G) {
   ASSERT(f, "Can not build adjacency matrix of NULL MIR function.");
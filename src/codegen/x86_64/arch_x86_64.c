@@ -139,6 +139,10 @@ Clobbers does_clobber(IRInstruction *instruction) {
   return CLOBBERS_NEITHER;
 }
 
+/// Largest memcpy() or memset() with a constant size that we unroll
+/// into a load and store per integer-sized block.
+#define MEMORY_UNROLL_MAX 256
+
 static usz emit_memcpy_impl(
   CodegenContext *context,
   Type *element_type,
@@ -198,6 +202,128 @@ static void emit_memcpy(
   );
 }
 
+static usz emit_memset_impl(
+  CodegenContext *context,
+  IRInstruction *value,
+  IRInstruction **to,
+  usz byte_size,
+  IRInstruction *before
+) {
+  usz iter_amount = type_sizeof(ir_typeof(value));
+  IRInstruction *increment = ir_create_immediate(context, t_integer, iter_amount);
+  ir_insert_before(before, increment);
+
+  /// Unroll the memset() loop.
+  for (; iter_amount <= byte_size; byte_size -= iter_amount) {
+    ir_insert_before(before, ir_create_store(context, value, *to));
+    if (byte_size - iter_amount) {
+      *to = ir_create_add(context, *to, increment);
+      ir_insert_before(before, *to);
+    }
+  }
+
+  return byte_size;
+}
+
+/// Repeat the byte that a memset() fills memory with in every byte
+/// of an integer.
+static IRInstruction *emit_memset_pattern(
+  CodegenContext *context,
+  IRInstruction *value,
+  IRInstruction *before
+) {
+  if (ir_kind(value) == IR_IMMEDIATE)
+    return ir_insert_before(before, ir_create_immediate(context, t_integer, (u8) ir_imm(value) * 0x0101010101010101ull));
+
+  IRInstruction *pattern = ir_insert_before(before, ir_create_zext(context, t_integer, value));
+  for (usz shift = 8; shift < 64; shift *= 2) {
+    IRInstruction *amount = ir_insert_before(before, ir_create_immediate(context, t_integer, shift));
+    IRInstruction *shifted = ir_insert_before(before, ir_create_shl(context, pattern, amount));
+    pattern = ir_insert_before(before, ir_create_or(context, pattern, shifted));
+  }
+  return pattern;
+}
+
+static void emit_memset(
+  CodegenContext *context,
+  IRInstruction *to,
+  IRInstruction *value,
+  usz bytes_to_set,
+  IRInstruction *insert_before_this
+) {
+  /// Fill in integer-sized blocks, which requires repeating the byte
+  /// in every byte of an integer.
+  if (bytes_to_set >= type_sizeof(t_integer)) {
+    IRInstruction *pattern = emit_memset_pattern(context, value, insert_before_this);
+    bytes_to_set = emit_memset_impl(context, pattern, &to, bytes_to_set, insert_before_this);
+  }
+
+  /// Fill in byte-sized blocks if there’s more to fill.
+  if (bytes_to_set) emit_memset_impl(context, value, &to, bytes_to_set, insert_before_this);
+}
+
+/// Copy `type`-sized blocks from `from` to `to`, or fill them with
+/// `value` if `from` is NULL, for as long as at least that many of
+/// the `size` bytes are left, starting `offset` bytes in. The loop
+/// is inserted in front of `before`, which ends up in the block that
+/// the loop exits to.
+///
+/// \return The offset of the first byte that is left over.
+static IRInstruction *emit_memory_loop(
+  CodegenContext *context,
+  Type *type,
+  IRInstruction *to,
+  IRInstruction *from,
+  IRInstruction *value,
+  IRInstruction *size,
+  IRInstruction *offset,
+  IRInstruction *before
+) {
+  IRBlock *entry = ir_parent(before);
+  IRBlock *exit = ir_split_block(context, before);
+  IRBlock *cond = ir_block_insert_before(exit, ir_block(context));
+  IRBlock *body = ir_block_insert_before(exit, ir_block(context));
+  ir_dest(ir_terminator(entry), cond);
+
+  /// Check if there is another block left.
+  IRInstruction *phi = ir_insert_at_end(cond, ir_create_phi(context, t_integer));
+  IRInstruction *step = ir_insert_at_end(cond, ir_create_immediate(context, t_integer, type_sizeof(type)));
+  IRInstruction *next = ir_insert_at_end(cond, ir_create_add(context, phi, step));
+  IRInstruction *more = ir_insert_at_end(cond, ir_create_le(context, next, size));
+  ir_insert_at_end(cond, ir_create_cond_br(context, more, body, exit));
+
+  /// Copy or fill it.
+  IRInstruction *addr = ir_insert_at_end(body, ir_create_add(context, to, phi));
+  if (from) {
+    IRInstruction *src = ir_insert_at_end(body, ir_create_add(context, from, phi));
+    value = ir_insert_at_end(body, ir_create_load(context, type, src));
+  }
+  ir_insert_at_end(body, ir_create_store(context, value, addr));
+  ir_insert_at_end(body, ir_create_br(context, cond));
+
+  ir_phi_add_arg(phi, entry, offset);
+  ir_phi_add_arg(phi, body, next);
+  return phi;
+}
+
+/// Lower a memcpy() or memset() whose size is only known at runtime,
+/// or that is too large to unroll, to a loop over integer-sized blocks
+/// followed by a loop over the remaining bytes. `from` is NULL for a
+/// memset().
+static void emit_memory_loops(
+  CodegenContext *context,
+  IRInstruction *to,
+  IRInstruction *from,
+  IRInstruction *value,
+  IRInstruction *size,
+  IRInstruction *intrinsic
+) {
+  IRInstruction *offset = ir_insert_before(intrinsic, ir_create_immediate(context, t_integer, 0));
+  IRInstruction *pattern = from ? NULL : emit_memset_pattern(context, value, intrinsic);
+  offset = emit_memory_loop(context, t_integer, to, from, pattern, size, offset, intrinsic);
+  emit_memory_loop(context, t_byte, to, from, value, size, offset, intrinsic);
+}
+
 typedef enum SysVArgumentClass {
   SYSV_REGCLASS_INVALID,
   SYSV_REGCLASS_INTEGER,
@@ -377,6 +503,20 @@ static void lower_memory_parameter(
   ir_remove(param);
 }
 
+/// Replace a parameter that is passed in a register with a reference
+/// to that register. Argument registers are clobbered by calls, so
+/// unless the parameter is only ever stored to memory (as it is before
+/// mem2reg), copy it into a value that RA is free to put elsewhere.
+static void lower_register_parameter(CodegenContext *context, IRInstruction *inst, Type *type, Register reg) {
+  IRInstruction *value = ir_insert_before(inst, ir_create_register(context, type, reg));
+  FOREACH_USER (user, inst) {
+    if (ir_kind(user) == IR_STORE && ir_store_value(user) == inst && ir_store_addr(user) != inst) continue;
+    value = ir_insert_before(inst, ir_create_copy(context, value));
+    break;
+  }
+  ir_replace(inst, value);
+}
+
 static void lower_parameter(CodegenContext *context, IRInstruction *inst) {
   switch (context->call_convention) {
     case CG_CALL_CONV_SYSV: {
@@ -394,7 +534,7 @@ static void lower_parameter(CodegenContext *context, IRInstruction *inst) {
         switch (class) {
           case SYSV_REGCLASS_INTEGER: {
             if (type_sizeof(type) > 8) sysv_load_two_register_parameter(context, inst);
-            else ir_replace(inst, ir_create_register(context, type, argument_registers[ir_imm(inst)]));
+            else lower_register_parameter(context, inst, type, argument_registers[ir_imm(inst)]);
           } break;
 
           case SYSV_REGCLASS_MEMORY: {
@@ -433,7 +573,7 @@ static void lower_parameter(CodegenContext *context, IRInstruction *inst) {
       // types, are passed as if they were integers of the same size.
       usz idx = ir_imm(inst);
       if (idx < argument_register_count) {
-        ir_replace(inst, ir_create_register(context, type, argument_registers[idx]));
+        lower_register_parameter(context, inst, type, argument_registers[idx]);
       } else {
         // Calculate offset to caller-allocated stack memory for large parameters.
         // FIXME: Tail calls, leaf functions, etc. may alter the size of the stack frame here.
@@ -582,7 +722,7 @@ static void lower_instruction(CodegenContext *context, IRInstruction *inst) {
     case IR_STORE: lower_store(context, inst); break;
 
     /// Handle intrinsics that require early lowering.
-    STATIC_ASSERT(INTRIN_BACKEND_COUNT == 3, "Handle backend intrinsics in codegen");
+    STATIC_ASSERT(INTRIN_BACKEND_COUNT == 4, "Handle backend intrinsics in codegen");
     case IR_INTRINSIC: {
       switch (ir_intrinsic_kind(inst)) {
         IGNORE_FRONTEND_INTRINSICS()
@@ -594,12 +734,13 @@ static void lower_instruction(CodegenContext *context, IRInstruction *inst) {
 
         /// Lower memory copies.
         case INTRIN_BUILTIN_MEMCPY: {
-          /// If the size is known at compile time, we can inline it.
+          /// If the size is known at compile time and small enough,
+          /// we can inline it. Otherwise, emit a loop.
           /// TODO: Should call libc `memcpy()` or our runtime’s
           /// `__intercept_memcpy()` once we have something like that
           /// if the size is too large.
           IRInstruction *size = ir_call_arg(inst, 2);
-          if (ir_kind(size) == IR_IMMEDIATE) {
+          if (ir_kind(size) == IR_IMMEDIATE && ir_imm(size) <= MEMORY_UNROLL_MAX) {
             emit_memcpy(
               context,
               ir_call_arg(inst, 0),
@@ -607,13 +748,29 @@ static void lower_instruction(CodegenContext *context, IRInstruction *inst) {
               ir_imm(size),
               inst
             );
+          } else {
+            emit_memory_loops(context, ir_call_arg(inst, 0), ir_call_arg(inst, 1), NULL, size, inst);
+          }
 
-            ir_remove(inst);
-            break;
+          ir_remove(inst);
+        } break;
+
+        /// Lower memory fills the same way.
+        case INTRIN_BUILTIN_MEMSET: {
+          IRInstruction *size = ir_call_arg(inst, 2);
+          if (ir_kind(size) == IR_IMMEDIATE && ir_imm(size) <= MEMORY_UNROLL_MAX) {
+            emit_memset(
+              context,
+              ir_call_arg(inst, 0),
+              ir_call_arg(inst, 1),
+              ir_imm(size),
+              inst
+            );
+          } else {
+            emit_memory_loops(context, ir_call_arg(inst, 0), NULL, ir_call_arg(inst, 1), size, inst);
           }
 
-          /// Size must be known at compile time.
-          ICE("Sorry, Non-constant-sized memory copies not supported");
+          ir_remove(inst);
         } break;
       }
     } break;
@@ -792,7 +949,10 @@ static void lower(CodegenContext *context) {
     for (usz i = 0; i < ty->function.parameters.size; i++) {
       IRInstruction *param = ir_parameter(func, i);
       if (ir_parent(param) == NULL) continue;
-      if (ir_use_count(param) == 0) ir_remove(param);
+      if (ir_use_count(param) == 0) {
+        ir_remove(param);
+        continue;
+      }
       lower_parameter(context, param);
     }
   }
@@ -930,6 +1090,8 @@ bool parameter_is_in_register_x86_64(CodegenContext *context, IRFunction *functi
   }
 }
 
+/// Insert the instructions that tear down the stack frame of a function
+/// before the instruction at `index`; `index` is advanced past them.
 static void mir_x86_64_function_exit_at(enum StackFrameKind frame_kind, MIRBlock *block, usz *index) {
   STATIC_ASSERT(FRAME_COUNT == 3, "Exhaustive handling of stack frame kinds in function entry MIR lowering");
   ASSERT(frame_kind < FRAME_COUNT, "Invalid stack frame kind!");
@@ -938,16 +1100,27 @@ static void mir_x86_64_function_exit_at(enum StackFrameKind frame_kind, MIRBlock
 
   case FRAME_FULL: {
     // MOV %RBP, %RSP
-    MIRInstruction *restore_sp = mir_makenew(MX64_MOV);
+    MIRInstruction *restore_sp = mir_makenew(block->function, MX64_MOV);
     mir_add_op(restore_sp, mir_op_register(REG_RBP, r64, false));
     mir_add_op(restore_sp, mir_op_register(REG_RSP, r64, false));
-    mir_insert_instruction(block, restore_sp, ++*index);
-  } FALLTHROUGH;
-  case FRAME_MINIMAL: {
+    mir_insert_instruction(block, restore_sp, (*index)++);
+
     // POP %RBP
-    MIRInstruction *restore_bp = mir_makenew(MX64_POP);
+    MIRInstruction *restore_bp = mir_makenew(block->function, MX64_POP);
     mir_add_op(restore_bp, mir_op_register(REG_RBP, r64, false));
-    mir_insert_instruction(block, restore_bp, ++*index);
+    mir_insert_instruction(block, restore_bp, (*index)++);
+  } break;
+
+  /// This must match the prologue emitted for minimal frames.
+  case FRAME_MINIMAL: {
+    isz frame_size = 0;
+    foreach (fo, block->function->frame_objects) frame_size += (isz) fo->size;
+
+    // ADD $OFFSET, %RSP
+    MIRInstruction *restore_sp = mir_makenew(block->function, MX64_ADD);
+    mir_add_op(restore_sp, mir_op_immediate(ALIGN_TO(frame_size, 16) + 8));
+    mir_add_op(restore_sp, mir_op_register(REG_RSP, r64, false));
+    mir_insert_instruction(block, restore_sp, (*index)++);
   } break;
 
   case FRAME_COUNT: FALLTHROUGH;
@@ -1053,7 +1226,7 @@ void codegen_emit_x86_64(CodegenContext *context) {
           // Create symbol for var->name at current offset within the .data section
           GObjSymbol sym = {0};
           sym.type = sym_type;
-          sym.name = strdup(var->name.data);
+          sym.name = var->name.data;
           sym.section_name = strdup(".data");
           sym.byte_offset = sec_initdata->data.bytes.size;
           vector_push(object.symbols, sym);
@@ -1083,7 +1256,7 @@ void codegen_emit_x86_64(CodegenContext *context) {
           // Create symbol for var->name at current offset within the .rodata section
           GObjSymbol sym = {0};
           sym.type = sym_type;
-          sym.name = strdup(var->name.data);
+          sym.name = var->name.data;
           sym.section_name = strdup(".rodata");
           sym.byte_offset = sec_rodata->data.bytes.size;
           vector_push(object.symbols, sym);
@@ -1119,14 +1292,14 @@ void codegen_emit_x86_64(CodegenContext *context) {
           // Create symbol referencing external var->name
           GObjSymbol sym = {0};
           sym.type = GOBJ_SYMTYPE_EXTERNAL;
-          sym.name = strdup(var->name.data);
+          sym.name = var->name.data;
           sym.section_name = strdup(".bss");
           vector_push(object.symbols, sym);
         } else {
           // Create symbol for var->name at current offset within the .bss section
           GObjSymbol sym = {0};
           sym.type = GOBJ_SYMTYPE_STATIC;
-          sym.name = strdup(var->name.data);
+          sym.name = var->name.data;
           sym.section_name = strdup(".bss");
           // Align to type's alignment requirements.
           sec_uninitdata->data.fill.amount = ALIGN_TO(sec_uninitdata->data.fill.amount, type_alignof(var->type));
@@ -1187,7 +1360,9 @@ void codegen_emit_x86_64(CodegenContext *context) {
         }
       }*/
 
-      ir_name(block, format(".L%U", block_cnt++));
+      string name = format(".L%U", block_cnt++);
+      ir_name(block, identifier_intern(as_span(name)));
+      free(name.data);
     }
   }
 
@@ -1196,6 +1371,17 @@ void codegen_emit_x86_64(CodegenContext *context) {
 
   MIRFunctionVector machine_instructions_from_ir = mir_from_ir(context);
 
+  // Assign labels to blocks that were created during lowering, e.g.
+  // to split critical edges.
+  foreach_val (function, machine_instructions_from_ir) {
+    foreach_val (block, function->blocks) {
+      if (block->name.size) continue;
+      string name = format(".L%U", block_cnt++);
+      block->name = as_span(identifier_intern(as_span(name)));
+      free(name.data);
+    }
+  }
+
   // TODO: Either embed x86_64 isel or somehow make this path knowable (i.e. via install).
   ISelPatterns patterns =  isel_parse_file(ISEL_TABLE_LOCATION_X86_64);
 
@@ -1239,19 +1425,19 @@ void codegen_emit_x86_64(CodegenContext *context) {
 
           if (src->kind == MIR_OP_IMMEDIATE) {
             i64 imm = src->value.imm & mask;
-            MIRInstruction *move = mir_makenew(MX64_MOV);
+            MIRInstruction *move = mir_makenew(function, MX64_MOV);
             mir_add_op(move, mir_op_immediate(imm));
             mir_add_op(move, mir_op_reference(instruction));
             mir_insert_instruction_with_reg(instruction->block, move, i++, instruction->reg);
             break;
           }
 
-          MIRInstruction *move = mir_makenew(MX64_MOV);
+          MIRInstruction *move = mir_makenew(function, MX64_MOV);
           mir_add_op(move, *src);
           mir_add_op(move, mir_op_reference(instruction));
           mir_insert_instruction(instruction->block, move, i++);
 
-          MIRInstruction *and = mir_makenew(MX64_AND);
+          MIRInstruction *and = mir_makenew(function, MX64_AND);
           mir_add_op(and, mir_op_immediate(mask));
           mir_add_op(and, mir_op_reference(instruction));
           mir_insert_instruction_with_reg(instruction->block, and, i++, instruction->reg);
@@ -1262,12 +1448,13 @@ void codegen_emit_x86_64(CodegenContext *context) {
         case MIR_INTRINSIC: {
           MIROperand *kind = mir_get_op(instruction, 0);
           ASSERT(kind->kind == MIR_OP_IMMEDIATE, "Intrinsic kind must be an immediate");
-          STATIC_ASSERT(INTRIN_BACKEND_COUNT == 3, "Handle backend intrinsics in codegen");
+          STATIC_ASSERT(INTRIN_BACKEND_COUNT == 4, "Handle backend intrinsics in codegen");
           switch (kind->value.imm) {
             IGNORE_FRONTEND_INTRINSICS();
 
-            /// Memcpy should already have been lowered.
-            case INTRIN_BUILTIN_MEMCPY: UNREACHABLE();
+            /// Memcpy and memset should already have been lowered.
+            case INTRIN_BUILTIN_MEMCPY:
+            case INTRIN_BUILTIN_MEMSET: UNREACHABLE();
 
             /// For syscalls, just emit a bunch of moves and the syscall.
             case INTRIN_BUILTIN_SYSCALL: {
@@ -1290,13 +1477,13 @@ void codegen_emit_x86_64(CodegenContext *context) {
                   continue;
                 }
 
-                MIRInstruction *mov = mir_makenew(MIR_COPY);
+                MIRInstruction *mov = mir_makenew(function, MIR_COPY);
                 mir_add_op(mov, *op);
                 mir_insert_instruction_with_reg(instruction->block, mov, i++, *arg_regs++);
               }
 
               /// Insert syscall.
-              MIRInstruction *sys = mir_makenew(MX64_SYSCALL);
+              MIRInstruction *sys = mir_makenew(function, MX64_SYSCALL);
               mir_add_op(sys, mir_op_register(REG_RAX, r64, true));
               mir_insert_instruction_with_reg(instruction->block, sys, i++, REG_RAX);
 
@@ -1309,7 +1496,7 @@ void codegen_emit_x86_64(CodegenContext *context) {
               clobbered.size = r64;
               for (usz r = 0; r < sizeof syscall_clobbers / sizeof *syscall_clobbers; r++) {
                 clobbered.value = syscall_clobbers[r];
-                vector_push(sys->clobbers, clobbered);
+                mir_add_clobber(sys, clobbered);
               }
 
               /// Yeet intrinsic call.
@@ -1318,7 +1505,7 @@ void codegen_emit_x86_64(CodegenContext *context) {
 
             /// For a debug trap, emit an int 3.
             case INTRIN_BUILTIN_DEBUGTRAP: {
-              MIRInstruction *int3 = mir_makenew(MX64_INT3);
+              MIRInstruction *int3 = mir_makenew(function, MX64_INT3);
               mir_insert_instruction(instruction->block, int3, i++);
               vector_push(instructions_to_remove, instruction);
             } break;
@@ -1379,7 +1566,7 @@ void codegen_emit_x86_64(CodegenContext *context) {
       for (Register r = 1; r < sizeof(func_regs) * 8; ++r) {
         if (r == desc.result_register) continue;
         if (func_regs & ((usz)1 << r) && is_callee_saved(r)) {
-          MIRInstruction *push = mir_makenew(MX64_PUSH);
+          MIRInstruction *push = mir_makenew(function, MX64_PUSH);
           mir_add_op(push, mir_op_register(r, r64, false));
           mir_insert_instruction(first_block, push, 0);
         }
@@ -1395,7 +1582,7 @@ void codegen_emit_x86_64(CodegenContext *context) {
       for (Register r = 1; r < sizeof(func_regs) * 8; ++r) {
         if (r == desc.result_register) continue;
         if (func_regs & ((usz)1 << r) && is_callee_saved(r)) {
-          MIRInstruction *pop = mir_makenew(MX64_POP);
+          MIRInstruction *pop = mir_makenew(function, MX64_POP);
           mir_add_op(pop, mir_op_register(r, r64, false));
           mir_append_instruction(function, pop);
         }
@@ -1429,9 +1616,9 @@ void codegen_emit_x86_64(CodegenContext *context) {
         case MIR_CALL: {
           // Tail call.
           if (ir_call_tail(instruction->origin)) {
-            // Restore the frame pointer if we have one.
+            // Tear down our stack frame before jumping to the callee.
             mir_x86_64_function_exit_at(stack_frame_kind(instruction->block->function), instruction->block, &i);
-            MIRInstruction *jump = mir_makenew(MX64_JMP);
+            MIRInstruction *jump = mir_makenew(function, MX64_JMP);
             mir_add_op(jump, *mir_get_op(instruction, 0));
             mir_insert_instruction(instruction->block, jump, i++);
 
@@ -1447,8 +1634,8 @@ void codegen_emit_x86_64(CodegenContext *context) {
           // that RAX can be clobbered by this instruction.
           // TODO: Determine a better way to figure out if we actually
           // need to save the result register over this call boundary.
-          if (instruction->reg < MIR_ARCH_START && instruction->reg != desc.result_register && func_regs & (1 << desc.result_register)) {
-            MIRInstruction *push = mir_makenew(MX64_PUSH);
+          if (instruction->reg != desc.result_register && func_regs & (1 << desc.result_register)) {
+            MIRInstruction *push = mir_makenew(function, MX64_PUSH);
             mir_add_op(push, mir_op_register(desc.result_register, r64, false));
             mir_insert_instruction(instruction->block, push, i++);
             regs_pushed_count++;
@@ -1464,7 +1651,7 @@ void codegen_emit_x86_64(CodegenContext *context) {
           // TODO: Don't push registers that are used for arguments.
           for (Register r = REG_RAX + 1; r < sizeof(func_regs) * 8; ++r) {
             if (func_regs & ((usz)1 << r) && is_caller_saved(r)) {
-              MIRInstruction *push = mir_makenew(MX64_PUSH);
+              MIRInstruction *push = mir_makenew(function, MX64_PUSH);
               mir_add_op(push, mir_op_register(r, r64, false));
               mir_insert_instruction(instruction->block, push, i++);
             }
@@ -1487,12 +1674,12 @@ void codegen_emit_x86_64(CodegenContext *context) {
               // If argument is passed on stack due to ABI.
               if (arg->kind == MIR_OP_LOCAL_REF) {
                 // Push the base pointer.
-                MIRInstruction *push = mir_makenew(MX64_PUSH);
+                MIRInstruction *push = mir_makenew(function, MX64_PUSH);
                 mir_add_op(push, mir_op_register(REG_RBP, r64, false));
                 mir_insert_instruction(instruction->block, push, i++);
                 bytes_pushed += 8;
                 // Subtract local's offset from base pointer from the newly pushed base pointer.
-                MIRInstruction *sub = mir_makenew(MX64_SUB);
+                MIRInstruction *sub = mir_makenew(function, MX64_SUB);
                 ASSERT(arg->value.local_ref < function->frame_objects.size, "Referenced frame object does not exist");
                 mir_add_op(sub, mir_op_immediate(-function->frame_objects.data[arg->value.local_ref].offset)); // value to subtract
                 mir_add_op(sub, mir_op_register(REG_RSP, r64, false)); // base address
@@ -1502,37 +1689,37 @@ void codegen_emit_x86_64(CodegenContext *context) {
               } else if (argument_registers_left < 0) {
                 if (arg->kind == MIR_OP_REGISTER) {
                   if (arg->value.reg.size == r64) {
-                    MIRInstruction *push = mir_makenew(MX64_PUSH);
+                    MIRInstruction *push = mir_makenew(function, MX64_PUSH);
                     mir_add_op(push, *arg);
                     mir_insert_instruction(instruction->block, push, i++);
                     bytes_pushed += 8;
                   } else if (arg->value.reg.size == r32) {
-                    MIRInstruction *move = mir_makenew(MX64_MOV);
+                    MIRInstruction *move = mir_makenew(function, MX64_MOV);
                     mir_add_op(move, *arg);
                     mir_add_op(move, mir_op_register(REG_RAX, r32, false));
                     mir_insert_instruction(instruction->block, move, i++);
-                    MIRInstruction *push = mir_makenew(MX64_PUSH);
+                    MIRInstruction *push = mir_makenew(function, MX64_PUSH);
                     mir_add_op(push, mir_op_register(REG_RAX, r64, false));
                     mir_insert_instruction(instruction->block, push, i++);
                     bytes_pushed += 8;
                   } else {
-                    MIRInstruction *move = mir_makenew(MX64_MOVZX);
+                    MIRInstruction *move = mir_makenew(function, MX64_MOVZX);
                     mir_add_op(move, *arg);
                     mir_add_op(move, mir_op_register(REG_RAX, r64, false));
                     mir_insert_instruction(instruction->block, move, i++);
-                    MIRInstruction *push = mir_makenew(MX64_PUSH);
+                    MIRInstruction *push = mir_makenew(function, MX64_PUSH);
                     mir_add_op(push, mir_op_register(REG_RAX, r64, false));
                     mir_insert_instruction(instruction->block, push, i++);
                     bytes_pushed += 8;
                   }
                 } else if (arg->kind == MIR_OP_IMMEDIATE) {
-                  MIRInstruction *move = mir_makenew(MX64_MOV);
+                  MIRInstruction *move = mir_makenew(function, MX64_MOV);
                   mir_add_op(move, *arg);
-                  if (arg->value.imm >= INT32_MIN && arg->value.imm <= INT32_MAX)
+                  if (arg->value.imm >= 0 && arg->value.imm <= UINT32_MAX)
                     mir_add_op(move, mir_op_register(REG_RAX, r32, false));
                   else mir_add_op(move, mir_op_register(REG_RAX, r64, false));
                   mir_insert_instruction(instruction->block, move, i++);
-                  MIRInstruction *push = mir_makenew(MX64_PUSH);
+                  MIRInstruction *push = mir_makenew(function, MX64_PUSH);
                   mir_add_op(push, mir_op_register(REG_RAX, r64, false));
                   mir_insert_instruction(instruction->block, push, i++);
                   bytes_pushed += 8;
@@ -1553,14 +1740,14 @@ void codegen_emit_x86_64(CodegenContext *context) {
             bytes_to_push += 32;
 
           if (bytes_to_push) {
-            MIRInstruction *sub = mir_makenew(MX64_SUB);
+            MIRInstruction *sub = mir_makenew(function, MX64_SUB);
             mir_add_op(sub, mir_op_immediate(bytes_to_push));
             mir_add_op(sub, mir_op_register(REG_RSP, r64, false));
             mir_insert_instruction(instruction->block, sub, i++);
             bytes_pushed += bytes_to_push;
           }
 
-          MIRInstruction *call = mir_makenew(MX64_CALL);
+          MIRInstruction *call = mir_makenew(function, MX64_CALL);
           call->origin = instruction->origin;
           instruction->lowered = call;
           mir_add_op(call, *mir_get_op(instruction, 0));
@@ -1568,7 +1755,7 @@ void codegen_emit_x86_64(CodegenContext *context) {
 
           // Restore stack
           if (bytes_pushed) {
-            MIRInstruction *add = mir_makenew(MX64_ADD);
+            MIRInstruction *add = mir_makenew(function, MX64_ADD);
             mir_add_op(add, mir_op_immediate((isz)bytes_pushed));
             mir_add_op(add, mir_op_register(REG_RSP, r64, false));
             mir_insert_instruction(instruction->block, add, i++);
@@ -1577,7 +1764,7 @@ void codegen_emit_x86_64(CodegenContext *context) {
           // Restore caller saved registers used in called function.
           for (Register r = sizeof(func_regs) * 8 - 1; r > REG_RAX; --r) {
             if (func_regs & ((usz)1 << r) && is_caller_saved(r)) {
-              MIRInstruction *pop = mir_makenew(MX64_POP);
+              MIRInstruction *pop = mir_makenew(function, MX64_POP);
               mir_add_op(pop, mir_op_register(r, r64, false));
               mir_insert_instruction(instruction->block, pop, i++);
             }
@@ -1587,17 +1774,22 @@ void codegen_emit_x86_64(CodegenContext *context) {
           // result just gets discarded (no use of it's vreg) so we can just
           // /not/ do this part.
           if (instruction->reg < MIR_ARCH_START && instruction->reg != desc.result_register) {
-            MIRInstruction *move = mir_makenew(MX64_MOV);
+            MIRInstruction *move = mir_makenew(function, MX64_MOV);
             mir_add_op(move, mir_op_register(desc.result_register, r64, false));
             mir_add_op(move, mir_op_register(instruction->reg, r64, false));
             mir_insert_instruction(instruction->block, move, i++);
 
             // Restore return register.
             if (func_regs & (1 << desc.result_register)) {
-              MIRInstruction *pop = mir_makenew(MX64_POP);
+              MIRInstruction *pop = mir_makenew(function, MX64_POP);
               mir_add_op(pop, mir_op_register(desc.result_register, r64, false));
               mir_insert_instruction(instruction->block, pop, i++);
             }
+          } else if (instruction->reg >= MIR_ARCH_START && func_regs & (1 << desc.result_register)) {
+            // Restore return register, which we saved above.
+            MIRInstruction *pop = mir_makenew(function, MX64_POP);
+            mir_add_op(pop, mir_op_register(desc.result_register, r64, false));
+            mir_insert_instruction(instruction->block, pop, i++);
           }
 
           vector_push(instructions_to_remove, instruction);
@@ -1708,4 +1900,8 @@ void codegen_emit_x86_64(CodegenContext *context) {
 
   generic_object_delete(&object);
 #endif // x86_64_GENERATE_MACHINE_CODE
+
+  /// Free the machine IR now that code has been emitted.
+  foreach_val (function, machine_instructions_from_ir) mir_function_free(function);
+  vector_delete(machine_instructions_from_ir);
 }
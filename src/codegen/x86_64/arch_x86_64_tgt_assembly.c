@@ -83,8 +83,9 @@ static const char *instruction_mnemonic(CodegenContext *context, MIROpcodex86_64
 
 static void femit_imm_to_reg(CodegenContext *context, MIROpcodex86_64 inst, int64_t immediate, RegisterDescriptor destination_register, enum RegSize size) {
   if ((inst == MX64_SUB || inst == MX64_ADD) && immediate == 0) return;
-  // We can get away with smaller (sign extended) moves if immediate is small enough.
-  if (size > r32 && (inst == MX64_MOV) && (immediate >= INT32_MIN && immediate <= INT32_MAX)) {
+  // We can get away with smaller moves if immediate is small enough. Note that
+  // 32-bit moves zero-extend, so this doesn’t work for negative immediates.
+  if (size > r32 && (inst == MX64_MOV) && (immediate >= 0 && immediate <= UINT32_MAX)) {
     size = r32;
   }
 
@@ -223,7 +223,8 @@ static void mcode_imm_to_reg(CodegenContext *context, MIROpcodex86_64 inst, int6
 
   case MX64_MOV: {
 
-    if (size == r64 && immediate > INT32_MIN && immediate < INT32_MAX)
+    /// 32-bit moves zero-extend the immediate.
+    if (size == r64 && immediate >= 0 && immediate <= UINT32_MAX)
       size = r32;
 
     switch (size) {
@@ -821,7 +822,7 @@ static void mcode_name_to_reg(CodegenContext *context, MIROpcodex86_64 inst, Reg
         Section *sec_code = code_section(context->object);
         ASSERT(sec_code, "NO CODE SECTION, WHAT HAVE YOU DONE?");
         reloc.sym.byte_offset = sec_code->data.bytes.size;
-        reloc.sym.name = strdup(name);
+        reloc.sym.name = name;
         reloc.sym.section_name = strdup(sec_code->name);
         reloc.type = RELOC_DISP32_PCREL;
         vector_push(context->object->relocs, reloc);
@@ -853,7 +854,7 @@ static void mcode_name_to_reg(CodegenContext *context, MIROpcodex86_64 inst, Reg
       RelocationEntry reloc = {0};
       Section *sec_code = code_section(context->object);
       reloc.sym.byte_offset = sec_code->data.bytes.size;
-      reloc.sym.name = strdup(name);
+      reloc.sym.name = name;
       reloc.sym.section_name = strdup(sec_code->name);
       reloc.type = RELOC_DISP32;
       vector_push(context->object->relocs, reloc);
@@ -882,7 +883,7 @@ static void mcode_name_to_reg(CodegenContext *context, MIROpcodex86_64 inst, Reg
         Section *sec_code = code_section(context->object);
         ASSERT(sec_code, "NO CODE SECTION, WHAT HAVE YOU DONE?");
         reloc.sym.byte_offset = sec_code->data.bytes.size;
-        reloc.sym.name = strdup(name);
+        reloc.sym.name = name;
         reloc.sym.section_name = strdup(sec_code->name);
         reloc.type = RELOC_DISP32_PCREL;
         vector_push(context->object->relocs, reloc);
@@ -907,7 +908,7 @@ static void mcode_name_to_reg(CodegenContext *context, MIROpcodex86_64 inst, Reg
       RelocationEntry reloc = {0};
       Section *sec_code = code_section(context->object);
       reloc.sym.byte_offset = sec_code->data.bytes.size;
-      reloc.sym.name = strdup(name);
+      reloc.sym.name = name;
       reloc.sym.section_name = strdup(sec_code->name);
       reloc.type = RELOC_DISP32;
       vector_push(context->object->relocs, reloc);
@@ -949,7 +950,7 @@ static void mcode_name_to_reg(CodegenContext *context, MIROpcodex86_64 inst, Reg
         Section *sec_code = code_section(context->object);
         ASSERT(sec_code, "NO CODE SECTION, WHAT HAVE YOU DONE?");
         reloc.sym.byte_offset = sec_code->data.bytes.size;
-        reloc.sym.name = strdup(name);
+        reloc.sym.name = name;
         reloc.sym.section_name = strdup(sec_code->name);
         reloc.type = RELOC_DISP32_PCREL;
         vector_push(context->object->relocs, reloc);
@@ -980,7 +981,7 @@ static void mcode_name_to_reg(CodegenContext *context, MIROpcodex86_64 inst, Reg
       RelocationEntry reloc = {0};
       Section *sec_code = code_section(context->object);
       reloc.sym.byte_offset = sec_code->data.bytes.size;
-      reloc.sym.name = strdup(name);
+      reloc.sym.name = name;
       reloc.sym.section_name = strdup(sec_code->name);
       reloc.type = RELOC_DISP32;
       vector_push(context->object->relocs, reloc);
@@ -1017,7 +1018,7 @@ static void mcode_name_to_reg(CodegenContext *context, MIROpcodex86_64 inst, Reg
         Section *sec_code = code_section(context->object);
         ASSERT(sec_code, "NO CODE SECTION, WHAT HAVE YOU DONE?");
         reloc.sym.byte_offset = sec_code->data.bytes.size;
-        reloc.sym.name = strdup(name);
+        reloc.sym.name = name;
         reloc.sym.section_name = strdup(sec_code->name);
         reloc.type = RELOC_DISP32_PCREL;
         vector_push(context->object->relocs, reloc);
@@ -1048,7 +1049,7 @@ static void mcode_name_to_reg(CodegenContext *context, MIROpcodex86_64 inst, Reg
       RelocationEntry reloc = {0};
       Section *sec_code = code_section(context->object);
       reloc.sym.byte_offset = sec_code->data.bytes.size;
-      reloc.sym.name = strdup(name);
+      reloc.sym.name = name;
       reloc.sym.section_name = strdup(sec_code->name);
       reloc.type = RELOC_DISP32;
       vector_push(context->object->relocs, reloc);
@@ -1077,7 +1078,7 @@ static void mcode_name_to_reg(CodegenContext *context, MIROpcodex86_64 inst, Reg
         Section *sec_code = code_section(context->object);
         ASSERT(sec_code, "NO CODE SECTION, WHAT HAVE YOU DONE?");
         reloc.sym.byte_offset = sec_code->data.bytes.size;
-        reloc.sym.name = strdup(name);
+        reloc.sym.name = name;
         reloc.sym.section_name = strdup(sec_code->name);
         reloc.type = RELOC_DISP32_PCREL;
         vector_push(context->object->relocs, reloc);
@@ -1105,7 +1106,7 @@ static void mcode_name_to_reg(CodegenContext *context, MIROpcodex86_64 inst, Reg
       RelocationEntry reloc = {0};
       Section *sec_code = code_section(context->object);
       reloc.sym.byte_offset = sec_code->data.bytes.size;
-      reloc.sym.name = strdup(name);
+      reloc.sym.name = name;
       reloc.sym.section_name = strdup(sec_code->name);
       reloc.type = RELOC_DISP32;
       vector_push(context->object->relocs, reloc);
@@ -1913,7 +1914,7 @@ static void mcode_reg_to_name(CodegenContext *context, MIROpcodex86_64 inst, Reg
         Section *sec_code = code_section(context->object);
         ASSERT(sec_code, "NO CODE SECTION, WHAT HAVE YOU DONE?");
         reloc.sym.byte_offset = sec_code->data.bytes.size;
-        reloc.sym.name = strdup(name);
+        reloc.sym.name = name;
         reloc.sym.section_name = strdup(sec_code->name);
         reloc.type = RELOC_DISP32_PCREL;
         vector_push(context->object->relocs, reloc);
@@ -1939,7 +1940,7 @@ static void mcode_reg_to_name(CodegenContext *context, MIROpcodex86_64 inst, Reg
       RelocationEntry reloc = {0};
       Section *sec_code = code_section(context->object);
       reloc.sym.byte_offset = sec_code->data.bytes.size;
-      reloc.sym.name = strdup(name);
+      reloc.sym.name = name;
       reloc.sym.section_name = strdup(sec_code->name);
       reloc.type = RELOC_DISP32;
       vector_push(context->object->relocs, reloc);
@@ -1972,7 +1973,7 @@ static void mcode_reg_to_name(CodegenContext *context, MIROpcodex86_64 inst, Reg
         Section *sec_code = code_section(context->object);
         ASSERT(sec_code, "NO CODE SECTION, WHAT HAVE YOU DONE?");
         reloc.sym.byte_offset = sec_code->data.bytes.size;
-        reloc.sym.name = strdup(name);
+        reloc.sym.name = name;
         reloc.sym.section_name = strdup(sec_code->name);
         reloc.type = RELOC_DISP32_PCREL;
         vector_push(context->object->relocs, reloc);
@@ -1998,7 +1999,7 @@ static void mcode_reg_to_name(CodegenContext *context, MIROpcodex86_64 inst, Reg
       RelocationEntry reloc = {0};
       Section *sec_code = code_section(context->object);
       reloc.sym.byte_offset = sec_code->data.bytes.size;
-      reloc.sym.name = strdup(name);
+      reloc.sym.name = name;
       reloc.sym.section_name = strdup(sec_code->name);
       reloc.type = RELOC_DISP32;
       vector_push(context->object->relocs, reloc);
@@ -2023,7 +2024,7 @@ static void mcode_reg_to_name(CodegenContext *context, MIROpcodex86_64 inst, Reg
         Section *sec_code = code_section(context->object);
         ASSERT(sec_code, "NO CODE SECTION, WHAT HAVE YOU DONE?");
         reloc.sym.byte_offset = sec_code->data.bytes.size;
-        reloc.sym.name = strdup(name);
+        reloc.sym.name = name;
         reloc.sym.section_name = strdup(sec_code->name);
         reloc.type = RELOC_DISP32_PCREL;
         vector_push(context->object->relocs, reloc);
@@ -2046,7 +2047,7 @@ static void mcode_reg_to_name(CodegenContext *context, MIROpcodex86_64 inst, Reg
       RelocationEntry reloc = {0};
       Section *sec_code = code_section(context->object);
       reloc.sym.byte_offset = sec_code->data.bytes.size;
-      reloc.sym.name = strdup(name);
+      reloc.sym.name = name;
       reloc.sym.section_name = strdup(sec_code->name);
       reloc.type = RELOC_DISP32;
       vector_push(context->object->relocs, reloc);
@@ -2109,7 +2110,7 @@ static void mcode_name(CodegenContext *context, MIROpcodex86_64 inst, const char
     // Current offset in machine code byte buffer
     if (is_function) reloc.sym.type = GOBJ_SYMTYPE_FUNCTION;
     reloc.sym.byte_offset = sec_code->data.bytes.size;
-    reloc.sym.name = strdup(name);
+    reloc.sym.name = name;
     reloc.sym.section_name = strdup(sec_code->name);
     reloc.type = RELOC_DISP32_PCREL;
     vector_push(context->object->relocs, reloc);
@@ -2127,7 +2128,7 @@ static void mcode_name(CodegenContext *context, MIROpcodex86_64 inst, const char
     Section *sec_code = code_section(context->object);
     if (is_function) reloc.sym.type = GOBJ_SYMTYPE_FUNCTION;
     reloc.sym.byte_offset = sec_code->data.bytes.size;
-    reloc.sym.name = strdup(name);
+    reloc.sym.name = name;
     reloc.sym.section_name = strdup(sec_code->name);
     reloc.type = RELOC_DISP32_PCREL;
     vector_push(context->object->relocs, reloc);
@@ -2226,7 +2227,7 @@ static void mcode_jcc(CodegenContext *context, IndirectJumpType type, const char
   Section *sec_code = code_section(context->object);
   if (is_function) reloc.sym.type = GOBJ_SYMTYPE_FUNCTION;
   reloc.sym.byte_offset = sec_code->data.bytes.size;
-  reloc.sym.name = strdup(label);
+  reloc.sym.name = label;
   reloc.sym.section_name = strdup(sec_code->name);
   reloc.type = RELOC_DISP32_PCREL;
   vector_push(context->object->relocs, reloc);
@@ -2252,7 +2253,7 @@ void emit_x86_64_generic_object(CodegenContext *context, MIRFunctionVector machi
     { // Function symbol
       GObjSymbol sym = {0};
       sym.type = !ir_func_is_definition(function->origin) ? GOBJ_SYMTYPE_EXTERNAL : GOBJ_SYMTYPE_FUNCTION;
-      sym.name = strdup(function->name.data);
+      sym.name = function->name.data;
       sym.section_name = strdup(code_section(context->object)->name);
       sym.byte_offset = code_section(context->object)->data.bytes.size;
       vector_push(context->object->symbols, sym);
@@ -2295,7 +2296,7 @@ void emit_x86_64_generic_object(CodegenContext *context, MIRFunctionVector machi
       { // Block label symbol
         GObjSymbol sym = {0};
         sym.type = GOBJ_SYMTYPE_STATIC;
-        sym.name = strdup(block->name.data);
+        sym.name = block->name.data;
         sym.section_name = strdup(code_section(context->object)->name);
         sym.byte_offset = code_section(context->object)->data.bytes.size;
         vector_push(context->object->symbols, sym);
@@ -2749,7 +2750,7 @@ void emit_x86_64_generic_object(CodegenContext *context, MIRFunctionVector machi
       // relocation type.
       GObjSymbol *label_sym = NULL;
       foreach (s, context->object->symbols) {
-        if (strcmp(s->name, sym->name) == 0) {
+        if (s->name == sym->name) {
           label_sym = s;
           break;
         }
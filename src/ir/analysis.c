@@ -0,0 +1,354 @@
+#include <ir/analysis.h>
+#include <ir/ir-impl.h>
+#include <ir/ir.h>
+#include <stdlib.h>
+#include <string.h>
+
+/// ===========================================================================
+///  Helpers
+/// ===========================================================================
+#define BIT_SET(set, i) ((set)[(i) / 64] |= (u64) 1 << ((i) % 64))
+#define BIT_TEST(set, i) (((set)[(i) / 64] >> ((i) % 64)) & 1)
+
+/// Get the successors of a block. Returns the number of successors.
+static usz successors(IRBlock *b, IRBlock *succs[2]) {
+  STATIC_ASSERT(IR_COUNT == 40, "Handle all branch types");
+  IRInstruction *br = ir_terminator(b);
+  switch (ir_kind(br)) {
+    default: return 0;
+    case IR_BRANCH:
+      succs[0] = ir_dest(br);
+      return 1;
+
+    case IR_BRANCH_CONDITIONAL:
+      succs[0] = ir_then(br);
+      succs[1] = ir_else(br);
+      return 2;
+  }
+}
+
+/// ===========================================================================
+///  Predecessors
+/// ===========================================================================
+void analysis_compute_preds(IRFunction *f, Predecessors *preds) {
+  mmap_clear(*preds);
+  FOREACH_BLOCK (block, f) {
+    IRBlock *succs[2];
+    usz count = successors(block, succs);
+    for (usz i = 0; i < count; i++) mmap_insert(*preds, succs[i], block);
+  }
+}
+
+/// ===========================================================================
+///  Loops
+/// ===========================================================================
+/// Sort loops by decreasing size; a loop nested in another
+/// loop is always smaller than the loop that contains it.
+static int compare_loops(const void *a, const void *b) {
+  const Loop *la = *(Loop *const *) a;
+  const Loop *lb = *(Loop *const *) b;
+  if (la->blocks.size != lb->blocks.size) return la->blocks.size > lb->blocks.size ? -1 : 1;
+  return 0;
+}
+
+/// Add a block to a loop.
+static void loop_add_block(Loop *loop, IRBlock *b, usz words) {
+  if (!loop->members.size) {
+    vector_resize(loop->members, words);
+    memset(loop->members.data, 0, words * sizeof(u64));
+  }
+
+  BIT_SET(loop->members.data, ir_block_index(b));
+  vector_push(loop->blocks, b);
+}
+
+void analysis_compute_loops(IRFunction *f, DominatorTree *dom, LoopInfo *loops) {
+  analysis_free_loops(loops);
+
+  /// The dominator tree has numbered the blocks for us.
+  usz words = (dom->blocks.size + 63) / 64;
+
+  /// Find all back edges, i.e. edges whose target dominates their
+  /// source, and group them by header.
+  Map(IRBlock *, Loop *) by_header = {0};
+  FOREACH_BLOCK (b, f) {
+    IRBlock *succs[2];
+    usz count = successors(b, succs);
+    for (usz i = 0; i < count; i++) {
+      IRBlock *header = succs[i];
+      if (!dom_tree_dominates(dom, header, b)) continue;
+      Loop **loop = map_get_default(by_header, header);
+      if (!*loop) {
+        *loop = calloc(1, sizeof(Loop));
+        (*loop)->header = header;
+        loop_add_block(*loop, header, words);
+        vector_push(loops->loops, *loop);
+      }
+      vector_push_unique((*loop)->latches, b);
+    }
+  }
+  map_delete(by_header);
+
+  /// Collect the body of each loop by walking backwards from its
+  /// latches until we reach the header.
+  Predecessors preds = {0};
+  if (loops->loops.size) analysis_compute_preds(f, &preds);
+  IRBlockVector worklist = {0};
+  foreach_val (loop, loops->loops) {
+    foreach_val (latch, loop->latches) vector_push(worklist, latch);
+    while (worklist.size) {
+      IRBlock *b = vector_pop(worklist);
+      if (loop_contains(loop, b)) continue;
+
+      /// Blocks that the header doesn’t dominate are unreachable.
+      if (!dom_tree_dominates(dom, loop->header, b)) continue;
+      loop_add_block(loop, b, words);
+      MapValue(preds) *p = map_get(preds, b);
+      if (p) foreach_val (pred, *p) vector_push(worklist, pred);
+    }
+  }
+  vector_delete(worklist);
+  mmap_delete(preds);
+
+  /// Outer loops are larger than the loops nested in them, so if we
+  /// process loops from largest to smallest, the innermost loop that
+  /// we’ve seen so far for a block is its parent.
+  if (loops->loops.size > 1) qsort(loops->loops.data, loops->loops.size, sizeof(Loop *), compare_loops);
+  foreach_val (loop, loops->loops) {
+    Loop **parent = map_get(loops->innermost, loop->header);
+    loop->parent = parent ? *parent : NULL;
+    loop->depth = loop->parent ? loop->parent->depth + 1 : 1;
+    foreach_val (b, loop->blocks) map_set(loops->innermost, b, loop);
+  }
+}
+
+Loop *loop_of(LoopInfo *loops, IRBlock *b) {
+  Loop **loop = map_get(loops->innermost, b);
+  return loop ? *loop : NULL;
+}
+
+bool loop_contains(Loop *loop, IRBlock *b) {
+  /// Don’t use `ir_block_index()` here: passes may add blocks to the
+  /// function while they still use the loops, which makes the index
+  /// of every block after them stale, but the bit sets still use the
+  /// old indices. New blocks have no index and are never found.
+  u32 idx = b->index;
+  return idx / 64 < loop->members.size && BIT_TEST(loop->members.data, idx);
+}
+
+IRBlock *loop_preheader(Loop *loop, Predecessors *preds) {
+  IRBlock *preheader = NULL;
+  foreach_val (p, *map_get(*preds, loop->header)) {
+    if (loop_contains(loop, p)) continue;
+    if (preheader) return NULL;
+    preheader = p;
+  }
+
+  if (!preheader || ir_kind(ir_terminator(preheader)) != IR_BRANCH) return NULL;
+  return preheader;
+}
+
+void analysis_free_loops(LoopInfo *loops) {
+  foreach_val (loop, loops->loops) {
+    vector_delete(loop->blocks);
+    vector_delete(loop->members);
+    vector_delete(loop->latches);
+    free(loop);
+  }
+  vector_clear(loops->loops);
+  map_clear(loops->innermost);
+}
+
+/// ===========================================================================
+///  Liveness
+/// ===========================================================================
+static u64 *live_in_set(Liveness *live, usz block) { return live->sets.data + 2 * block * live->words; }
+static u64 *live_out_set(Liveness *live, usz block) { return live->sets.data + (2 * block + 1) * live->words; }
+
+void analysis_compute_liveness(IRFunction *f, Liveness *live) {
+  analysis_free_liveness(live);
+
+  /// This only needs the operands of each instruction and the shape of
+  /// the CFG, so walk the packed form of the function.
+  IRPackedFunction p = {0};
+  ir_pack_function(f, &p);
+  usz count = ir_packed_count(&p);
+  usz blocks = ir_packed_block_count(&p);
+  usz words = live->words = (count + 63) / 64;
+  vector_resize(live->sets, 2 * blocks * words);
+  if (live->sets.size) memset(live->sets.data, 0, live->sets.size * sizeof(u64));
+
+  /// Compute the upward-exposed uses (gen) and the definitions (kill)
+  /// of each block. PHIs are defined at the start of their block; their
+  /// arguments are handled when computing the live-out sets.
+  Vector(u64) gen_kill = {0};
+  vector_resize(gen_kill, 2 * blocks * words);
+  if (gen_kill.size) memset(gen_kill.data, 0, gen_kill.size * sizeof(u64));
+  for (usz b = 0; b < blocks; b++) {
+    map_set(live->block_index, f->blocks.data[b], b);
+    u64 *gen = gen_kill.data + 2 * b * words;
+    u64 *kill = gen_kill.data + (2 * b + 1) * words;
+    for (u32 i = p.blocks_begin.data[b]; i < p.blocks_begin.data[b + 1]; i++) {
+      if (p.kinds.data[i] != IR_PHI) {
+        FOREACH_PACKED_OPERAND (op, &p, i)
+          if (*op != IR_NO_INDEX && !BIT_TEST(kill, *op)) BIT_SET(gen, *op);
+      }
+      BIT_SET(kill, i);
+    }
+  }
+
+  /// Iterate to a fixpoint. Liveness flows backwards, so visit blocks
+  /// in reverse order to converge faster.
+  ///
+  ///   out(B) = ∪ in(S) ∪ { PHI arguments in S incoming from B }
+  ///   in(B)  = gen(B) ∪ (out(B) \ kill(B))
+  bool changed;
+  do {
+    changed = false;
+    for (usz bi = blocks; bi--;) {
+      u64 *in = live_in_set(live, bi);
+      u64 *out = live_out_set(live, bi);
+      u64 *gen = gen_kill.data + 2 * bi * words;
+      u64 *kill = gen_kill.data + (2 * bi + 1) * words;
+
+      for (usz s = 0; s < 2; s++) {
+        u32 succ = p.successors.data[2 * bi + s];
+        if (succ == IR_NO_INDEX) continue;
+        u64 *succ_in = live_in_set(live, succ);
+        for (usz w = 0; w < words; w++) out[w] |= succ_in[w];
+        for (u32 phi = p.blocks_begin.data[succ]; phi < p.blocks_begin.data[succ + 1]; phi++) {
+          if (p.kinds.data[phi] != IR_PHI) continue;
+          FOREACH_PACKED_OPERAND (arg, &p, phi)
+            if (*arg != IR_NO_INDEX && p.incoming.data[arg - p.operands.data] == bi) BIT_SET(out, *arg);
+        }
+      }
+
+      for (usz w = 0; w < words; w++) {
+        u64 new_in = gen[w] | (out[w] & ~kill[w]);
+        if (new_in != in[w]) {
+          in[w] = new_in;
+          changed = true;
+        }
+      }
+    }
+  } while (changed);
+
+  vector_delete(gen_kill);
+  ir_packed_free(&p);
+}
+
+bool liveness_live_in(Liveness *live, IRBlock *b, IRInstruction *value) {
+  usz *idx = map_get(live->block_index, b);
+  ASSERT(idx, "Block is not part of the function");
+  return BIT_TEST(live_in_set(live, *idx), ir_index(value));
+}
+
+bool liveness_live_out(Liveness *live, IRBlock *b, IRInstruction *value) {
+  usz *idx = map_get(live->block_index, b);
+  ASSERT(idx, "Block is not part of the function");
+  return BIT_TEST(live_out_set(live, *idx), ir_index(value));
+}
+
+usz liveness_live_in_count(Liveness *live, IRBlock *b) {
+  usz *idx = map_get(live->block_index, b);
+  ASSERT(idx, "Block is not part of the function");
+  u64 *in = live_in_set(live, *idx);
+  usz count = 0;
+  for (usz w = 0; w < live->words; w++) count += (usz) __builtin_popcountll(in[w]);
+  return count;
+}
+
+void analysis_free_liveness(Liveness *live) {
+  map_clear(live->block_index);
+  vector_clear(live->sets);
+  live->words = 0;
+}
+
+/// ===========================================================================
+///  Analysis Manager
+/// ===========================================================================
+/// Get the cache entry for a function.
+static FunctionAnalyses *entry(AnalysisManager *am, IRFunction *f) {
+  FunctionAnalyses **fa = map_get_default(am->functions, f);
+  if (!*fa) *fa = calloc(1, sizeof(FunctionAnalyses));
+  return *fa;
+}
+
+Predecessors *analysis_preds(AnalysisManager *am, IRFunction *f) {
+  FunctionAnalyses *fa = entry(am, f);
+  if (!(fa->valid & ANALYSIS_PREDECESSORS)) {
+    analysis_compute_preds(f, &fa->preds);
+    fa->valid |= ANALYSIS_PREDECESSORS;
+  }
+  return &fa->preds;
+}
+
+DominatorTree *analysis_dom_tree(AnalysisManager *am, IRFunction *f) {
+  FunctionAnalyses *fa = entry(am, f);
+  if (!(fa->valid & ANALYSIS_DOMINATORS)) {
+    dom_tree_free(&fa->dom);
+    fa->dom = dom_tree_build(f);
+    fa->valid |= ANALYSIS_DOMINATORS;
+  }
+  return &fa->dom;
+}
+
+LoopInfo *analysis_loops(AnalysisManager *am, IRFunction *f) {
+  FunctionAnalyses *fa = entry(am, f);
+  if (!(fa->valid & ANALYSIS_LOOPS)) {
+    analysis_compute_loops(f, analysis_dom_tree(am, f), &fa->loops);
+    fa->valid |= ANALYSIS_LOOPS;
+  }
+  return &fa->loops;
+}
+
+Liveness *analysis_liveness(AnalysisManager *am, IRFunction *f) {
+  FunctionAnalyses *fa = entry(am, f);
+  if (!(fa->valid & ANALYSIS_LIVENESS)) {
+    analysis_compute_liveness(f, &fa->liveness);
+    fa->valid |= ANALYSIS_LIVENESS;
+  }
+  return &fa->liveness;
+}
+
+MemorySSA *analysis_memory_ssa(AnalysisManager *am, IRFunction *f) {
+  FunctionAnalyses *fa = entry(am, f);
+  if (!(fa->valid & ANALYSIS_MEMORY_SSA)) {
+    memssa_free(&fa->memssa);
+    fa->memssa = memssa_build(f, analysis_dom_tree(am, f));
+    fa->valid |= ANALYSIS_MEMORY_SSA;
+  }
+  return &fa->memssa;
+}
+
+void analysis_invalidate(AnalysisManager *am, IRFunction *f, AnalysisKind preserved) {
+  FunctionAnalyses **fa = map_get(am->functions, f);
+  if (!fa) return;
+
+  /// Loops and Memory SSA are computed from the dominator tree.
+  if (!(preserved & ANALYSIS_DOMINATORS)) preserved &= ANALYSIS_ALL ^ (ANALYSIS_LOOPS | ANALYSIS_MEMORY_SSA);
+  (*fa)->valid &= preserved;
+}
+
+/// Free the analyses of a function.
+static void free_analyses(FunctionAnalyses *fa) {
+  mmap_delete(fa->preds);
+  dom_tree_free(&fa->dom);
+  analysis_free_loops(&fa->loops);
+  vector_delete(fa->loops.loops);
+  map_delete(fa->loops.innermost);
+  map_delete(fa->liveness.block_index);
+  vector_delete(fa->liveness.sets);
+  memssa_free(&fa->memssa);
+  free(fa);
+}
+
+void analysis_invalidate_all(AnalysisManager *am) {
+  map_foreach (e, am->functions) free_analyses(e->value);
+  map_clear(am->functions);
+}
+
+void analysis_manager_free(AnalysisManager *am) {
+  analysis_invalidate_all(am);
+  map_delete(am->functions);
+}
@@ -0,0 +1,161 @@
+#ifndef INTERCEPT_IR_ANALYSIS_H
+#define INTERCEPT_IR_ANALYSIS_H
+
+#include <codegen/codegen_forward.h>
+#include <ir/dom.h>
+#include <ir/memssa.h>
+#include <stdbool.h>
+#include <vector.h>
+
+/// ===========================================================================
+///  Analyses
+/// ===========================================================================
+/// Map containing the predecessors of each block.
+typedef MultiMap(IRBlock*, IRBlock*) Predecessors;
+
+/// A natural loop, i.e. a set of blocks with a single entry, the
+/// header, that dominates all blocks in the loop, and at least one
+/// back edge to the header.
+typedef struct Loop {
+  /// The header of the loop.
+  IRBlock *header;
+
+  /// All blocks in the loop, including those of nested loops. The
+  /// header is always the first block.
+  IRBlockVector blocks;
+
+  /// The same blocks as a bit set indexed by `ir_block_index()`.
+  Vector(u64) members;
+
+  /// Blocks in the loop that branch back to the header.
+  IRBlockVector latches;
+
+  /// The innermost loop that contains this loop, or NULL if this
+  /// is an outermost loop.
+  struct Loop *parent;
+
+  /// Nesting depth of the loop. Outermost loops have depth 1.
+  usz depth;
+} Loop;
+
+/// The loops of a function.
+typedef struct LoopInfo {
+  /// All loops, sorted such that outer loops come before any
+  /// loops nested in them.
+  Vector(Loop *) loops;
+
+  /// Map from blocks to the innermost loop containing them. Blocks
+  /// that are not part of any loop are not in this map.
+  Map(IRBlock *, Loop *) innermost;
+} LoopInfo;
+
+/// The SSA values that are live on entry to and on exit from
+/// each block, stored as bit sets indexed by `ir_index()`.
+///
+/// The result of a PHI counts as defined at the start of its block,
+/// and PHI arguments are live on exit from the incoming block only.
+typedef struct Liveness {
+  /// Map from blocks to their position in `sets`.
+  Map(IRBlock *, usz) block_index;
+
+  /// Live-in and live-out sets of each block, `words` each.
+  Vector(u64) sets;
+  usz words;
+} Liveness;
+
+/// Compute the predecessors of each block in a function.
+void analysis_compute_preds(IRFunction *f, Predecessors *preds);
+
+/// Find the loops of a function.
+void analysis_compute_loops(IRFunction *f, DominatorTree *dom, LoopInfo *loops);
+
+/// Compute which values are live at block boundaries. This
+/// renumbers the instructions of the function.
+void analysis_compute_liveness(IRFunction *f, Liveness *live);
+
+/// Get the innermost loop containing a block, or NULL if the
+/// block is not part of a loop.
+Loop *loop_of(LoopInfo *loops, IRBlock *b);
+
+/// Check whether a loop contains a block. This takes constant time.
+/// Blocks created after the loops were computed are never part of
+/// a loop.
+bool loop_contains(Loop *loop, IRBlock *b);
+
+/// Get the preheader of a loop, i.e. the only predecessor of the
+/// header that is not part of the loop, if it exists and branches
+/// to the header unconditionally.
+IRBlock *loop_preheader(Loop *loop, Predecessors *preds);
+
+/// Check whether a value is live on entry to or exit from a block.
+bool liveness_live_in(Liveness *live, IRBlock *b, IRInstruction *value);
+bool liveness_live_out(Liveness *live, IRBlock *b, IRInstruction *value);
+
+/// Get the number of values that are live on entry to a block.
+usz liveness_live_in_count(Liveness *live, IRBlock *b);
+
+void analysis_free_loops(LoopInfo *loops);
+void analysis_free_liveness(Liveness *live);
+
+/// ===========================================================================
+///  Analysis Manager
+/// ===========================================================================
+/// Analyses that the analysis manager can cache. These are flags
+/// so passes can specify a set of analyses that they preserve.
+typedef enum AnalysisKind {
+  ANALYSIS_NONE = 0,
+  ANALYSIS_PREDECESSORS = 1 << 0,
+  ANALYSIS_DOMINATORS = 1 << 1,
+  ANALYSIS_LOOPS = 1 << 2,
+  ANALYSIS_LIVENESS = 1 << 3,
+  ANALYSIS_MEMORY_SSA = 1 << 4,
+
+  /// Analyses that only depend on the shape of the CFG. Passes
+  /// that never add, remove, or retarget branches preserve these.
+  ANALYSIS_CFG = ANALYSIS_PREDECESSORS | ANALYSIS_DOMINATORS | ANALYSIS_LOOPS,
+  ANALYSIS_ALL = ANALYSIS_CFG | ANALYSIS_LIVENESS | ANALYSIS_MEMORY_SSA,
+} AnalysisKind;
+
+/// Cached analyses of a single function.
+typedef struct FunctionAnalyses {
+  /// Analyses that are currently up to date.
+  AnalysisKind valid;
+
+  Predecessors preds;
+  DominatorTree dom;
+  LoopInfo loops;
+  Liveness liveness;
+  MemorySSA memssa;
+} FunctionAnalyses;
+
+/// Computes analyses on demand and caches them per function until
+/// they are invalidated. A zero-initialised manager is empty.
+///
+/// Passes must call `analysis_invalidate()` after changing a function
+/// (or have the pass driver do it for them), passing the analyses
+/// they preserve. Pointers returned by the accessors are invalidated
+/// along with the analysis they point to.
+typedef struct AnalysisManager {
+  Map(IRFunction *, FunctionAnalyses *) functions;
+} AnalysisManager;
+
+/// Get an analysis of a function, computing it if need be.
+Predecessors *analysis_preds(AnalysisManager *am, IRFunction *f);
+DominatorTree *analysis_dom_tree(AnalysisManager *am, IRFunction *f);
+LoopInfo *analysis_loops(AnalysisManager *am, IRFunction *f);
+Liveness *analysis_liveness(AnalysisManager *am, IRFunction *f);
+MemorySSA *analysis_memory_ssa(AnalysisManager *am, IRFunction *f);
+
+/// Invalidate all analyses of a function except for the ones
+/// in `preserved`. An analysis is only preserved if all of the
+/// analyses it is computed from are preserved as well.
+void analysis_invalidate(AnalysisManager *am, IRFunction *f, AnalysisKind preserved);
+
+/// Invalidate all analyses of all functions. This must be called
+/// after functions are deleted or modified by interprocedural passes.
+void analysis_invalidate_all(AnalysisManager *am);
+
+/// Free all memory owned by an analysis manager.
+void analysis_manager_free(AnalysisManager *am);
+
+#endif // INTERCEPT_IR_ANALYSIS_H
@@ -1,114 +1,117 @@
 #include <ir/dom.h>
 #include <ir/ir.h>
 
-/// TODO: This implementation is brand-new, but it is already a pile of
-///       jank. It will do for now, but it should be replaced with the
-///       algorithm that also computes the loop nesting forest.
-PUSH_IGNORE_WARNING("-Wint-to-pointer-cast");
-PRAGMA_STR(GCC diagnostic ignored "-Wshadow");
- 
-typedef Vector(int) IntVector;
+typedef Vector(u32) U32Vector;
 
+/// State used while computing the dominator tree. Except for `dfnum`,
+/// all arrays are indexed by DFS number. DFS numbers start at 1; 0 is
+/// the auxiliary vertex.
 struct DomTreeComputeState {
-  IRBlockVector verts_by_id;
-  Map(IRBlock*, usz) ids_by_vert;
-
-  IRBlockVector label;
-  IRBlockVector parent;
-  IRBlockVector ancestor;
-  IRBlockVector child;
-  IRBlockVector ndfs; /// Vertex by DFS number.
-  IntVector verts_dfs;
-  IntVector semi;
-  IntVector size;
-  IRBlockVector idom;
-  Vector(IRBlockVector) pred;
-  Vector(IRBlockVector) bucket;
-  IRBlock *aux; /// ‘zero block’.
-  int n;
+  U32Vector dfnum;      /// DFS number of each block by block index; 0 if unreachable.
+  IRBlockVector vertex; /// Block by DFS number.
+  U32Vector parent;
+  U32Vector semi;
+  U32Vector label;
+  U32Vector ancestor;
+  U32Vector child;
+  U32Vector size;
+  U32Vector idom;
+  Vector(U32Vector) pred;
+  Vector(U32Vector) bucket;
+  U32Vector stack; /// Scratch space for COMPRESS.
+  u32 n;           /// Number of reachable blocks.
 };
 
-/// Get the ID of a block.
-usz block_to_id(struct DomTreeComputeState *st, IRBlock* b) {
-  return *map_get(st->ids_by_vert, b);
-}
-
-/// Map number or vertex to index.
-///
-/// This abomination of a macro is as horrible as it is because
-/// the C standard requires that, for some ungodly reason, *all*
-/// subexpressions of a _Generic selection be valid—even discarded
-/// ones.
-///
-/// But since we can’t perform member access on an integer, we have
-/// first cast it to the same type that it would have when that branch
-/// is taken. This raises a bogus warning if the type actually ends up
-/// being int, since we’re casting an int to a pointer. Since C is too
-/// stupid to acknowledge that that branch will never be taken, we
-/// suppress the warning with a pragma.
-#define AT(i) _Generic((i),                         \
-  int: i,                                           \
-  usz: i,                                           \
-  IRBlock *: ({                                     \
-     usz _id_ = (block_to_id(st, (IRBlock *) (i))); \
-     _id_;                                          \
-  })                                                \
-)
-
-#define LABEL(v) (st->label.data[AT(v)])
-#define PARENT(v) (st->parent.data[AT(v)])
-#define ANCESTOR(v) (st->ancestor.data[AT(v)])
-#define CHILD(v) (st->child.data[AT(v)])
-#define SEMI(v) (st->semi.data[AT(v)])
-#define IDOM(v) (st->idom.data[AT(v)])
-#define PRED(v) (st->pred.data[AT(v)])
-#define BUCKET(v) (st->bucket.data[AT(v)])
-#define NDFS(v) (st->ndfs.data[AT(v)])
-#define SIZE(v) (st->size.data[AT(v)])
+#define PARENT(v) (st->parent.data[v])
+#define SEMI(v) (st->semi.data[v])
+#define LABEL(v) (st->label.data[v])
+#define ANCESTOR(v) (st->ancestor.data[v])
+#define CHILD(v) (st->child.data[v])
+#define SIZE(v) (st->size.data[v])
+#define IDOM(v) (st->idom.data[v])
+#define PRED(v) (st->pred.data[v])
+#define BUCKET(v) (st->bucket.data[v])
+#define VERTEX(v) (st->vertex.data[v])
+#define DFNUM(b) (st->dfnum.data[ir_block_index(b)])
 #define COMPRESS(v) dom_compress(st, v)
 #define EVAL(v) dom_eval(st, v)
 #define LINK(v, w) dom_link(st, v, w)
-#define N0 (st->aux)
-#define N (st->n)
-
-static void dom_dfs(struct DomTreeComputeState *st, IRBlock *v) {
-#define VISIT(w)        \
-  do {                  \
-    if (SEMI(w) == 0) { \
-      PARENT(w) = v;    \
-      dom_dfs(st, w);   \
-    }                   \
-  } while (0)
-
-  SEMI(v) = N;
-  NDFS(N) = LABEL(v) = v;
-  ANCESTOR(v) = CHILD(v) = N0;
-  SIZE(v) = 1;
-  N++;
+#define N0 ((u32) 0)
 
+/// Get the successors of a block. Returns the number of successors.
+static usz dom_successors(IRBlock *b, IRBlock *succs[2]) {
   STATIC_ASSERT(IR_COUNT == 40, "Handle all branch types");
-  IRInstruction *br = ir_terminator(v);
+  IRInstruction *br = ir_terminator(b);
   switch (ir_kind(br)) {
-    default: break;
-    case IR_BRANCH: VISIT(ir_dest(br)); break;
+    default: return 0;
+    case IR_BRANCH:
+      succs[0] = ir_dest(br);
+      return 1;
+
     case IR_BRANCH_CONDITIONAL:
-      VISIT(ir_then(br));
-      VISIT(ir_else(br));
-      break;
+      succs[0] = ir_then(br);
+      succs[1] = ir_else(br);
+      return 2;
+  }
+}
+
+/// Number the blocks reachable from the root in DFS preorder and
+/// record the DFS tree. This is iterative since functions can have
+/// tens of thousands of blocks.
+static void dom_dfs(struct DomTreeComputeState *st, IRBlock *root) {
+  typedef struct { IRBlock *block; usz next_succ; } frame;
+  Vector(frame) stack = {0};
+
+#define VISIT(b, p)                    \
+  do {                                 \
+    u32 _v = ++st->n;                  \
+    DFNUM(b) = _v;                     \
+    VERTEX(_v) = (b);                  \
+    PARENT(_v) = (p);                  \
+    SEMI(_v) = LABEL(_v) = _v;         \
+    SIZE(_v) = 1;                      \
+    vector_push(stack, ((frame){b, 0})); \
+  } while (0)
+
+  VISIT(root, N0);
+  while (stack.size) {
+    frame *fr = &vector_back(stack);
+    IRBlock *succs[2];
+    usz count = dom_successors(fr->block, succs);
+    if (fr->next_succ == count) {
+      (void) vector_pop(stack);
+      continue;
+    }
+
+    IRBlock *w = succs[fr->next_succ++];
+    if (DFNUM(w) == 0) {
+      u32 v = DFNUM(fr->block);
+      VISIT(w, v);
+    }
   }
 
 #undef VISIT
+  vector_delete(stack);
 }
 
-static void dom_compress(struct DomTreeComputeState *st, IRBlock *v) {
-  if (ANCESTOR(ANCESTOR(v)) == N0) return;
-  COMPRESS(ANCESTOR(v));
-  if (SEMI(LABEL(ANCESTOR(v))) < SEMI(LABEL(v)))
-    LABEL(v) = LABEL(ANCESTOR(v));
-  ANCESTOR(v) = ANCESTOR(ANCESTOR(v));
+/// Compress the path from v to the root of its tree in the forest
+/// built by LINK. This is iterative for the same reason as dom_dfs().
+static void dom_compress(struct DomTreeComputeState *st, u32 v) {
+  vector_clear(st->stack);
+  while (ANCESTOR(ANCESTOR(v)) != N0) {
+    vector_push(st->stack, v);
+    v = ANCESTOR(v);
+  }
+
+  while (st->stack.size) {
+    v = vector_pop(st->stack);
+    if (SEMI(LABEL(ANCESTOR(v))) < SEMI(LABEL(v)))
+      LABEL(v) = LABEL(ANCESTOR(v));
+    ANCESTOR(v) = ANCESTOR(ANCESTOR(v));
+  }
 }
 
-static IRBlock *dom_eval(struct DomTreeComputeState *st, IRBlock *v) {
+static u32 dom_eval(struct DomTreeComputeState *st, u32 v) {
   if (ANCESTOR(v) == N0) return LABEL(v);
   COMPRESS(v);
   return SEMI(LABEL(ANCESTOR(v))) >= SEMI(LABEL(v))
@@ -116,8 +119,8 @@ static IRBlock *dom_eval(struct DomTreeComputeState *st, IRBlock *v) {
          : LABEL(ANCESTOR(v));
 }
 
-static void dom_link(struct DomTreeComputeState *st, IRBlock *v, IRBlock *w) {
-  IRBlock *s = w;
+static void dom_link(struct DomTreeComputeState *st, u32 v, u32 w) {
+  u32 s = w;
   while (SEMI(LABEL(w)) < SEMI(LABEL(CHILD(s)))) {
     if (SIZE(s) + SIZE(CHILD(CHILD(s))) >= 2 * SIZE(CHILD(s))) {
       ANCESTOR(CHILD(s)) = s;
@@ -131,7 +134,7 @@ static void dom_link(struct DomTreeComputeState *st, IRBlock *v, IRBlock *w) {
   LABEL(s) = LABEL(w);
   SIZE(v) += SIZE(w);
   if (SIZE(v) < 2 * SIZE(w)) {
-    IRBlock *tmp = s;
+    u32 tmp = s;
     s = CHILD(v);
     CHILD(v) = tmp;
   }
@@ -141,22 +144,29 @@ static void dom_link(struct DomTreeComputeState *st, IRBlock *v, IRBlock *w) {
   }
 }
 
-/// Compute predecessor info from a node.
-static void dom_compute_preds(struct DomTreeComputeState *st, IRBlock *v) {
-  /// Skip dummy vertex.
-  if (v == N0) return;
-  STATIC_ASSERT(IR_COUNT == 40, "Handle all branch types");
-  IRInstruction *br = ir_terminator(v);
-  switch (ir_kind(br)) {
-    default: break;
-    case IR_BRANCH:
-      vector_push(PRED(ir_dest(br)), v);
-      break;
-    case IR_BRANCH_CONDITIONAL:
-      vector_push(PRED(ir_then(br)), v);
-      vector_push(PRED(ir_else(br)), v);
-      break;
+/// Number the nodes of the dominator tree in preorder and postorder.
+static void dom_number_tree(DominatorTree *dom, IRBlock *root) {
+  typedef struct { IRBlock *block; usz next_child; } frame;
+  Vector(frame) stack = {0};
+  u32 pre = 1, post = 1;
+
+  dom->pre.data[ir_block_index(root)] = pre++;
+  vector_push(stack, ((frame){root, 0}));
+  while (stack.size) {
+    frame *fr = &vector_back(stack);
+    IRBlockVector *children = dom->children.data + ir_block_index(fr->block);
+    if (fr->next_child == children->size) {
+      dom->post.data[ir_block_index(fr->block)] = post++;
+      (void) vector_pop(stack);
+      continue;
+    }
+
+    IRBlock *c = children->data[fr->next_child++];
+    dom->pre.data[ir_block_index(c)] = pre++;
+    vector_push(stack, ((frame){c, 0}));
   }
+
+  vector_delete(stack);
 }
 
 /// Compute the dominator tree for a function.
@@ -175,109 +185,192 @@ DominatorTree dom_tree_build(IRFunction *f) {
   struct DomTreeComputeState _st = {0};
   struct DomTreeComputeState *st = &_st;
   IRBlock * const root = *ir_begin(f);
+  usz blocks = ir_number_blocks(f);
 
-  /// Collect all vertices (except for the root) and
-  /// number them. Also add in an auxiliary vertex.
-  vector_reserve(st->verts_by_id, ir_count(f));
-  vector_push(st->verts_by_id, N0);
-  FOREACH_BLOCK (v, f) {
-    /// Skip the root.
-    if (v == root) {
-      map_set(st->ids_by_vert, v, (usz)0);
-      continue;
-    }
-
-    map_set(st->ids_by_vert, v, st->verts_by_id.size);
-    vector_push(st->verts_by_id, v);
-  }
+#define ALLOC(vec, count)                                                  \
+  do {                                                                     \
+    vector_resize(vec, count);                                             \
+    if (vec.size) memset(vec.data, 0, vec.size * sizeof *vec.data);        \
+  } while (0)
 
-  /// Compute predecessors.
-  vector_resize(st->pred, st->verts_by_id.size);
-  foreach_val (v, st->verts_by_id) dom_compute_preds(st, v);
-  dom_compute_preds(st, root);
-
-  /// Initialise data structures.
-  vector_resize(st->label, st->verts_by_id.size);
-  vector_resize(st->parent, st->verts_by_id.size);
-  vector_resize(st->ancestor, st->verts_by_id.size);
-  vector_resize(st->child, st->verts_by_id.size);
-  vector_resize(st->verts_dfs, st->verts_by_id.size);
-  vector_resize(st->ndfs, st->verts_by_id.size);
-  vector_resize(st->semi, st->verts_by_id.size);
-  vector_resize(st->size, st->verts_by_id.size);
-  vector_resize(st->idom, st->verts_by_id.size);
-  vector_resize(st->bucket, st->verts_by_id.size);
-
-  foreach (v, st->label) *v = N0;
-  foreach (v, st->parent) *v = N0;
-  foreach (v, st->ancestor) *v = N0;
-  foreach (v, st->child) *v = N0;
-  foreach (v, st->idom) *v = N0;
+  /// Initialise data structures. DFS numbers go up to `blocks`, and
+  /// we need one extra entry for the auxiliary vertex.
+  ALLOC(st->dfnum, blocks);
+  ALLOC(st->vertex, blocks + 1);
+  ALLOC(st->parent, blocks + 1);
+  ALLOC(st->semi, blocks + 1);
+  ALLOC(st->label, blocks + 1);
+  ALLOC(st->ancestor, blocks + 1);
+  ALLOC(st->child, blocks + 1);
+  ALLOC(st->size, blocks + 1);
+  ALLOC(st->idom, blocks + 1);
+  ALLOC(st->pred, blocks + 1);
+  ALLOC(st->bucket, blocks + 1);
 
   /// Perform DFS.
   dom_dfs(st, root);
 
-  /// Step 1.
-  foreach_index_rev (i, st->verts_dfs) {
-    /// Skip dummy vertex.
-    if (i == 0) break;
+  /// Compute predecessors. Edges from unreachable blocks are
+  /// not part of the graph and thus ignored.
+  for (u32 v = 1; v <= st->n; v++) {
+    IRBlock *succs[2];
+    usz count = dom_successors(VERTEX(v), succs);
+    for (usz i = 0; i < count; i++) vector_push(PRED(DFNUM(succs[i])), v);
+  }
 
+  /// Step 1. Skip the root, which has DFS number 1.
+  for (u32 w = st->n; w >= 2; w--) {
     /// Compute initial semidominators.
-    IRBlock *w = NDFS(i);
-    foreach_val (v, PRED(w)) {
-      IRBlock *u = EVAL(v);
+    foreach (v, PRED(w)) {
+      u32 u = EVAL(*v);
       if (SEMI(u) < SEMI(w)) SEMI(w) = SEMI(u);
     }
 
     /// Collect buckets.
-    vector_push(BUCKET(NDFS(SEMI(w))), w);
+    vector_push(BUCKET(SEMI(w)), w);
     LINK(PARENT(w), w);
 
     /// Compute idoms for all the nodes in the bucket.
     while (BUCKET(PARENT(w)).size) {
-      IRBlock *v = vector_pop(BUCKET(PARENT(w)));
-      IRBlock *u = EVAL(v);
+      u32 v = vector_pop(BUCKET(PARENT(w)));
+      u32 u = EVAL(v);
       if (SEMI(u) < SEMI(v)) IDOM(v) = u;
       else IDOM(v) = PARENT(w);
     }
   }
 
   /// Adjust idoms.
-  foreach_index (i, st->verts_dfs) {
-    /// Skip dummy vertex.
-    if (i == 0) continue;
-    IRBlock *w = NDFS(i);
-    if (IDOM(w) != NDFS(SEMI(w))) IDOM(w) = IDOM(IDOM(w));
-  }
+  for (u32 w = 2; w <= st->n; w++)
+    if (IDOM(w) != SEMI(w)) IDOM(w) = IDOM(IDOM(w));
 
-  /// Set the immediate dominator to the root for
-  /// all nodes for which it is still N0.
-  foreach (v, st->idom) {
-    if (v == st->idom.data) *v = NULL;
-    if (*v == N0) *v = root;
+  /// Create dominator tree. Since we process vertices in DFS
+  /// order, children are added in DFS order as well.
+  DominatorTree dom = {0};
+  FOREACH_BLOCK (b, f) vector_push(dom.blocks, b);
+  ALLOC(dom.idoms, blocks);
+  ALLOC(dom.children, blocks);
+  ALLOC(dom.pre, blocks);
+  ALLOC(dom.post, blocks);
+  for (u32 w = 2; w <= st->n; w++) {
+    IRBlock *b = VERTEX(w);
+    IRBlock *idom = VERTEX(IDOM(w));
+    dom.idoms.data[ir_block_index(b)] = idom;
+    vector_push(dom.children.data[ir_block_index(idom)], b);
   }
+  dom_number_tree(&dom, root);
 
-  /// Create dominator tree.
-  DominatorTree dom = {0};
-  vector_reserve(dom.doms, st->verts_by_id.size);
-  foreach_val (v, st->verts_by_id) map_set(dom.doms, v, IDOM(v));
+#undef ALLOC
 
   /// Delete state.
-  vector_delete(st->verts_by_id);
-  vector_delete(st->label);
+  foreach (v, st->pred) vector_delete(*v);
+  foreach (v, st->bucket) vector_delete(*v);
+  vector_delete(st->dfnum);
+  vector_delete(st->vertex);
   vector_delete(st->parent);
+  vector_delete(st->semi);
+  vector_delete(st->label);
   vector_delete(st->ancestor);
   vector_delete(st->child);
-  vector_delete(st->verts_dfs);
-  vector_delete(st->ndfs);
-  vector_delete(st->semi);
   vector_delete(st->size);
   vector_delete(st->idom);
   vector_delete(st->pred);
   vector_delete(st->bucket);
+  vector_delete(st->stack);
   return dom;
 }
 
-void dom_tree_delete(DominatorTree *info) {
-  vector_delete(info->doms);
+void dom_tree_free(DominatorTree *info) {
+  foreach (v, info->children) vector_delete(*v);
+  foreach (v, info->frontiers) vector_delete(*v);
+  vector_delete(info->blocks);
+  vector_delete(info->idoms);
+  vector_delete(info->children);
+  vector_delete(info->pre);
+  vector_delete(info->post);
+  vector_delete(info->frontiers);
+  info->frontiers_computed = false;
+}
+
+/// Get the index of a block in the dominator tree.
+static usz dom_index(DominatorTree *info, IRBlock *b) {
+  usz idx = ir_block_index(b);
+  ASSERT(idx < info->blocks.size && info->blocks.data[idx] == b, "Dominator tree is out of date");
+  return idx;
+}
+
+IRBlock *dom_tree_idom(DominatorTree *info, IRBlock *b) {
+  return info->idoms.data[dom_index(info, b)];
+}
+
+bool dom_tree_dominates(DominatorTree *info, IRBlock *a, IRBlock *b) {
+  if (a == b) return true;
+  usz ai = dom_index(info, a), bi = dom_index(info, b);
+  if (!info->pre.data[ai] || !info->pre.data[bi]) return false;
+  return info->pre.data[ai] <= info->pre.data[bi] &&
+         info->post.data[bi] <= info->post.data[ai];
+}
+
+bool dom_tree_strictly_dominates(DominatorTree *info, IRBlock *a, IRBlock *b) {
+  return a != b && dom_tree_dominates(info, a, b);
+}
+
+bool dom_tree_reachable(DominatorTree *info, IRBlock *b) {
+  return info->pre.data[dom_index(info, b)] != 0;
+}
+
+IRBlockVector *dom_tree_children(DominatorTree *info, IRBlock *b) {
+  return info->children.data + dom_index(info, b);
+}
+
+/// Compute the dominance frontiers of all blocks.
+///
+/// This uses the algorithm described in (Cooper, K. D., Harvey, T. J.
+/// and Kennedy, K. (2001). ‘A Simple, Fast Dominance Algorithm’): for
+/// each edge P → B, every block on the path from P up to, but not
+/// including, the immediate dominator of B has B in its frontier.
+static void dom_compute_frontiers(DominatorTree *info) {
+  usz blocks = info->blocks.size;
+  vector_resize(info->frontiers, blocks);
+  memset(info->frontiers.data, 0, blocks * sizeof *info->frontiers.data);
+
+  /// Group edges by their target so we can avoid adding a block to
+  /// the same frontier twice by remembering which target we last
+  /// added to each frontier.
+  Vector(U32Vector) preds = {0};
+  U32Vector last = {0};
+  vector_resize(preds, blocks);
+  vector_resize(last, blocks);
+  memset(preds.data, 0, blocks * sizeof *preds.data);
+  memset(last.data, 0, blocks * sizeof *last.data);
+  foreach_index (i, info->blocks) {
+    if (!info->pre.data[i]) continue;
+    IRBlock *succs[2];
+    usz count = dom_successors(info->blocks.data[i], succs);
+    for (usz s = 0; s < count; s++) vector_push(preds.data[ir_block_index(succs[s])], (u32) i);
+  }
+
+  foreach_index (i, info->blocks) {
+    if (preds.data[i].size < 2) continue;
+    IRBlock *b = info->blocks.data[i];
+    IRBlock *idom = info->idoms.data[i];
+    foreach (p, preds.data[i]) {
+      for (IRBlock *runner = info->blocks.data[*p]; runner && runner != idom; runner = info->idoms.data[ir_block_index(runner)]) {
+        usz r = ir_block_index(runner);
+        if (last.data[r] == i + 1) break;
+        last.data[r] = (u32) i + 1;
+        vector_push(info->frontiers.data[r], b);
+      }
+    }
+  }
+
+  foreach (v, preds) vector_delete(*v);
+  vector_delete(preds);
+  vector_delete(last);
+  info->frontiers_computed = true;
+}
+
+IRBlockVector *dom_tree_frontier(DominatorTree *info, IRBlock *b) {
+  usz idx = dom_index(info, b);
+  if (!info->frontiers_computed) dom_compute_frontiers(info);
+  return info->frontiers.data + idx;
 }
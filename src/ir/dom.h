@@ -61,16 +61,65 @@
 ///                B2      B6
 ///                |
 ///                B5
-/// Depth-first search tree.
+///
+/// All per-block data is stored in arrays indexed by `ir_block_index()`,
+/// so the blocks of a function must not be changed while a dominator
+/// tree built for it is in use.
+///
+/// Blocks that are unreachable from the entry block are not part of the
+/// tree: they have no immediate dominator, no children, and dominate
+/// nothing but themselves.
 typedef struct DominatorTree {
-  /// Map from blocks to their immediate dominators.
-  IRBlockMap doms;
+  /// The blocks of the function, indexed by block index.
+  IRBlockVector blocks;
+
+  /// The immediate dominator of each block, or NULL for the
+  /// entry block and unreachable blocks.
+  IRBlockVector idoms;
+
+  /// The children of each block in the dominator tree, in DFS
+  /// order of the CFG.
+  Vector(IRBlockVector) children;
+
+  /// Preorder and postorder numbers of each block in a DFS over
+  /// the dominator tree. Numbers start at 1; unreachable blocks
+  /// have 0. These are used to answer dominance queries in
+  /// constant time.
+  Vector(u32) pre;
+  Vector(u32) post;
+
+  /// Dominance frontier of each block. These are computed the first
+  /// time they are requested; see `dom_tree_frontier()`.
+  Vector(IRBlockVector) frontiers;
+  bool frontiers_computed;
 } DominatorTree;
 
-/// Build the dominator tree of a function.
+/// Build the dominator tree of a function. This renumbers the
+/// blocks of the function.
 DominatorTree dom_tree_build(IRFunction *f);
 
 /// Free the memory used by the dominator tree.
 void dom_tree_free(DominatorTree *info);
 
+/// Get the immediate dominator of a block, or NULL if it is the
+/// entry block or unreachable.
+IRBlock *dom_tree_idom(DominatorTree *info, IRBlock *b);
+
+/// Check whether `a` dominates `b`. This takes constant time.
+bool dom_tree_dominates(DominatorTree *info, IRBlock *a, IRBlock *b);
+
+/// Check whether `a` strictly dominates `b`.
+bool dom_tree_strictly_dominates(DominatorTree *info, IRBlock *a, IRBlock *b);
+
+/// Check whether a block is reachable from the entry block.
+bool dom_tree_reachable(DominatorTree *info, IRBlock *b);
+
+/// Get the blocks that a block immediately dominates.
+IRBlockVector *dom_tree_children(DominatorTree *info, IRBlock *b);
+
+/// Get the dominance frontier of a block, i.e. the set of blocks
+/// that the block does not strictly dominate but that have a
+/// predecessor that it does dominate.
+IRBlockVector *dom_tree_frontier(DominatorTree *info, IRBlock *b);
+
 #endif // FUNCOMPILER_DOM_H
@@ -9,7 +9,8 @@ typedef struct InlineContext {
     IRFunction *callee;  /// The function called by this call.
     usz inlined_via;     /// Index into this history. -1 if root entry.
   }) history;
-  Vector(IRInstruction *) not_inlinable;
+  Map(IRInstruction *, usz) history_index; /// Latest history entry of each call.
+  Map(IRInstruction *, bool) not_inlinable;
   bool may_fail;
 } InlineContext;
 
@@ -57,7 +58,7 @@ static inline_result ir_inline_call(
   /// Handle the degenerate case of the callee being empty.
   isz count = instruction_count(callee, false);
   if (count == 0) {
-    ASSERT(call->users.size == 0, "Call to empty function cannot possibly return a value");
+    ASSERT(ir_use_count(call) == 0, "Call to empty function cannot possibly return a value");
     ir_remove(call);
     return (inline_result) {
       .changed = false,
@@ -72,11 +73,10 @@ static inline_result ir_inline_call(
   /// does, check if one of its parents is itself.
   {
     struct history_entry *e = NULL;
-    foreach_index (i, ictx->history) {
-      if (ictx->history.data[i].call == call) {
-        e = ictx->history.data + i;
-        call_history_index = i;
-      }
+    usz *index = map_get(ictx->history_index, call);
+    if (index) {
+      e = ictx->history.data + *index;
+      call_history_index = *index;
     }
 
     /// Call exists.
@@ -116,6 +116,7 @@ static inline_result ir_inline_call(
     /// anywhere—at least not in this inlining pass.
     else {
       call_history_index = ictx->history.size;
+      map_set(ictx->history_index, call, ictx->history.size);
       vector_push(
         ictx->history,
         (struct history_entry){
@@ -132,7 +133,11 @@ static inline_result ir_inline_call(
   /// Note that the call cannot be the last instruction in the
   /// block.
   IRInstructionVector after_call = {0};
-  vector_move_to(after_call, call_block->instructions, index_in_block(call) + 1);
+  while (ir_next(call)) {
+    IRInstruction *next = ir_next(call);
+    ir_unlink(next);
+    vector_push(after_call, next);
+  }
 
   /// Copy instructions from the callee into the caller, replacing
   /// any parameter references with the arguments to the call. Since
@@ -150,14 +155,14 @@ static inline_result ir_inline_call(
   vector_reserve(instructions, (usz) count);
   vector_reserve(blocks, block_count);
 
-  /// Allocate instructions separately; this is unfortunately necessary
-  /// since they will be freed separately later on. The same also applies
-  /// to the blocks, except that the first block, i.e. the block into which
-  /// we start inserting, is mapped to the block containing the call.
+  /// Allocate instructions and blocks from the context’s pools, since
+  /// they will be freed separately later on. The first block, i.e. the
+  /// block into which we start inserting, is mapped to the block
+  /// containing the call.
   vector_push(blocks, call_block);
-  for (usz i = 0; i < (usz) count; i++) vector_push(instructions, calloc(1, sizeof(IRInstruction)));
+  for (usz i = 0; i < (usz) count; i++) vector_push(instructions, ir_alloc_instruction(ctx));
   for (usz i = 1; i < block_count; i++) {
-    IRBlock *b = calloc(1, sizeof(IRBlock));
+    IRBlock *b = ir_block(ctx);
     b->function = call_block->function;
     vector_push(blocks, b);
   }
@@ -172,7 +177,7 @@ static inline_result ir_inline_call(
   u32 instruction_id = 0;
   foreach_val (block, callee->blocks) {
     block->id = block_id++;
-    foreach_val (inst, block->instructions) {
+    FOREACH_INSTRUCTION (inst, block) {
       if (inst->kind == IR_PARAMETER) {
         u32 mapped_index = (u32) ((usz) count - callee->parameters.size + inst->imm);
         inst->id = mapped_index;
@@ -185,7 +190,7 @@ static inline_result ir_inline_call(
   /// Put the arguments at the end of the instructions vector.
   foreach_index (i, call->call.arguments) {
     u32 mapped_index = (u32) ((usz) count - callee->parameters.size + i);
-    instructions.data[mapped_index] = call->call.arguments.data[i];
+    instructions.data[mapped_index] = call->call.arguments.data[i].usee;
   }
 
   /// Map an instruction or block to its replacement.
@@ -207,7 +212,7 @@ static inline_result ir_inline_call(
 
   /// Copy the instructions.
   foreach_val (block, callee->blocks) {
-    foreach_val (inst, block->instructions) {
+    FOREACH_INSTRUCTION (inst, block) {
       /// Skip parameters.
       if (inst->kind == IR_PARAMETER) continue;
 
@@ -237,7 +242,7 @@ static inline_result ir_inline_call(
           vector_push(inst->static_ref->references, copy);
           break;
 
-        STATIC_ASSERT(INTRIN_BACKEND_COUNT == 3, "Handle all backend intrinsics in inliner");
+        STATIC_ASSERT(INTRIN_BACKEND_COUNT == 4, "Handle all backend intrinsics in inliner");
         case IR_INTRINSIC:
           copy->call.intrinsic = inst->call.intrinsic;
           FALLTHROUGH;
@@ -247,11 +252,12 @@ static inline_result ir_inline_call(
           copy->call.tail_call = inst->call.tail_call;
           if (inst->call.is_indirect) copy->call.callee_instruction = MAP(inst->call.callee_instruction);
           else copy->call.callee_function = inst->call.callee_function;
-          foreach_val (arg, inst->call.arguments)
-            vector_push(copy->call.arguments, MAP(arg));
+          foreach (arg, inst->call.arguments)
+            vector_push(copy->call.arguments, (IRUse){.usee = MAP(arg->usee)});
 
           /// Record the origin of this call.
           if (inst->kind == IR_CALL) {
+            map_set(ictx->history_index, copy, ictx->history.size);
             vector_push(
               ictx->history,
               (struct history_entry){
@@ -335,11 +341,8 @@ static inline_result ir_inline_call(
           /// the function, and it’s also the only one, just set
           /// the return value and discard it.
           if (!return_block) {
-            if (block == vector_back(callee->blocks) && inst == vector_back(block->instructions)) {
-              if (inst->operand) {
-                return_value = MAP(inst->operand);
-                MAP(inst) = call; /// See below.
-              }
+            if (block == vector_back(callee->blocks) && inst == block->instructions.last) {
+              if (inst->operand) return_value = MAP(inst->operand);
 
               /// Continue because we want to drop this instruction, not insert it.
               continue;
@@ -349,7 +352,7 @@ static inline_result ir_inline_call(
             /// separate return block.
             return_block = ir_block(ctx);
             if (inst->operand) {
-              return_value = calloc(1, sizeof(IRInstruction));
+              return_value = ir_alloc_instruction(ctx);
               return_value->kind = IR_PHI;
               ir_insert_at_end(return_block, return_value);
             }
@@ -364,33 +367,25 @@ static inline_result ir_inline_call(
               .block = block,
             };
             vector_push(return_value->phi_args, new);
-
-            /// Replace ourselves with the call instruction in
-            /// the vector so uses are updated correctly later on.
-            MAP(inst) = call;
           }
         } break;
       }
 
-      /// Insert the instruction into the block.
+      /// Insert the instruction into the block. Its operands may
+      /// not have been filled in yet, but they already exist, so
+      /// we can link their uses.
       if (!ir_is_branch(copy)) inlined++;
+      ir_link_operands(copy);
       ir_insert_at_end(MAP_BLOCK(block), copy);
     }
   }
 
-  /// Fix up uses.
-  FOREACH_INSTRUCTION_IN_FUNCTION (instruction, b, callee) {
-    IRInstruction *copy = MAP(instruction);
-    foreach_val (user, instruction->users)
-      mark_used(copy, MAP(user));
-  }
+  /// The arguments of the return value PHI are only complete now.
+  if (return_block && return_value) ir_link_operands(return_value);
 
   /// Fix up the return value by replacing all uses of the
   /// call with the return value.
-  if (return_value) {
-    remove_use(return_value, call);
-    ir_replace_uses(call, return_value);
-  }
+  if (return_value) ir_replace_uses(call, return_value);
 
   /// Delete the call.
   ir_remove(call);
@@ -441,7 +436,7 @@ static inline_result ir_inline_call(
   /// Free unused instructions.
   foreach_val (i, instructions)
     if (i != call && !i->parent_block)
-      free(i);
+      ir_release_instruction(ctx, i);
 
   /// Delete vectors.
   vector_delete(instructions);
@@ -465,10 +460,11 @@ static inline_result inline_calls_in_function(
 ) {
   inline_result res = {0};
   vector_clear(ictx->history);
+  map_clear(ictx->history_index);
 
 again:
   foreach_val (block, f->blocks) {
-    foreach_val (inst, block->instructions) {
+    FOREACH_INSTRUCTION (inst, block) {
       /// Skip non-calls and indirect calls.
       if (inst->kind != IR_CALL) continue;
       if (inst->call.is_indirect) continue;
@@ -478,7 +474,7 @@ again:
       if (!ir_func_is_definition(callee)) continue;
 
       /// Skip calls that we’ve already determined are impossible to inline.
-      if (vector_contains(ictx->not_inlinable, inst)) continue;
+      if (map_contains(ictx->not_inlinable, inst)) continue;
 
       /// Skip noinline functions unless the user has overriden this
       /// with __builtin_inline().
@@ -507,7 +503,7 @@ again:
                 "Sorry, could not inline non-tail-recursive call"
               );
               res.failed = true;
-              vector_push(ictx->not_inlinable, inst);
+              map_set(ictx->not_inlinable, inst, true);
             }
           }
 
@@ -521,7 +517,7 @@ again:
         if (inlined.changed) res.changed = true;
         if (inlined.failed) {
           res.failed = true;
-          vector_push(ictx->not_inlinable, inst);
+          map_set(ictx->not_inlinable, inst, true);
         }
 
         /// This may have added new blocks *after* this block,
@@ -540,6 +536,7 @@ static inline_result run_inliner(CodegenContext *ctx, isz threshold, bool may_fa
   /// detection to make sure we don’t fall into an infinite loop.
   InlineContext ictx = {
     .history = {0},
+    .history_index = {0},
     .not_inlinable = {0},
     .may_fail = may_fail,
   };
@@ -552,7 +549,8 @@ static inline_result run_inliner(CodegenContext *ctx, isz threshold, bool may_fa
   }
 
   vector_delete(ictx.history);
-  vector_delete(ictx.not_inlinable);
+  map_delete(ictx.history_index);
+  map_delete(ictx.not_inlinable);
   return res;
 }
 
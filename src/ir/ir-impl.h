@@ -7,11 +7,21 @@
 /// Internal header. Do not include this in non-IR-implementation files.
 ///
 
+/// An operand of an instruction, which can be accessed as `name`,
+/// and its use, `name##_use`. See `IRUse`.
+#define IR_OPERAND(name) \
+  union {                \
+    IRInstruction *name; \
+    IRUse name##_use;    \
+  }
+
+typedef Vector(IRUse) IRUseVector;
+
 typedef struct IRCall {
-  IRInstructionVector arguments;
+  IRUseVector arguments;
   // TODO: Make this a named union!
   union {
-    IRInstruction *callee_instruction;
+    IR_OPERAND(callee_instruction);
     IRFunction *callee_function;
   };
   enum IntrinsicKind intrinsic; /// Only used by intrinsic calls.
@@ -21,7 +31,7 @@ typedef struct IRCall {
 } IRCall;
 
 typedef struct IRBranchConditional {
-  IRInstruction *condition;
+  IR_OPERAND(condition);
   IRBlock *then;
   IRBlock *else_;
 } IRBranchConditional;
@@ -31,8 +41,6 @@ typedef struct IRStackAllocation {
   usz offset;
 } IRStackAllocation;
 
-void mark_used(IRInstruction *usee, IRInstruction *user);
-
 typedef struct IRInstruction {
   enum IRType kind;
 
@@ -42,30 +50,40 @@ typedef struct IRInstruction {
   Type *type;
 
   u32 id;
-  u32 padding : 32; /// Add flags etc. here.
 
-  /// List of instructions using this instruction.
-  InstructionVector users;
+  /// Dense index in the parent function. See `ir_index()`.
+  u32 index;
+
+  /// Uses of this instruction, and the number thereof.
+  IRUse *users;
+  u32 use_count;
+
+  /// Position in the parent block. See `ir_comes_before()`.
+  u32 order;
 
   IRBlock *parent_block;
 
+  /// Neighbours in the parent block.
+  struct IRInstruction *prev;
+  struct IRInstruction *next;
+
   /// Source location of the instruction.
   loc source_location;
 
   union {
     IRBlock *destination_block;
-    IRInstruction *operand;
+    IR_OPERAND(operand);
     u64 imm;
     IRCall call;
     Vector(IRPhiArgument) phi_args;
     IRBranchConditional cond_br;
     struct {
-      IRInstruction *addr;
-      IRInstruction *value;
+      IR_OPERAND(addr);
+      IR_OPERAND(value);
     } store;
     struct {
-      IRInstruction *lhs;
-      IRInstruction *rhs;
+      IR_OPERAND(lhs);
+      IR_OPERAND(rhs);
     };
     IRStaticVariable* static_ref;
     IRFunction *function_ref;
@@ -81,9 +99,18 @@ typedef struct IRInstruction {
 /// A block is a list of instructions that have control flow enter at
 /// the beginning and leave at the end.
 typedef struct IRBlock {
-  string name;
+  string name; ///< Interned.
 
-  IRInstructionVector instructions;
+  /// The instructions in this block, as a doubly linked list.
+  struct {
+    IRInstruction *first;
+    IRInstruction *last;
+  } instructions;
+  u32 instruction_count;
+
+  /// Set if instructions were inserted without room for their order
+  /// key, in which case the block is renumbered on the next query.
+  bool stale_order;
 
   /// A pointer to the function the block is attached to, or NULL if
   /// detached.
@@ -92,6 +119,9 @@ typedef struct IRBlock {
   // Unique ID (among blocks)
   u32 id;
 
+  /// Dense index of the block. See `ir_block_index()`.
+  u32 index;
+
   // MIRBlock that was created to represent this IRBlock.
   MIRBlock *machine_block;
 
@@ -100,7 +130,7 @@ typedef struct IRBlock {
 } IRBlock;
 
 typedef struct IRFunction {
-  string name;
+  string name; ///< Interned.
 
   IRBlockVector blocks;
 
@@ -123,6 +153,12 @@ typedef struct IRFunction {
 
   usz registers_in_use;
 
+  /// Number of instructions as of the last ir_number_instructions().
+  u32 instruction_count;
+
+  /// Worklist that changed instructions are queued on, if any.
+  IRWorklist *worklist;
+
   SymbolLinkage linkage;
 
 #define def_function_attr(_, name) bool attr_##name : 1;
@@ -135,9 +171,9 @@ struct IR {
   Vector(IRFunction*) functions;
 };
 
-/// Get the index of an instruction in a block. The instruction
-/// must have a parent block.
-usz index_in_block(IRInstruction* inst);
+/// Unlink an instruction from its parent block without removing
+/// it, e.g. to move it elsewhere.
+void ir_unlink(IRInstruction *inst);
 
 /// Check if an instruction returns a value.
 bool ir_is_value(IRInstruction *instruction);
@@ -150,6 +186,13 @@ void ir_print_defun(FILE *file, IRFunction *function);
 /// instructions, so use this only when freeing the entire IR.
 void ir_free_instruction_data(IRInstruction *instruction);
 
+/// Allocate a zeroed instruction from the context’s instruction pool.
+IRInstruction *ir_alloc_instruction(CodegenContext *ctx);
+
+/// Return an instruction to the context’s instruction pool. This
+/// does not free any data owned by the instruction.
+void ir_release_instruction(CodegenContext *ctx, IRInstruction *instruction);
+
 /// Iterate over each child of an instruction.
 ///
 /// \param instruction The instruction to iterate over.
@@ -161,8 +204,10 @@ void ir_for_each_child(
     void *data
 );
 
-/// Do not use these unless you know what you’re doing.
-void mark_used(IRInstruction *usee, IRInstruction *user);
-void remove_use(IRInstruction *usee, IRInstruction *user);
+/// Link the uses of all operands of an instruction whose operands
+/// were set directly rather than through the IR API, e.g. because
+/// it was copied from another instruction. The operands must not
+/// have been linked before.
+void ir_link_operands(IRInstruction *user);
 
 #endif // INTERCEPT_IR_IMPL_H
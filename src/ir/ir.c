@@ -6,6 +6,7 @@
 #include <ir/ir.h>
 #include <platform.h>
 #include <stdlib.h>
+#include <time.h>
 #include <utils.h>
 
 //#define DEBUG_USES
@@ -45,7 +46,7 @@ CodegenContext *codegen_context_create(
     default: UNREACHABLE();
   }
 
-  context->poison = calloc(1, sizeof(IRInstruction));
+  context->poison = pool_new(&context->instruction_pool, IRInstruction);
   context->poison->kind = IR_POISON;
   context->poison->ctx = context;
 
@@ -71,17 +72,12 @@ void codegen_context_free(CodegenContext *context) {
   vector_delete(context->functions);
 
   /// Free static variables.
-  foreach_val (var, context->static_vars) {
-    free(var->name.data);
-    free(var);
-  }
+  foreach_val (var, context->static_vars) free(var);
   vector_delete(context->static_vars);
 
-  /// Free free lists.
-  foreach_val (b, context->free_blocks) free(b);
-  foreach_val (i, context->free_instructions) free(i);
-  vector_delete(context->free_blocks);
-  vector_delete(context->free_instructions);
+  /// Free all instructions and blocks.
+  pool_free(&context->instruction_pool);
+  pool_free(&context->block_pool);
 
   /// Free backend-specific data.
   STATIC_ASSERT(ARCH_COUNT == 2, "Exhaustive handling of architectures");
@@ -103,33 +99,115 @@ void codegen_context_free(CodegenContext *context) {
 /// ===========================================================================
 ///  Helper Functions
 /// ===========================================================================
-void mark_used(IRInstruction *usee, IRInstruction *user) {
-  vector_push_unique(usee->users, user);
+/// Queue an instruction on the worklist of its function, if there is one.
+static void track_change(IRInstruction *i) {
+  if (!i->parent_block || !i->parent_block->function) return;
+  IRWorklist *w = i->parent_block->function->worklist;
+  if (w) ir_worklist_push(w, i);
+}
+
+/// Add a use to the list of users of its usee.
+static void link_use(IRUse *use, IRInstruction *user) {
+  IRInstruction *usee = use->usee;
+  use->user = user;
+  use->next_user = NULL;
+  use->prev_user = NULL;
+  if (!usee) return;
+
+  /// Append to the users of the usee.
+  if (!usee->users) {
+    usee->users = use;
+    use->prev_user = use;
+  } else {
+    IRUse *last = usee->users->prev_user;
+    last->next_user = use;
+    use->prev_user = last;
+    usee->users->prev_user = use;
+  }
+
+  usee->use_count++;
+  track_change(user);
 }
 
-void remove_use(IRInstruction *usee, IRInstruction *user) {
+/// Remove a use from the list of users of its usee.
+static void unlink_use(IRUse *use) {
+  IRInstruction *usee = use->usee;
   if (!usee) return;
+  if (use == usee->users) {
+    usee->users = use->next_user;
+    if (usee->users) usee->users->prev_user = use->prev_user;
+  } else {
+    use->prev_user->next_user = use->next_user;
+    if (use->next_user) use->next_user->prev_user = use->prev_user;
+    else usee->users->prev_user = use->prev_user;
+  }
+  usee->use_count--;
 
-#ifdef DEBUG_USES
-  eprint("[Use] Removing use of %%%u in %%%u\n", usee ? -1u : usee->id, user->id);
-#endif
+  /// The usee may have become dead.
+  track_change(usee);
+}
 
-  vector_remove_element_unordered(usee->users, user);
+/// Change the value of an operand. The operand must either be linked
+/// or empty.
+static void set_operand(IRInstruction *user, IRUse *use, IRInstruction *value) {
+  if (use->usee == value && use->user == user) return;
+  unlink_use(use);
+  use->usee = value;
+  link_use(use, user);
 }
 
-static void ir_internal_unmark_usee(IRInstruction *user, IRInstruction **child, void *_) {
-  (void) _;
-  foreach_val (child_user, (*child)->users) {
-    if (child_user == user) {
-      vector_remove_element_unordered((*child)->users, child_user);
-      break;
-    }
-  }
+/// Operands that are stored in a vector have their uses embedded in
+/// the vector, so they must be unlinked before the vector moves them
+/// around in memory and relinked afterwards. The first member of each
+/// element must be the use.
+#define unlink_operands(vec, first)                         \
+  for (usz _n = (first); _n < (vec).size; _n++)             \
+    unlink_use((IRUse *) ((vec).data + _n))
+
+#define link_operands(user, vec, first)                     \
+  for (usz _n = (first); _n < (vec).size; _n++)             \
+    link_use((IRUse *) ((vec).data + _n), (user))
+
+/// Insert an operand into a vector of operands.
+#define insert_operand(user, vec, index, ...)               \
+  do {                                                      \
+    usz _at = (index);                                      \
+    usz _first = (vec).size == (vec).capacity ? 0 : _at;    \
+    unlink_operands(vec, _first);                           \
+    vector_insert_index(vec, _at, __VA_ARGS__);             \
+    link_operands(user, vec, _first);                       \
+  } while (0)
+
+/// Remove an operand from a vector of operands.
+#define remove_operand(user, vec, index)                    \
+  do {                                                      \
+    usz _at = (index);                                      \
+    unlink_operands(vec, _at);                              \
+    vector_remove_index(vec, _at);                          \
+    link_operands(user, vec, _at);                          \
+  } while (0)
+
+static void link_operand_callback(IRInstruction *user, IRInstruction **child, void *data) {
+  (void) data;
+  link_use((IRUse *) child, user);
+}
+
+void ir_link_operands(IRInstruction *user) {
+  ir_for_each_child(user, link_operand_callback, NULL);
+}
+
+static void unlink_operand_callback(IRInstruction *user, IRInstruction **child, void *data) {
+  (void) user;
+  (void) data;
+  unlink_use((IRUse *) child);
 }
 
 void ir_free_instruction_data(IRInstruction *i) {
   if (!i) return;
 
+  /// Remove all uses by this instruction.
+  ir_for_each_child(i, unlink_operand_callback, NULL);
+
   STATIC_ASSERT(IR_COUNT == 40, "Handle all instruction types.");
   switch (i->kind) {
     default: break;
@@ -147,8 +225,12 @@ void ir_free_instruction_data(IRInstruction *i) {
       break;
   }
 
-  /// Free usage data.
-  vector_delete(i->users);
+  /// Any remaining users are only freed along with this instruction
+  /// if we’re freeing the entire IR, so just make sure they don’t try
+  /// to unlink themselves from it later on.
+  for (IRUse *use = i->users; use; use = use->next_user) use->usee = NULL;
+  i->users = NULL;
+  i->use_count = 0;
 }
 
 /// This implements printing a single instruction.
@@ -204,14 +286,15 @@ static void ir_emit_instruction(
       case INTRIN_BUILTIN_SYSCALL: format_to(out, "%33intrin.syscall "); break;
       case INTRIN_BUILTIN_DEBUGTRAP: format_to(out, "%33intrin.debugtrap "); break;
       case INTRIN_BUILTIN_MEMCPY: format_to(out, "%33intrin.memcpy "); break;
+      case INTRIN_BUILTIN_MEMSET: format_to(out, "%33intrin.memset "); break;
     }
 
     format_to(out, "%31(");
     bool first = true;
-    foreach_val (i, inst->call.arguments) {
+    foreach (arg, inst->call.arguments) {
       if (!first) { format_to(out, "%31, "); }
       else first = false;
-      format_to(out, "%34%%%u", i->id);
+      format_to(out, "%34%%%u", arg->usee->id);
     }
     format_to(out, "%31)");
   } break;
@@ -226,10 +309,10 @@ static void ir_emit_instruction(
     }
     format_to(out, "%31(");
     bool first = true;
-    foreach_val (i, inst->call.arguments) {
+    foreach (arg, inst->call.arguments) {
       if (!first) { format_to(out, "%31, "); }
       else first = false;
-      format_to(out, "%34%%%u", i->id);
+      format_to(out, "%34%%%u", arg->usee->id);
     }
     format_to(out, "%31)");
   } break;
@@ -322,7 +405,7 @@ static void ir_emit_instruction(
 #ifdef DEBUG_USES
   /// Print users
   format_to(out, "%m\033[60GUsers: ");
-  foreach_val (user, inst->users) {
+  FOREACH_USER (user, inst) {
     format_to(out, "%%%u, ", user->id);
   }
 #endif
@@ -330,28 +413,68 @@ static void ir_emit_instruction(
   format_to(out, "%m");
 }
 
-typedef struct {
-  IRInstruction *usee;
-  IRInstruction *replacement;
-} ir_internal_replace_use_t;
-static void ir_internal_replace_use(IRInstruction *user, IRInstruction **child, void *data) {
-  ir_internal_replace_use_t *replace = data;
+/// Spacing between the order keys of adjacent instructions after
+/// a block is renumbered; this leaves room for insertions.
+#define ORDER_STRIDE 16
 
-#ifdef DEBUG_USES
-  eprint("  Replacing uses of %%%u in %%%u with %%%u\n",
-    replace->usee->id, user->id, replace->replacement->id);
-#endif
-
-  if (user == replace->replacement) return;
-  if (*child == replace->usee) {
-    *child = replace->replacement;
-    remove_use(replace->usee, user);
-    mark_used(replace->replacement, user);
+/// Assign fresh order keys to all instructions in a block.
+static void renumber_block(Block *b) {
+  u32 order = ORDER_STRIDE;
+  for (Inst *i = b->instructions.first; i; i = i->next) {
+    i->order = order;
+    order += ORDER_STRIDE;
   }
-}
-
-usz index_in_block(Inst *inst) {
-  return (usz) (ir_it(inst) - inst->parent_block->instructions.data);
+  b->stale_order = false;
+}
+
+/// Pick an order key for an instruction that was just linked into
+/// a block. If there is no room between its neighbours, the block
+/// is renumbered lazily the next time we need to know the order.
+static void assign_order(Inst *i) {
+  Block *b = i->parent_block;
+  if (b->stale_order) return;
+  u32 lo = i->prev ? i->prev->order : 0;
+  if (!i->next) {
+    if (lo <= UINT32_MAX - ORDER_STRIDE) {
+      i->order = lo + ORDER_STRIDE;
+      return;
+    }
+  } else {
+    u32 hi = i->next->order;
+    if (hi - lo > 1) {
+      i->order = lo + (hi - lo) / 2;
+      return;
+    }
+  }
+  b->stale_order = true;
+}
+
+/// Link an instruction into a block before another instruction, or
+/// at the end of the block if `before` is NULL.
+static void link_instruction(Block *b, Inst *before, Inst *i) {
+  ASSERT(!i->parent_block, "Cannot insert instruction that is already inserted");
+  i->parent_block = b;
+  i->next = before;
+  i->prev = before ? before->prev : b->instructions.last;
+  if (i->prev) i->prev->next = i;
+  else b->instructions.first = i;
+  if (i->next) i->next->prev = i;
+  else b->instructions.last = i;
+  b->instruction_count++;
+  assign_order(i);
+  track_change(i);
+}
+
+void ir_unlink(Inst *i) {
+  Block *b = i->parent_block;
+  ASSERT(b, "Cannot unlink floating instruction");
+  if (i->prev) i->prev->next = i->next;
+  else b->instructions.first = i->next;
+  if (i->next) i->next->prev = i->prev;
+  else b->instructions.last = i->prev;
+  b->instruction_count--;
+  i->prev = i->next = NULL;
+  i->parent_block = NULL;
 }
 
 void ir_for_each_child(
@@ -393,7 +516,7 @@ void ir_for_each_child(
   case IR_INTRINSIC:
   case IR_CALL:
     if (user->call.is_indirect) callback(user, &user->call.callee_instruction, data);
-    foreach (arg, user->call.arguments) callback(user, arg, data);
+    foreach (arg, user->call.arguments) callback(user, &arg->usee, data);
     break;
 
   case IR_BRANCH_CONDITIONAL:
@@ -479,33 +602,9 @@ void ir_print_defun(FILE *file, IRFunction *f) {
 #undef F
 }
 
-/// Clean up context free list so we don’t leak memory.
-static void clean_free_list(CodegenContext *ctx) {
-  /// Clean up free blocks list.
-  if (ctx->free_blocks.size > 1000) {
-    for (usz i = 0; i < 500; i++) {
-      Block *b = vector_pop(ctx->free_blocks);
-      free(b);
-    }
-  }
-
-  /// Clean up free instructions list.
-  if (ctx->free_instructions.size > 10000) {
-    for (usz i = 0; i < 5000; i++) {
-      Inst *inst = vector_pop(ctx->free_instructions);
-      free(inst);
-    }
-  }
-}
-
-/// Free data used by a block.
-static void free_block_data(Block *block) {
-  if (block->name.size) free(block->name.data);
-}
-
 /// Delete an instruction. The `ctx` may be `NULL`.
 static void ir_remove_impl(CodegenContext *ctx, IRInstruction *i) {
-  if (i->users.size) {
+  if (i->users) {
     eprint("Cannot remove used instruction.\nInstruction:\n");
     if (i->parent_block->function) {
       ir_set_func_ids(i->parent_block->function);
@@ -518,13 +617,15 @@ static void ir_remove_impl(CodegenContext *ctx, IRInstruction *i) {
     ICE("Cannot remove used instruction.");
   }
 
-  /// Remove the instruction if it’s inserted in a block.
-  if (i->parent_block) vector_remove_element(i->parent_block->instructions, i);
-
-  /// Unmark usees.
-  ir_for_each_child(i, ir_internal_unmark_usee, NULL);
+  /// Remove the instruction if it’s inserted in a block, and make
+  /// sure we don’t try to visit it again.
+  if (i->parent_block) {
+    IRFunction *f = i->parent_block->function;
+    if (f && f->worklist) map_remove(f->worklist->queued, i);
+    ir_unlink(i);
+  }
 
-  /// Delete instruction data.
+  /// Delete instruction data. This also unmarks usees.
   ir_free_instruction_data(i);
 
   /// Don’t delete the main poison value of a context, but allow
@@ -538,15 +639,10 @@ static void ir_remove_impl(CodegenContext *ctx, IRInstruction *i) {
   /// Parameters should not be freed here.
   if (i->kind == IR_PARAMETER) return;
 
-  /// Free the instruction.
-  if (ctx) {
-    i->kind = IR_COUNT;
-    ASAN_POISON(i, sizeof(Inst));
-    vector_push(ctx->free_instructions, i);
-    clean_free_list(ctx);
-  } else {
-    free(i);
-  }
+  /// Return the instruction to the pool. If we don’t know what context
+  /// the instruction belongs to, its memory is only reclaimed once the
+  /// context is freed.
+  if (ctx) ir_release_instruction(ctx, i);
 }
 
 static void dot_print_block(FILE *file, IRBlock *block, string_buffer *sb) {
@@ -556,7 +652,7 @@ static void dot_print_block(FILE *file, IRBlock *block, string_buffer *sb) {
 
   /// Emit all instructions to a string.
   vector_clear(*sb);
-  foreach_val (i, block->instructions) {
+  FOREACH_INSTRUCTION (i, block) {
     ir_emit_instruction(sb, i, true);
     format_to(sb, "\\l");
   }
@@ -621,11 +717,12 @@ static void ir_print_dot_dj_function(IRFunction *f, FILE* file) {
 
   /// We don’t have join edges yet, so just print the
   /// dominator tree for now.
-  foreach (entry, dom.doms)
-    if (entry->value)
-      fprint(file, "    Block%p -> Block%p;\n", entry->value, entry->key);
+  foreach_val (block, f->blocks)
+    foreach_val (child, *dom_tree_children(&dom, block))
+      fprint(file, "    Block%p -> Block%p;\n", block, child);
 
   fprint(file, "}\n");
+  dom_tree_free(&dom);
   vector_delete(sb);
 }
 
@@ -656,39 +753,102 @@ static void print_dot_impl(CodegenContext *ctx, void print_dot (IRFunction *f, F
 /// ===========================================================================
 ///  Instruction Creation
 /// ===========================================================================
-NODISCARD static Inst *alloc(CodegenContext *ctx, IRType kind) {
-  Inst *inst = NULL;
+Inst *ir_alloc_instruction(CodegenContext *ctx) {
+  ASSERT(ctx, "Cannot allocate an instruction without a context");
+  Inst *i = pool_new(&ctx->instruction_pool, Inst);
+  i->index = IR_NO_INDEX;
+  return i;
+}
 
-  if (ctx && ctx->free_instructions.size) {
-    inst = vector_pop(ctx->free_instructions);
-    ASAN_UNPOISON(inst, sizeof(Inst));
-    *inst = (Inst){0};
-  } else {
-    inst = calloc(1, sizeof *inst);
-  }
+void ir_release_instruction(CodegenContext *ctx, Inst *i) {
+  pool_release(&ctx->instruction_pool, i, sizeof(Inst));
+}
 
+NODISCARD static Inst *alloc(CodegenContext *ctx, IRType kind) {
+  Inst *inst = ir_alloc_instruction(ctx);
   inst->kind = kind;
   inst->type = t_void;
   return inst;
 }
 
 NODISCARD static Block* alloc_block(CodegenContext *ctx) {
-  Block *block = NULL;
-
-  if (ctx && ctx->free_blocks.size) {
-    block = vector_pop(ctx->free_blocks);
-    ASAN_UNPOISON(block, sizeof(Block));
-    *block = (Block){0};
-  } else {
-    block = calloc(1, sizeof *block);
-  }
-
-  return block;
+  ASSERT(ctx, "Cannot allocate a block without a context");
+  Block *b = pool_new(&ctx->block_pool, Block);
+  b->index = IR_NO_INDEX;
+  return b;
 }
 
 /// Create a basic block.
 Block *ir_block(CodegenContext *ctx) { return alloc_block(ctx); }
 
+Inst *ir_clone(CodegenContext *ctx, Inst *i) {
+  Inst *copy = alloc(ctx, i->kind);
+  copy->type = i->type;
+  copy->source_location = i->source_location;
+
+  STATIC_ASSERT(IR_COUNT == 40, "Handle all instruction types.");
+  switch (i->kind) {
+    case IR_PARAMETER:
+    case IR_REGISTER:
+    case IR_POISON:
+    case IR_COUNT:
+      ICE("Cannot clone %S instruction", ir_kind_to_str(i->kind));
+
+    case IR_IMMEDIATE:
+    case IR_LIT_INTEGER:
+      copy->imm = i->imm;
+      break;
+
+    case IR_LIT_STRING:
+      copy->str = i->str;
+      copy->string_index = i->string_index;
+      break;
+
+    case IR_FUNC_REF: copy->function_ref = i->function_ref; break;
+    case IR_ALLOCA: copy->alloca = i->alloca; break;
+    case IR_UNREACHABLE: break;
+
+    case IR_STATIC_REF:
+      copy->static_ref = i->static_ref;
+      vector_push(i->static_ref->references, copy);
+      break;
+
+    case IR_INTRINSIC:
+    case IR_CALL:
+      copy->call = i->call;
+      copy->call.arguments = (IRUseVector){0};
+      foreach (arg, i->call.arguments) vector_push(copy->call.arguments, (IRUse){.usee = arg->usee});
+      break;
+
+    case IR_LOAD:
+    case IR_COPY:
+    case IR_NOT:
+    case IR_ZERO_EXTEND:
+    case IR_SIGN_EXTEND:
+    case IR_TRUNCATE:
+    case IR_BITCAST:
+    case IR_RETURN:
+      copy->operand = i->operand;
+      break;
+
+    ALL_BINARY_INSTRUCTION_CASES()
+      copy->lhs = i->lhs;
+      copy->rhs = i->rhs;
+      break;
+
+    case IR_STORE: copy->store = i->store; break;
+    case IR_BRANCH: copy->destination_block = i->destination_block; break;
+    case IR_BRANCH_CONDITIONAL: copy->cond_br = i->cond_br; break;
+
+    case IR_PHI:
+      foreach (arg, i->phi_args) vector_push(copy->phi_args, *arg);
+      break;
+  }
+
+  ir_link_operands(copy);
+  return copy;
+}
+
 /// Create a function.
 Func *ir_create_function(
   CodegenContext *ctx,
@@ -750,7 +910,7 @@ Inst *ir_create_bitcast(
   Inst *bitcast = alloc(ctx, IR_BITCAST);
   bitcast->operand = value;
   bitcast->type = to_type;
-  mark_used(value, bitcast);
+  ir_link_operands(bitcast);
   return bitcast;
 }
 
@@ -773,7 +933,7 @@ Inst *ir_create_cond_br(
   br->cond_br.condition = condition;
   br->cond_br.then = then_block;
   br->cond_br.else_ = else_block;
-  mark_used(condition, br);
+  ir_link_operands(br);
   return br;
 }
 
@@ -784,7 +944,7 @@ Inst *ir_create_copy(
   Inst *copy = alloc(ctx, IR_COPY);
   copy->operand = source;
   copy->type = source->type;
-  mark_used(source, copy);
+  ir_link_operands(copy);
   return copy;
 }
 
@@ -814,9 +974,9 @@ Inst *ir_create_int_lit(CodegenContext *ctx, usz value) {
 }
 
 Inst *ir_create_interned_str_lit(CodegenContext *ctx, usz string_index) {
-  ASSERT(string_index < ctx->ast->strings.size, "Invalid string index %Z", string_index);
+  ASSERT(string_index < ctx->ast->strings.entries.size, "Invalid string index %Z", string_index);
   Inst *s = alloc(ctx, IR_LIT_STRING);
-  s->str = ctx->ast->strings.data[string_index];
+  s->str = ctx->ast->strings.entries.data[string_index];
   s->string_index = string_index;
   return s;
 }
@@ -836,7 +996,7 @@ Inst *ir_create_load(
   Inst *load = alloc(ctx, IR_LOAD);
   load->type = type;
   load->operand = address;
-  mark_used(address, load);
+  ir_link_operands(load);
   return load;
 }
 
@@ -847,12 +1007,25 @@ IRInstruction *ir_create_memcpy(
   IRInstruction *size
 ) {
   IRInstruction *call = ir_create_intrinsic(context, t_void, INTRIN_BUILTIN_MEMCPY);
-  vector_push(call->call.arguments, dest);
-  vector_push(call->call.arguments, src);
-  vector_push(call->call.arguments, size);
-  mark_used(dest, call);
-  mark_used(src, call);
-  mark_used(size, call);
+  vector_push(call->call.arguments, (IRUse){.usee = dest});
+  vector_push(call->call.arguments, (IRUse){.usee = src});
+  vector_push(call->call.arguments, (IRUse){.usee = size});
+  ir_link_operands(call);
+  return call;
+}
+
+IRInstruction *ir_create_memset(
+  CodegenContext *context,
+  IRInstruction *dest,
+  IRInstruction *value,
+  IRInstruction *size
+) {
+  ASSERT(type_sizeof(ir_typeof(value)) == 1, "Memset value must be a byte");
+  IRInstruction *call = ir_create_intrinsic(context, t_void, INTRIN_BUILTIN_MEMSET);
+  vector_push(call->call.arguments, (IRUse){.usee = dest});
+  vector_push(call->call.arguments, (IRUse){.usee = value});
+  vector_push(call->call.arguments, (IRUse){.usee = size});
+  ir_link_operands(call);
   return call;
 }
 
@@ -864,7 +1037,7 @@ Inst *ir_create_not(
   Inst *not = alloc(ctx, IR_NOT);
   not->operand = op;
   not->type = op->type;
-  mark_used(op, not);
+  ir_link_operands(not);
   return not;
 }
 
@@ -893,7 +1066,7 @@ Inst *ir_create_return(
 ) {
   Inst *ret = alloc(ctx, IR_RETURN);
   ret->operand = retval;
-  if (retval) mark_used(retval, ret);
+  ir_link_operands(ret);
   return ret;
 }
 
@@ -905,7 +1078,7 @@ Inst *ir_create_sext(
   Inst *sext = alloc(ctx, IR_SIGN_EXTEND);
   sext->type = result_type;
   sext->operand = value;
-  mark_used(value, sext);
+  ir_link_operands(sext);
   return sext;
 }
 
@@ -942,8 +1115,7 @@ Inst *ir_create_store(
   Inst *store = alloc(ctx, IR_STORE);
   store->store.addr = address;
   store->store.value = data;
-  mark_used(address, store);
-  mark_used(data, store);
+  ir_link_operands(store);
   return store;
 }
 
@@ -955,7 +1127,7 @@ Inst *ir_create_trunc(
   Inst *trunc = alloc(ctx, IR_TRUNCATE);
   trunc->type = result_type;
   trunc->operand = value;
-  mark_used(value, trunc);
+  ir_link_operands(trunc);
   return trunc;
 }
 
@@ -971,7 +1143,7 @@ Inst *ir_create_zext(
   Inst *zext = alloc(ctx, IR_ZERO_EXTEND);
   zext->type = result_type;
   zext->operand = value;
-  mark_used(value, zext);
+  ir_link_operands(zext);
   return zext;
 }
 
@@ -981,8 +1153,7 @@ Inst *ir_create_zext(
     x->type = lhs->type;                                              \
     x->lhs = lhs;                                                     \
     x->rhs = rhs;                                                     \
-    mark_used(lhs, x);                                                \
-    mark_used(rhs, x);                                                \
+    ir_link_operands(x);                                              \
     return x;                                                         \
   }
 
@@ -993,8 +1164,7 @@ Inst *ir_create_zext(
     x->type = t_integer;                                              \
     x->lhs = lhs;                                                     \
     x->rhs = rhs;                                                     \
-    mark_used(lhs, x);                                                \
-    mark_used(rhs, x);                                                \
+    ir_link_operands(x);                                              \
     return x;                                                         \
   }
 
@@ -1043,12 +1213,7 @@ Inst *ir_insert_after(
   Inst *instruction
 ) {
   ASSERT(after->parent_block, "Cannot insert after floating instruction");
-  ASSERT(!instruction->parent_block, "Cannot insert instruction that is already inserted");
-  Inst **it = vector_find_if(el, after->parent_block->instructions, *el == after);
-
-  ASSERT(it, "Instruction not found in parent block");
-  vector_insert(after->parent_block->instructions, it + 1, instruction);
-  instruction->parent_block = after->parent_block;
+  link_instruction(after->parent_block, after->next, instruction);
   return instruction;
 }
 
@@ -1065,8 +1230,7 @@ Inst *ir_force_insert_at_end(
   Block *block,
   Inst *instruction
 ) {
-  vector_push(block->instructions, instruction);
-  instruction->parent_block = block;
+  link_instruction(block, NULL, instruction);
   return instruction;
 }
 
@@ -1076,15 +1240,75 @@ Inst *ir_insert_before(
   Inst *instruction
 ) {
   ASSERT(before->parent_block, "Cannot insert before floating instruction");
-  ASSERT(!instruction->parent_block, "Cannot insert instruction that is already inserted");
-  Inst **it = vector_find_if(el, before->parent_block->instructions, *el == before);
-
-  ASSERT(it, "Instruction not found in parent block");
-  vector_insert(before->parent_block->instructions, it, instruction);
-  instruction->parent_block = before->parent_block;
+  link_instruction(before->parent_block, before, instruction);
   return instruction;
 }
 
+void ir_move_before(
+  Inst *before,
+  Inst *instruction
+) {
+  ASSERT(before->parent_block, "Cannot insert before floating instruction");
+  ASSERT(before != instruction, "Cannot move instruction before itself");
+  ir_unlink(instruction);
+  link_instruction(before->parent_block, before, instruction);
+}
+
+Block *ir_block_insert_before(Block *before, Block *block) {
+  ASSERT(before->function, "Cannot insert before floating block");
+  ASSERT(!block->function, "Block is already attached to a function");
+  IRBlockVector *blocks = &before->function->blocks;
+  IRBlock **pos = vector_find_if(b, *blocks, *b == before);
+  ASSERT(pos);
+  vector_insert(*blocks, pos, block);
+  block->function = before->function;
+  return block;
+}
+
+Block *ir_block_insert_after(Block *after, Block *block) {
+  ASSERT(after->function, "Cannot insert after floating block");
+  ASSERT(!block->function, "Block is already attached to a function");
+  IRBlockVector *blocks = &after->function->blocks;
+  IRBlock **pos = vector_find_if(b, *blocks, *b == after);
+  ASSERT(pos);
+  vector_insert(*blocks, pos + 1, block);
+  block->function = after->function;
+  return block;
+}
+
+Block *ir_split_block(CodegenContext *ctx, Inst *at) {
+  Block *b = at->parent_block;
+  ASSERT(b, "Cannot split at floating instruction");
+  ASSERT(at->kind != IR_PHI, "Cannot split a block before a PHI");
+  Block *rest = ir_block_insert_after(b, ir_block(ctx));
+  while (at) {
+    Inst *next = at->next;
+    ir_unlink(at);
+    link_instruction(rest, NULL, at);
+    at = next;
+  }
+
+  /// The successors are now reached from the new block.
+  Inst *term = rest->instructions.last;
+  Block *successors[2] = {NULL, NULL};
+  if (term->kind == IR_BRANCH) successors[0] = term->destination_block;
+  if (term->kind == IR_BRANCH_CONDITIONAL) {
+    successors[0] = term->cond_br.then;
+    successors[1] = term->cond_br.else_;
+  }
+
+  for (usz n = 0; n < 2; n++)
+    if (successors[n])
+      FOREACH_INSTRUCTION (i, successors[n])
+        if (i->kind == IR_PHI)
+          foreach (arg, i->phi_args)
+            if (arg->block == b)
+              arg->block = rest;
+
+  ir_insert_at_end(b, ir_create_br(ctx, rest));
+  return rest;
+}
+
 Inst *ir_insert_alloca(CodegenContext *context, Type *type) {
   return ir_insert(context, ir_create_alloca(context, type));
 }
@@ -1172,8 +1396,7 @@ Block *ir_block_get(Func *function, usz n) {
 
 void ir_call_add_arg(Inst *call, Inst *value) {
   ASSERT(call->kind == IR_CALL || call->kind == IR_INTRINSIC);
-  vector_push(call->call.arguments, value);
-  mark_used(value, call);
+  insert_operand(call, call->call.arguments, call->call.arguments.size, (IRUse){.usee = value});
 }
 
 usz ir_call_args_count(Inst *call) {
@@ -1194,8 +1417,7 @@ Type *ir_call_callee_type(Inst *call) {
 
 void ir_call_insert_arg(Inst *call, usz n, Inst *value) {
   ASSERT(call->kind == IR_CALL || call->kind == IR_INTRINSIC);
-  vector_insert_index(call->call.arguments, n, value);
-  mark_used(value, call);
+  insert_operand(call, call->call.arguments, n, (IRUse){.usee = value});
 }
 
 bool ir_call_is_direct(Inst *call) {
@@ -1206,19 +1428,17 @@ bool ir_call_is_direct(Inst *call) {
 void ir_call_remove_arg(Inst *call, usz n) {
   ASSERT(call->kind == IR_CALL || call->kind == IR_INTRINSIC);
   ASSERT(n < call->call.arguments.size);
-  remove_use(call->call.arguments.data[n], call);
-  vector_remove_index(call->call.arguments, n);
+  remove_operand(call, call->call.arguments, n);
 }
 
 void ir_call_replace_arg(Inst *call, usz n, Inst *value) {
   ASSERT(call->kind == IR_CALL || call->kind == IR_INTRINSIC);
-  remove_use(call->call.arguments.data[n], call);
-  call->call.arguments.data[n] = value;
-  mark_used(value, call);
+  ASSERT(n < call->call.arguments.size);
+  set_operand(call, call->call.arguments.data + n, value);
 }
 
 bool ir_is_closed(Block *block) {
-  return block->instructions.size && ir_is_branch(vector_back(block->instructions));
+  return block->instructions.last && ir_is_branch(block->instructions.last);
 }
 
 Block *ir_entry_block(IRFunction *function) {
@@ -1236,8 +1456,20 @@ Func *ir_func_ref_func(Inst *func_ref) {
 }
 
 Inst *ir_inst_get(Block *block, usz n) {
-  ASSERT(n < block->instructions.size);
-  return block->instructions.data[n];
+  ASSERT(n < block->instruction_count);
+  Inst *i = block->instructions.first;
+  while (n--) i = i->next;
+  return i;
+}
+
+Inst *ir_front(Block *block) { return block->instructions.first; }
+Inst *ir_next(Inst *i) { return i->next; }
+Inst *ir_prev(Inst *i) { return i->prev; }
+
+bool ir_comes_before(Inst *a, Inst *b) {
+  ASSERT(a->parent_block && a->parent_block == b->parent_block, "Instructions must be in the same block");
+  if (a->parent_block->stale_order) renumber_block(a->parent_block);
+  return a->order < b->order;
 }
 
 bool ir_is_branch(Inst *i) {
@@ -1300,16 +1532,13 @@ void ir_phi_add_arg(Inst *phi, Block *from, Inst *value) {
   /// Replace the value if there already is an entry for that block.
   IRPhiArgument *old_arg = vector_find_if(el, phi->phi_args, el->block == from);
   if (old_arg) {
-    remove_use(old_arg->value, phi);
-    mark_used(value, phi);
-    old_arg->value = value;
+    set_operand(phi, &old_arg->use, value);
     return;
   }
 
   /// Otherwise, add a new entry.
   IRPhiArgument arg = {.block = from, .value = value};
-  vector_push(phi->phi_args, arg);
-  mark_used(value, phi);
+  insert_operand(phi, phi->phi_args, phi->phi_args.size, arg);
 }
 
 const IRPhiArgument *ir_phi_arg(Inst *phi, usz n) {
@@ -1328,8 +1557,7 @@ void ir_phi_remove_arg(Inst *phi, Block *block) {
   /// Remove the argument if it exists.
   IRPhiArgument *arg = vector_find_if(el, phi->phi_args, el->block == block);
   if (!arg) return;
-  remove_use(arg->value, phi);
-  vector_remove_index(phi->phi_args, (usz) (arg - phi->phi_args.data));
+  remove_operand(phi, phi->phi_args, (usz) (arg - phi->phi_args.data));
 }
 
 void ir_set_type(Inst *i, Type *type) {
@@ -1343,18 +1571,175 @@ IRStaticVariable *ir_static_ref_var(Inst *ref) {
 
 span ir_string_data(CodegenContext *ctx, Inst *lit) {
   ASSERT(lit->kind == IR_LIT_STRING);
-  return as_span(ctx->ast->strings.data[lit->string_index]);
+  return as_span(ctx->ast->strings.entries.data[lit->string_index]);
 }
 
-Inst *ir_terminator(Block *block) { return vector_back(block->instructions); }
+Inst *ir_terminator(Block *block) {
+  ASSERT(block->instructions.last, "Block has no terminator");
+  return block->instructions.last;
+}
 
 usz ir_use_count(Inst *i) {
-  return i->users.size;
+  return i->use_count;
 }
 
 Inst *ir_user_get(Inst *inst, usz n) {
-  ASSERT(n < inst->users.size);
-  return inst->users.data[n];
+  ASSERT(n < inst->use_count);
+  IRUse *use = inst->users;
+  while (n--) use = use->next_user;
+  return use->user;
+}
+
+static void ir_operands_callback(Inst *user, Inst **child, void *data) {
+  (void) user;
+  IRInstructionVector *ops = data;
+  vector_push_unique(*ops, *child);
+}
+
+void ir_operands(Inst *i, IRInstructionVector *ops) {
+  vector_clear(*ops);
+  ir_for_each_child(i, ir_operands_callback, ops);
+}
+
+u32 ir_index(Inst *i) {
+  ASSERT(i->parent_block && i->parent_block->function, "Instruction is not part of a function");
+  ASSERT(i->index != IR_NO_INDEX, "Instruction was created after the last ir_number_instructions()");
+  ASSERT(i->index < i->parent_block->function->instruction_count, "Stale instruction index");
+  return i->index;
+}
+
+usz ir_number_instructions(Func *f) {
+  u32 index = 0;
+  FOREACH_INSTRUCTION_IN_FUNCTION (i, b, f) i->index = index++;
+  f->instruction_count = index;
+  return index;
+}
+
+u32 ir_block_index(Block *b) {
+  ASSERT(b->function, "Block is not part of a function");
+  ASSERT(
+    b->index < b->function->blocks.size && b->function->blocks.data[b->index] == b,
+    "Stale block index"
+  );
+  return b->index;
+}
+
+usz ir_number_blocks(Func *f) {
+  foreach_index (i, f->blocks) f->blocks.data[i]->index = (u32) i;
+  return f->blocks.size;
+}
+
+static void pack_operand(Inst *user, Inst **child, void *data) {
+  IRPackedFunction *p = data;
+  Inst *value = *child;
+  bool local = value && value->parent_block && value->parent_block->function == p->function;
+  vector_push(p->operands, local ? ir_index(value) : IR_NO_INDEX);
+}
+
+void ir_pack_function(Func *f, IRPackedFunction *p) {
+  STATIC_ASSERT(IR_COUNT <= 256, "Instruction kinds must fit in a byte");
+  ir_packed_free(p);
+  p->function = f;
+
+  /// We can’t renumber the blocks here since other analyses, e.g.
+  /// loops, may still be using the old block indices.
+  Map(Block *, u32) positions = {0};
+  foreach_index (i, f->blocks) map_set(positions, f->blocks.data[i], (u32) i);
+
+  usz count = ir_number_instructions(f);
+  vector_reserve(p->instructions, count);
+  vector_reserve(p->kinds, count);
+  vector_reserve(p->types, count);
+  vector_reserve(p->locations, count);
+  vector_reserve(p->operands_begin, count + 1);
+  vector_reserve(p->blocks_begin, f->blocks.size + 1);
+  vector_reserve(p->successors, 2 * f->blocks.size);
+
+  FOREACH_BLOCK (b, f) {
+    vector_push(p->blocks_begin, (u32) p->kinds.size);
+    FOREACH_INSTRUCTION (i, b) {
+      vector_push(p->instructions, i);
+      vector_push(p->kinds, (u8) i->kind);
+      vector_push(p->types, i->type);
+      vector_push(p->locations, i->source_location);
+      vector_push(p->operands_begin, (u32) p->operands.size);
+      ir_for_each_child(i, pack_operand, p);
+
+      /// Keep `incoming` in sync with `operands`.
+      if (i->kind == IR_PHI) {
+        foreach (arg, i->phi_args) {
+          u32 *pos = map_get(positions, arg->block);
+          vector_push(p->incoming, pos ? *pos : IR_NO_INDEX);
+        }
+      }
+      while (p->incoming.size < p->operands.size) vector_push(p->incoming, IR_NO_INDEX);
+    }
+
+    u32 succs[2] = {IR_NO_INDEX, IR_NO_INDEX};
+    Inst *br = ir_terminator(b);
+    if (br && br->kind == IR_BRANCH) {
+      succs[0] = *map_get(positions, br->destination_block);
+    } else if (br && br->kind == IR_BRANCH_CONDITIONAL) {
+      succs[0] = *map_get(positions, br->cond_br.then);
+      succs[1] = *map_get(positions, br->cond_br.else_);
+    }
+    vector_push(p->successors, succs[0]);
+    vector_push(p->successors, succs[1]);
+  }
+
+  vector_push(p->operands_begin, (u32) p->operands.size);
+  vector_push(p->blocks_begin, (u32) p->kinds.size);
+  map_delete(positions);
+}
+
+usz ir_packed_size(IRPackedFunction *p) {
+  return p->instructions.size * sizeof *p->instructions.data
+       + p->kinds.size * sizeof *p->kinds.data
+       + p->types.size * sizeof *p->types.data
+       + p->locations.size * sizeof *p->locations.data
+       + p->operands_begin.size * sizeof *p->operands_begin.data
+       + p->operands.size * sizeof *p->operands.data
+       + p->incoming.size * sizeof *p->incoming.data
+       + p->blocks_begin.size * sizeof *p->blocks_begin.data
+       + p->successors.size * sizeof *p->successors.data;
+}
+
+void ir_packed_free(IRPackedFunction *p) {
+  vector_delete(p->instructions);
+  vector_delete(p->kinds);
+  vector_delete(p->types);
+  vector_delete(p->locations);
+  vector_delete(p->operands_begin);
+  vector_delete(p->operands);
+  vector_delete(p->incoming);
+  vector_delete(p->blocks_begin);
+  vector_delete(p->successors);
+  p->function = NULL;
+}
+
+void ir_worklist_push(IRWorklist *w, Inst *i) {
+  if (!i->parent_block || map_contains(w->queued, i)) return;
+  map_set(w->queued, i, true);
+  vector_push(w->items, i);
+}
+
+Inst *ir_worklist_pop(IRWorklist *w) {
+  while (w->items.size) {
+    Inst *i = vector_pop(w->items);
+    if (!map_contains(w->queued, i)) continue;
+    map_remove(w->queued, i);
+    return i;
+  }
+  return NULL;
+}
+
+void ir_worklist_delete(IRWorklist *w) {
+  vector_delete(w->items);
+  map_delete(w->queued);
+}
+
+void ir_attach_worklist(Func *f, IRWorklist *w) {
+  f->worklist = w;
 }
 
 /// ===========================================================================
@@ -1364,37 +1749,58 @@ CodegenContext *ir_context(IRFunction *func) {
   return func->context;
 }
 
+void ir_block_detach(IRBlock *block) {
+  Inst *term = block->instructions.last;
+  if (!term || (term->kind != IR_BRANCH && term->kind != IR_BRANCH_CONDITIONAL)) return;
+
+  /// Remove any incoming values from this block from PHIs in its
+  /// successors, even if they aren’t defined in this block.
+  Block *successors[2] = {term->destination_block, NULL};
+  if (term->kind == IR_BRANCH_CONDITIONAL) {
+    successors[0] = term->cond_br.then;
+    successors[1] = term->cond_br.else_;
+  }
+
+  for (usz n = 0; n < 2; n++)
+    if (successors[n])
+      FOREACH_INSTRUCTION (i, successors[n])
+        if (i->kind == IR_PHI)
+          ir_phi_remove_arg(i, block);
+
+  ir_remove(term);
+}
+
 void ir_delete_block(IRBlock *block) {
-  /// Remove all instructions from the block.
-  while (block->instructions.size) {
-    Inst* i = vector_back(block->instructions);
+  ir_block_detach(block);
 
-    /// Remove this instruction from PHIs that use it.
-    foreach_val (user, i->users)
+  /// Remove all instructions from the block.
+  IRInstructionVector phis = {0};
+  while (block->instructions.last) {
+    Inst* i = block->instructions.last;
+
+    /// Remove this instruction from PHIs that use it. Removing an
+    /// argument moves the other arguments of the PHI, so collect
+    /// the PHIs first.
+    vector_clear(phis);
+    FOREACH_USER (user, i)
       if (user->kind == IR_PHI)
-        ir_phi_remove_arg(user, block);
+        vector_push_unique(phis, user);
+    foreach_val (phi, phis) ir_phi_remove_arg(phi, block);
 
     /// Remove it from the block.
     ir_remove(i);
   }
-
-  /// Free block name if there is one.
-  free_block_data(block);
+  vector_delete(phis);
 
   /// Actually remove the block from the function.
   if (block->function)
     vector_remove_element(block->function->blocks, block);
 
-  /// Add block to free list if possible or free it otherwise.
+  /// Return the block to the pool if we know what context it belongs
+  /// to; otherwise, it is reclaimed once the context is freed.
   if (block->function) {
     CodegenContext *ctx = block->function->context;
-    ASAN_POISON(block, sizeof(Block));
-    vector_push(ctx->free_blocks, block);
-
-    /// Clean up free list a bit if its too big.
-    clean_free_list(ctx);
-  } else {
-    free(block);
+    pool_release(&ctx->block_pool, block, sizeof(Block));
   }
 }
 
@@ -1406,30 +1812,25 @@ void ir_delete_function(IRFunction *f) {
     Block *b = vector_pop(f->blocks);
 
     /// Free each instruction.
-    while (b->instructions.size) {
-      Inst *i = vector_pop(b->instructions);
+    while (b->instructions.last) {
+      Inst *i = b->instructions.last;
+      ir_unlink(i);
       if (i->kind == IR_PARAMETER) continue;
       ir_free_instruction_data(i);
-      ASAN_POISON(i, sizeof(Inst));
-      vector_push(ctx->free_instructions, i);
+      ir_release_instruction(ctx, i);
     }
 
-    /// Free the block name.
-    free_block_data(b);
-    ASAN_POISON(b, sizeof(Block));
-    vector_push(ctx->free_blocks, b);
+    pool_release(&ctx->block_pool, b, sizeof(Block));
   }
 
   /// Free each parameter instruction.
   while (f->parameters.size) {
     Inst *i = vector_pop(f->parameters);
     ir_free_instruction_data(i);
-    ASAN_POISON(i, sizeof(Inst));
-    vector_push(ctx->free_instructions, i);
+    ir_release_instruction(ctx, i);
   }
 
-  /// Free the name, params, and block list.
-  free(f->name.data);
+  /// Free the params and block list.
   vector_delete(f->parameters);
   vector_delete(f->blocks);
 
@@ -1438,52 +1839,60 @@ void ir_delete_function(IRFunction *f) {
 
   /// Remove it from the list of functions.
   vector_remove_element(ctx->functions, f);
-
-  /// Clean up free lists.
-  clean_free_list(ctx);
 }
 
 void ir_force_remove(IRInstruction *instruction) {
-  ASSERT(instruction->parent_block);
-  if (instruction->parent_block->function) {
-    ir_replace(instruction, instruction->parent_block->function->context->poison);
-  } else {
-    ir_replace(instruction, alloc(NULL, IR_POISON));
-  }
+  ASSERT(instruction->parent_block && instruction->parent_block->function);
+  ir_replace(instruction, instruction->parent_block->function->context->poison);
 }
 
 void ir_make_unreachable(IRBlock *block) {
   if (block->function) {
     foreach_val (b, block->function->blocks) {
-      foreach_val (i, b->instructions) {
+      FOREACH_INSTRUCTION (i, b) {
         if (i->kind != IR_PHI) continue;
         ir_phi_remove_arg(i, block);
       }
     }
-    ir_replace(vector_back(block->instructions), ir_create_unreachable(block->function->context));
+    ir_replace(block->instructions.last, ir_create_unreachable(block->function->context));
   } else {
-    ir_replace(vector_back(block->instructions), ir_create_unreachable(NULL));
+    ir_replace(block->instructions.last, ir_create_unreachable(NULL));
   }
 }
 
 void ir_merge_blocks(IRBlock *into, IRBlock *from) {
-  ASSERT(into->instructions.size == 0 || !ir_is_branch(vector_back(into->instructions)));
-  vector_append(into->instructions, from->instructions);
+  ASSERT(!into->instructions.last || !ir_is_branch(into->instructions.last));
+
+  /// Move the instructions over.
+  Inst *first = from->instructions.first;
+  if (first) {
+    first->prev = into->instructions.last;
+    if (into->instructions.last) into->instructions.last->next = first;
+    else into->instructions.first = first;
+    into->instructions.last = from->instructions.last;
+    into->instruction_count += from->instruction_count;
+    into->stale_order = true;
+  }
+
+  /// Clear `from` block.
+  from->instructions.first = from->instructions.last = NULL;
+  from->instruction_count = 0;
 
   /// Update all PHIs in other block that have incoming values
   /// from the `from` block to point to `into` instead.
   if (into->function)
     foreach_val (b, into->function->blocks)
-      foreach_val (i, b->instructions)
+      FOREACH_INSTRUCTION (i, b)
         if (i->kind == IR_PHI)
           foreach (arg, i->phi_args)
             if (arg->block == from)
               arg->block = into;
 
   /// Set parent of instructions to the block we’re inserting into and
-  /// collect any PHIs that need fixing.
+  /// collect any PHIs that need fixing, as well as their replacements.
   IRInstructionVector phis_to_replace = {0};
-  foreach_val (i, from->instructions) {
+  IRInstructionVector replacements = {0};
+  for (Inst *i = first; i; i = i->next) {
     i->parent_block = into;
     if (i->kind == IR_PHI) {
       /// Any PHIs that have an incoming value from the block we’re
@@ -1492,28 +1901,18 @@ void ir_merge_blocks(IRBlock *into, IRBlock *from) {
         if (arg->block != into) continue;
         ASSERT(!vector_contains(phis_to_replace, i));
         vector_push(phis_to_replace, i);
-
-        /// Remove each other value.
-        foreach (arg2, i->phi_args) {
-          if (arg2->block == from) continue;
-          remove_use(arg2->value, i);
-        }
-
-        /// Move the value we’re replacing with into first
-        /// position and skip all other arguments.
-        i->phi_args.data[0].value = arg->value;
+        vector_push(replacements, arg->value);
         break;
       }
     }
   }
 
   /// Remove any PHIs that were marked for removal.
-  foreach_val (phi, phis_to_replace)
-    ir_replace(phi, phi->phi_args.data[0].value);
+  foreach_index (n, phis_to_replace)
+    ir_replace(phis_to_replace.data[n], replacements.data[n]);
 
-  /// Clear `from` block.
-  vector_clear(from->instructions);
   vector_delete(phis_to_replace);
+  vector_delete(replacements);
 }
 
 void ir_print_instruction(
@@ -1531,7 +1930,7 @@ void ir_print_block(
   IRBlock *block
 ) {
   fprint(file, "%33bb%u%31:\n", block->id);
-  foreach_val(i, block->instructions) ir_print_instruction(file, i);
+  FOREACH_INSTRUCTION (i, block) ir_print_instruction(file, i);
   fprint(file, "%m");
 }
 
@@ -1568,6 +1967,92 @@ void ir_print_dot_dj(CodegenContext *ctx) {
   print_dot_impl(ctx, ir_print_dot_dj_function);
 }
 
+/// Walk each function this many times when benchmarking; a single
+/// walk over a small function is too short to time.
+#define BENCHMARK_ROUNDS 100
+
+/// Get the current time in nanoseconds.
+static u64 benchmark_now(void) {
+  struct timespec ts;
+  timespec_get(&ts, TIME_UTC);
+  return (u64) ts.tv_sec * 1000000000 + (u64) ts.tv_nsec;
+}
+
+static void benchmark_visit_operand(Inst *user, Inst **child, void *data) {
+  u64 *sum = data;
+  Inst *value = *child;
+  if (value && value->parent_block && value->parent_block->function == user->parent_block->function)
+    *sum += value->index;
+}
+
+void ir_print_storage_benchmark(CodegenContext *ctx) {
+  usz total_count = 0, total_objects = 0, total_packed = 0;
+  u64 total_objects_ns = 0, total_packed_ns = 0;
+  foreach_val (f, ctx->functions) {
+    if (!ir_func_is_definition(f)) continue;
+    IRPackedFunction p = {0};
+    ir_pack_function(f, &p);
+
+    /// Instructions, plus operand lists that are stored out of line.
+    usz objects = 0;
+    FOREACH_INSTRUCTION_IN_FUNCTION (i, b, f) {
+      objects += sizeof(Inst);
+      if (i->kind == IR_PHI) objects += i->phi_args.size * sizeof *i->phi_args.data;
+      if (i->kind == IR_CALL || i->kind == IR_INTRINSIC) objects += i->call.arguments.size * sizeof *i->call.arguments.data;
+    }
+
+    /// Look at the kind, type, and operands of every instruction, as
+    /// most passes do. Sum them up so neither loop can be optimised
+    /// away, and so we can check that both forms agree.
+    u64 sum_objects = 0, sum_packed = 0;
+    u64 start = benchmark_now();
+    for (usz r = 0; r < BENCHMARK_ROUNDS; r++) {
+      FOREACH_INSTRUCTION_IN_FUNCTION (i, b, f) {
+        sum_objects += (u64) i->kind + (u64) (uintptr_t) i->type;
+        ir_for_each_child(i, benchmark_visit_operand, &sum_objects);
+      }
+    }
+    u64 objects_ns = (benchmark_now() - start) / BENCHMARK_ROUNDS;
+
+    start = benchmark_now();
+    for (usz r = 0; r < BENCHMARK_ROUNDS; r++) {
+      for (u32 i = 0; i < ir_packed_count(&p); i++) {
+        sum_packed += (u64) p.kinds.data[i] + (u64) (uintptr_t) p.types.data[i];
+        FOREACH_PACKED_OPERAND (op, &p, i)
+          if (*op != IR_NO_INDEX) sum_packed += *op;
+      }
+    }
+    u64 packed_ns = (benchmark_now() - start) / BENCHMARK_ROUNDS;
+    ASSERT(sum_objects == sum_packed, "Packed function doesn’t match its instructions");
+
+    print(
+      "%S: %Z instructions, %Z bytes as objects, %Z bytes packed; walk takes %U ns as objects, %U ns packed\n",
+      ir_name(f),
+      ir_packed_count(&p),
+      objects,
+      ir_packed_size(&p),
+      objects_ns,
+      packed_ns
+    );
+
+    total_count += ir_packed_count(&p);
+    total_objects += objects;
+    total_packed += ir_packed_size(&p);
+    total_objects_ns += objects_ns;
+    total_packed_ns += packed_ns;
+    ir_packed_free(&p);
+  }
+
+  print(
+    "Total: %Z instructions, %Z bytes as objects, %Z bytes packed; walk takes %U ns as objects, %U ns packed\n",
+    total_count,
+    total_objects,
+    total_packed,
+    total_objects_ns,
+    total_packed_ns
+  );
+}
+
 void ir_remove(IRInstruction *i) {
   if (i->parent_block && i->parent_block->function) {
     ir_remove_impl(i->parent_block->function->context, i);
@@ -1595,8 +2080,7 @@ IRInstruction *ir_replace(IRInstruction *old, IRInstruction *new) {
 
   /// Insert new instruction if need be.
   if (!new->parent_block) {
-    vector_replace_element(old->parent_block->instructions, old, new);
-    new->parent_block = old->parent_block;
+    link_instruction(old->parent_block, old, new);
   }
 
   /// Replace uses.
@@ -1604,7 +2088,7 @@ IRInstruction *ir_replace(IRInstruction *old, IRInstruction *new) {
 
   /// Instruction should have no more uses.
   ASSERT(
-    old->users.size == 0,
+    old->use_count == 0,
     "Instruction should not be used anymore. Did you mean to use ir_replace_uses() instead?"
   );
 
@@ -1619,19 +2103,30 @@ void ir_replace_uses(IRInstruction *inst, IRInstruction *replacement) {
   eprint("[Use] Replacing uses of %%%u with %%%u\n", inst->id, replacement->id);
 #endif
 
-  /// Note: We need to handle the case of an instruction being 
+  /// Note: We need to handle the case of an instruction being
   /// replaced with an instruction that uses it.
-  bool used_by_replacement = vector_contains(inst->users, replacement);
-  if (used_by_replacement) remove_use(inst, replacement);
-
-  /// Replace the remaining uses.
-  while (inst->users.size) {
-    ir_internal_replace_use_t replace = { inst, replacement };
-    ir_for_each_child(inst->users.data[0], ir_internal_replace_use, &replace);
+  for (IRUse *use = inst->users, *next; use; use = next) {
+    next = use->next_user;
+    if (use->user != replacement) set_operand(use->user, use, replacement);
   }
+}
+
+typedef struct {
+  IRInstruction *(*map)(IRInstruction *operand, void *data);
+  void *data;
+} ir_internal_map_operand_t;
+static void ir_internal_map_operand(IRInstruction *user, IRInstruction **child, void *data) {
+  ir_internal_map_operand_t *m = data;
+  set_operand(user, (IRUse *) child, m->map(*child, m->data));
+}
 
-  /// Add the use by the replacement back in.
-  if (used_by_replacement) mark_used(inst, replacement);
+void ir_map_operands(
+  IRInstruction *user,
+  IRInstruction *map(IRInstruction *operand, void *data),
+  void *data
+) {
+  ir_internal_map_operand_t m = {map, data};
+  ir_for_each_child(user, ir_internal_map_operand, &m);
 }
 
 void ir_set_func_ids(IRFunction *f) {
@@ -1641,7 +2136,7 @@ void ir_set_func_ids(IRFunction *f) {
 
   foreach_val (block, f->blocks) {
     block->id = block_id++;
-    foreach_val (instruction, block->instructions) {
+    FOREACH_INSTRUCTION (instruction, block) {
         if (instruction->kind == IR_PARAMETER || !ir_is_value(instruction)) instruction->id = 0;
         else instruction->id = instruction_id++;
     }
@@ -1709,7 +2204,7 @@ NODISCARD static Inst* ir_create_call_impl(CodegenContext *ctx, bool direct, Val
   } else {
     call->call.callee_instruction = val.inst;
     call->type = ir_call_callee_type(call)->function.return_type;
-    mark_used(val.inst, call);
+    ir_link_operands(call);
   }
   return call;
 }
@@ -1755,31 +2250,21 @@ usz ir_func_regs_in_use_impl_get(Func *f) { return f->registers_in_use; }
 void ir_func_regs_in_use_impl_set(Func *f, usz n) { f->registers_in_use = n; }
 
 span ir_name_b_impl_get(Block *b) { return as_span(b->name); }
-void ir_name_b_impl_set(Block *b, string name) {
-  if (b->name.data) free(b->name.data);
-  b->name = name;
-}
+void ir_name_b_impl_set(Block *b, string name) { b->name = name; }
 
 span ir_name_f_impl_get(Func *f) { return as_span(f->name); }
-void ir_name_f_impl_set(Func *f, string name) {
-  if (f->name.data) free(f->name.data);
-  f->name = name;
-}
+void ir_name_f_impl_set(Func *f, string name) { f->name = name; }
 
 Block **ir_blocks_begin_impl(Func *f) { return f->blocks.data; }
 Block **ir_blocks_end_impl(Func *f) { return f->blocks.data + f->blocks.size; }
-Inst **ir_instructions_begin_impl(Block *b) { return b->instructions.data; }
-Inst **ir_instructions_end_impl(Block *b) { return b->instructions.data + b->instructions.size; }
-Inst **ir_users_begin_impl(Inst *i) { return i->users.data; }
-Inst **ir_users_end_impl(Inst *i) { return i->users.data + i->users.size; }
+Inst **ir_users_begin_impl(Inst *i) { return i->users ? &i->users->user : NULL; }
+Inst **ir_users_next_impl(Inst **user) {
+  IRUse *use = (IRUse *) ((char *) user - offsetof(IRUse, user));
+  return use->next_user ? &use->next_user->user : NULL;
+}
 Block *ir_parent_impl_i(Inst *i) { return i->parent_block; }
 Func *ir_parent_impl_b(Block *b) { return b->function; }
 
-Inst **ir_it_impl_i(Inst *i) {
-  ASSERT(i->parent_block);
-  return vector_find_if(el, i->parent_block->instructions, *el == i);
-}
-
 Block **ir_it_impl_b(Block *b) {
   ASSERT(b->function);
   return vector_find_if(el, b->function->blocks, *el == b);
@@ -1787,7 +2272,7 @@ Block **ir_it_impl_b(Block *b) {
 
 SymbolLinkage ir_linkage_impl_f(Func *f) { return f->linkage; }
 SymbolLinkage ir_linkage_impl_v(IRStaticVariable *var) { return var->linkage; }
-usz ir_count_impl_b(Block *b) { return b->instructions.size; }
+usz ir_count_impl_b(Block *b) { return b->instruction_count; }
 usz ir_count_impl_f(Func *f) { return f->blocks.size; }
 
 void ir_debug_iterators_impl(
@@ -1823,15 +2308,13 @@ void ir_alloca_size_impl_set(Inst *obj, usz val) {
 Inst *ir_call_arg_impl_get(Inst *i, usz n) {
   ASSERT(i->kind == IR_CALL || i->kind == IR_INTRINSIC);
   ASSERT(n < i->call.arguments.size);
-  return i->call.arguments.data[n];
+  return i->call.arguments.data[n].usee;
 }
 
 void ir_call_arg_impl_set(Inst *i, usz n, Inst *val) {
   ASSERT(i->kind == IR_CALL || i->kind == IR_INTRINSIC);
   ASSERT(n < i->call.arguments.size);
-  remove_use(i->call.arguments.data[n], i);
-  i->call.arguments.data[n] = val;
-  mark_used(val, i);
+  set_operand(i, i->call.arguments.data + n, val);
 }
 
 bool ir_call_force_inline_impl_get(Inst *obj) {
@@ -1862,8 +2345,9 @@ Value ir_callee_impl_get(Inst *call) {
 
 void ir_callee_impl_set(Inst *call, Value val, bool direct) {
   ASSERT(call->kind == IR_CALL);
-  if (call->call.is_indirect && call->call.callee_instruction)
-    remove_use(call->call.callee_instruction, call);
+  /// The callee shares storage with the callee function.
+  if (call->call.is_indirect) set_operand(call, &call->call.callee_instruction_use, NULL);
+  call->call.callee_instruction_use = (IRUse){0};
 
   if (direct) {
     call->call.is_indirect = false;
@@ -1871,9 +2355,8 @@ void ir_callee_impl_set(Inst *call, Value val, bool direct) {
     call->type = val.func->type->function.return_type;
   } else {
     call->call.is_indirect = true;
-    call->call.callee_instruction = val.inst;
+    set_operand(call, &call->call.callee_instruction_use, val.inst);
     call->type = ir_call_callee_type(call)->function.return_type;
-    mark_used(val.inst, call);
   }
 }
 
@@ -1884,9 +2367,7 @@ Inst *ir_cond_impl_get(Inst *i) {
 
 void ir_cond_impl_set(Inst *i, Inst *val) {
   ASSERT(i->kind == IR_BRANCH_CONDITIONAL);
-  remove_use(i->cond_br.condition, i);
-  i->cond_br.condition = val;
-  mark_used(val, i);
+  set_operand(i, &i->cond_br.condition_use, val);
 }
 
 Block *ir_dest_impl_get(Inst *obj) {
@@ -1941,9 +2422,7 @@ Inst *ir_lhs_impl_get(Inst *i) {
 
 void ir_lhs_impl_set(Inst *i, Inst *val) {
   assert_is_binary(i);
-  remove_use(i->lhs, i);
-  i->lhs = val;
-  mark_used(val, i);
+  set_operand(i, &i->lhs_use, val);
 }
 
 Inst *ir_operand_impl_get(Inst *i) {
@@ -1953,9 +2432,7 @@ Inst *ir_operand_impl_get(Inst *i) {
 
 void ir_operand_impl_set(Inst *i, Inst *val) {
   assert_has_operand(i);
-  if (i->operand) remove_use(i->operand, i);
-  i->operand = val;
-  mark_used(val, i);
+  set_operand(i, &i->operand_use, val);
 }
 
 Inst *ir_rhs_impl_get(Inst *i) {
@@ -1965,9 +2442,7 @@ Inst *ir_rhs_impl_get(Inst *i) {
 
 void ir_rhs_impl_set(Inst *i, Inst *val) {
   assert_is_binary(i);
-  remove_use(i->rhs, i);
-  i->rhs = val;
-  mark_used(val, i);
+  set_operand(i, &i->rhs_use, val);
 }
 
 Inst *ir_static_var_init_impl_get(IRStaticVariable *var) {
@@ -1975,9 +2450,7 @@ Inst *ir_static_var_init_impl_get(IRStaticVariable *var) {
 }
 
 void ir_static_var_init_impl_set(IRStaticVariable *var, Inst *val) {
-  if (var->init) remove_use(var->init, val);
   var->init = val;
-  mark_used(val, val);
 }
 
 Inst *ir_store_addr_impl_get(Inst *i) {
@@ -1987,9 +2460,7 @@ Inst *ir_store_addr_impl_get(Inst *i) {
 
 void ir_store_addr_impl_set(Inst *i, Inst *val) {
   ASSERT(i->kind == IR_STORE);
-  remove_use(i->store.addr, i);
-  i->store.addr = val;
-  mark_used(val, i);
+  set_operand(i, &i->store.addr_use, val);
 }
 
 Inst *ir_store_value_impl_get(Inst *i) {
@@ -1999,9 +2470,7 @@ Inst *ir_store_value_impl_get(Inst *i) {
 
 void ir_store_value_impl_set(Inst *i, Inst *val) {
   ASSERT(i->kind == IR_STORE);
-  remove_use(i->store.value, i);
-  i->store.value = val;
-  mark_used(val, i);
+  set_operand(i, &i->store.value_use, val);
 }
 
 Block *ir_then_impl_get(Inst *obj) {
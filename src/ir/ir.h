@@ -19,9 +19,38 @@ typedef enum IRType {
 } IRType;
 #undef DEFINE_IR_INSTRUCTION_TYPE
 
+/// A use of an instruction by another instruction.
+///
+/// Uses are embedded in the operand slots of their users: the first
+/// member of a use is the operand itself. Thus, there is one use per
+/// operand, and an instruction that is used twice by the same user
+/// has two uses.
+///
+/// Each use is linked into the list of users of its usee, which is
+/// doubly linked so uses can be unlinked in constant time. Changing
+/// an operand just moves its use from one list to another.
+///
+/// Uses are managed by the IR API; do not modify them directly.
+typedef struct IRUse {
+  /// The instruction being used. This must be the first member.
+  IRInstruction *usee;
+
+  /// The instruction whose operand this is.
+  IRInstruction *user;
+
+  /// Next use of the usee. The `prev_user` of the first use in
+  /// the list points to the last use.
+  struct IRUse *next_user;
+  struct IRUse *prev_user;
+} IRUse;
+
 typedef struct IRPhiArgument {
-  /// The value of the argument itself.
-  IRInstruction *value;
+  /// The value of the argument itself, and its use. The use
+  /// must come first; see `IRUse`.
+  union {
+    IRInstruction *value;
+    IRUse use;
+  };
   /// Stores the predecessor to the Phi node in the direction of the
   /// argument assignment.
   ///    [a]
@@ -42,8 +71,8 @@ typedef union IRValue {
 /// ===========================================================================
 ///  Iterators
 /// ===========================================================================
-/// These iterator macros may not be used if you plan on inserting or deleting
-/// stuff from the range you’re iterating over.
+/// Unless stated otherwise, these iterator macros may not be used if you plan
+/// on inserting or deleting stuff from the range you’re iterating over.
 #define FOREACH_BLOCK(block, function)                                                           \
   for (IRBlock * block,                                                                          \
        ** const CAT(block, _begin_ptr) = ir_blocks_begin_impl(function),                         \
@@ -53,23 +82,27 @@ typedef union IRValue {
            CAT(block, _ptr) != CAT(block, _end_ptr) ? (block = *CAT(block, _ptr), true) : false; \
        ++CAT(block, _ptr))
 
-#define FOREACH_INSTRUCTION(inst, block)                                                     \
-  for (IRInstruction * inst,                                                                 \
-       ** const CAT(inst, _begin_ptr) = ir_instructions_begin_impl(block),                   \
-       **CAT(inst, _ptr) = CAT(inst, _begin_ptr),                                            \
-       ** const CAT(inst, _end_ptr) = ir_instructions_end_impl(block);                       \
-       DEBUG_ITERATOR(inst, block, instructions) &&                                          \
-           CAT(inst, _ptr) != CAT(inst, _end_ptr) ? (inst = *CAT(inst, _ptr), true) : false; \
-       ++CAT(inst, _ptr))
-
+/// Unlike the other iterators, this one may be used to remove, replace,
+/// or insert instructions after the current instruction. Instructions
+/// inserted after the current instruction are not visited.
+#define FOREACH_INSTRUCTION(inst, block)                                      \
+  for (IRInstruction * inst = ir_front(block),                                \
+       *CAT(inst, _next) = inst ? ir_next(inst) : NULL;                       \
+       inst;                                                                  \
+       inst = CAT(inst, _next), CAT(inst, _next) = inst ? ir_next(inst) : NULL)
+
+/// Unlike the other iterators, this one may be used to remove the
+/// current use, but not any other uses of the same instruction. Note
+/// that a user is visited once for each of its operands that refer
+/// to the instruction.
 #define FOREACH_USER(user, inst)                                                             \
   for (IRInstruction * user,                                                                 \
-       ** const CAT(user, _begin_ptr) = ir_users_begin_impl(inst),                           \
-       **CAT(user, _ptr) = CAT(user, _begin_ptr),                                            \
-       ** const CAT(user, _end_ptr) = ir_users_end_impl(inst);                               \
-       DEBUG_ITERATOR(user, inst, users) &&                                                  \
-           CAT(user, _ptr) != CAT(user, _end_ptr) ? (user = *CAT(user, _ptr), true) : false; \
-       ++CAT(user, _ptr))
+       **CAT(user, _ptr) = ir_users_begin_impl(inst),                                        \
+       **CAT(user, _next_ptr);                                                               \
+       CAT(user, _ptr)                                                                       \
+           ? (user = *CAT(user, _ptr), CAT(user, _next_ptr) = ir_users_next_impl(CAT(user, _ptr)), true) \
+           : false;                                                                          \
+       CAT(user, _ptr) = CAT(user, _next_ptr))
 
 /// Helper to detect iterator invalitation.
 #ifdef NDEBUG
@@ -127,10 +160,9 @@ typedef union IRValue {
 /// Access a function attribute.
 #define ir_attribute(func, attr, ...) IR_PROPERTY2(ir_attribute, func, attr __VA_OPT__(,) __VA_ARGS__)
 
-/// Get an iterator to the beginning of an instruction or block list.
-#define ir_begin(obj) _Generic((obj),   \
-  IRBlock*: ir_instructions_begin_impl, \
-  IRFunction*: ir_blocks_begin_impl     \
+/// Get an iterator to the beginning of a block list.
+#define ir_begin(obj) _Generic((obj), \
+  IRFunction*: ir_blocks_begin_impl   \
 )(obj)
 
 /// Access the nth argument of a call.
@@ -160,10 +192,9 @@ typedef union IRValue {
 /// Access the else branch of a conditional branch.
 #define ir_else(cond, ...) IR_PROPERTY(ir_else, cond, __VA_ARGS__)
 
-/// Get an iterator to the end of an instruction or block list.
-#define ir_end(obj) _Generic((obj),   \
-  IRBlock*: ir_instructions_end_impl, \
-  IRFunction*: ir_blocks_end_impl     \
+/// Get an iterator to the end of a block list.
+#define ir_end(obj) _Generic((obj), \
+  IRFunction*: ir_blocks_end_impl   \
 )(obj)
 
 
@@ -188,9 +219,8 @@ typedef union IRValue {
 /// Access the intrinsic kind of an intrinsic call.
 #define ir_intrinsic_kind(call, ...) IR_PROPERTY(ir_intrinsic_kind, call, __VA_ARGS__)
 
-/// Get an iterator from an instruction or block.
+/// Get an iterator from a block.
 #define ir_it(obj) _Generic((obj), \
-  IRInstruction*: ir_it_impl_i,    \
   IRBlock*: ir_it_impl_b           \
 )(obj)
 
@@ -231,7 +261,8 @@ typedef union IRValue {
     )                                            \
   )(obj __VA_OPT__(,) __VA_ARGS__)
 
-/// Access the name of a function or block.
+/// Access the name of a function or block. Names are interned
+/// identifiers; see `identifier_intern()`.
 #define ir_name(obj, ...) _Generic((VA_FIRST(__VA_ARGS__ __VA_OPT__(,) ((struct no_generic_argument*)NULL))), \
     struct no_generic_argument*: _Generic((obj), \
       IRBlock *: ir_name_b_impl_get,             \
@@ -327,9 +358,21 @@ NODISCARD bool ir_func_is_definition(IRFunction *function);
 /// Get the referenced function from a func ref.
 NODISCARD IRFunction *ir_func_ref_func(IRInstruction *func_ref);
 
-/// Get the nth instruction of a block.
+/// Get the nth instruction of a block. This is linear in `n`.
 NODISCARD IRInstruction *ir_inst_get(IRBlock *block, usz n);
 
+/// Get the first instruction of a block, or NULL if it is empty.
+NODISCARD IRInstruction *ir_front(IRBlock *block);
+
+/// Get the next or previous instruction in the same block, or
+/// NULL if there is none.
+NODISCARD IRInstruction *ir_next(IRInstruction *inst);
+NODISCARD IRInstruction *ir_prev(IRInstruction *inst);
+
+/// Check whether `a` comes before `b`. Both instructions must be
+/// in the same block. This takes amortised constant time.
+NODISCARD bool ir_comes_before(IRInstruction *a, IRInstruction *b);
+
 /// Check if an instruction is a branch instruction.
 NODISCARD bool ir_is_branch(IRInstruction* i);
 
@@ -384,19 +427,168 @@ NODISCARD span ir_string_data(CodegenContext *ctx, IRInstruction *lit);
 NODISCARD IRInstruction *ir_terminator(IRBlock *block);
 
 /// Get the use count of an instruction, i.e. how often an
-/// instruction is used by other instructions.
+/// instruction is used by other instructions. A user that has
+/// the instruction as several operands counts once per operand.
 NODISCARD usz ir_use_count(IRInstruction *i);
 
 /// Get the nth user of an instruction.
 NODISCARD IRInstruction *ir_user_get(IRInstruction *inst, usz n);
 
+/// Collect the operands of an instruction into `ops`, which is
+/// cleared first. Operands that are used several times are only
+/// added once.
+void ir_operands(IRInstruction *i, IRInstructionVector *ops);
+
+/// A queue of instructions that need to be looked at (again).
+///
+/// While a worklist is attached to a function, every instruction of
+/// that function that is inserted, or whose operands or users change,
+/// is queued automatically, and instructions that are deleted are
+/// dropped from it. This lets passes that simplify instructions one
+/// at a time pick up where other passes changed something instead of
+/// rescanning the entire function.
+typedef struct IRWorklist {
+  IRInstructionVector items;
+
+  /// Instructions that are currently queued. Entries in `items`
+  /// that are not in here have been deleted and are skipped.
+  Map(IRInstruction *, bool) queued;
+} IRWorklist;
+
+/// Queue an instruction if it isn’t queued already. Instructions
+/// that are not inserted in a block are ignored.
+void ir_worklist_push(IRWorklist *w, IRInstruction *i);
+
+/// Dequeue the instruction that was queued last.
+///
+/// \return The instruction, or NULL if the worklist is empty.
+NODISCARD IRInstruction *ir_worklist_pop(IRWorklist *w);
+
+/// Free a worklist. This does not detach it from any function.
+void ir_worklist_delete(IRWorklist *w);
+
+/// Attach a worklist to a function, or detach it if `w` is NULL.
+void ir_attach_worklist(IRFunction *f, IRWorklist *w);
+
+/// Index of an instruction or block that was created after its
+/// function was last numbered.
+#define IR_NO_INDEX ((u32) -1)
+
+/// Get the index of an instruction in its function.
+///
+/// Indices are dense and start at 0, so they can be used to look up
+/// per-instruction data in an `IRInstructionTable` rather than in a
+/// map, or in the arrays of an `IRPackedFunction`. Indices are only valid
+/// after calling `ir_number_instructions()` and until instructions are
+/// added to or moved between functions. Instructions created since
+/// then don’t have an index.
+NODISCARD u32 ir_index(IRInstruction *i);
+
+/// Assign dense indices to all instructions in a function.
+///
+/// \return The number of instructions in the function.
+usz ir_number_instructions(IRFunction *f);
+
+/// Get the index of a block in its function.
+///
+/// Like instruction indices, these are dense and start at 0. They are
+/// only valid after calling `ir_number_blocks()` and until blocks are
+/// added to, removed from, or reordered in the function.
+NODISCARD u32 ir_block_index(IRBlock *b);
+
+/// Assign dense indices to all blocks in a function.
+///
+/// \return The number of blocks in the function.
+usz ir_number_blocks(IRFunction *f);
+
+/// A table that stores a value for each instruction in a function,
+/// indexed by `ir_index()`.
+#define IRInstructionTable(type) Vector(type)
+
+/// Number the instructions in a function and create a zero-initialised
+/// table with one entry per instruction.
+#define ir_instruction_table_init(table, f)                             \
+  do {                                                                  \
+    usz _count = ir_number_instructions(f);                             \
+    vector_clear(table);                                                \
+    vector_resize((table), _count);                                     \
+    if (_count) memset((table).data, 0, _count * sizeof *(table).data); \
+  } while (0)
+
+/// Access the entry of an instruction in an `IRInstructionTable`.
+#define ir_instruction_table_get(table, inst) ((table).data[ir_index(inst)])
+
+/// A function whose instructions are stored as parallel arrays rather
+/// than as individual objects. Instructions are referred to by their
+/// 32-bit `ir_index()`, and blocks by their position in the function.
+///
+/// This is a read-only copy of the function: passes that only need to
+/// look at the IR, such as analyses, can walk these arrays instead of
+/// chasing pointers. It becomes stale as soon as the function changes;
+/// use `instructions` to get back to the instruction to change.
+typedef struct IRPackedFunction {
+  IRFunction *function;
+
+  /// Per instruction.
+  IRInstructionVector instructions;
+  Vector(u8) kinds;
+  Vector(Type *) types;
+  Vector(loc) locations;
+
+  /// The operands of instruction `i` are `operands[operands_begin[i]]`
+  /// up to `operands[operands_begin[i + 1]]`, in the order in which
+  /// `ir_for_each_child()` visits them. Operands that aren’t part of
+  /// this function are `IR_NO_INDEX`.
+  Vector(u32) operands_begin;
+  Vector(u32) operands;
+
+  /// For each operand of a PHI, the block that it is incoming from;
+  /// `IR_NO_INDEX` for operands of other instructions.
+  Vector(u32) incoming;
+
+  /// Per block. The instructions of block `b` are `blocks_begin[b]`
+  /// up to `blocks_begin[b + 1]`. Each block has two entries in
+  /// `successors`; missing successors are `IR_NO_INDEX`.
+  Vector(u32) blocks_begin;
+  Vector(u32) successors;
+} IRPackedFunction;
+
+/// Number of instructions and blocks in a packed function.
+#define ir_packed_count(p) ((p)->kinds.size)
+#define ir_packed_block_count(p) ((p)->blocks_begin.size - 1)
+
+/// Iterate over the operands of an instruction in a packed function.
+#define FOREACH_PACKED_OPERAND(op, p, i)                                      \
+  for (u32 *op = (p)->operands.data + (p)->operands_begin.data[i],            \
+           *op##_end = (p)->operands.data + (p)->operands_begin.data[(i) + 1]; \
+       op < op##_end;                                                         \
+       op++)
+
+/// Copy a function into its packed form. This renumbers the
+/// instructions of the function.
+void ir_pack_function(IRFunction *f, IRPackedFunction *p);
+
+/// Number of bytes used by a packed function.
+usz ir_packed_size(IRPackedFunction *p);
+
+/// Free the memory used by a packed function.
+void ir_packed_free(IRPackedFunction *p);
+
 /// ===========================================================================
 ///  Instruction Creation
 /// ===========================================================================
 /// Create a basic block.
 NODISCARD IRBlock *ir_block(CodegenContext *ctx);
 
-/// Create a function.
+/// Create a copy of an instruction that is not inserted anywhere.
+///
+/// The copy has the same type and operands as the original. The
+/// arguments of a PHI are copied along with their incoming blocks,
+/// and branches refer to the same blocks as the original; callers
+/// that clone code into new blocks must remap these themselves.
+NODISCARD IRInstruction *ir_clone(CodegenContext *context, IRInstruction *instruction);
+
+/// Create a function. The name must be interned.
 NODISCARD IRFunction *ir_create_function(
   CodegenContext *context,
   string name,
@@ -481,6 +673,14 @@ NODISCARD IRInstruction *ir_create_memcpy(
   IRInstruction *size
 );
 
+/// Create a call to the memset intrinsic. The value must be a byte.
+NODISCARD IRInstruction *ir_create_memset(
+  CodegenContext *context,
+  IRInstruction *dest,
+  IRInstruction *value,
+  IRInstruction *size
+);
+
 /// Create a not instruction.
 NODISCARD IRInstruction *ir_create_not(
   CodegenContext *context,
@@ -517,7 +717,7 @@ NODISCARD IRInstruction *ir_create_sext(
 /// \param context The codegen context.
 /// \param decl The expression that declares the variable (may be NULL).
 /// \param type The type of the variable.
-/// \param name The name of the variable.
+/// \param name The name of the variable. This must be interned.
 /// \return An handle to the variable that can be used to create references.
 NODISCARD IRStaticVariable *ir_create_static(
   CodegenContext *context,
@@ -640,6 +840,48 @@ IRInstruction *ir_insert_before(
   IRInstruction *instruction
 );
 
+/// Move an instruction to before another instruction.
+///
+/// Unlike \c ir_insert_before(), this takes an instruction that is
+/// already inserted; its uses are not affected. The instructions may
+/// be in different blocks.
+///
+/// \param before The instruction before which to insert.
+/// \param instruction The instruction to move.
+void ir_move_before(
+  IRInstruction *before,
+  IRInstruction *instruction
+);
+
+/// Insert a block into a function before another block.
+///
+/// \param before The block before which to insert.
+/// \param block The block to insert. It must not be attached
+///        to a function yet.
+/// \return The inserted block.
+IRBlock *ir_block_insert_before(IRBlock *before, IRBlock *block);
+
+/// Insert a block into a function after another block.
+///
+/// \param after The block after which to insert.
+/// \param block The block to insert. It must not be attached
+///        to a function yet.
+/// \return The inserted block.
+IRBlock *ir_block_insert_after(IRBlock *after, IRBlock *block);
+
+/// Split a block in two before an instruction.
+///
+/// The instruction and everything after it are moved into a new
+/// block that is inserted after the original block, which then
+/// branches to it. PHIs in the successors are updated to receive
+/// their values from the new block.
+///
+/// \param context The codegen context.
+/// \param at The first instruction of the new block. This must
+///        not be a PHI.
+/// \return The new block.
+IRBlock *ir_split_block(CodegenContext *context, IRInstruction *at);
+
 /// These `ir_insert_X` functions are the same as calling
 /// `ir_insert(context, ir_X(...))`.
 IRInstruction *ir_insert_alloca(CodegenContext *context, Type *type);
@@ -672,6 +914,11 @@ ALL_BINARY_INSTRUCTION_TYPES(F)
 /// Get the context from a function.
 NODISCARD CodegenContext *ir_context(IRFunction *func);
 
+/// Remove the branch at the end of a block and the incoming values
+/// from this block from PHIs in its successors. When deleting several
+/// blocks that may branch to one another, detach all of them first.
+void ir_block_detach(IRBlock *block);
+
 /// Delete a block and all of its instructions from a function. If
 /// there are any PHI nodes referencing this block, the incoming
 /// values will be removed.
@@ -714,6 +961,11 @@ void ir_print_dot_cfg(CodegenContext *ctx);
 /// Print DJ graph for a function in DOT format.
 void ir_print_dot_dj(CodegenContext *ctx);
 
+/// Print how much memory the instructions of each function use as
+/// objects and in packed form, and how long it takes to visit every
+/// operand of every instruction in either form.
+void ir_print_storage_benchmark(CodegenContext *ctx);
+
 /// Remove an instruction from its block.
 ///
 /// It is an error to call this function if it is still
@@ -750,6 +1002,18 @@ IRInstruction *ir_replace(IRInstruction *old, IRInstruction *new);
 /// \param new The instruction to replace it with.
 void ir_replace_uses(IRInstruction *old, IRInstruction *new);
 
+/// Replace each operand of an instruction with the result of
+/// calling `map` on it.
+///
+/// All operands are replaced at once, so `map` may e.g. swap two
+/// operands. It is called once for every operand, including ones
+/// that occur more than once.
+void ir_map_operands(
+  IRInstruction *user,
+  IRInstruction *map(IRInstruction *operand, void *data),
+  void *data
+);
+
 /// Set IDs for all instructions in a function.
 ///
 /// \param f The function to set IDs for.
@@ -776,13 +1040,10 @@ NODISCARD span ir_name_f_impl_get(IRFunction *);
 void ir_name_f_impl_set(IRFunction *, string);
 NODISCARD IRBlock **ir_blocks_begin_impl(IRFunction *);
 NODISCARD IRBlock **ir_blocks_end_impl(IRFunction *);
-NODISCARD IRInstruction **ir_instructions_begin_impl(IRBlock *);
-NODISCARD IRInstruction **ir_instructions_end_impl(IRBlock *);
 NODISCARD IRInstruction **ir_users_begin_impl(IRInstruction *);
-NODISCARD IRInstruction **ir_users_end_impl(IRInstruction *);
+NODISCARD IRInstruction **ir_users_next_impl(IRInstruction **);
 NODISCARD IRBlock *ir_parent_impl_i(IRInstruction *);
 NODISCARD IRFunction *ir_parent_impl_b(IRBlock *);
-NODISCARD IRInstruction **ir_it_impl_i(IRInstruction *);
 NODISCARD IRBlock **ir_it_impl_b(IRBlock *);
 NODISCARD SymbolLinkage ir_linkage_impl_f(IRFunction *);
 NODISCARD SymbolLinkage ir_linkage_impl_v(IRStaticVariable *);
@@ -0,0 +1,372 @@
+#include <codegen/opt/opt.h>
+#include <ir/ir.h>
+#include <ir/memssa.h>
+#include <stdlib.h>
+
+/// ===========================================================================
+///  Alias analysis
+/// ===========================================================================
+/// An address, split into the address it is computed from and an
+/// offset from that address.
+typedef struct {
+  IRInstruction *base;
+  i64 offset;
+  bool known_offset;
+} MemoryLocation;
+
+static bool is_address(Type *t) {
+  return type_is_pointer(t) || type_is_reference(t);
+}
+
+/// Strip casts and constant offsets off an address.
+static MemoryLocation decompose(IRInstruction *addr) {
+  MemoryLocation location = {addr, 0, true};
+  for (;;) {
+    switch (ir_kind(location.base)) {
+      default: return location;
+      case IR_COPY:
+      case IR_BITCAST:
+        location.base = ir_operand(location.base);
+        break;
+
+      case IR_ADD: {
+        IRInstruction *ptr = ir_lhs(location.base);
+        IRInstruction *offset = ir_rhs(location.base);
+        if (!is_address(ir_typeof(ptr))) {
+          IRInstruction *tmp = ptr;
+          ptr = offset;
+          offset = tmp;
+          if (!is_address(ir_typeof(ptr))) return location;
+        }
+
+        if (ir_kind(offset) == IR_IMMEDIATE) location.offset += (i64) ir_imm(offset);
+        else location.known_offset = false;
+        location.base = ptr;
+      } break;
+    }
+  }
+}
+
+/// Get the object that an address points to, i.e. the variable
+/// if it is a local or global variable, and NULL otherwise.
+static void *object_of(IRInstruction *base) {
+  switch (ir_kind(base)) {
+    default: return NULL;
+    case IR_ALLOCA: return base;
+    case IR_STATIC_REF: return ir_static_ref_var(base);
+  }
+}
+
+/// Check if an address that is derived from an alloca is used by
+/// anything other than loads and stores.
+static bool address_escapes(IRInstruction *addr) {
+  FOREACH_USER (user, addr) {
+    switch (ir_kind(user)) {
+      default: return true;
+      case IR_LOAD: break;
+      case IR_STORE:
+        if (ir_store_value(user) == addr) return true;
+        break;
+
+      case IR_COPY:
+      case IR_BITCAST:
+      case IR_ADD:
+        if (address_escapes(user)) return true;
+        break;
+    }
+  }
+
+  return false;
+}
+
+/// Check if a location may be accessed by code outside this function.
+static bool is_visible(MemorySSA *m, MemoryLocation *location) {
+  if (ir_kind(location->base) != IR_ALLOCA) return true;
+  bool *escapes = map_get(m->escapes, location->base);
+  return !escapes || *escapes;
+}
+
+/// Check if a type is a byte or any other integer type of size 1.
+static bool is_byte(Type *t) {
+  return type_is_integer_canon(t) && type_sizeof(t) == 1;
+}
+
+bool tbaa_may_alias(Type *a, Type *b) {
+  a = type_canonical(a);
+  b = type_canonical(b);
+  if (!a || !b || type_equals_canon(a, b)) return true;
+
+  /// Any memory can be accessed as bytes.
+  if (is_byte(a) || is_byte(b)) return true;
+
+  /// Integers of the same size only differ in signedness.
+  if (type_is_integer_canon(a) && type_is_integer_canon(b))
+    return type_sizeof(a) == type_sizeof(b);
+
+  /// Pointers are freely cast to other pointers.
+  if (is_address(a) && is_address(b)) return true;
+
+  /// An aggregate overlaps any of its members or elements.
+  for (usz n = 0; n < 2; n++) {
+    Type *agg = n ? b : a;
+    Type *other = n ? a : b;
+    if (agg->kind == TYPE_ARRAY && tbaa_may_alias(agg->array.of, other)) return true;
+    if (agg->kind == TYPE_STRUCT) {
+      foreach (m, agg->structure.members)
+        if (tbaa_may_alias(m->type, other))
+          return true;
+    }
+  }
+
+  return false;
+}
+
+AliasResult memssa_alias(MemorySSA *m, IRInstruction *a, Type *a_type, IRInstruction *b, Type *b_type) {
+  usz a_size = type_sizeof(a_type);
+  usz b_size = type_sizeof(b_type);
+  if (a == b) return a_size == b_size ? ALIAS_MUST : ALIAS_MAY;
+  MemoryLocation la = decompose(a);
+  MemoryLocation lb = decompose(b);
+  void *oa = object_of(la.base);
+  void *ob = object_of(lb.base);
+
+  /// Accesses relative to the same address overlap iff their
+  /// ranges do.
+  if (oa ? oa == ob : la.base == lb.base) {
+    if (la.known_offset && lb.known_offset) {
+      if (la.offset == lb.offset && a_size == b_size) return ALIAS_MUST;
+      if (la.offset + (i64) a_size <= lb.offset || lb.offset + (i64) b_size <= la.offset) return ALIAS_NO;
+    }
+  }
+
+  /// Distinct variables never overlap, and nothing can point to a
+  /// local variable whose address is never taken.
+  else {
+    if (oa && ob) return ALIAS_NO;
+    if (oa && !is_visible(m, &la)) return ALIAS_NO;
+    if (ob && !is_visible(m, &lb)) return ALIAS_NO;
+  }
+
+  /// Only accesses through pointers are subject to the type rules;
+  /// a variable can always be accessed as any type directly.
+  if (optimise_tbaa && (!oa || !ob) && !tbaa_may_alias(a_type, b_type)) return ALIAS_NO;
+  return ALIAS_MAY;
+}
+
+bool memssa_disjoint(MemorySSA *m, IRInstruction *a, IRInstruction *b) {
+  MemoryLocation la = decompose(a);
+  MemoryLocation lb = decompose(b);
+  if (la.base == lb.base) return false;
+  void *oa = object_of(la.base);
+  void *ob = object_of(lb.base);
+  if (oa && ob) return oa != ob;
+
+  /// A parameter can’t point to a local variable, since those are
+  /// only created once the function has been entered.
+  for (usz n = 0; n < 2; n++) {
+    MemoryLocation *local = n ? &lb : &la;
+    MemoryLocation *other = n ? &la : &lb;
+    if (ir_kind(local->base) != IR_ALLOCA) continue;
+    if (!is_visible(m, local) || ir_kind(other->base) == IR_PARAMETER) return true;
+  }
+
+  return false;
+}
+
+/// Check if a call may access the memory at an address.
+static bool call_may_access(MemorySSA *m, IRInstruction *addr) {
+  MemoryLocation location = decompose(addr);
+  return is_visible(m, &location);
+}
+
+bool memssa_may_write(MemorySSA *m, MemoryAccess *access, IRInstruction *addr, Type *type) {
+  if (access->kind != MEMORY_DEF) return false;
+  IRInstruction *i = access->inst;
+  if (ir_kind(i) == IR_STORE)
+    return memssa_alias(m, ir_store_addr(i), ir_typeof(ir_store_value(i)), addr, type) != ALIAS_NO;
+  return call_may_access(m, addr);
+}
+
+bool memssa_may_read(MemorySSA *m, MemoryAccess *access, IRInstruction *addr, Type *type) {
+  if (access->kind != MEMORY_DEF && access->kind != MEMORY_USE) return false;
+  IRInstruction *i = access->inst;
+  switch (ir_kind(i)) {
+    default: return call_may_access(m, addr);
+    case IR_STORE: return false;
+    case IR_LOAD: return memssa_alias(m, ir_operand(i), ir_typeof(i), addr, type) != ALIAS_NO;
+
+    /// Local variables die when we return.
+    case IR_RETURN: return ir_kind(decompose(addr).base) != IR_ALLOCA;
+  }
+}
+
+MemoryAccess *memssa_clobber(MemorySSA *m, MemoryAccess *start, IRInstruction *addr, Type *type) {
+  MemoryAccess *a = start;
+  while (a->kind == MEMORY_DEF && !memssa_may_write(m, a, addr, type)) a = a->defining;
+  return a;
+}
+
+/// ===========================================================================
+///  Construction
+/// ===========================================================================
+/// Get the successors of a block. Returns the number of successors.
+static usz memssa_successors(IRBlock *b, IRBlock *succs[2]) {
+  STATIC_ASSERT(IR_COUNT == 40, "Handle all branch types");
+  IRInstruction *br = ir_terminator(b);
+  switch (ir_kind(br)) {
+    default: return 0;
+    case IR_BRANCH:
+      succs[0] = ir_dest(br);
+      return 1;
+
+    case IR_BRANCH_CONDITIONAL:
+      succs[0] = ir_then(br);
+      succs[1] = ir_else(br);
+      return succs[0] == succs[1] ? 1 : 2;
+  }
+}
+
+/// Check if an instruction accesses memory, and how.
+static bool access_kind(IRInstruction *i, MemoryAccessKind *kind) {
+  STATIC_ASSERT(IR_COUNT == 40, "Handle all instructions");
+  switch (ir_kind(i)) {
+    default: return false;
+    case IR_LOAD:
+    case IR_RETURN:
+      *kind = MEMORY_USE;
+      return true;
+
+    case IR_STORE:
+    case IR_INTRINSIC:
+      *kind = MEMORY_DEF;
+      return true;
+
+    /// Tail calls are not pure since they also return from this function.
+    case IR_CALL:
+      if (ir_call_is_direct(i) && !ir_call_tail(i)) {
+        IRFunction *callee = ir_callee(i).func;
+        if (ir_attribute(callee, FUNC_ATTR_CONST)) return false;
+        if (ir_attribute(callee, FUNC_ATTR_PURE)) {
+          *kind = MEMORY_USE;
+          return true;
+        }
+      }
+
+      *kind = MEMORY_DEF;
+      return true;
+  }
+}
+
+static MemoryAccess *new_access(MemorySSA *m, MemoryAccessKind kind, IRInstruction *i, IRBlock *b) {
+  MemoryAccess *a = calloc(1, sizeof *a);
+  a->kind = kind;
+  a->inst = i;
+  a->block = b;
+  vector_push(m->all, a);
+  return a;
+}
+
+static void add_phi_arg(MemoryAccess *phi, IRBlock *block, MemoryAccess *value) {
+  vector_push(phi->args, ((MemoryPhiArgument){block, value}));
+  vector_push(value->users, phi);
+}
+
+/// This is the same algorithm that mem2reg uses to construct SSA
+/// form, except that there is only one variable, namely memory.
+MemorySSA memssa_build(IRFunction *f, DominatorTree *dom) {
+  MemorySSA m = {0};
+  m.live_on_entry = new_access(&m, MEMORY_LIVE_ON_ENTRY, NULL, NULL);
+
+  /// Create accesses for all instructions and remember which
+  /// blocks contain defs.
+  IRBlockVector worklist = {0};
+  FOREACH_BLOCK (b, f) {
+    bool reachable = dom_tree_reachable(dom, b);
+    bool has_def = false;
+    FOREACH_INSTRUCTION (i, b) {
+      if (ir_kind(i) == IR_ALLOCA) map_set(m.escapes, i, address_escapes(i));
+
+      MemoryAccessKind kind;
+      if (!reachable || !access_kind(i, &kind)) continue;
+      map_set(m.accesses, i, new_access(&m, kind, i, b));
+      if (kind == MEMORY_DEF) has_def = true;
+    }
+
+    if (has_def) vector_push(worklist, b);
+  }
+
+  /// Place phis at the iterated dominance frontier of those blocks.
+  IRBlock *entry = ir_entry_block(f);
+  vector_push(worklist, entry);
+  while (worklist.size) {
+    IRBlock *b = vector_pop(worklist);
+    foreach_val (df, *dom_tree_frontier(dom, b)) {
+      if (map_contains(m.phis, df)) continue;
+      MemoryAccess *phi = new_access(&m, MEMORY_PHI, NULL, df);
+      map_set(m.phis, df, phi);
+      vector_push(worklist, df);
+
+      /// If the entry block is part of a loop, memory on entry
+      /// to the function also flows into it.
+      if (df == entry) add_phi_arg(phi, NULL, m.live_on_entry);
+    }
+  }
+
+  /// Link each access to the nearest def that dominates it by walking
+  /// the dominator tree. This is iterative since functions can have
+  /// tens of thousands of blocks.
+  typedef struct { IRBlock *block; MemoryAccess *current; } frame;
+  Vector(frame) stack = {0};
+  vector_push(stack, ((frame){entry, m.live_on_entry}));
+  while (stack.size) {
+    frame fr = vector_pop(stack);
+    MemoryAccess *phi = memssa_phi(&m, fr.block);
+    if (phi) fr.current = phi;
+
+    FOREACH_INSTRUCTION (i, fr.block) {
+      MemoryAccess *a = memssa_access(&m, i);
+      if (!a) continue;
+      a->defining = fr.current;
+      vector_push(fr.current->users, a);
+      if (a->kind == MEMORY_DEF) fr.current = a;
+    }
+
+    IRBlock *succs[2];
+    usz count = memssa_successors(fr.block, succs);
+    for (usz n = 0; n < count; n++) {
+      MemoryAccess *succ_phi = memssa_phi(&m, succs[n]);
+      if (succ_phi) add_phi_arg(succ_phi, fr.block, fr.current);
+    }
+
+    foreach_val (child, *dom_tree_children(dom, fr.block))
+      vector_push(stack, ((frame){child, fr.current}));
+  }
+
+  vector_delete(stack);
+  vector_delete(worklist);
+  return m;
+}
+
+void memssa_free(MemorySSA *m) {
+  foreach_val (a, m->all) {
+    vector_delete(a->args);
+    vector_delete(a->users);
+    free(a);
+  }
+
+  vector_delete(m->all);
+  map_delete(m->accesses);
+  map_delete(m->phis);
+  map_delete(m->escapes);
+  m->live_on_entry = NULL;
+}
+
+MemoryAccess *memssa_access(MemorySSA *m, IRInstruction *i) {
+  MemoryAccess **a = map_get(m->accesses, i);
+  return a ? *a : NULL;
+}
+
+MemoryAccess *memssa_phi(MemorySSA *m, IRBlock *b) {
+  MemoryAccess **a = map_get(m->phis, b);
+  return a ? *a : NULL;
+}
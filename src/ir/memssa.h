@@ -0,0 +1,156 @@
+#ifndef INTERCEPT_IR_MEMSSA_H
+#define INTERCEPT_IR_MEMSSA_H
+
+#include <ast.h>
+#include <codegen/codegen_forward.h>
+#include <ir/dom.h>
+#include <stdbool.h>
+#include <vector.h>
+
+/// Memory SSA treats all of memory as a single variable and puts it
+/// into SSA form: every instruction that may write to memory is a
+/// *def* that creates a new version of memory, every instruction that
+/// may read from memory is a *use* of the version it sees, and *phis*
+/// merge versions where control flow joins, just like PHIs do for
+/// values.
+///
+/// To find the store that a load reads from, we can thus walk up the
+/// chain of defs starting at the load, skipping any defs that don’t
+/// write to the loaded address, instead of having to scan all blocks
+/// that may be executed before the load.
+///
+/// For example, in
+///
+///     bb0:
+///         store 1 into %a      ; 1 = def(live on entry)
+///         br.cond %c, bb1, bb2
+///     bb1:
+///         store 2 into %b      ; 2 = def(1)
+///         br bb2
+///     bb2:                     ; 3 = phi(bb0: 1, bb1: 2)
+///         %x = load %a         ; use(3)
+///
+/// the load of `%a` uses the phi in `bb2`, which in turn uses the
+/// two stores. If `%a` and `%b` don’t alias, both paths lead to the
+/// first store, so `%x` is always 1.
+///
+/// Instructions in blocks that are unreachable from the entry block
+/// don’t have accesses.
+typedef enum MemoryAccessKind {
+  /// The state of memory on entry to the function.
+  MEMORY_LIVE_ON_ENTRY,
+
+  /// A store, or a call that may write to memory.
+  MEMORY_DEF,
+
+  /// A load, a call that only reads from memory, or a return; the
+  /// latter reads all memory that outlives the function.
+  MEMORY_USE,
+
+  /// Merges the states of memory flowing in from the predecessors
+  /// of a block.
+  MEMORY_PHI,
+} MemoryAccessKind;
+
+typedef struct MemoryAccess MemoryAccess;
+typedef Vector(MemoryAccess *) MemoryAccessVector;
+
+typedef struct MemoryPhiArgument {
+  /// The predecessor that the value flows in from.
+  IRBlock *block;
+  MemoryAccess *value;
+} MemoryPhiArgument;
+
+struct MemoryAccess {
+  MemoryAccessKind kind;
+
+  /// The instruction, or NULL for phis and the live-on-entry def.
+  IRInstruction *inst;
+
+  /// The block containing the access, or NULL for the live-on-entry def.
+  IRBlock *block;
+
+  /// The version of memory that a def or use sees, i.e. the nearest
+  /// def or phi that dominates it. NULL for phis and the live-on-entry
+  /// def.
+  MemoryAccess *defining;
+
+  /// Arguments of a phi, one per reachable predecessor.
+  Vector(MemoryPhiArgument) args;
+
+  /// Accesses that use this one as their defining access or as
+  /// a phi argument. May contain duplicates.
+  MemoryAccessVector users;
+};
+
+/// Result of an alias query.
+typedef enum AliasResult {
+  /// The two accesses never overlap.
+  ALIAS_NO,
+
+  /// The two accesses may overlap.
+  ALIAS_MAY,
+
+  /// The two accesses are to exactly the same memory.
+  ALIAS_MUST,
+} AliasResult;
+
+typedef struct MemorySSA {
+  /// The state of memory on entry to the function.
+  MemoryAccess *live_on_entry;
+
+  /// Map from instructions to their accesses.
+  Map(IRInstruction *, MemoryAccess *) accesses;
+
+  /// Map from blocks to their phis. Not every block has one.
+  Map(IRBlock *, MemoryAccess *) phis;
+
+  /// Whether the address of an alloca may be used by anything
+  /// other than loads and stores in this function.
+  Map(IRInstruction *, bool) escapes;
+
+  /// All accesses, for freeing.
+  MemoryAccessVector all;
+} MemorySSA;
+
+/// Build the Memory SSA form of a function.
+MemorySSA memssa_build(IRFunction *f, DominatorTree *dom);
+
+/// Free the memory used by Memory SSA.
+void memssa_free(MemorySSA *m);
+
+/// Get the access of an instruction, or NULL if it doesn’t
+/// access memory or is unreachable.
+MemoryAccess *memssa_access(MemorySSA *m, IRInstruction *i);
+
+/// Get the phi of a block, or NULL if it doesn’t have one.
+MemoryAccess *memssa_phi(MemorySSA *m, IRBlock *b);
+
+/// Check whether an access of type `a` through a pointer may overlap
+/// an access of type `b`. This is the case if the types are the same
+/// or only differ in signedness, if either is a byte, if both are
+/// pointers, or if one is an aggregate that contains a member or
+/// element that may alias the other.
+bool tbaa_may_alias(Type *a, Type *b);
+
+/// Check whether an access of type `a_type` at `a` may overlap an
+/// access of type `b_type` at `b`.
+AliasResult memssa_alias(MemorySSA *m, IRInstruction *a, Type *a_type, IRInstruction *b, Type *b_type);
+
+/// Check whether two addresses point into different objects, so that
+/// accesses relative to them never overlap, however large they are.
+bool memssa_disjoint(MemorySSA *m, IRInstruction *a, IRInstruction *b);
+
+/// Check whether an access may write to or read from a value of
+/// type `type` at `addr`. Phis and the live-on-entry def don’t do
+/// either.
+bool memssa_may_write(MemorySSA *m, MemoryAccess *access, IRInstruction *addr, Type *type);
+bool memssa_may_read(MemorySSA *m, MemoryAccess *access, IRInstruction *addr, Type *type);
+
+/// Walk up the defs starting at `start` and return the first one that
+/// may write to a value of type `type` at `addr`, a phi, or the
+/// live-on-entry def. To find what a load reads from, start at its
+/// defining access.
+MemoryAccess *memssa_clobber(MemorySSA *m, MemoryAccess *start, IRInstruction *addr, Type *type);
+
+#endif // INTERCEPT_IR_MEMSSA_H
@@ -1,6 +1,7 @@
 #include <ast.h>
 #include <codegen.h>
 #include <error.h>
+#include <errno.h>
 #include <locale.h>
 #include <parser.h>
 #include <stdio.h>
@@ -29,6 +30,8 @@ static void print_usage(char **argv) {
         "   `--print-ir`        :: Print the intermediate representation.\n"
         "   `--annotate-code    :: Emit comments in generated code.\n"
         "   `-O`, `--optimize`  :: Optimize the generated code.\n"
+        "   `--no-tbaa`         :: Don't assume that pointers to incompatible types never alias.\n"
+        "   `--bench-ir`        :: Compare the size and walking speed of the IR stored as objects and packed, and exit.\n"
         "   `-v`, `--verbose`   :: Print out more information.\n");
   print("Options:\n"
         "    `-o`, `--output`   :: Set the output filepath to the one given.\n"
@@ -37,6 +40,7 @@ static void print_usage(char **argv) {
         "    `-cc`, `--calling` :: Set the calling convention to the one given.\n"
         "   `--dot-cfg <func>`  :: Print the control flow graph of a function in DOT format and exit.\n"
         "   `--dot-dj <func>`   :: Print the DJ-graph of a function in DOT format and exit.\n"
+        "   `--unroll-threshold <n>` :: Only unroll loops if the result has at most <n> instructions (0 disables unrolling).\n"
         "    `-L`               :: Check for modules within the given directory.\n"
         "    `--colours`        :: Set whether to use colours in diagnostics.\n"
         "Anything other arguments are treated as input filepaths (source code).\n");
@@ -50,6 +54,8 @@ enum CodegenCallingConvention output_calling_convention = CG_CALL_CONV_DEFAULT;
 
 int verbosity = 0;
 int optimise = 0;
+bool optimise_tbaa = true;
+usz optimise_unroll_threshold = 64;
 bool debug_ir = false;
 bool print_ast = false;
 bool syntax_only = false;
@@ -60,6 +66,7 @@ bool annotate_code = false;
 bool print_ir2 = false;
 bool print_dot_cfg = false;
 bool print_dot_dj = false;
+bool bench_ir_storage = false;
 const char* print_dot_function = NULL;
 Vector(string) search_paths = {};
 
@@ -133,9 +140,25 @@ static int handle_command_line_arguments(int argc, char **argv) {
       if (++i >= argc)
         ICE("Expected target after command line argument %s", argument);
       print_dot_function = i[argv]; /// Note: Copilot autocompleted this and I’m leaving it like that lol.
+    } else if (strcmp(argument, "--bench-ir") == 0) {
+      bench_ir_storage = true;
     } else if (strcmp(argument, "-O") == 0
                || strcmp(argument, "--optimise") == 0) {
       optimise = 1;
+    } else if (strcmp(argument, "--no-tbaa") == 0) {
+      optimise_tbaa = false;
+    } else if (strcmp(argument, "--unroll-threshold") == 0) {
+      if (++i >= argc)
+        ICE("Expected instruction count after command line argument %s", argument);
+      char *end;
+      errno = 0;
+      unsigned long long threshold = strtoull(argv[i], &end, 10);
+      if (errno || *end || !*argv[i] || 0[argv[i]] == '-') {
+        print("Expected instruction count after command line argument %s\n"
+              "Instead, got: \"%s\".\n", argument, argv[i]);
+        return 1;
+      }
+      optimise_unroll_threshold = (usz) threshold;
     }  else if (strcmp(argument, "-v") == 0
                || strcmp(argument, "--verbose") == 0) {
       verbosity = 1;
@@ -560,15 +583,15 @@ int main(int argc, char **argv) {
       vector_delete(search_path);
 
       span metadata = grab_section_reference(as_span(module_object), INTC_MODULE_SECTION_NAME);
-      ast->imports.data[i] = deserialise_module(metadata);
+      ast->imports.data[i] = deserialise_module(metadata, ast);
       ast->imports.data[i]->module_name = import->module_name;
 
       foreach_val (export, ast->imports.data[i]->exports) {
         if (export->kind == NODE_FUNCTION_REFERENCE) {
           Scope *global_scope = vector_front(ast->scope_stack);
-          Symbol *func_sym = scope_find_or_add_symbol(global_scope, SYM_FUNCTION, as_span(export->funcref.name), true);
+          Symbol *func_sym = scope_find_or_add_symbol(global_scope, SYM_FUNCTION, export->funcref.name, true);
           /// FIXME: Should probably create function in imported module?
-          func_sym->val.node = ast_make_function(ast, (loc){0}, export->type, LINKAGE_IMPORTED, (Nodes){0}, NULL, as_span(export->funcref.name));
+          func_sym->val.node = ast_make_function(ast, (loc){0}, export->type, LINKAGE_IMPORTED, (Nodes){0}, NULL, export->funcref.name);
           export->funcref.scope = global_scope;
           export->funcref.resolved = func_sym;
         }
@@ -599,6 +622,7 @@ int main(int argc, char **argv) {
     )) exit(3);
 
   done:
+    if (verbosity) print("AST arena: %Z bytes used, %Z bytes reserved\n", ast->arena.bytes_used, ast->arena.bytes_reserved);
     ast_free(ast);
   }
 
@@ -36,7 +36,8 @@ typedef struct PACKED SerialisedMember {
 
 PACKED_DEFAULT;
 
-typedef Vector(Type *) TypeCache;
+/// Map from types to their index in the type table.
+typedef Map(Type *, uint64_t) TypeCache;
 
 static void write_bytes(string_buffer *out, const char *ptr, usz size) {
   /// Synthesise a buffer from the string we need to print.
@@ -50,13 +51,12 @@ static void write_bytes(string_buffer *out, const char *ptr, usz size) {
 
 /// Append serialised type to first parameter.
 uint64_t serialise_type(string_buffer *out, Type *type, TypeCache *cache) {
-  foreach_index (i, *cache) {
-    Type *cached_type = cache->data[i];
-    if (type_equals(type, cached_type)) return i;
-  }
+  /// Types are interned, so equal types are usually the same object.
+  uint64_t *cached = map_get(*cache, type);
+  if (cached) return *cached;
 
-  usz type_index = cache->size;
-  vector_push(*cache, type);
+  usz type_index = map_size(*cache);
+  map_set(*cache, type, type_index);
 
   uint8_t tag = (uint8_t)type->kind;
   write_bytes(out, (const char *)&tag, 1);
@@ -142,14 +142,18 @@ uint64_t serialise_type(string_buffer *out, Type *type, TypeCache *cache) {
       format_to(out, "%S", param->name);
     }
 
+    /// Serialising a type may reallocate the buffer, so only compute
+    /// where to put its index afterwards.
     foreach_index (param_index, type->function.parameters) {
       Parameter *param = type->function.parameters.data + param_index;
+      uint64_t param_type = serialise_type(out, param->type, cache);
       uint64_t *member_offset = (uint64_t*)(out->data + params_byte_offset + (param_index * sizeof(uint64_t)));
-      *member_offset = serialise_type(out, param->type, cache);
+      *member_offset = param_type;
     }
 
+    uint64_t return_type = serialise_type(out, type->function.return_type, cache);
     uint64_t *return_offset = (uint64_t*)(out->data + return_byte_offset);
-    *return_offset = serialise_type(out, type->function.return_type, cache);
+    *return_offset = return_type;
 
   } break;
   case TYPE_STRUCT: {
@@ -186,9 +190,10 @@ uint64_t serialise_type(string_buffer *out, Type *type, TypeCache *cache) {
     // Fixups
     foreach_index (member_index, type->structure.members) {
       Member *member = type->structure.members.data + member_index;
+      uint64_t member_type = serialise_type(out, member->type, cache);
       SerialisedMember *member_offset = (SerialisedMember*)(out->data + members_byte_offset + (member_index * sizeof(uint64_t)));
       member_offset->byte_offset = (uint32_t)member->byte_offset;
-      member_offset->type_index = serialise_type(out, member->type, cache);
+      member_offset->type_index = member_type;
     }
 
   } break;
@@ -206,8 +211,12 @@ uint64_t serialise_type(string_buffer *out, Type *type, TypeCache *cache) {
   return type_index;
 }
 
-// @return The `from` pointer advanced past deserialised type.
-uint8_t *deserialise_type(uint8_t *from, Type *type, Type **types) {
+/// Read a type from the type table of a module. Element types are
+/// pointers into `types`, which must be passed to `intern_type()`
+/// once the entire table has been read.
+///
+/// @return The `from` pointer advanced past deserialised type.
+uint8_t *deserialise_type(uint8_t *from, Type *type, Type *types) {
   uint8_t type_tag = *from;
   switch ((TypeKind)type_tag) {
   case TYPE_PRIMITIVE: {
@@ -219,7 +228,7 @@ uint8_t *deserialise_type(uint8_t *from, Type *type, Type **types) {
     type->named = calloc(1, sizeof(Symbol));
     type->named->kind = SYM_TYPE;
     type->named->val.type = primitive_types[index];
-    type->named->name = string_dup(primitive_types[index]->primitive.name);
+    type->named->name = identifier_intern(primitive_types[index]->primitive.name);
 
     return from + 1 + sizeof(uint8_t);
   }
@@ -230,10 +239,10 @@ uint8_t *deserialise_type(uint8_t *from, Type *type, Type **types) {
     name.data = (const char *)(from + 1 + sizeof(uint32_t));
     type->kind = TYPE_NAMED;
 
+    /// We don’t know what type this refers to, so leave it unresolved.
     Symbol *sym = calloc(1, sizeof(Symbol));
     sym->kind = SYM_TYPE;
-    sym->name = string_dup(name);
-    sym->val.type = type;
+    sym->name = identifier_intern(name);
     // FIXME: Do we need to set scope? Hopefully not..
 
     type->named = sym;
@@ -244,14 +253,14 @@ uint8_t *deserialise_type(uint8_t *from, Type *type, Type **types) {
     // [type_index]
     uint64_t *type_index = (uint64_t*)(from + 1);
     type->kind = TYPE_POINTER;
-    type->reference.to = types[*type_index];
+    type->pointer.to = types + *type_index;
     return from + 1 + sizeof(uint64_t);
   }
   case TYPE_REFERENCE: {
     // [type_index]
     uint64_t *type_index = (uint64_t*)(from + 1);
     type->kind = TYPE_REFERENCE;
-    type->reference.to = types[*type_index];
+    type->reference.to = types + *type_index;
     return from + 1 + sizeof(uint64_t);
   }
   case TYPE_ARRAY: {
@@ -259,7 +268,7 @@ uint8_t *deserialise_type(uint8_t *from, Type *type, Type **types) {
     SerialisedTypeArray *array = (SerialisedTypeArray*)(from + 1);
     type->kind = TYPE_ARRAY;
     type->array.size = array->element_count;
-    type->array.of = types[array->element_type_index];
+    type->array.of = types + array->element_type_index;
     return from + 1 + sizeof(SerialisedTypeArray);
   }
   case TYPE_FUNCTION: {
@@ -285,14 +294,14 @@ uint8_t *deserialise_type(uint8_t *from, Type *type, Type **types) {
       uint64_t param_type_index = *(uint64_t*)from_it;
       from_it += sizeof(uint64_t);
 
-      param.type = types[param_type_index];
+      param.type = types + param_type_index;
       vector_push(type->function.parameters, param);
     }
 
     uint64_t return_type_index = *(uint64_t*)from_it;
     from_it += sizeof(uint64_t);
 
-    type->function.return_type = types[return_type_index];
+    type->function.return_type = types + return_type_index;
 
     for (uint32_t i = 0; i < param_count; ++i) {
       uint32_t param_name_length = *(uint32_t*)from_it;
@@ -300,18 +309,9 @@ uint8_t *deserialise_type(uint8_t *from, Type *type, Type **types) {
 
       ASSERT(param_name_length < 1000, "Sorry, parameter names longer than a kilobyte aren't supported, you psycho");
 
-      string_buffer param_name = {0};
-      vector_reserve(param_name, param_name_length);
-      param_name.size = param_name_length;
-      memcpy(param_name.data, from_it, param_name_length);
+      span param_name = {(const char *) from_it, param_name_length};
+      type->function.parameters.data[i].name = identifier_intern(param_name);
       from_it += param_name_length;
-
-      // MOVE param_name vector into param.name string
-      type->function.parameters.data[i].name.data = param_name.data;
-      type->function.parameters.data[i].name.size = param_name.size;
-      param_name.data = NULL;
-      param_name.size = 0;
-      param_name.capacity = 0;
     }
     return from_it;
   }
@@ -336,7 +336,57 @@ uint8_t *deserialise_type(uint8_t *from, Type *type, Type **types) {
   UNREACHABLE();
 }
 
-Module *deserialise_module(span metadata) {
+/// Intern a type read by `deserialise_type()` in the module that imports
+/// it, so it is the same object as the same type in that module. Types
+/// may refer to types that come after them in the type table, which is
+/// why we can only do this once the entire table has been read.
+static Type *intern_type(Module *importer, Type *types, Type **interned, Type *type) {
+  usz index = (usz) (type - types);
+  if (interned[index]) return interned[index];
+
+  Type *out = NULL;
+  switch (type->kind) {
+  default: ICE("Unrecognized type kind in module metadata");
+
+  /// Primitive types are read as named types that refer to them.
+  case TYPE_NAMED:
+    if (type->named->val.type) {
+      out = type->named->val.type;
+      free(type->named);
+    } else {
+      out = ast_make_type_named(importer, (loc){0}, type->named);
+    }
+    break;
+
+  case TYPE_POINTER:
+    out = ast_make_type_pointer(importer, (loc){0}, intern_type(importer, types, interned, type->pointer.to));
+    break;
+
+  case TYPE_REFERENCE:
+    out = ast_make_type_reference(importer, (loc){0}, intern_type(importer, types, interned, type->reference.to));
+    break;
+
+  case TYPE_ARRAY:
+    out = ast_make_type_array(importer, (loc){0}, intern_type(importer, types, interned, type->array.of), type->array.size);
+    break;
+
+  case TYPE_INTEGER:
+    out = ast_make_type_integer(importer, (loc){0}, type->integer.is_signed, type->integer.bit_width);
+    break;
+
+  /// The parameters are moved into the new function type.
+  case TYPE_FUNCTION: {
+    foreach (param, type->function.parameters) param->type = intern_type(importer, types, interned, param->type);
+    Type *ret = intern_type(importer, types, interned, type->function.return_type);
+    out = ast_make_type_function(importer, (loc){0}, ret, type->function.parameters);
+    out->function.attr_discardable = type->function.attr_discardable;
+  } break;
+  }
+
+  return interned[index] = out;
+}
+
+Module *deserialise_module(span metadata, Module *importer) {
   Module *module = ast_create();
   module->is_module = true;
 
@@ -347,18 +397,17 @@ Module *deserialise_module(span metadata) {
       || desc->magic[2] != INTC_MODULE_MAG2)
     ICE("Invalid module description header");
 
-  // Preallocate types
-  vector_reserve(module->_types_, desc->type_count);
-  Type *type_blob = calloc(desc->type_count, sizeof(Type));
-  for (size_t i = 0; i < desc->type_count; ++i)
-    module->_types_.data[i] = type_blob + i;
-
   // Deserialise type info
+  Type *types = calloc(desc->type_count, sizeof(Type));
+  Type **interned = calloc(desc->type_count, sizeof(Type *));
   uint8_t *type_table = (uint8_t*)(metadata.data + desc->type_table_offset);
   for (usz i = 0; i < desc->type_count; ++i) {
-    type_table = deserialise_type(type_table, module->_types_.data[i], module->_types_.data);
+    type_table = deserialise_type(type_table, types + i, types);
   }
 
+  for (usz i = 0; i < desc->type_count; ++i) intern_type(importer, types, interned, types + i);
+  free(types);
+
   // Starting at (metadata.data + sizeof(*desc)),
   // parse module declarations (name + index in type table)
   uint8_t* begin_ptr = (uint8_t*)(metadata.data + sizeof(*desc));
@@ -367,23 +416,20 @@ Module *deserialise_module(span metadata) {
 
     // Get pointer within preallocated types using type index
     uint64_t type_index = *(uint64_t *)(begin_ptr);
-    Type *type = module->_types_.data[type_index];
+    Type *type = interned[type_index];
     //print("deserialised type: %T\n", type);
 
     // Get name length and then the name data
     uint32_t name_length = *(uint32_t *)(begin_ptr + sizeof(type_index));
     char *name_ptr = (char *)(begin_ptr + sizeof(type_index) + sizeof(uint32_t));
-    string_buffer name = {0};
-    vector_reserve(name, name_length);
-    name.size = name_length;
-    memcpy(name.data, name_ptr, name_length);
-    //print("deserialised name: %S\n", as_span(name));
+    string name = identifier_intern((span){name_ptr, name_length});
+    //print("deserialised name: %S\n", name);
 
     // Construct an AST node to represent the deserialised declaration
     Node *node = NULL;
     switch (type->kind) {
     case TYPE_FUNCTION: {
-      node = ast_make_function_reference(module, (loc){0}, as_span(name));
+      node = ast_make_function_reference(module, (loc){0}, name);
       node->type = type;
     } break;
     case TYPE_PRIMITIVE:
@@ -393,7 +439,7 @@ Module *deserialise_module(span metadata) {
     case TYPE_ARRAY:
     case TYPE_STRUCT:
     case TYPE_INTEGER: {
-      node = ast_make_declaration(module, (loc){0}, type, LINKAGE_IMPORTED, as_span(name), NULL);
+      node = ast_make_declaration(module, (loc){0}, type, LINKAGE_IMPORTED, name, NULL);
     } break;
 
     case TYPE_COUNT:
@@ -407,6 +453,7 @@ Module *deserialise_module(span metadata) {
     begin_ptr += sizeof(type_index) + sizeof(name_length) + name_length;
   }
 
+  free(interned);
   foreach_val (export, module->exports) {
     ast_print_node(export);
   }
@@ -466,10 +513,11 @@ string serialise_module(CodegenContext *context, Module *module) {
   // Fixup header with references.
   ModuleDescription *desc_ptr = (ModuleDescription *)out.data;
   desc_ptr->size = (uint32_t)out.size;
-  desc_ptr->type_count = (uint32_t)cache.size;
+  desc_ptr->type_count = (uint32_t)map_size(cache);
   desc_ptr->type_table_offset = (uint32_t)type_table_offset;
   desc_ptr->name_offset = (uint32_t)module_name_offset;
   desc_ptr->declaration_count = (uint32_t)module->exports.size;
+  map_delete(cache);
 
   string ret = {0};
   ret.size = out.size;
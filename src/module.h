@@ -13,7 +13,9 @@
 
 NODISCARD string serialise_module(CodegenContext *context, Module *module);
 
-Module *deserialise_module(span metadata);
+/// Read the description of a module. Its types are interned in the
+/// module that imports it.
+Module *deserialise_module(span metadata, Module *importer);
 
 // ModuleDescription { ModuleDeclaration } <anything trailing>
 typedef struct ModuleDescription {
@@ -58,6 +58,9 @@ typedef struct Token {
   // Any text; may be an identifier, keyword, etc.
   string_buffer text;
 
+  // The interned identifier, if this is an identifier.
+  string name;
+
   // True iff identifier found in `text` was created via escaping.
   bool artificial;
 
@@ -133,6 +136,10 @@ typedef struct Parser {
   /// The current token.
   Token tok;
 
+  /// Location of the type parsed last. Types may be shared, so
+  /// we can’t take this from the type itself.
+  loc type_location;
+
   /// The AST of the program.
   Module *ast;
 
@@ -220,6 +227,8 @@ static void next_identifier(Parser *p) {
     vector_push(p->tok.text, p->lastc);
     next_char(p);
   }
+
+  p->tok.name = identifier_intern(as_span(p->tok.text));
 }
 
 /// Lex a string.
@@ -714,6 +723,7 @@ static void next_token(Parser *p) {
         }
       }
       p->tok.type = TK_IDENT;
+      p->tok.name = identifier_intern(as_span(p->tok.text));
       p->tok.artificial = true;
     } break;
 
@@ -1199,7 +1209,9 @@ static Node *parse_call_expr(Parser *p, Node *callee) {
 /// Parse function attributes.
 static void parse_function_attributes(Parser *p, Attributes *attribs) {
   while (p->tok.type == TK_IDENT) {
-    int attr_kind = ATTR_COUNT;
+    /// Note: ATTR_COUNT is a valid function attribute kind, so
+    /// don’t use it to indicate that we didn’t find one.
+    int attr_kind = -1;
     for (size_t i = 0; i < sizeof function_attributes / sizeof *function_attributes; i++) {
       if (string_eq(function_attributes[i].name, p->tok.text)) {
         attr_kind = (int) function_attributes[i].kind;
@@ -1207,7 +1219,7 @@ static void parse_function_attributes(Parser *p, Attributes *attribs) {
       }
     }
 
-    if (attr_kind == ATTR_COUNT) break;
+    if (attr_kind == -1) break;
 
     // Yeet the attribute identifier that gave us the attribute kind.
     next_token(p);
@@ -1222,7 +1234,7 @@ static void parse_function_attributes(Parser *p, Attributes *attribs) {
   }
 }
 
-static void ensure_hygienic_declaration_if_within_macro(Parser *p, span ident, loc *source_location) {
+static void ensure_hygienic_declaration_if_within_macro(Parser *p, string ident, loc *source_location) {
   // If we are
   //   1. reading from a macro expansion, and
   //   2. encounter a variable declaration,
@@ -1230,10 +1242,10 @@ static void ensure_hygienic_declaration_if_within_macro(Parser *p, span ident, l
   // name passed as macro arguments (hygiene).
   if (p->macro_expansion_stack.size) {
     foreach (t, p->macro_expansion_stack.data[0].bound_arguments) {
-      if ((t->token.type == TK_IDENT && string_eq(t->token.text, ident)) || (t->token.type == TK_AST_NODE && t->token.node->kind == NODE_VARIABLE_REFERENCE && string_eq(t->token.node->var->name, ident))) {
+      if ((t->token.type == TK_IDENT && t->token.name.data == ident.data) || (t->token.type == TK_AST_NODE && t->token.node->kind == NODE_VARIABLE_REFERENCE && t->token.node->var->name.data == ident.data)) {
         if (source_location)
           ISSUE_DIAGNOSTIC(DIAG_NOTE, *source_location, p, "This declaration within a macro would shadow a passed identifier\n");
-        ERR_AT(p->macro_expansion_stack.data[0].source_location, "Unhygienic expansion of macro. Probably need \"defines %S\" specified for macro\n", as_span(ident));
+        ERR_AT(p->macro_expansion_stack.data[0].source_location, "Unhygienic expansion of macro. Probably need \"defines %S\" specified for macro\n", ident);
       }
     }
   }
@@ -1260,9 +1272,9 @@ static Node *parse_function_body(Parser *p, Type *function_type, Nodes *param_de
 
   /// Create a declaration for each parameter.
   foreach (param, function_type->function.parameters) {
-    Node *var = ast_make_declaration(p->ast, param->source_location, param->type, LINKAGE_LOCALVAR, as_span(param->name), NULL);
-    ensure_hygienic_declaration_if_within_macro(p, as_span(param->name), &param->source_location);
-    if (!scope_add_symbol(curr_scope(p), SYM_VARIABLE, as_span(var->declaration.name), var))
+    Node *var = ast_make_declaration(p->ast, param->source_location, param->type, LINKAGE_LOCALVAR, param->name, NULL);
+    ensure_hygienic_declaration_if_within_macro(p, param->name, &param->source_location);
+    if (!scope_add_symbol(curr_scope(p), SYM_VARIABLE, var->declaration.name, var))
       ERR_AT(var->source_location, "Redefinition of parameter '%S'", var->declaration.name);
     vector_push(*param_decls, var);
   }
@@ -1282,6 +1294,8 @@ static Node *parse_function_body(Parser *p, Type *function_type, Nodes *param_de
 ///
 /// <expr-lambda>    ::= <type-function> <expr-block>
 static Node *parse_type_expr(Parser *p, Type *type) {
+  loc location = p->type_location;
+
   /// If this is a function type, then this is a lambda expression.
   if (type->kind == TYPE_FUNCTION) {
     /// Parse the function body.
@@ -1294,14 +1308,14 @@ static Node *parse_type_expr(Parser *p, Type *type) {
 
     /// Create a function for the lambda.
     string name = format("_XLambda_%Z", p->ast->counter++);
-    Node *func = ast_make_function(p->ast, type->source_location, type, LINKAGE_INTERNAL, params, body, as_span(name));
+    Node *func = ast_make_function(p->ast, location, type, LINKAGE_INTERNAL, params, body, identifier_intern(as_span(name)));
     free(name.data);
     return func;
   }
 
   /// Otherwise, this is an error.
   /// TODO: Struct literals.
-  ERR_AT(type->source_location, "Expected expression, got type");
+  ERR_AT(location, "Expected expression, got type");
 }
 
 /// <param-decl> ::= <decl-start> <type>
@@ -1309,7 +1323,7 @@ static Parameter parse_param_decl(Parser *p) {
   loc start = p->tok.source_location;
 
   /// Parse the name, colon, and type.
-  string name = string_dup(p->tok.text);
+  string name = p->tok.name;
   consume(p, TK_IDENT);
   consume(p, TK_COLON);
   Type *type = parse_type(p);
@@ -1326,7 +1340,7 @@ static Member parse_struct_member(Parser *p) {
   loc start = p->tok.source_location;
 
   /// Parse the name, colon, and type.
-  string name = string_dup(p->tok.text);
+  string name = p->tok.name;
   consume(p, TK_IDENT);
   consume(p, TK_COLON);
   Type *type = parse_type(p);
@@ -1342,8 +1356,12 @@ static Member parse_struct_member(Parser *p) {
 /// <type-derived>  ::= <type-array> | <type-function>
 /// <type-array>    ::= <type> "[" <expression> "]"
 /// <type-function> ::= <type> "(" { <param-decl> [ "," ]  } ")"
-static Type *parse_type_derived(Parser *p, Type *base) {
+///
+/// `location` is the location of the base type in the source code. Types
+/// may be shared, so we can't take this from the base type itself.
+static Type *parse_type_derived(Parser *p, Type *base, loc location) {
   ASSERT(base);
+  u32 start = location.start;
 
   /// Parse the rest of the type.
   for (;;) {
@@ -1360,7 +1378,7 @@ static Type *parse_type_derived(Parser *p, Type *base) {
         usz dim = size->literal.integer;
 
         /// Yeet "]" and record the location.
-        loc l = {.start = base->source_location.start, .end = p->tok.source_location.end};
+        loc l = {.start = start, .end = p->tok.source_location.end};
         consume(p, TK_RBRACK);
 
         /// Base type must not be incomplete.
@@ -1368,6 +1386,7 @@ static Type *parse_type_derived(Parser *p, Type *base) {
 
         /// Create the array type.
         base = ast_make_type_array(p->ast, l, base, dim);
+        location = l;
       } break;
 
       /// Function type.
@@ -1384,15 +1403,18 @@ static Type *parse_type_derived(Parser *p, Type *base) {
 
 
         /// Yeet ")".
-        loc l = {.start = base->source_location.start, .end = p->tok.source_location.end};
+        loc l = {.start = start, .end = p->tok.source_location.end};
         consume(p, TK_RPAREN);
 
         /// Create the function type.
         base = ast_make_type_function(p->ast, l, base, args);
+        location = l;
       } break;
 
       /// Done.
-      default: return base;
+      default:
+        p->type_location = location;
+        return base;
     }
   }
 }
@@ -1413,19 +1435,21 @@ static Type *parse_type(Parser *p) {
 
   Type *out = NULL;
 
+  /// Most base types are a single token.
+  u32 end = p->tok.source_location.end;
+
   /// Parse the base type.
   switch (p->tok.type) {
 
   case TK_IDENT: {
     /// Make sure the identifier is a type.
-    Symbol *sym = scope_find_or_add_symbol(curr_scope(p), SYM_TYPE, as_span(p->tok.text), false);
+    Symbol *sym = scope_find_or_add_symbol(curr_scope(p), SYM_TYPE, p->tok.name, false);
     if (sym->kind != SYM_TYPE) ERR("'%S' is not a type!", as_span(p->tok.text));
 
     /// Create a named type from it.
-    out = ast_make_type_named(p->ast, p->tok.source_location, sym);
+    out = ast_make_type_named(p->ast, (loc){start.start, p->tok.source_location.end}, sym);
 
     /// Yeet the identifier and parse the rest of the type.
-    out->source_location.start = start.start;
     next_token(p);
   } break;
 
@@ -1436,7 +1460,7 @@ static Type *parse_type(Parser *p) {
     out = parse_type(p);
 
     /// Yeet ")" and parse the rest of the type.
-    out->source_location.start = start.start;
+    end = p->tok.source_location.end;
     consume(p, TK_RPAREN);
   } break;
 
@@ -1447,7 +1471,7 @@ static Type *parse_type(Parser *p) {
     next_token(p);
     out = parse_type(p);
     // Set end location of type
-    ref_type_loc.end = out->source_location.end;
+    ref_type_loc.end = end = p->type_location.end;
 
     out = ast_make_type_reference(p->ast, ref_type_loc, out);
   } break;
@@ -1525,6 +1549,7 @@ static Type *parse_type(Parser *p) {
       vector_push(members, member_decl);
       if (p->tok.type == TK_COMMA) next_token(p);
     }
+    end = p->tok.source_location.end;
     consume(p, TK_RBRACE);
     out = ast_make_type_struct(p->ast, type_kw_loc, members);
 
@@ -1540,7 +1565,7 @@ static Type *parse_type(Parser *p) {
   /// If we have pointer indirection levels, wrap the type in a pointer.
   while (level--) out = ast_make_type_pointer(p->ast, (loc){start.start--, p->tok.source_location.end}, out);
 
-  return parse_type_derived(p, out);
+  return parse_type_derived(p, out, (loc){start.start, end});
 }
 
 /// <expr-decl>      ::= <decl-start> <decl-rest>
@@ -1563,10 +1588,10 @@ static Node *parse_decl_rest(Parser *p, string ident, loc location) {
     /// Not external.
     if (!is_ext) {
       /// Create a symbol table entry before parsing the body.
-      Symbol *sym = scope_add_symbol_unconditional(curr_scope(p), SYM_FUNCTION, as_span(ident), NULL);
+      Symbol *sym = scope_add_symbol_unconditional(curr_scope(p), SYM_FUNCTION, ident, NULL);
 
       if (sym->kind != SYM_FUNCTION || sym->val.node)
-        ERR_AT(location, "Redefinition of symbol '%S'", as_span(ident));
+        ERR_AT(location, "Redefinition of symbol '%S'", ident);
 
       /// Parse the body, create the function, and update the symbol table.
       Nodes params = {0};
@@ -1576,9 +1601,9 @@ static Node *parse_decl_rest(Parser *p, string ident, loc location) {
       apply_function_attributes(p, type, attribs);
       vector_delete(attribs);
 
-      Node *func = ast_make_function(p->ast, location, type, LINKAGE_INTERNAL, params, body, as_span(ident));
+      Node *func = ast_make_function(p->ast, location, type, LINKAGE_INTERNAL, params, body, ident);
       sym->val.node = func;
-      Node *funcref = ast_make_function_reference(p->ast, location, as_span(ident));
+      Node *funcref = ast_make_function_reference(p->ast, location, ident);
       funcref->funcref.resolved = sym;
       funcref->type = type;
       return funcref;
@@ -1587,9 +1612,9 @@ static Node *parse_decl_rest(Parser *p, string ident, loc location) {
     /// External.
     else {
       /// Create a symbol table entry.
-      Symbol *sym = scope_find_or_add_symbol(curr_scope(p), SYM_FUNCTION, as_span(ident), true);
+      Symbol *sym = scope_find_or_add_symbol(curr_scope(p), SYM_FUNCTION, ident, true);
       if (sym->kind != SYM_FUNCTION || sym->val.node)
-        ERR_AT(location, "Redefinition of symbol '%S'", as_span(ident));
+        ERR_AT(location, "Redefinition of symbol '%S'", ident);
 
       /// Parse the function's attributes, if any.
       Attributes attribs = {0};
@@ -1598,10 +1623,10 @@ static Node *parse_decl_rest(Parser *p, string ident, loc location) {
       vector_delete(attribs);
 
       /// Create the function.
-      Node *func = ast_make_function(p->ast, location, type, LINKAGE_IMPORTED, (Nodes){0}, NULL, as_span(ident));
+      Node *func = ast_make_function(p->ast, location, type, LINKAGE_IMPORTED, (Nodes){0}, NULL, ident);
       type->function.attr_nomangle = true;
       sym->val.node = func;
-      Node *funcref = ast_make_function_reference(p->ast, location, as_span(ident));
+      Node *funcref = ast_make_function_reference(p->ast, location, ident);
       funcref->funcref.resolved = sym;
       funcref->type = type;
       return funcref;
@@ -1610,11 +1635,11 @@ static Node *parse_decl_rest(Parser *p, string ident, loc location) {
 
   /// Create the declaration.
   SymbolLinkage linkage = p->ast->scope_stack.size == 1 ? LINKAGE_INTERNAL : LINKAGE_LOCALVAR;
-  Node *decl = ast_make_declaration(p->ast, location, type, linkage, as_span(ident), NULL);
-  ensure_hygienic_declaration_if_within_macro(p, as_span(ident), &location);
+  Node *decl = ast_make_declaration(p->ast, location, type, linkage, ident, NULL);
+  ensure_hygienic_declaration_if_within_macro(p, ident, &location);
 
   /// Add the declaration to the current scope.
-  if (!scope_add_symbol(curr_scope(p), SYM_VARIABLE, as_span(ident), decl))
+  if (!scope_add_symbol(curr_scope(p), SYM_VARIABLE, ident, decl))
     ERR_AT(location, "Redefinition of symbol '%S'", ident);
 
   /// A non-external declaration may have an initialiser.
@@ -1640,9 +1665,7 @@ static Node *parse_declaration(Parser *p, string ident, loc location) {
   case TK_COLON: {
     /// Parse the rest of the declaration.
     next_token(p);
-    Node *decl = parse_decl_rest(p, ident, location);
-    free(ident.data);
-    return decl;
+    return parse_decl_rest(p, ident, location);
   }
 
   case TK_COLON_GT: {
@@ -1652,26 +1675,24 @@ static Node *parse_declaration(Parser *p, string ident, loc location) {
     Type *type = parse_type(p);
 
     if (type->kind == TYPE_STRUCT) {
-      Symbol *struct_decl_sym = scope_find_or_add_symbol(curr_scope(p), SYM_TYPE, as_span(ident), true);
+      Symbol *struct_decl_sym = scope_find_or_add_symbol(curr_scope(p), SYM_TYPE, ident, true);
       struct_decl_sym->val.type = type;
       Node *struct_decl = ast_make_structure_declaration(p->ast, location, struct_decl_sym);
       type->structure.decl = struct_decl;
       struct_decl->type = type;
-      free(ident.data);
       return struct_decl;
     }
-    free(ident.data);
     TODO("Named type alias not implemented");
   }
 
   case TK_COLON_COLON: {
     /// Create the declaration.
     SymbolLinkage linkage = p->ast->scope_stack.size == 1 ? LINKAGE_INTERNAL : LINKAGE_LOCALVAR;
-    Node *decl = ast_make_declaration(p->ast, location, NULL, linkage, as_span(ident), NULL);
-    ensure_hygienic_declaration_if_within_macro(p, as_span(ident), &location);
+    Node *decl = ast_make_declaration(p->ast, location, NULL, linkage, ident, NULL);
+    ensure_hygienic_declaration_if_within_macro(p, ident, &location);
 
     /// Add the declaration to the current scope.
-    if (!scope_add_symbol(curr_scope(p), SYM_VARIABLE, as_span(ident), decl))
+    if (!scope_add_symbol(curr_scope(p), SYM_VARIABLE, ident, decl))
       ERR_AT(location, "Redefinition of symbol '%S'", ident);
 
     /// A type-inferred declaration MUST have an initialiser.
@@ -1683,7 +1704,6 @@ static Node *parse_declaration(Parser *p, string ident, loc location) {
     decl->declaration.init->parent = decl;
 
     /// Done.
-    free(ident.data);
     return decl;
   }
 
@@ -1700,7 +1720,7 @@ static Node *parse_ident_expr(Parser *p) {
   ASSERT(p->tok.type == TK_IDENT,
          "parse_ident_expr() may only be called with identifier token, but it was called with %s.",
          token_type_to_string(p->tok.type));
-  string ident = string_dup(p->tok.text);
+  string ident = p->tok.name;
   loc location = p->tok.source_location;
   next_token(p);
 
@@ -1717,23 +1737,19 @@ static Node *parse_ident_expr(Parser *p) {
 
   /// Otherwise, check if the identifier is a declared symbol; if it isn’t,
   /// it can only be a function name, so add it as a symbol.
-  Symbol *sym = scope_find_symbol(curr_scope(p), as_span(ident), false);
+  Symbol *sym = scope_find_symbol(curr_scope(p), ident, false);
 
   /// If the symbol is a variable or function, then create a variable or
   /// function reference, and we’re done here.
   if (!sym || sym->kind == SYM_FUNCTION) {
-    Node *ref = ast_make_function_reference(p->ast, location, as_span(ident));
-    free(ident.data);
-    return ref;
+    return ast_make_function_reference(p->ast, location, ident);
   }
 
-  /// Identifier is no longer needed at this point.
-  free(ident.data);
   if (sym->kind == SYM_VARIABLE) return ast_make_variable_reference(p->ast, location, sym);
 
   /// If the symbol is a type, then parse the rest of the type and delegate.
   if (sym->kind == SYM_TYPE) {
-    Type *type = parse_type_derived(p, ast_make_type_named(p->ast, location, sym));
+    Type *type = parse_type_derived(p, ast_make_type_named(p->ast, location, sym), location);
     return parse_type_expr(p, type);
   }
 
@@ -1776,6 +1792,7 @@ static Node *parse_expr_with_precedence(Parser *p, isz current_precedence) {
     // Cursed use of macro to append string (non-vector) to string buffer
     string generated_sym = vector_back(p->macro_expansion_stack).gensyms.data[p->tok.integer];
     vector_append(p->tok.text, generated_sym);
+    p->tok.name = identifier_intern(as_span(generated_sym));
     // From this point on, matches TK_IDENTIFIER handling.
     p->tok.type = TK_IDENT;
     lhs = parse_ident_expr(p);
@@ -1804,7 +1821,7 @@ static Node *parse_expr_with_precedence(Parser *p, isz current_precedence) {
       next_token(p);
 
       if (p->tok.type != TK_IDENT) ERR("Expected identifier following \"export\"");
-      string ident = string_dup(p->tok.text);
+      string ident = p->tok.name;
 
       next_token(p);
       lhs = parse_declaration(p, ident, p->tok.source_location);
@@ -1902,11 +1919,12 @@ static Node *parse_expr_with_precedence(Parser *p, isz current_precedence) {
       /// If the next token can be the start of a <type-base>, then this is
       /// a type; parse the type and wrap it in a pointer type.
       if (p->tok.type == TK_IDENT) {
-        Symbol *sym = scope_find_symbol(curr_scope(p), as_span(p->tok.text), false);
+        Symbol *sym = scope_find_symbol(curr_scope(p), p->tok.name, false);
         if (sym && sym->kind == SYM_TYPE) {
-          Type *type = ast_make_type_named(p->ast, p->tok.source_location, sym);
+          loc type_loc = p->tok.source_location;
+          Type *type = ast_make_type_named(p->ast, type_loc, sym);
           next_token(p);
-          while (at_count--) type = ast_make_type_pointer(p->ast, p->tok.source_location, parse_type_derived(p, type));
+          while (at_count--) type = ast_make_type_pointer(p->ast, p->tok.source_location, parse_type_derived(p, type, type_loc));
           lhs = parse_type_expr(p, type);
           break;
         }
@@ -1994,14 +2012,14 @@ static Node *parse_expr_with_precedence(Parser *p, isz current_precedence) {
     /// The `as` operator is special because its RHS is a type.
     if (tt == TK_AS) {
       Type *type = parse_type(p);
-      lhs = ast_make_cast(p->ast, (loc){.start = lhs->source_location.start, .end = type->source_location.end}, type, lhs);
+      lhs = ast_make_cast(p->ast, (loc){.start = lhs->source_location.start, .end = p->type_location.end}, type, lhs);
       continue;
     }
 
     /// The `as` operator is special because its RHS is a type.
     if (tt == TK_DOT) {
       if (p->tok.type != TK_IDENT) ERR("RHS of operator '.' must be an identifier.");
-      lhs = ast_make_member_access(p->ast, (loc){.start = lhs->source_location.start, .end = p->tok.source_location.end}, as_span(p->tok.text), lhs);
+      lhs = ast_make_member_access(p->ast, (loc){.start = lhs->source_location.start, .end = p->tok.source_location.end}, p->tok.name, lhs);
       // Yeet identifier token
       next_token(p);
       continue;
@@ -173,17 +173,16 @@ typedef Vector(Candidate) OverloadSet;
 static OverloadSet collect_overload_set(Node *func) {
   OverloadSet overload_set = {0};
   for (Scope *scope = func->funcref.scope; scope; scope = scope->parent) {
-    foreach_val (sym, scope->symbols) {
+    Symbol *first = scope_find_symbol(scope, func->funcref.name, true);
+    for (Symbol *sym = first; sym; sym = sym->next_with_name) {
       if (sym->kind != SYM_FUNCTION) {
         continue;
       }
-      if (string_eq(sym->name, func->funcref.name)) {
-        Candidate s = {0};
-        s.symbol = sym;
-        s.score = 0;
-        s.validity = candidate_valid;
-        vector_push(overload_set, s);
-      }
+      Candidate s = {0};
+      s.symbol = sym;
+      s.score = 0;
+      s.validity = candidate_valid;
+      vector_push(overload_set, s);
     }
   }
   return overload_set;
@@ -316,7 +315,7 @@ NODISCARD static bool resolve_overload(
           eprint("No overload of %32%S%m with type %T", arg->funcref.name, param->type);
 
           /// Mark that we need to print the overload set of this function too.
-          span *ptr = vector_find_if(n, dependent_function_names, string_eq(*n, arg->funcref.name));
+          span *ptr = vector_find_if(n, dependent_function_names, n->data == arg->funcref.name.data);
           if (!ptr) {
             vector_push(dependent_functions, arg);
             vector_push(dependent_function_names, as_span(arg->funcref.name));
@@ -690,40 +689,42 @@ NODISCARD static bool resolve_function(Module *ast, Node *func) {
   goto done;
 }
 
-NODISCARD static bool typecheck_type(Module *ast, Type *t) {
+/// Check a type. `where` is where the type is used, since interned
+/// types have no source location of their own.
+NODISCARD static bool typecheck_type(Module *ast, Type *t, loc where) {
   if (t->type_checked) return true;
   t->type_checked = true;
   switch (t->kind) {
   default: ICE("Invalid type kind of type %T", t);
   case TYPE_PRIMITIVE: return true;
-  case TYPE_POINTER: return typecheck_type(ast, t->pointer.to);
-  case TYPE_REFERENCE: return typecheck_type(ast, t->reference.to);
+  case TYPE_POINTER: return typecheck_type(ast, t->pointer.to, where);
+  case TYPE_REFERENCE: return typecheck_type(ast, t->reference.to, where);
 
   case TYPE_NAMED: {
     if (t->named->val.type)
-      return typecheck_type(ast, t->named->val.type);
+      return typecheck_type(ast, t->named->val.type, where);
     return true;
   }
 
   case TYPE_FUNCTION:
-    if (!typecheck_type(ast, t->function.return_type)) return false;
+    if (!typecheck_type(ast, t->function.return_type, where)) return false;
     foreach (param, t->function.parameters) {
-      if (!typecheck_type(ast, param->type)) return false;
+      if (!typecheck_type(ast, param->type, param->source_location)) return false;
       if (type_is_incomplete(param->type))
         ERR(param->source_location, "Function parameter must not be of incomplete type");
     }
     return true;
 
   case TYPE_ARRAY:
-    if (!typecheck_type(ast, t->array.of)) return false;
+    if (!typecheck_type(ast, t->array.of, where)) return false;
     if (!t->array.size)
-      ERR(t->source_location,
+      ERR(where,
           "Cannot create array of zero size: %T", t);
     return true;
 
   case TYPE_STRUCT:
     foreach (member, t->structure.members) {
-      if (!typecheck_type(ast, member->type)) return false;
+      if (!typecheck_type(ast, member->type, member->source_location)) return false;
     }
 
     // If a struct already has it's alignment set, then we will keep the
@@ -748,11 +749,11 @@ NODISCARD static bool typecheck_type(Module *ast, Type *t) {
 
   case TYPE_INTEGER: {
     if (!t->integer.bit_width)
-      ERR(t->source_location, "Rejecting arbitrary integer of zero width: %T", t);
+      ERR(where, "Rejecting arbitrary integer of zero width: %T", t);
 
     // TODO: This should probably be backend-dependant.
     if (t->integer.bit_width > 64)
-      SORRY(t->source_location, "Rejecting arbitrary integer of width greater than 64: %T. This is a WIP, sorry!", t);
+      SORRY(where, "Rejecting arbitrary integer of width greater than 64: %T. This is a WIP, sorry!", t);
 
     return true;
   }
@@ -765,14 +766,26 @@ NODISCARD static bool typecheck_type(Module *ast, Type *t) {
 /// \param callee The callee to check.
 /// \return The intrinsic number if it is an intrinsic, or I_BUILTIN_COUNT otherwise.
 NODISCARD static enum IntrinsicKind intrinsic_kind(Node *callee) {
-    STATIC_ASSERT(INTRIN_COUNT == 7, "Handle all intrinsics in sema");
+    STATIC_ASSERT(INTRIN_COUNT == 8, "Handle all intrinsics in sema");
+    static struct {
+      span spelling;
+      enum IntrinsicKind kind;
+      const char *name;
+    } intrinsics[] = {
+      {literal_span_raw("__builtin_syscall"), INTRIN_BUILTIN_SYSCALL, NULL},
+      {literal_span_raw("__builtin_inline"), INTRIN_BUILTIN_INLINE, NULL},
+      {literal_span_raw("__builtin_line"), INTRIN_BUILTIN_LINE, NULL},
+      {literal_span_raw("__builtin_filename"), INTRIN_BUILTIN_FILENAME, NULL},
+      {literal_span_raw("__builtin_debugtrap"), INTRIN_BUILTIN_DEBUGTRAP, NULL},
+      {literal_span_raw("__builtin_memcpy"), INTRIN_BUILTIN_MEMCPY, NULL},
+    };
+
     if (callee->kind != NODE_FUNCTION_REFERENCE) return INTRIN_COUNT;
-    if (string_eq(callee->funcref.name, literal_span("__builtin_syscall"))) return INTRIN_BUILTIN_SYSCALL;
-    if (string_eq(callee->funcref.name, literal_span("__builtin_inline"))) return INTRIN_BUILTIN_INLINE;
-    if (string_eq(callee->funcref.name, literal_span("__builtin_line"))) return INTRIN_BUILTIN_LINE;
-    if (string_eq(callee->funcref.name, literal_span("__builtin_filename"))) return INTRIN_BUILTIN_FILENAME;
-    if (string_eq(callee->funcref.name, literal_span("__builtin_debugtrap"))) return INTRIN_BUILTIN_DEBUGTRAP;
-    if (string_eq(callee->funcref.name, literal_span("__builtin_memcpy"))) return INTRIN_BUILTIN_MEMCPY;
+    for (usz i = 0; i < sizeof intrinsics / sizeof *intrinsics; i++) {
+      /// Intern the names on first use so we can compare pointers.
+      if (!intrinsics[i].name) intrinsics[i].name = identifier_intern(intrinsics[i].spelling).data;
+      if (callee->funcref.name.data == intrinsics[i].name) return intrinsics[i].kind;
+    }
     return INTRIN_COUNT;
 }
 
@@ -798,12 +811,16 @@ NODISCARD static bool typecheck_intrinsic(Module *ast, Node *expr) {
     ASSERT(expr->kind == NODE_CALL);
     ASSERT(expr->call.callee->kind == NODE_FUNCTION_REFERENCE);
 
-    STATIC_ASSERT(INTRIN_COUNT == 7, "Handle all intrinsics in sema");
+    STATIC_ASSERT(INTRIN_COUNT == 8, "Handle all intrinsics in sema");
     switch (expr->call.intrinsic) {
         case INTRIN_COUNT:
         case INTRIN_BACKEND_COUNT:
           UNREACHABLE();
 
+        /// Only created by the optimiser.
+        case INTRIN_BUILTIN_MEMSET:
+          UNREACHABLE();
+
         /// This has 1-7 integer-sized arguments and returns an integer.
         case INTRIN_BUILTIN_SYSCALL: {
             if (expr->call.arguments.size < 1 || expr->call.arguments.size > 7)
@@ -890,7 +907,7 @@ NODISCARD static bool typecheck_intrinsic(Module *ast, Node *expr) {
             }
           );
 
-          string s = ast->strings.data[expr->literal.string_index];
+          string s = ast->strings.entries.data[expr->literal.string_index];
           expr->type = ast_make_type_array(ast, expr->source_location, t_byte, s.size + 1);
           return true;
         }
@@ -935,7 +952,7 @@ NODISCARD bool typecheck_expression(Module *ast, Node *expr) {
   if (expr->type_checked) return true;
   expr->type_checked = true;
 
-  if (expr->type && !typecheck_type(ast, expr->type)) return false;
+  if (expr->type && !typecheck_type(ast, expr->type, expr->source_location)) return false;
 
   /// Typecheck the expression.
   switch (expr->kind) {
@@ -1082,7 +1099,15 @@ NODISCARD bool typecheck_expression(Module *ast, Node *expr) {
           expr->declaration.init->type = expr->type;
         else if (expr->declaration.init->type->kind == TYPE_ARRAY &&
                  expr->declaration.init->type->array.of == t_integer_literal) {
-          expr->declaration.init->type->array.of = expr->type->array.of;
+          /// Array types are interned, so create a new one instead of
+          /// changing the element type of the literal’s type.
+          Type *literal_type = expr->declaration.init->type;
+          expr->declaration.init->type = ast_make_type_array(
+            ast,
+            expr->declaration.init->source_location,
+            expr->type->array.of,
+            literal_type->array.size
+          );
           foreach_val (node, expr->declaration.init->literal.compound) {
             node->type = expr->type->array.of;
           }
@@ -1090,7 +1115,7 @@ NODISCARD bool typecheck_expression(Module *ast, Node *expr) {
 
       } else if (!expr->type) ERR(expr->source_location, "Cannot infer type of declaration without initialiser");
 
-      if (!typecheck_type(ast, expr->type)) return false;
+      if (!typecheck_type(ast, expr->type, expr->source_location)) return false;
 
       /// Strip arrays and recursive typedefs.
       Type *base_type = type_canonical(expr->type);
@@ -1234,7 +1259,7 @@ NODISCARD bool typecheck_expression(Module *ast, Node *expr) {
       Type *t_to = expr->type;
       // TO any incomplete type is DISALLOWED
       if (type_is_incomplete(t_to))
-        ERR(t_to->source_location, "Cannot cast to incomplete type %T", t_to);
+        ERR(expr->source_location, "Cannot cast to incomplete type %T", t_to);
 
       if (!typecheck_expression(ast, expr->cast.value))
         return false;
@@ -1467,7 +1492,7 @@ NODISCARD bool typecheck_expression(Module *ast, Node *expr) {
       switch (expr->literal.type) {
       case TK_NUMBER: expr->type = t_integer_literal; break;
       case TK_STRING: {
-        string s = ast->strings.data[expr->literal.string_index];
+        string s = ast->strings.entries.data[expr->literal.string_index];
         expr->type = ast_make_type_array(ast, expr->source_location, t_byte, s.size + 1);
       } break;
       case TK_LBRACK:
@@ -1500,7 +1525,7 @@ NODISCARD bool typecheck_expression(Module *ast, Node *expr) {
 
     /// The type of a structure declaration is the type of the struct.
     case NODE_STRUCTURE_DECLARATION:
-      return typecheck_type(ast, expr->struct_decl->val.type);
+      return typecheck_type(ast, expr->struct_decl->val.type, expr->source_location);
 
     /// The type of a structure declaration is the type of the struct.
     case NODE_MEMBER_ACCESS: {
@@ -1534,7 +1559,7 @@ NODISCARD bool typecheck_expression(Module *ast, Node *expr) {
           else if (n->kind == NODE_FUNCTION_REFERENCE)
             name = &n->funcref.name;
           else ICE("Unexpected node type exported by module");
-          if (string_eq(*name, expr->member_access.ident)) {
+          if (name->data == expr->member_access.ident.data) {
             found = n;
             break;
           }
@@ -1548,12 +1573,12 @@ NODISCARD bool typecheck_expression(Module *ast, Node *expr) {
           expr->kind = NODE_VARIABLE_REFERENCE;
           expr->var = calloc(1, sizeof(Symbol));
           expr->var->kind = SYM_VARIABLE;
-          expr->var->name = string_dup(found->declaration.name);
+          expr->var->name = found->declaration.name;
           expr->var->val.node = found;
           expr->type = found->type;
         } else if (found->kind == NODE_FUNCTION_REFERENCE) {
           expr->kind = NODE_FUNCTION_REFERENCE;
-          expr->funcref.name = string_dup(found->funcref.name);
+          expr->funcref.name = found->funcref.name;
           expr->funcref.resolved = found->funcref.resolved;
           expr->funcref.scope = found->funcref.scope;
           expr->type = found->type;
@@ -1569,7 +1594,7 @@ NODISCARD bool typecheck_expression(Module *ast, Node *expr) {
               "Cannot access member of type %T", struct_type);
 
         Member *member = vector_find_if(m, struct_type->structure.members,
-                         string_eq(m->name, expr->member_access.ident));
+                         m->name.data == expr->member_access.ident.data);
         if (!member)
           ERR(expr->source_location,
               "Cannot access member \"%S\" that does not exist in \"%S\", an instance of %T",
@@ -8,6 +8,7 @@
 #include <codegen/machine_ir.h>
 #include <error.h>
 #include <inttypes.h>
+#include <platform.h>
 #include <utils.h>
 #include <vector.h>
 
@@ -35,6 +36,17 @@ string string_dup_impl(const char *src, usz size) {
   return dest;
 }
 
+/// Hash a string.
+u64 string_hash(span str) {
+  /// FNV-1a.
+  u64 h = 0xcbf29ce484222325ull;
+  for (usz i = 0; i < str.size; i++) {
+    h ^= (u8) str.data[i];
+    h *= 0x100000001b3ull;
+  }
+  return h;
+}
+
 /// Zero-terminate a string buffer. This is harder than it sounds.
 void string_buf_zterm(string_buffer *buf) {
   /// Push a zero to null-terminate the string. At the same time, the zero
@@ -423,3 +435,78 @@ char *strrstr(char *input, const char *token) {
   }
   return NULL;
 }
+
+/// Size of a regular arena chunk. Larger allocations get a chunk of their own.
+#define ARENA_CHUNK_SIZE ((usz) 64 * 1024)
+
+static ArenaChunk *arena_new_chunk(Arena *arena, usz size) {
+  ArenaChunk *chunk = malloc(sizeof(ArenaChunk) + size);
+  if (!chunk) ICE("Out of memory");
+  chunk->size = size;
+  chunk->next = arena->chunks;
+  arena->chunks = chunk;
+  arena->bytes_reserved += size;
+  return chunk;
+}
+
+void *arena_alloc(Arena *arena, usz size, usz alignment) {
+  ASSERT(alignment && (alignment & (alignment - 1)) == 0, "Alignment must be a power of two");
+  ASSERT(alignment <= 16, "Arena does not support alignments greater than 16");
+
+  /// Oversized allocations are given a dedicated chunk so that the
+  /// rest of the current chunk isn’t wasted.
+  if (size > ARENA_CHUNK_SIZE / 4) {
+    ArenaChunk *chunk = arena_new_chunk(arena, size);
+    arena->bytes_used += size;
+    memset(chunk->data, 0, size);
+    return chunk->data;
+  }
+
+  /// Start a new chunk if the current one is exhausted.
+  uintptr_t p = ((uintptr_t) arena->ptr + alignment - 1) & ~(uintptr_t) (alignment - 1);
+  if (!arena->ptr || p + size > (uintptr_t) arena->end) {
+    ArenaChunk *chunk = arena_new_chunk(arena, ARENA_CHUNK_SIZE);
+    arena->ptr = chunk->data;
+    arena->end = chunk->data + ARENA_CHUNK_SIZE;
+    p = (uintptr_t) arena->ptr;
+  }
+
+  arena->ptr = (char *) p + size;
+  arena->bytes_used += size;
+  memset((void *) p, 0, size);
+  return (void *) p;
+}
+
+void arena_free(Arena *arena) {
+  for (ArenaChunk *chunk = arena->chunks, *next; chunk; chunk = next) {
+    next = chunk->next;
+    free(chunk);
+  }
+  *arena = (Arena){0};
+}
+
+void *pool_alloc(Pool *pool, usz size, usz alignment) {
+  ASSERT(size >= sizeof(void *), "Pool objects must be able to hold a free list link");
+
+  /// Reuse a released object if there is one.
+  if (pool->free_list) {
+    void *ptr = pool->free_list;
+    ASAN_UNPOISON(ptr, size);
+    pool->free_list = *(void **) ptr;
+    memset(ptr, 0, size);
+    return ptr;
+  }
+
+  return arena_alloc(&pool->arena, size, alignment);
+}
+
+void pool_release(Pool *pool, void *ptr, usz size) {
+  *(void **) ptr = pool->free_list;
+  pool->free_list = ptr;
+  ASAN_POISON(ptr, size);
+}
+
+void pool_free(Pool *pool) {
+  arena_free(&pool->arena);
+  pool->free_list = NULL;
+}
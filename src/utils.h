@@ -113,6 +113,9 @@ NODISCARD
 string string_dup_impl(const char *src, usz size);
 #define string_dup(src) string_dup_impl((src).data, (src).size)
 
+/// Hash a string.
+NODISCARD u64 string_hash(span str);
+
 /// Zero-terminate a string buffer. This is harder than it sounds.
 void string_buf_zterm(string_buffer *buf);
 
@@ -173,6 +176,63 @@ static inline string_buffer as_string_buffer(string s) {
 /// Replace all occurences of a span with another span.
 void sb_replace(string_buffer *buf, span from, span to);
 
+/// ===========================================================================
+///  Arena allocator.
+/// ===========================================================================
+/// A chunk of memory owned by an arena.
+typedef struct ArenaChunk {
+  struct ArenaChunk *next;
+  usz size;
+  _Alignas(16) char data[];
+} ArenaChunk;
+
+/// Chunked bump allocator. Chunks are never moved or resized, so
+/// pointers returned by `arena_alloc()` remain valid until the
+/// arena is freed. All memory is released at once.
+typedef struct Arena {
+  ArenaChunk *chunks;
+  char *ptr;
+  char *end;
+
+  /// Number of bytes handed out by `arena_alloc()`.
+  usz bytes_used;
+
+  /// Total size of all chunks owned by this arena.
+  usz bytes_reserved;
+} Arena;
+
+/// Allocate zero-initialised memory from an arena.
+NODISCARD void *arena_alloc(Arena *arena, usz size, usz alignment);
+
+/// Allocate a zero-initialised object of type T from an arena.
+#define arena_new(arena, T) ((T *) arena_alloc((arena), sizeof(T), _Alignof(T)))
+
+/// Free all memory owned by an arena.
+void arena_free(Arena *arena);
+
+/// Pool of fixed-size objects backed by an arena. Released objects
+/// are threaded onto an intrusive free list and handed out again by
+/// later allocations; the memory itself is only returned to the system
+/// when the entire pool is freed.
+typedef struct Pool {
+  Arena arena;
+  void *free_list;
+} Pool;
+
+/// Allocate a zero-initialised object from a pool. All objects
+/// allocated from the same pool must have the same size.
+NODISCARD void *pool_alloc(Pool *pool, usz size, usz alignment);
+
+/// Allocate a zero-initialised object of type T from a pool.
+#define pool_new(pool, T) ((T *) pool_alloc((pool), sizeof(T), _Alignof(T)))
+
+/// Return an object of the given size to a pool. The object is
+/// poisoned if we’re compiling with ASAN.
+void pool_release(Pool *pool, void *ptr, usz size);
+
+/// Free all memory owned by a pool.
+void pool_free(Pool *pool);
+
 /// ===========================================================================
 ///  Other.
 /// ===========================================================================
@@ -378,9 +378,33 @@
 #define list_foreach_rev(it, list) \
   for (__typeof__(*(list).first) *it = (list).last; it; it = it->prev)
 
-/// Should eventually be a hash map implementation, but this is good enough for now.
-#define Map(key_t, value_t)      Vector(struct { key_t key; value_t value; })
-#define MultiMap(key_t, value_t) Vector(struct { key_t key; Vector(value_t) value; })
+/// ===========================================================================
+///  Maps
+/// ===========================================================================
+/// Maps are hash maps that store their entries densely in insertion order
+/// in `data`, just like a vector, and keep an open-addressing index (linear
+/// probing) of `u32`s on the side that maps hashes to entries. A slot in the
+/// index is 0 if it is empty and the index of the entry plus 1 otherwise.
+///
+/// Keys are hashed and compared bytewise, so they must not contain padding.
+///
+/// Since the entries are stored densely, a map can be iterated over in
+/// insertion order using `foreach` or `map_foreach`. Do *not* use any of
+/// the vector macros that add or remove elements on a map as that will
+/// desynchronise the index.
+#define Map(key_t, value_t) \
+  struct {                  \
+    struct {                \
+      key_t key;            \
+      value_t value;        \
+    } *data;                \
+    size_t size;            \
+    size_t capacity;        \
+    u32 *index;             \
+    size_t index_capacity;  \
+  }
+
+#define MultiMap(key_t, value_t) Map(key_t, Vector(value_t))
 
 /// Get the value type of a map.
 ///
@@ -391,51 +415,218 @@
 /// ```
 #define MapValue(map) __typeof__((map).data->value)
 
+/// Get the key type of a map.
+#define MapKey(map) __typeof__((map).data->key)
+
+/// Hash a key. Pointers and integers are by far the most common key
+/// types, so those get a fast path.
+static inline u64 map_impl_hash(const void *key, usz size) {
+  if (size == sizeof(u64)) {
+    u64 k;
+    memcpy(&k, key, sizeof k);
+    k ^= k >> 33;
+    k *= 0xff51afd7ed558ccdull;
+    k ^= k >> 33;
+    k *= 0xc4ceb9fe1a85ec53ull;
+    k ^= k >> 33;
+    return k;
+  }
+
+  /// FNV-1a.
+  u64 h = 0xcbf29ce484222325ull;
+  const u8 *bytes = key;
+  for (usz i = 0; i < size; i++) {
+    h ^= bytes[i];
+    h *= 0x100000001b3ull;
+  }
+  return h;
+}
+
+/// Find the index slot of a key. Returns a pointer to the slot that
+/// contains the key or to the empty slot where it would be inserted,
+/// or NULL if the map has no index yet.
+static inline u32 *map_impl_lookup(
+  u32 *index,
+  usz index_capacity,
+  const void *entries,
+  usz stride,
+  const void *key,
+  usz key_size
+) {
+  if (!index_capacity) return NULL;
+  usz mask = index_capacity - 1;
+  usz i = (usz) map_impl_hash(key, key_size) & mask;
+  while (index[i]) {
+    const char *entry = (const char *) entries + (index[i] - 1) * stride;
+    if (memcmp(entry, key, key_size) == 0) return index + i;
+    i = (i + 1) & mask;
+  }
+  return index + i;
+}
+
+/// Make sure there is room in the index for one more entry.
+static inline void map_impl_grow(
+  u32 **index,
+  usz *index_capacity,
+  const void *entries,
+  usz stride,
+  usz key_size,
+  usz size
+) {
+  /// Keep the load factor below 3/4.
+  if ((size + 1) * 4 <= *index_capacity * 3) return;
+  usz new_capacity = *index_capacity ? *index_capacity * 2 : 16;
+  free(*index);
+  *index = calloc(new_capacity, sizeof(u32));
+  *index_capacity = new_capacity;
+
+  /// Reinsert all entries.
+  for (usz e = 0; e < size; e++) {
+    const void *key = (const char *) entries + e * stride;
+    *map_impl_lookup(*index, new_capacity, entries, stride, key, key_size) = (u32) (e + 1);
+  }
+}
+
+/// Remove a key from the index and move the last entry into the
+/// hole that this leaves in the entry storage. Returns the index
+/// of the removed entry, or -1 if the key was not found.
+static inline isz map_impl_remove(
+  u32 *index,
+  usz index_capacity,
+  void *entries,
+  usz stride,
+  usz size,
+  const void *key,
+  usz key_size
+) {
+  u32 *slot = map_impl_lookup(index, index_capacity, entries, stride, key, key_size);
+  if (!slot || !*slot) return -1;
+  usz removed = *slot - 1;
+
+  /// Backward-shift deletion so we don’t need tombstones.
+  usz mask = index_capacity - 1;
+  usz hole = (usz) (slot - index);
+  for (usz j = (hole + 1) & mask; index[j]; j = (j + 1) & mask) {
+    const void *k = (const char *) entries + (index[j] - 1) * stride;
+    usz home = (usz) map_impl_hash(k, key_size) & mask;
+
+    /// Move the entry into the hole iff its home slot is not
+    /// cyclically in (hole, j].
+    bool in_range = hole <= j ? (home > hole && home <= j) : (home > hole || home <= j);
+    if (!in_range) {
+      index[hole] = index[j];
+      hole = j;
+    }
+  }
+  index[hole] = 0;
+
+  /// Move the last entry into the freed spot.
+  usz last = size - 1;
+  if (removed != last) {
+    char *dest = (char *) entries + removed * stride;
+    const char *src = (const char *) entries + last * stride;
+    *map_impl_lookup(index, index_capacity, entries, stride, src, key_size) = (u32) (removed + 1);
+    memcpy(dest, src, stride);
+  }
+
+  return (isz) removed;
+}
+
+#define map_impl_lookup_in(map, key_ptr) \
+  map_impl_lookup((map).index, (map).index_capacity, (map).data, sizeof *(map).data, (key_ptr), sizeof (map).data->key)
+
+#define map_impl_grow_in(map) \
+  map_impl_grow(&(map).index, &(map).index_capacity, (map).data, sizeof *(map).data, sizeof (map).data->key, (map).size)
+
+/// Get the slot for a key, adding a zero-initialised entry if it
+/// does not exist yet. Evaluates to the index of the entry.
+#define map_impl_entry(map, key_ptr) ({                             \
+  map_impl_grow_in(map);                                            \
+  u32 *_slot = map_impl_lookup_in(map, key_ptr);                    \
+  if (!*_slot) {                                                    \
+    vector_push((map), (__typeof__(*(map).data)){0});               \
+    memcpy(&vector_back((map)).key, (key_ptr), sizeof (map).data->key); \
+    *_slot = (u32) (map).size;                                      \
+  }                                                                 \
+  (usz) (*_slot - 1);                                               \
+})
+
 /// Set an element in a map.
-#define map_set(map, _key_, _val_)                                                                                     \
-  do {                                                                                                                 \
-    __typeof__(_key_) _key = _key_;                                                                                    \
-    __typeof__(_val_) _val = _val_;                                                                                    \
-    __typeof__(*(map).data) *_element_ptr = vector_find_if(el, (map), memcmp(&el->key, &(_key), sizeof el->key) == 0); \
-    if (_element_ptr) _element_ptr->value = _val;                                                                      \
-    else vector_push((map), (__typeof__(*_element_ptr)){.key = _key, .value = _val});                                  \
+#define map_set(map, _key_, _val_)                          \
+  do {                                                      \
+    MapKey(map) _key = (_key_);                             \
+    MapValue(map) _val = (_val_);                           \
+    usz _entry = map_impl_entry((map), &_key);              \
+    (map).data[_entry].value = _val;                        \
   } while (0)
 
-/// Get an element from a map.
-#define map_get(map, _key_) ({                                                                                       \
-  __typeof__(_key_) _key = _key_;                                                                                    \
-  __typeof__(*(map).data) *_element_ptr = vector_find_if(el, (map), memcmp(&el->key, &(_key), sizeof el->key) == 0); \
-  _element_ptr ? &_element_ptr->value : NULL;                                                                        \
+/// Get an element from a map. Returns a pointer to the value
+/// or NULL if the key is not in the map.
+#define map_get(map, _key_) ({                  \
+  MapKey(map) _key = (_key_);                   \
+  u32 *_slot = map_impl_lookup_in((map), &_key); \
+  _slot && *_slot                               \
+    ? &(map).data[*_slot - 1].value             \
+    : NULL;                                     \
 })
 
+/// Check if a map contains a key.
+#define map_contains(map, _key_) (map_get((map), (_key_)) != NULL)
+
 /// Insert an element into a multimap.
-#define mmap_insert(map, _key_, _val_)                                                                                 \
-  do {                                                                                                                 \
-    __typeof__(_key_) _key = _key_;                                                                                    \
-    __typeof__(_val_) _val = _val_;                                                                                    \
-    __typeof__(*(map).data) *_element_ptr = vector_find_if(el, (map), memcmp(&el->key, &(_key), sizeof el->key) == 0); \
-    if (_element_ptr) vector_push(_element_ptr->value, _val);                                                          \
-    else {                                                                                                             \
-      vector_push((map), (__typeof__(*_element_ptr)){0});                                                              \
-      _element_ptr = &vector_back((map));                                                                              \
-      _element_ptr->key = _key;                                                                                        \
-      vector_push(_element_ptr->value, _val);                                                                          \
-    }                                                                                                                  \
+#define mmap_insert(map, _key_, _val_)                             \
+  do {                                                             \
+    MapKey(map) _key = (_key_);                                    \
+    usz _entry = map_impl_entry((map), &_key);                     \
+    vector_push((map).data[_entry].value, (_val_));                \
   } while (0)
 
 /// Get an element from a map or insert a zero-initialised element otherwise.
-#define map_get_default(map, _key_) ({                                                                               \
-  __typeof__(_key_) _key = _key_;                                                                                    \
-  __typeof__(*(map).data) *_element_ptr = vector_find_if(el, (map), memcmp(&el->key, &(_key), sizeof el->key) == 0); \
-  if (!_element_ptr) {                                                                                               \
-    vector_push((map), (__typeof__(*(map).data)){0});                                                                \
-    _element_ptr = &vector_back((map));                                                                              \
-  }                                                                                                                  \
-  _element_ptr ? &_element_ptr->value : NULL;                                                                        \
+#define map_get_default(map, _key_) ({       \
+  MapKey(map) _key = (_key_);                \
+  usz _entry = map_impl_entry((map), &_key); \
+  &(map).data[_entry].value;                 \
 })
 
+/// Remove an element from a map. This may change the order of
+/// the remaining elements. Does nothing if the key is not present.
+#define map_remove(map, _key_)                                \
+  do {                                                        \
+    MapKey(map) _key = (_key_);                               \
+    isz _removed = map_impl_remove(                           \
+      (map).index,                                            \
+      (map).index_capacity,                                   \
+      (map).data,                                             \
+      sizeof *(map).data,                                     \
+      (map).size,                                             \
+      &_key,                                                  \
+      sizeof (map).data->key                                  \
+    );                                                        \
+    if (_removed >= 0) (map).size--;                          \
+  } while (0)
+
+/// Remove an element from a multimap and free its values.
+#define mmap_remove(map, _key_)                               \
+  do {                                                        \
+    MapKey(map) _mkey = (_key_);                              \
+    MapValue(map) *_values = map_get((map), _mkey);           \
+    if (_values) vector_delete(*_values);                     \
+    map_remove((map), _mkey);                                 \
+  } while (0)
+
+/// Iterate over the entries of a map in insertion order. Each entry
+/// has a `key` and a `value` field.
+#define map_foreach(entry, map) foreach (entry, (map))
+
+/// Get the number of elements in a map.
+#define map_size(map) ((map).size)
+
 /// Clear a map.
-#define map_clear(map) vector_clear((map))
+#define map_clear(map)                                                       \
+  do {                                                                       \
+    vector_clear((map));                                                     \
+    if ((map).index) memset((map).index, 0, (map).index_capacity * sizeof(u32)); \
+  } while (0)
 
 /// Clear a multimap.
 #define mmap_clear(map)                             \
@@ -445,7 +636,13 @@
   } while (0)
 
 /// Free a map.
-#define map_delete(map) vector_delete((map))
+#define map_delete(map)            \
+  do {                             \
+    vector_delete((map));          \
+    free((map).index);             \
+    (map).index = NULL;            \
+    (map).index_capacity = 0;      \
+  } while (0)
 
 /// Free a multimap.
 #define mmap_delete(map)                            \